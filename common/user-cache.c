@@ -0,0 +1,280 @@
+/* -*- Mode: C; indent-tabs-mode:nil; tab-width:4 -*-
+ *
+ * Copyright (C) 2026 LightDM contributors.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2 or version 3 of the License.
+ * See http://www.gnu.org/copyleft/lgpl.html the full text of the license.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib/gstdio.h>
+
+#include "user-cache.h"
+
+/* The cache file is a header, followed by a table of records sorted by
+ * username and then a pool of nul terminated strings the records point into.
+ * It is only read on the machine that wrote it so uses native byte order. */
+
+#define USER_CACHE_MAGIC "LDMUSR02"
+
+#define NO_STRING G_MAXUINT32
+
+enum
+{
+    STRING_NAME,
+    STRING_REAL_NAME,
+    STRING_HOME_DIRECTORY,
+    STRING_IMAGE,
+    STRING_LANGUAGE,
+    STRING_LAYOUTS,
+    STRING_SESSION,
+    N_STRINGS
+};
+
+typedef struct
+{
+    gchar magic[8];
+    guint32 n_records;
+    guint32 strings_length;
+    gint64 source_mtime;
+} UserCacheHeader;
+
+typedef struct
+{
+    guint32 uid;
+    guint32 gid;
+    guint32 strings[N_STRINGS];
+    guint32 padding;
+    gint64 dmrc_mtime;
+    gint64 face_mtime;
+} UserCacheRecord;
+
+struct UserCache
+{
+    /* Mapped cache file */
+    GMappedFile *file;
+
+    /* Pointers into the mapped file */
+    const UserCacheHeader *header;
+    const UserCacheRecord *records;
+    const gchar *strings;
+};
+
+UserCache *
+user_cache_open (const gchar *path)
+{
+    g_autoptr(GError) error = NULL;
+    GMappedFile *file = g_mapped_file_new (path, FALSE, &error);
+    if (!file)
+    {
+        if (!g_error_matches (error, G_FILE_ERROR, G_FILE_ERROR_NOENT))
+            g_warning ("Failed to open user cache %s: %s", path, error->message);
+        return NULL;
+    }
+
+    /* Check the file is complete before trusting any offsets in it */
+    gsize length = g_mapped_file_get_length (file);
+    const gchar *contents = g_mapped_file_get_contents (file);
+    const UserCacheHeader *header = (const UserCacheHeader *) contents;
+    if (length < sizeof (UserCacheHeader) ||
+        memcmp (header->magic, USER_CACHE_MAGIC, sizeof (header->magic)) != 0 ||
+        header->strings_length == 0 ||
+        header->n_records > (length - sizeof (UserCacheHeader)) / sizeof (UserCacheRecord) ||
+        sizeof (UserCacheHeader) + header->n_records * sizeof (UserCacheRecord) + header->strings_length != length ||
+        contents[length - 1] != '\0')
+    {
+        g_warning ("Ignoring invalid user cache %s", path);
+        g_mapped_file_unref (file);
+        return NULL;
+    }
+
+    UserCache *cache = g_malloc0 (sizeof (UserCache));
+    cache->file = file;
+    cache->header = header;
+    cache->records = (const UserCacheRecord *) (contents + sizeof (UserCacheHeader));
+    cache->strings = contents + sizeof (UserCacheHeader) + header->n_records * sizeof (UserCacheRecord);
+
+    return cache;
+}
+
+gint64
+user_cache_get_source_mtime (UserCache *cache)
+{
+    g_return_val_if_fail (cache != NULL, 0);
+    return cache->header->source_mtime;
+}
+
+static const gchar *
+get_string (UserCache *cache, const UserCacheRecord *record, int index)
+{
+    guint32 offset = record->strings[index];
+    if (offset == NO_STRING || offset >= cache->header->strings_length)
+        return NULL;
+    return cache->strings + offset;
+}
+
+gboolean
+user_cache_lookup (UserCache *cache, const gchar *name, UserCacheEntry *entry)
+{
+    g_return_val_if_fail (cache != NULL, FALSE);
+    g_return_val_if_fail (name != NULL, FALSE);
+    g_return_val_if_fail (entry != NULL, FALSE);
+
+    /* Records are sorted by name */
+    guint32 start = 0, end = cache->header->n_records;
+    while (start < end)
+    {
+        guint32 middle = start + (end - start) / 2;
+        const UserCacheRecord *record = &cache->records[middle];
+        int result = g_strcmp0 (name, get_string (cache, record, STRING_NAME));
+        if (result < 0)
+            end = middle;
+        else if (result > 0)
+            start = middle + 1;
+        else
+        {
+            entry->name = get_string (cache, record, STRING_NAME);
+            entry->real_name = get_string (cache, record, STRING_REAL_NAME);
+            entry->home_directory = get_string (cache, record, STRING_HOME_DIRECTORY);
+            entry->image = get_string (cache, record, STRING_IMAGE);
+            entry->language = get_string (cache, record, STRING_LANGUAGE);
+            entry->layouts = get_string (cache, record, STRING_LAYOUTS);
+            entry->session = get_string (cache, record, STRING_SESSION);
+            entry->uid = record->uid;
+            entry->gid = record->gid;
+            entry->dmrc_mtime = record->dmrc_mtime;
+            entry->face_mtime = record->face_mtime;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+void
+user_cache_free (UserCache *cache)
+{
+    if (!cache)
+        return;
+    g_mapped_file_unref (cache->file);
+    g_free (cache);
+}
+
+static guint32
+add_string (GString *strings, const gchar *value)
+{
+    if (!value)
+        return NO_STRING;
+
+    guint32 offset = strings->len;
+    g_string_append_len (strings, value, strlen (value) + 1);
+    return offset;
+}
+
+static gint
+compare_entry (gconstpointer a, gconstpointer b)
+{
+    const UserCacheEntry *entry_a = *((const UserCacheEntry **) a);
+    const UserCacheEntry *entry_b = *((const UserCacheEntry **) b);
+    return g_strcmp0 (entry_a->name, entry_b->name);
+}
+
+gboolean
+user_cache_save (const gchar *path, GPtrArray *entries, gint64 source_mtime, uid_t owner_uid, gid_t owner_gid, GError **error)
+{
+    g_return_val_if_fail (path != NULL, FALSE);
+    g_return_val_if_fail (entries != NULL, FALSE);
+
+    g_autoptr(GPtrArray) sorted_entries = g_ptr_array_sized_new (entries->len);
+    for (guint i = 0; i < entries->len; i++)
+    {
+        UserCacheEntry *entry = g_ptr_array_index (entries, i);
+        if (entry->name)
+            g_ptr_array_add (sorted_entries, entry);
+    }
+    g_ptr_array_sort (sorted_entries, compare_entry);
+
+    g_autoptr(GString) strings = g_string_new ("");
+    g_autofree UserCacheRecord *records = g_malloc0_n (sorted_entries->len, sizeof (UserCacheRecord));
+    for (guint i = 0; i < sorted_entries->len; i++)
+    {
+        UserCacheEntry *entry = g_ptr_array_index (sorted_entries, i);
+        UserCacheRecord *record = &records[i];
+
+        record->uid = entry->uid;
+        record->gid = entry->gid;
+        record->dmrc_mtime = entry->dmrc_mtime;
+        record->face_mtime = entry->face_mtime;
+        record->strings[STRING_NAME] = add_string (strings, entry->name);
+        record->strings[STRING_REAL_NAME] = add_string (strings, entry->real_name);
+        record->strings[STRING_HOME_DIRECTORY] = add_string (strings, entry->home_directory);
+        record->strings[STRING_IMAGE] = add_string (strings, entry->image);
+        record->strings[STRING_LANGUAGE] = add_string (strings, entry->language);
+        record->strings[STRING_LAYOUTS] = add_string (strings, entry->layouts);
+        record->strings[STRING_SESSION] = add_string (strings, entry->session);
+    }
+
+    /* Always have a terminating nul so the string pool can be validated */
+    if (strings->len == 0)
+        g_string_append_c (strings, '\0');
+
+    UserCacheHeader header;
+    memset (&header, 0, sizeof (header));
+    memcpy (header.magic, USER_CACHE_MAGIC, sizeof (header.magic));
+    header.n_records = sorted_entries->len;
+    header.strings_length = strings->len;
+    header.source_mtime = source_mtime;
+
+    g_autoptr(GByteArray) data = g_byte_array_new ();
+    g_byte_array_append (data, (const guint8 *) &header, sizeof (header));
+    g_byte_array_append (data, (const guint8 *) records, sorted_entries->len * sizeof (UserCacheRecord));
+    g_byte_array_append (data, (const guint8 *) strings->str, strings->len);
+
+    /* Written to a temporary file and renamed so readers mapping the old file
+     * are not affected and never see the file before it is owned by the reader */
+    g_autofree gchar *temp_path = g_strdup_printf ("%s.XXXXXX", path);
+    int fd = g_mkstemp_full (temp_path, O_RDWR, 0600);
+    if (fd < 0)
+    {
+        int errsv = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv), "Failed to create %s: %s", temp_path, g_strerror (errsv));
+        return FALSE;
+    }
+
+    gsize offset = 0;
+    while (offset < data->len)
+    {
+        ssize_t n_written = write (fd, data->data + offset, data->len - offset);
+        if (n_written < 0 && errno == EINTR)
+            continue;
+        if (n_written < 0)
+        {
+            int errsv = errno;
+            g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv), "Failed to write %s: %s", temp_path, g_strerror (errsv));
+            close (fd);
+            g_unlink (temp_path);
+            return FALSE;
+        }
+        offset += n_written;
+    }
+
+    /* Only the greeter user can read the cache */
+    if (geteuid () == 0 && fchown (fd, owner_uid, owner_gid) < 0)
+        g_warning ("Failed to set owner of %s: %s", temp_path, g_strerror (errno));
+    close (fd);
+
+    if (g_rename (temp_path, path) < 0)
+    {
+        int errsv = errno;
+        g_set_error (error, G_FILE_ERROR, g_file_error_from_errno (errsv), "Failed to rename %s to %s: %s", temp_path, path, g_strerror (errsv));
+        g_unlink (temp_path);
+        return FALSE;
+    }
+
+    return TRUE;
+}
@@ -0,0 +1,51 @@
+/*
+ * Copyright (C) 2026 LightDM contributors.
+ *
+ * This library is free software; you can redistribute it and/or modify it under
+ * the terms of the GNU Lesser General Public License as published by the Free
+ * Software Foundation; either version 2 or version 3 of the License.
+ * See http://www.gnu.org/copyleft/lgpl.html the full text of the license.
+ */
+
+#ifndef USER_CACHE_H_
+#define USER_CACHE_H_
+
+#include <glib.h>
+#include <sys/types.h>
+
+G_BEGIN_DECLS
+
+typedef struct UserCache UserCache;
+
+typedef struct
+{
+    const gchar *name;
+    const gchar *real_name;
+    const gchar *home_directory;
+    const gchar *image;
+    const gchar *language;
+    /* Newline separated keyboard layouts */
+    const gchar *layouts;
+    const gchar *session;
+    uid_t uid;
+    gid_t gid;
+    /* Modification times of ~/.dmrc and ~/.face, 0 if missing */
+    gint64 dmrc_mtime;
+    gint64 face_mtime;
+} UserCacheEntry;
+
+UserCache *user_cache_open (const gchar *path);
+
+gint64 user_cache_get_source_mtime (UserCache *cache);
+
+gboolean user_cache_lookup (UserCache *cache, const gchar *name, UserCacheEntry *entry);
+
+void user_cache_free (UserCache *cache);
+
+gboolean user_cache_save (const gchar *path, GPtrArray *entries, gint64 source_mtime, uid_t owner_uid, gid_t owner_gid, GError **error);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (UserCache, user_cache_free)
+
+G_END_DECLS
+
+#endif /* USER_CACHE_H_ */
@@ -14,12 +14,18 @@
 #include <config.h>
 
 #include <errno.h>
+#include <fcntl.h>
 #include <string.h>
+#include <unistd.h>
 #include <sys/utsname.h>
+#include <sys/stat.h>
 #include <pwd.h>
 #include <gio/gio.h>
+#include <glib/gstdio.h>
 
+#include "configuration.h"
 #include "dmrc.h"
+#include "user-cache.h"
 #include "user-list.h"
 
 enum
@@ -52,6 +58,7 @@ enum
     USER_ADDED,
     USER_CHANGED,
     USER_REMOVED,
+    LOADED,
     LAST_LIST_SIGNAL
 };
 static guint list_signals[LAST_LIST_SIGNAL] = { 0 };
@@ -83,8 +90,49 @@ typedef struct
     /* TRUE if have scanned users */
     gboolean have_users;
 
-    /* List of users */
-    GList *users;
+    /* TRUE if all users have been loaded */
+    gboolean loaded;
+
+    /* Cancellable for asynchronous loading */
+    GCancellable *cancellable;
+
+    /* Number of outstanding asynchronous loads */
+    guint n_loading;
+
+    /* Users being loaded asynchronously, keyed by accounts service path */
+    GHashTable *loading_users;
+
+    /* Users, sorted by display name */
+    GSequence *users;
+
+    /* Indexes into the user list */
+    GHashTable *users_by_name;
+    GHashTable *users_by_uid;
+    GHashTable *users_by_path;
+
+    /* Copy of the users returned by common_user_list_get_users (), rebuilt on demand */
+    GList *users_list;
+    gboolean users_list_changed;
+
+    /* Cache of user information written by the daemon */
+    UserCache *cache;
+
+    /* TRUE if the cache is newer than the password file */
+    gboolean cache_is_fresh;
+
+    /* File to write the user cache to */
+    gchar *cache_path;
+
+    /* User and group to own the user cache */
+    uid_t cache_uid;
+    gid_t cache_gid;
+
+    /* Timeout to write the user cache */
+    guint save_cache_timeout;
+
+    /* TRUE if the user cache is being written and if it needs to be written again after that */
+    gboolean saving_cache;
+    gboolean save_cache_again;
 
     /* List of sessions */
     GList *sessions;
@@ -139,6 +187,9 @@ typedef struct
 
     /* User default session */
     gchar *session;
+
+    /* Position in the user list, or NULL if not in it */
+    GSequenceIter *iter;
 } CommonUserPrivate;
 
 typedef struct
@@ -165,6 +216,9 @@ G_DEFINE_TYPE (CommonSession, common_session, G_TYPE_OBJECT)
 #define PASSWD_FILE      "/etc/passwd"
 #define USER_CONFIG_FILE "/etc/lightdm/users.conf"
 
+/* Time to wait for changes to settle before writing the user cache */
+#define SAVE_CACHE_DELAY 1
+
 static CommonUserList *singleton = NULL;
 
 /**
@@ -193,14 +247,17 @@ get_user_by_name (CommonUserList *user_list, const gchar *username)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
-    for (GList *link = priv->users; link; link = link->next)
-    {
-        CommonUser *user = link->data;
-        if (g_strcmp0 (common_user_get_name (user), username) == 0)
-            return user;
-    }
+    if (!username)
+        return NULL;
 
-    return NULL;
+    return g_hash_table_lookup (priv->users_by_name, username);
+}
+
+static CommonUser *
+get_user_by_uid (CommonUserList *user_list, uid_t uid)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    return g_hash_table_lookup (priv->users_by_uid, GUINT_TO_POINTER (uid));
 }
 
 static CommonUser *
@@ -208,21 +265,112 @@ get_user_by_path (CommonUserList *user_list, const gchar *path)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
-    for (GList *link = priv->users; link; link = link->next)
+    if (!path)
+        return NULL;
+
+    return g_hash_table_lookup (priv->users_by_path, path);
+}
+
+static gboolean
+has_value (gpointer key, gpointer value, gpointer user_data)
+{
+    return value == user_data;
+}
+
+static void schedule_save_cache (CommonUserList *user_list);
+
+/* Add a user to the lookup indexes */
+static void
+index_user (CommonUserList *user_list, CommonUser *user)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+
+    schedule_save_cache (user_list);
+    if (user_priv->name)
+        g_hash_table_insert (priv->users_by_name, g_strdup (user_priv->name), user);
+    g_hash_table_insert (priv->users_by_uid, GUINT_TO_POINTER ((uid_t) user_priv->uid), user);
+    if (user_priv->path)
+        g_hash_table_insert (priv->users_by_path, g_strdup (user_priv->path), user);
+}
+
+/* Remove a user from the lookup indexes */
+static void
+unindex_user (CommonUserList *user_list, CommonUser *user)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+
+    schedule_save_cache (user_list);
+
+    /* Only remove entries that still point to this user, another user may share the same key */
+    if (user_priv->name && g_hash_table_lookup (priv->users_by_name, user_priv->name) == user)
+        g_hash_table_remove (priv->users_by_name, user_priv->name);
+    if (g_hash_table_lookup (priv->users_by_uid, GUINT_TO_POINTER ((uid_t) user_priv->uid)) == user)
+        g_hash_table_remove (priv->users_by_uid, GUINT_TO_POINTER ((uid_t) user_priv->uid));
+    if (user_priv->path && g_hash_table_lookup (priv->users_by_path, user_priv->path) == user)
+        g_hash_table_remove (priv->users_by_path, user_priv->path);
+}
+
+/* Update the indexes after a user has changed, the name and UID may be modified by AccountsService */
+static void
+reindex_user (CommonUserList *user_list, CommonUser *user)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+
+    if (user_priv->name && g_hash_table_lookup (priv->users_by_name, user_priv->name) != user)
     {
-        CommonUser *user = link->data;
-        if (g_strcmp0 (GET_USER_PRIVATE (user)->path, path) == 0)
-            return user;
+        g_hash_table_foreach_remove (priv->users_by_name, has_value, user);
+        g_hash_table_insert (priv->users_by_name, g_strdup (user_priv->name), user);
+    }
+    if (g_hash_table_lookup (priv->users_by_uid, GUINT_TO_POINTER ((uid_t) user_priv->uid)) != user)
+    {
+        g_hash_table_foreach_remove (priv->users_by_uid, has_value, user);
+        g_hash_table_insert (priv->users_by_uid, GUINT_TO_POINTER ((uid_t) user_priv->uid), user);
     }
-
-    return NULL;
 }
 
 static gint
 compare_user (gconstpointer a, gconstpointer b)
 {
     CommonUser *user_a = (CommonUser *) a, *user_b = (CommonUser *) b;
-    return g_strcmp0 (common_user_get_display_name (user_a), common_user_get_display_name (user_b));
+
+    /* Break ties on the username so every user has a unique position */
+    gint result = g_strcmp0 (common_user_get_display_name (user_a), common_user_get_display_name (user_b));
+    if (result != 0)
+        return result;
+    return g_strcmp0 (common_user_get_name (user_a), common_user_get_name (user_b));
+}
+
+static gint
+compare_user_in_list (gconstpointer a, gconstpointer b, gpointer data)
+{
+    return compare_user (a, b);
+}
+
+/* Add a user to the sorted user list */
+static void
+insert_user (CommonUserList *user_list, CommonUser *user)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    GET_USER_PRIVATE (user)->iter = g_sequence_insert_sorted (priv->users, user, compare_user_in_list, NULL);
+    priv->users_list_changed = TRUE;
+}
+
+static void
+remove_user (CommonUserList *user_list, CommonUser *user)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+    CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+
+    if (!user_priv->iter)
+        return;
+
+    g_sequence_remove (user_priv->iter);
+    user_priv->iter = NULL;
+    priv->users_list_changed = TRUE;
 }
 
 static gboolean
@@ -274,9 +422,54 @@ get_logged_in_cb (CommonUser *user, CommonUserList *user_list)
 static void
 user_changed_cb (CommonUser *user, CommonUserList *user_list)
 {
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    /* Move the user if their display name changed */
+    GSequenceIter *iter = GET_USER_PRIVATE (user)->iter;
+    if (iter)
+    {
+        GSequenceIter *prev = g_sequence_iter_prev (iter), *next = g_sequence_iter_next (iter);
+        if ((prev != iter && compare_user (g_sequence_get (prev), user) > 0) ||
+            (!g_sequence_iter_is_end (next) && compare_user (user, g_sequence_get (next)) > 0))
+        {
+            g_sequence_sort_changed (iter, compare_user_in_list, NULL);
+            priv->users_list_changed = TRUE;
+        }
+    }
+
+    reindex_user (user_list, user);
+    schedule_save_cache (user_list);
     g_signal_emit (user_list, list_signals[USER_CHANGED], 0, user);
 }
 
+/* Modification time of a file or 0 if it can't be read */
+static gint64
+get_file_mtime (const gchar *path)
+{
+    GStatBuf file_stat;
+    if (g_stat (path, &file_stat) < 0)
+        return 0;
+    return file_stat.st_mtime;
+}
+
+static gchar *
+find_image (const gchar *home_directory)
+{
+    gchar *image = g_build_filename (home_directory, ".face", NULL);
+    if (!g_file_test (image, G_FILE_TEST_EXISTS))
+    {
+        g_free (image);
+        image = g_build_filename (home_directory, ".face.icon", NULL);
+        if (!g_file_test (image, G_FILE_TEST_EXISTS))
+        {
+            g_free (image);
+            image = NULL;
+        }
+    }
+
+    return image;
+}
+
 static CommonUser *
 make_passwd_user (CommonUserList *user_list, struct passwd *entry)
 {
@@ -292,16 +485,37 @@ make_passwd_user (CommonUserList *user_list, struct passwd *entry)
     else
         real_name = g_strdup ("");
 
-    gchar *image = g_build_filename (entry->pw_dir, ".face", NULL);
-    if (!g_file_test (image, G_FILE_TEST_EXISTS))
+    /* Use the cached information if it still matches the password entry and the user's files */
+    CommonUserListPrivate *list_priv = GET_LIST_PRIVATE (user_list);
+    UserCacheEntry cached;
+    gboolean have_cached = list_priv->cache_is_fresh &&
+                           user_cache_lookup (list_priv->cache, entry->pw_name, &cached) &&
+                           cached.uid == entry->pw_uid &&
+                           g_strcmp0 (cached.home_directory, entry->pw_dir) == 0;
+    if (have_cached)
     {
-        g_free (image);
-        image = g_build_filename (entry->pw_dir, ".face.icon", NULL);
-        if (!g_file_test (image, G_FILE_TEST_EXISTS))
+        g_autofree gchar *dmrc_path = g_build_filename (entry->pw_dir, ".dmrc", NULL);
+        g_autofree gchar *face_path = g_build_filename (entry->pw_dir, ".face", NULL);
+        have_cached = cached.dmrc_mtime == get_file_mtime (dmrc_path) &&
+                      cached.face_mtime == get_file_mtime (face_path);
+    }
+
+    gchar *image;
+    if (have_cached)
+        image = g_strdup (cached.image);
+    else
+        image = find_image (entry->pw_dir);
+
+    if (have_cached)
+    {
+        priv->loaded_dmrc = TRUE;
+        priv->language = g_strdup (cached.language);
+        if (cached.layouts && cached.layouts[0] != '\0')
         {
-            g_free (image);
-            image = NULL;
+            g_strfreev (priv->layouts);
+            priv->layouts = g_strsplit (cached.layouts, "\n", -1);
         }
+        priv->session = g_strdup (cached.session);
     }
 
     priv->name = g_strdup (entry->pw_name);
@@ -342,9 +556,18 @@ load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
         hidden_shells_list = g_strdup ("/bin/false /usr/sbin/nologin");
     g_auto(GStrv) hidden_shells = g_strsplit (hidden_shells_list, " ", -1);
 
+    /* The cache is only valid if written after the last password change */
+    if (priv->cache)
+    {
+        struct stat passwd_stat;
+        priv->cache_is_fresh = stat (PASSWD_FILE, &passwd_stat) == 0 &&
+                               passwd_stat.st_mtime <= user_cache_get_source_mtime (priv->cache);
+    }
+
     setpwent ();
 
-    GList *users = NULL, *new_users = NULL, *changed_users = NULL;
+    g_autoptr(GHashTable) seen_names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    GList *new_users = NULL, *changed_users = NULL;
     while (TRUE)
     {
         errno = 0;
@@ -371,29 +594,24 @@ load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
         if (hidden_users[i])
             continue;
 
+        /* Skip duplicate entries, the first one wins as with getpwnam() */
+        if (g_hash_table_contains (seen_names, entry->pw_name))
+            continue;
+        g_hash_table_add (seen_names, g_strdup (entry->pw_name));
+
         CommonUser *user = make_passwd_user (user_list, entry);
 
         /* Update existing users if have them */
-        GList *link;
-        for (link = priv->users; link; link = link->next)
-        {
-            CommonUser *info = link->data;
-            if (strcmp (common_user_get_name (info), common_user_get_name (user)) == 0)
-            {
-                if (update_passwd_user (info, common_user_get_real_name (user), common_user_get_home_directory (user), common_user_get_shell (user), common_user_get_image (user)))
-                    changed_users = g_list_insert_sorted (changed_users, info, compare_user);
-                g_object_unref (user);
-                user = info;
-                break;
-            }
-        }
-        if (!link)
+        CommonUser *info = get_user_by_name (user_list, common_user_get_name (user));
+        if (info)
         {
-            /* Only notify once we have loaded the user list */
-            if (priv->have_users)
-                new_users = g_list_insert_sorted (new_users, user, compare_user);
+            if (update_passwd_user (info, common_user_get_real_name (user), common_user_get_home_directory (user), common_user_get_shell (user), common_user_get_image (user)))
+                changed_users = g_list_prepend (changed_users, info);
+            g_object_unref (user);
+            user = info;
         }
-        users = g_list_insert_sorted (users, user, compare_user);
+        else
+            new_users = g_list_prepend (new_users, user);
     }
 
     if (errno != 0)
@@ -401,20 +619,25 @@ load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
 
     endpwent ();
 
-    /* Use new user list */
-    GList *old_users = priv->users;
-    priv->users = users;
-
-    /* Notify of changes */
-    for (GList *link = new_users; link; link = link->next)
+    /* Update the list one user at a time so it always matches the signals
+     * already emitted, listeners use the position of each user in the list */
+    GSequenceIter *iter = g_sequence_get_begin_iter (priv->users);
+    while (!g_sequence_iter_is_end (iter))
     {
-        CommonUser *info = link->data;
-        g_debug ("User %s added", common_user_get_name (info));
-        g_signal_connect (info, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), user_list);
-        if (emit_add_signal)
-            g_signal_emit (user_list, list_signals[USER_ADDED], 0, info);
+        GSequenceIter *next = g_sequence_iter_next (iter);
+        CommonUser *info = g_sequence_get (iter);
+
+        if (!g_hash_table_contains (seen_names, common_user_get_name (info)))
+        {
+            remove_user (user_list, info);
+            unindex_user (user_list, info);
+            g_debug ("User %s removed", common_user_get_name (info));
+            g_signal_emit (user_list, list_signals[USER_REMOVED], 0, info);
+            g_object_unref (info);
+        }
+        iter = next;
     }
-    g_list_free (new_users);
+    changed_users = g_list_sort (changed_users, compare_user);
     for (GList *link = changed_users; link; link = link->next)
     {
         CommonUser *info = link->data;
@@ -422,25 +645,25 @@ load_passwd_file (CommonUserList *user_list, gboolean emit_add_signal)
         g_signal_emit (info, user_signals[CHANGED], 0);
     }
     g_list_free (changed_users);
-    for (GList *link = old_users; link; link = link->next)
+
+    /* Add the new users in display order */
+    new_users = g_list_sort (new_users, compare_user);
+    for (GList *link = new_users; link; link = link->next)
     {
-        /* See if this user is in the current list */
-        GList *new_link;
-        for (new_link = priv->users; new_link; new_link = new_link->next)
-        {
-            if (new_link->data == link->data)
-                break;
-        }
+        CommonUser *info = link->data;
 
-        if (!new_link)
-        {
-            CommonUser *info = link->data;
-            g_debug ("User %s removed", common_user_get_name (info));
-            g_signal_emit (user_list, list_signals[USER_REMOVED], 0, info);
-            g_object_unref (info);
-        }
+        insert_user (user_list, info);
+        index_user (user_list, info);
+
+        g_debug ("User %s added", common_user_get_name (info));
+        g_signal_connect (info, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), user_list);
+        if (emit_add_signal)
+            g_signal_emit (user_list, list_signals[USER_ADDED], 0, info);
     }
-    g_list_free (old_users);
+    g_list_free (new_users);
+
+    /* Record the new password file time even if no users changed */
+    schedule_save_cache (user_list);
 }
 
 static void
@@ -475,12 +698,11 @@ accounts_user_changed_cb (GDBusConnection *connection,
         g_signal_emit (user, user_signals[CHANGED], 0);
 }
 
-static gboolean
-load_accounts_user (CommonUser *user)
+static void
+subscribe_accounts_user (CommonUser *user)
 {
     CommonUserPrivate *priv = GET_USER_PRIVATE (user);
 
-    /* Get the properties for this user */
     if (!priv->changed_signal)
         priv->changed_signal = g_dbus_connection_signal_subscribe (priv->bus,
                                                                    "org.freedesktop.Accounts",
@@ -492,23 +714,13 @@ load_accounts_user (CommonUser *user)
                                                                    accounts_user_changed_cb,
                                                                    user,
                                                                    NULL);
+}
 
-    g_autoptr(GError) error = NULL;
-    g_autoptr(GVariant) result = g_dbus_connection_call_sync (priv->bus,
-                                                              "org.freedesktop.Accounts",
-                                                              priv->path,
-                                                              "org.freedesktop.DBus.Properties",
-                                                              "GetAll",
-                                                              g_variant_new ("(s)", "org.freedesktop.Accounts.User"),
-                                                              G_VARIANT_TYPE ("(a{sv})"),
-                                                              G_DBUS_CALL_FLAGS_NONE,
-                                                              -1,
-                                                              NULL,
-                                                              &error);
-    if (error)
-        g_warning ("Error updating user %s: %s", priv->path, error->message);
-    if (!result)
-        return FALSE;
+/* Store the properties from org.freedesktop.Accounts.User, returns FALSE if this is a system account */
+static gboolean
+update_accounts_user (CommonUser *user, GVariant *result)
+{
+    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
 
     /* Store the properties we need */
     GVariantIter *iter;
@@ -563,6 +775,71 @@ load_accounts_user (CommonUser *user)
     }
     g_variant_iter_free (iter);
 
+    return !system_account;
+}
+
+/* Store the properties from the org.freedesktop.DisplayManager.AccountsService extension */
+static void
+update_accounts_user_extra (CommonUser *user, GVariant *result)
+{
+    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+
+    GVariantIter *iter;
+    g_variant_get (result, "(a{sv})", &iter);
+    const gchar *name;
+    GVariant *value;
+    while (g_variant_iter_loop (iter, "{&sv}", &name, &value))
+    {
+        if (strcmp (name, "BackgroundFile") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
+        {
+            g_free (priv->background);
+            priv->background = g_variant_dup_string (value, NULL);
+            if (strcmp (priv->background, "") == 0)
+                g_clear_pointer (&priv->background, g_free);
+        }
+        else if (strcmp (name, "HasMessages") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+            priv->has_messages = g_variant_get_boolean (value);
+        else if (strcmp (name, "KeyboardLayouts") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING_ARRAY))
+        {
+            g_strfreev (priv->layouts);
+            priv->layouts = g_variant_dup_strv (value, NULL);
+            if (!priv->layouts)
+            {
+                priv->layouts = g_malloc (sizeof (gchar *) * 1);
+                priv->layouts[0] = NULL;
+            }
+        }
+    }
+    g_variant_iter_free (iter);
+}
+
+static gboolean
+load_accounts_user (CommonUser *user)
+{
+    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+
+    /* Get the properties for this user */
+    subscribe_accounts_user (user);
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) result = g_dbus_connection_call_sync (priv->bus,
+                                                              "org.freedesktop.Accounts",
+                                                              priv->path,
+                                                              "org.freedesktop.DBus.Properties",
+                                                              "GetAll",
+                                                              g_variant_new ("(s)", "org.freedesktop.Accounts.User"),
+                                                              G_VARIANT_TYPE ("(a{sv})"),
+                                                              G_DBUS_CALL_FLAGS_NONE,
+                                                              -1,
+                                                              NULL,
+                                                              &error);
+    if (error)
+        g_warning ("Error updating user %s: %s", priv->path, error->message);
+    if (!result)
+        return FALSE;
+
+    gboolean is_login_user = update_accounts_user (user, result);
+
     g_autoptr(GVariant) extra_result = g_dbus_connection_call_sync (priv->bus,
                                                                     "org.freedesktop.Accounts",
                                                                     priv->path,
@@ -576,34 +853,10 @@ load_accounts_user (CommonUser *user)
                                                                     &error);
     if (error)
         g_warning ("Error updating user %s: %s", priv->path, error->message);
-    if (extra_result) {
-        g_variant_get (extra_result, "(a{sv})", &iter);
-        while (g_variant_iter_loop (iter, "{&sv}", &name, &value))
-        {
-            if (strcmp (name, "BackgroundFile") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING))
-            {
-                g_free (priv->background);
-                priv->background = g_variant_dup_string (value, NULL);
-                if (strcmp (priv->background, "") == 0)
-                    g_clear_pointer (&priv->background, g_free);
-            }
-            else if (strcmp (name, "HasMessages") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
-                priv->has_messages = g_variant_get_boolean (value);
-            else if (strcmp (name, "KeyboardLayouts") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_STRING_ARRAY))
-            {
-                g_strfreev (priv->layouts);
-                priv->layouts = g_variant_dup_strv (value, NULL);
-                if (!priv->layouts)
-                {
-                    priv->layouts = g_malloc (sizeof (gchar *) * 1);
-                    priv->layouts[0] = NULL;
-                }
-            }
-        }
-        g_variant_iter_free (iter);
-    }
+    if (extra_result)
+        update_accounts_user_extra (user, extra_result);
 
-    return !system_account;
+    return is_login_user;
 }
 
 static void
@@ -621,7 +874,8 @@ add_accounts_user (CommonUserList *user_list, const gchar *path, gboolean emit_s
     g_signal_connect (user, "get-logged-in", G_CALLBACK (get_logged_in_cb), user_list);
     if (load_accounts_user (user))
     {
-        list_priv->users = g_list_insert_sorted (list_priv->users, user, compare_user);
+        insert_user (user_list, user);
+        index_user (user_list, user);
         if (emit_signal)
             g_signal_emit (user_list, list_signals[USER_ADDED], 0, user);
     }
@@ -651,7 +905,7 @@ accounts_user_added_cb (GDBusConnection *connection,
 
     /* Add user if we haven't got them */
     CommonUser *user = get_user_by_path (user_list, path);
-    if (!user)
+    if (!user && !g_hash_table_contains (GET_LIST_PRIVATE (user_list)->loading_users, path))
         add_accounts_user (user_list, path, TRUE);
 }
 
@@ -676,12 +930,16 @@ accounts_user_deleted_cb (GDBusConnection *connection,
     const gchar *path;
     g_variant_get (parameters, "(&o)", &path);
 
+    /* Stop any load in progress */
+    g_hash_table_remove (priv->loading_users, path);
+
     /* Delete user if we know of them */
     CommonUser *user = get_user_by_path (user_list, path);
     if (user)
     {
         g_debug ("User %s deleted", path);
-        priv->users = g_list_remove (priv->users, user);
+        remove_user (user_list, user);
+        unindex_user (user_list, user);
 
         g_signal_emit (user_list, list_signals[USER_REMOVED], 0, user);
 
@@ -854,15 +1112,10 @@ load_sessions (CommonUserList *user_list)
 }
 
 static void
-load_users (CommonUserList *user_list)
+subscribe_accounts (CommonUserList *user_list)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
-    if (priv->have_users)
-        return;
-    priv->have_users = TRUE;
-
-    /* Get user list from accounts service and fall back to /etc/passwd if that fails */
     priv->user_added_signal = g_dbus_connection_signal_subscribe (priv->bus,
                                                                   "org.freedesktop.Accounts",
                                                                   "org.freedesktop.Accounts",
@@ -883,6 +1136,42 @@ load_users (CommonUserList *user_list)
                                                                     accounts_user_deleted_cb,
                                                                     user_list,
                                                                     NULL);
+}
+
+/* Fall back to /etc/passwd when the accounts service is not available */
+static void
+load_passwd_users (CommonUserList *user_list, gboolean emit_add_signal)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_added_signal);
+    priv->user_added_signal = 0;
+    g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_removed_signal);
+    priv->user_removed_signal = 0;
+
+    load_passwd_file (user_list, emit_add_signal);
+
+    /* Watch for changes to user list */
+    g_autoptr(GFile) passwd_file = g_file_new_for_path (PASSWD_FILE);
+    g_autoptr(GError) e = NULL;
+    priv->passwd_monitor = g_file_monitor (passwd_file, G_FILE_MONITOR_NONE, NULL, &e);
+    if (e)
+        g_warning ("Error monitoring %s: %s", PASSWD_FILE, e->message);
+    else
+        g_signal_connect (priv->passwd_monitor, "changed", G_CALLBACK (passwd_changed_cb), user_list);
+}
+
+static void
+load_users (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    if (priv->have_users)
+        return;
+    priv->have_users = TRUE;
+
+    /* Get user list from accounts service and fall back to /etc/passwd if that fails */
+    subscribe_accounts (user_list);
 
     g_autoptr(GError) error = NULL;
     g_autoptr(GVariant) result = g_dbus_connection_call_sync (priv->bus,
@@ -909,25 +1198,509 @@ load_users (CommonUserList *user_list)
         g_variant_iter_free (iter);
     }
     else
+        load_passwd_users (user_list, FALSE);
+
+    priv->loaded = TRUE;
+}
+
+typedef struct
+{
+    CommonUserList *user_list;
+
+    /* User being loaded */
+    CommonUser *user;
+
+    /* Replies to the GetAll calls */
+    GVariant *result;
+    GVariant *extra_result;
+
+    /* Number of calls still to complete */
+    gint n_pending;
+
+    /* TRUE if the user list was destroyed while loading */
+    gboolean cancelled;
+} LoadUserRequest;
+
+static void
+load_finished (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    priv->n_loading--;
+    if (priv->n_loading > 0)
+        return;
+
+    g_debug ("Loaded %d users from org.freedesktop.Accounts", g_sequence_get_length (priv->users));
+    priv->loaded = TRUE;
+    g_signal_emit (user_list, list_signals[LOADED], 0);
+}
+
+static void
+load_user_request_complete (LoadUserRequest *request)
+{
+    request->n_pending--;
+    if (request->n_pending > 0)
+        return;
+
+    if (!request->cancelled)
     {
-        g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_added_signal);
-        priv->user_added_signal = 0;
-        g_dbus_connection_signal_unsubscribe (priv->bus, priv->user_removed_signal);
-        priv->user_removed_signal = 0;
+        CommonUserList *user_list = request->user_list;
+        CommonUserListPrivate *list_priv = GET_LIST_PRIVATE (user_list);
+        CommonUser *user = request->user;
+        const gchar *path = GET_USER_PRIVATE (user)->path;
+
+        /* Only add if not deleted or added by a signal while loading */
+        gboolean still_wanted = g_hash_table_lookup (list_priv->loading_users, path) == request;
+        if (still_wanted)
+            g_hash_table_remove (list_priv->loading_users, path);
+
+        if (still_wanted && request->result && update_accounts_user (user, request->result))
+        {
+            if (request->extra_result)
+                update_accounts_user_extra (user, request->extra_result);
+            subscribe_accounts_user (user);
+
+            insert_user (user_list, g_object_ref (user));
+            index_user (user_list, user);
+            g_signal_emit (user_list, list_signals[USER_ADDED], 0, user);
+        }
+
+        load_finished (user_list);
+    }
+
+    g_clear_pointer (&request->result, g_variant_unref);
+    g_clear_pointer (&request->extra_result, g_variant_unref);
+    g_object_unref (request->user);
+    g_free (request);
+}
+
+static void
+get_user_properties_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    LoadUserRequest *request = data;
+
+    g_autoptr(GError) error = NULL;
+    request->result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), result, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        request->cancelled = TRUE;
+    else if (error)
+        g_warning ("Error updating user %s: %s", GET_USER_PRIVATE (request->user)->path, error->message);
+
+    load_user_request_complete (request);
+}
+
+static void
+get_user_extra_properties_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    LoadUserRequest *request = data;
+
+    g_autoptr(GError) error = NULL;
+    request->extra_result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), result, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        request->cancelled = TRUE;
+    else if (error)
+        g_warning ("Error updating user %s: %s", GET_USER_PRIVATE (request->user)->path, error->message);
+
+    load_user_request_complete (request);
+}
+
+static void
+load_accounts_user_async (CommonUserList *user_list, const gchar *path)
+{
+    CommonUserListPrivate *list_priv = GET_LIST_PRIVATE (user_list);
+
+    if (get_user_by_path (user_list, path) || g_hash_table_contains (list_priv->loading_users, path))
+        return;
+
+    CommonUser *user = g_object_new (COMMON_TYPE_USER, NULL);
+    CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+
+    priv->bus = g_object_ref (list_priv->bus);
+    priv->path = g_strdup (path);
+    g_signal_connect (user, USER_SIGNAL_CHANGED, G_CALLBACK (user_changed_cb), user_list);
+    g_signal_connect (user, "get-logged-in", G_CALLBACK (get_logged_in_cb), user_list);
+
+    LoadUserRequest *request = g_malloc0 (sizeof (LoadUserRequest));
+    request->user_list = user_list;
+    request->user = user;
+    request->n_pending = 2;
+    g_hash_table_insert (list_priv->loading_users, g_strdup (path), request);
+    list_priv->n_loading++;
+
+    /* Both calls are sent immediately, so the requests for all users are pipelined on the bus */
+    g_dbus_connection_call (priv->bus,
+                            "org.freedesktop.Accounts",
+                            priv->path,
+                            "org.freedesktop.DBus.Properties",
+                            "GetAll",
+                            g_variant_new ("(s)", "org.freedesktop.Accounts.User"),
+                            G_VARIANT_TYPE ("(a{sv})"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            list_priv->cancellable,
+                            get_user_properties_cb,
+                            request);
+    g_dbus_connection_call (priv->bus,
+                            "org.freedesktop.Accounts",
+                            priv->path,
+                            "org.freedesktop.DBus.Properties",
+                            "GetAll",
+                            g_variant_new ("(s)", "org.freedesktop.DisplayManager.AccountsService"),
+                            G_VARIANT_TYPE ("(a{sv})"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            list_priv->cancellable,
+                            get_user_extra_properties_cb,
+                            request);
+}
+
+static void
+list_cached_users_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    CommonUserList *user_list = data;
+    if (error)
+        g_warning ("Error getting user list from org.freedesktop.Accounts: %s", error->message);
+    if (result)
+    {
+        g_debug ("Loading users from org.freedesktop.Accounts");
+        GVariantIter *iter;
+        g_variant_get (result, "(ao)", &iter);
+        const gchar *path;
+        while (g_variant_iter_loop (iter, "&o", &path))
+            load_accounts_user_async (user_list, path);
+        g_variant_iter_free (iter);
+    }
+    else
+        load_passwd_users (user_list, TRUE);
+
+    load_finished (user_list);
+}
+
+/**
+ * common_user_list_load_async:
+ * @user_list: A #CommonUserList
+ *
+ * Start loading the users without blocking.  Users are reported with the
+ * ::user-added signal as they arrive and ::loaded is emitted once all users
+ * are known.  Until then common_user_list_get_users() only returns the users
+ * loaded so far.  Does nothing if the users are already loaded or loading.
+ **/
+void
+common_user_list_load_async (CommonUserList *user_list)
+{
+    g_return_if_fail (COMMON_IS_USER_LIST (user_list));
+
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    if (priv->have_users)
+        return;
+    priv->have_users = TRUE;
+
+    subscribe_accounts (user_list);
+
+    priv->n_loading = 1;
+    g_dbus_connection_call (priv->bus,
+                            "org.freedesktop.Accounts",
+                            "/org/freedesktop/Accounts",
+                            "org.freedesktop.Accounts",
+                            "ListCachedUsers",
+                            g_variant_new ("()"),
+                            G_VARIANT_TYPE ("(ao)"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            priv->cancellable,
+                            list_cached_users_cb,
+                            user_list);
+}
+
+/**
+ * common_user_list_get_is_loaded:
+ * @user_list: A #CommonUserList
+ *
+ * Check if all users have been loaded.
+ *
+ * Return value: #TRUE if the user list is complete.
+ **/
+gboolean
+common_user_list_get_is_loaded (CommonUserList *user_list)
+{
+    g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), FALSE);
+    return GET_LIST_PRIVATE (user_list)->loaded;
+}
 
-        load_passwd_file (user_list, FALSE);
+typedef struct
+{
+    /* Users to write, the strings are stored in the chunk */
+    GPtrArray *entries;
+    GStringChunk *strings;
+
+    /* Directory with copies of the users' .dmrc files */
+    gchar *dmrc_cache_dir;
+
+    gchar *path;
+    gint64 source_mtime;
+    uid_t owner_uid;
+    gid_t owner_gid;
+} SaveCacheData;
 
-        /* Watch for changes to user list */
-        g_autoptr(GFile) passwd_file = g_file_new_for_path (PASSWD_FILE);
-        g_autoptr(GError) e = NULL;
-        priv->passwd_monitor = g_file_monitor (passwd_file, G_FILE_MONITOR_NONE, NULL, &e);
-        if (e)
-            g_warning ("Error monitoring %s: %s", PASSWD_FILE, e->message);
+static void
+save_cache_data_free (SaveCacheData *data)
+{
+    g_ptr_array_unref (data->entries);
+    g_string_chunk_free (data->strings);
+    g_free (data->dmrc_cache_dir);
+    g_free (data->path);
+    g_free (data);
+}
+
+static const gchar *
+insert_string (GStringChunk *chunk, const gchar *value)
+{
+    return value ? g_string_chunk_insert_const (chunk, value) : NULL;
+}
+
+/* Copy the password information for the users so the rest can be filled in from another thread */
+static SaveCacheData *
+make_save_cache_data (CommonUserList *user_list, const gchar *path)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    g_autofree gchar *cache_dir = config_get_string (config_get_instance (), "LightDM", "cache-directory");
+
+    SaveCacheData *data = g_malloc0 (sizeof (SaveCacheData));
+    data->entries = g_ptr_array_new_with_free_func (g_free);
+    data->strings = g_string_chunk_new (1024);
+    data->dmrc_cache_dir = g_build_filename (cache_dir, "dmrc", NULL);
+    data->path = g_strdup (path);
+    data->owner_uid = priv->cache_uid;
+    data->owner_gid = priv->cache_gid;
+
+    /* Note the password file time first so a change while writing makes the cache stale */
+    struct stat passwd_stat;
+    if (stat (PASSWD_FILE, &passwd_stat) == 0)
+        data->source_mtime = passwd_stat.st_mtime;
+
+    for (GSequenceIter *iter = g_sequence_get_begin_iter (priv->users); !g_sequence_iter_is_end (iter); iter = g_sequence_iter_next (iter))
+    {
+        CommonUser *user = g_sequence_get (iter);
+        CommonUserPrivate *user_priv = GET_USER_PRIVATE (user);
+
+        /* Only users from the password file are cached */
+        if (user_priv->path)
+            continue;
+
+        UserCacheEntry *entry = g_malloc0 (sizeof (UserCacheEntry));
+        entry->name = insert_string (data->strings, user_priv->name);
+        entry->real_name = insert_string (data->strings, user_priv->real_name);
+        entry->home_directory = insert_string (data->strings, user_priv->home_directory);
+        entry->uid = user_priv->uid;
+        entry->gid = user_priv->gid;
+        g_ptr_array_add (data->entries, entry);
+    }
+
+    return data;
+}
+
+/* Read a .dmrc file without following links, as a user could point it at a file they shouldn't read */
+static GKeyFile *
+load_dmrc_file (const UserCacheEntry *entry, gint64 *mtime)
+{
+    *mtime = 0;
+
+    g_autofree gchar *path = g_build_filename (entry->home_directory, ".dmrc", NULL);
+    int fd = open (path, O_RDONLY | O_NOFOLLOW | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+        return NULL;
+
+    struct stat dmrc_stat;
+    g_autofree gchar *contents = NULL;
+    if (fstat (fd, &dmrc_stat) == 0 && S_ISREG (dmrc_stat.st_mode) &&
+        (geteuid () != 0 || dmrc_stat.st_uid == entry->uid) &&
+        dmrc_stat.st_size < 65536)
+    {
+        contents = g_malloc (dmrc_stat.st_size + 1);
+        ssize_t n_read = read (fd, contents, dmrc_stat.st_size);
+        if (n_read >= 0)
+        {
+            contents[n_read] = '\0';
+            *mtime = dmrc_stat.st_mtime;
+        }
         else
-            g_signal_connect (priv->passwd_monitor, "changed", G_CALLBACK (passwd_changed_cb), user_list);
+            g_clear_pointer (&contents, g_free);
+    }
+    close (fd);
+
+    if (!contents)
+        return NULL;
+
+    g_autoptr(GKeyFile) dmrc_file = g_key_file_new ();
+    if (!g_key_file_load_from_data (dmrc_file, contents, -1, G_KEY_FILE_NONE, NULL))
+        return NULL;
+
+    return g_steal_pointer (&dmrc_file);
+}
+
+/* Fill in the information from the users' home directories, run in a thread as these may be slow to access */
+static void
+fill_save_cache_data (SaveCacheData *data)
+{
+    for (guint i = 0; i < data->entries->len; i++)
+    {
+        UserCacheEntry *entry = g_ptr_array_index (data->entries, i);
+
+        g_autofree gchar *face_path = g_build_filename (entry->home_directory, ".face", NULL);
+        entry->face_mtime = get_file_mtime (face_path);
+        g_autofree gchar *image = find_image (entry->home_directory);
+        entry->image = insert_string (data->strings, image);
+
+        /* Use the copy of the .dmrc if the user doesn't have one, as dmrc_load() does */
+        g_autoptr(GKeyFile) dmrc_file = load_dmrc_file (entry, &entry->dmrc_mtime);
+        if (!dmrc_file)
+        {
+            g_autofree gchar *filename = g_strdup_printf ("%s.dmrc", entry->name);
+            g_autofree gchar *cache_path = g_build_filename (data->dmrc_cache_dir, filename, NULL);
+            dmrc_file = g_key_file_new ();
+            g_key_file_load_from_file (dmrc_file, cache_path, G_KEY_FILE_NONE, NULL);
+        }
+
+        g_autofree gchar *language = g_key_file_get_string (dmrc_file, "Desktop", "Language", NULL);
+        entry->language = insert_string (data->strings, language);
+        g_autofree gchar *layout = g_key_file_get_string (dmrc_file, "Desktop", "Layout", NULL);
+        entry->layouts = insert_string (data->strings, layout);
+        g_autofree gchar *session = g_key_file_get_string (dmrc_file, "Desktop", "Session", NULL);
+        entry->session = insert_string (data->strings, session);
     }
 }
 
+static gboolean
+write_save_cache_data (SaveCacheData *data, GError **error)
+{
+    fill_save_cache_data (data);
+
+    g_debug ("Writing user cache %s", data->path);
+    return user_cache_save (data->path, data->entries, data->source_mtime, data->owner_uid, data->owner_gid, error);
+}
+
+static void
+save_cache_thread (GTask *task, gpointer source_object, gpointer task_data, GCancellable *cancellable)
+{
+    GError *error = NULL;
+    if (write_save_cache_data (task_data, &error))
+        g_task_return_boolean (task, TRUE);
+    else
+        g_task_return_error (task, error);
+}
+
+static void
+save_cache_done_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    CommonUserList *user_list = COMMON_USER_LIST (object);
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    g_autoptr(GError) error = NULL;
+    if (!g_task_propagate_boolean (G_TASK (result), &error))
+        g_warning ("Failed to write user cache: %s", error->message);
+
+    priv->saving_cache = FALSE;
+    if (priv->save_cache_again)
+    {
+        priv->save_cache_again = FALSE;
+        schedule_save_cache (user_list);
+    }
+}
+
+static gboolean
+save_cache_cb (gpointer data)
+{
+    CommonUserList *user_list = data;
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    priv->save_cache_timeout = 0;
+
+    /* Write again once the current write completes so the newest information wins */
+    if (priv->saving_cache)
+    {
+        priv->save_cache_again = TRUE;
+        return G_SOURCE_REMOVE;
+    }
+
+    load_users (user_list);
+
+    /* Only the password information is copied here, the home directories are read in a thread so they can't block the daemon */
+    priv->saving_cache = TRUE;
+    g_autoptr(GTask) task = g_task_new (user_list, NULL, save_cache_done_cb, NULL);
+    g_task_set_task_data (task, make_save_cache_data (user_list, priv->cache_path), (GDestroyNotify) save_cache_data_free);
+    g_task_run_in_thread (task, save_cache_thread);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_save_cache (CommonUserList *user_list)
+{
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    if (priv->cache_path && priv->save_cache_timeout == 0)
+        priv->save_cache_timeout = g_timeout_add_seconds (SAVE_CACHE_DELAY, save_cache_cb, user_list);
+}
+
+/**
+ * common_user_list_set_cache_path:
+ * @user_list: A #CommonUserList
+ * @path: File to keep the user cache in.
+ * @uid: User to own the cache.
+ * @gid: Group to own the cache.
+ *
+ * Keep a cache of the user information in @path, updated whenever the users
+ * change.  Processes that have the path in the LIGHTDM_USER_CACHE environment
+ * variable use this cache rather than reading each user's files.  Only @uid
+ * can read the cache.
+ **/
+void
+common_user_list_set_cache_path (CommonUserList *user_list, const gchar *path, uid_t uid, gid_t gid)
+{
+    g_return_if_fail (COMMON_IS_USER_LIST (user_list));
+
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    g_free (priv->cache_path);
+    priv->cache_path = g_strdup (path);
+    priv->cache_uid = uid;
+    priv->cache_gid = gid;
+    schedule_save_cache (user_list);
+}
+
+/**
+ * common_user_list_save_cache:
+ * @user_list: A #CommonUserList
+ * @path: File to write the cache to.
+ * @error: return location for a #GError, or %NULL
+ *
+ * Write the information for the current users to a cache file.  This reads
+ * every user's home directory so may block.
+ *
+ * Return value: #TRUE if the cache was written.
+ **/
+gboolean
+common_user_list_save_cache (CommonUserList *user_list, const gchar *path, GError **error)
+{
+    g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), FALSE);
+    g_return_val_if_fail (path != NULL, FALSE);
+
+    load_users (user_list);
+
+    SaveCacheData *data = make_save_cache_data (user_list, path);
+    gboolean result = write_save_cache_data (data, error);
+    save_cache_data_free (data);
+
+    return result;
+}
+
 /**
  * common_user_list_get_length:
  * @user_list: a #CommonUserList
@@ -939,7 +1712,7 @@ common_user_list_get_length (CommonUserList *user_list)
 {
     g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), 0);
     load_users (user_list);
-    return g_list_length (GET_LIST_PRIVATE (user_list)->users);
+    return g_sequence_get_length (GET_LIST_PRIVATE (user_list)->users);
 }
 
 /**
@@ -955,8 +1728,98 @@ GList *
 common_user_list_get_users (CommonUserList *user_list)
 {
     g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), NULL);
+
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
     load_users (user_list);
-    return GET_LIST_PRIVATE (user_list)->users;
+
+    /* The previous copy is kept until now in case a caller is still using it */
+    if (priv->users_list_changed)
+    {
+        g_list_free (priv->users_list);
+        priv->users_list = NULL;
+        for (GSequenceIter *iter = g_sequence_get_end_iter (priv->users); !g_sequence_iter_is_begin (iter); )
+        {
+            iter = g_sequence_iter_prev (iter);
+            priv->users_list = g_list_prepend (priv->users_list, g_sequence_get (iter));
+        }
+        priv->users_list_changed = FALSE;
+    }
+
+    return priv->users_list;
+}
+
+/**
+ * common_user_list_get_users_range:
+ * @user_list: A #CommonUserList
+ * @offset: Index of the first user to get.
+ * @count: Maximum number of users to get.
+ *
+ * Get a window of the list returned by common_user_list_get_users().
+ *
+ * Return value: (element-type CommonUser) (transfer container): A list of #CommonUser.
+ **/
+GList *
+common_user_list_get_users_range (CommonUserList *user_list, guint offset, guint count)
+{
+    g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), NULL);
+
+    CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    load_users (user_list);
+
+    GList *users = NULL;
+    GSequenceIter *iter = offset <= G_MAXINT ? g_sequence_get_iter_at_pos (priv->users, offset) : g_sequence_get_end_iter (priv->users);
+    for (guint i = 0; i < count && !g_sequence_iter_is_end (iter); i++, iter = g_sequence_iter_next (iter))
+        users = g_list_prepend (users, g_sequence_get (iter));
+
+    return g_list_reverse (users);
+}
+
+static gboolean
+has_prefix_casefold (const gchar *text, const gchar *prefix)
+{
+    if (!text)
+        return FALSE;
+
+    g_autofree gchar *folded = g_utf8_casefold (text, -1);
+    return g_str_has_prefix (folded, prefix);
+}
+
+/**
+ * common_user_list_find_users:
+ * @user_list: A #CommonUserList
+ * @prefix: Text to match against the start of the username or real name.
+ * @max_results: Maximum number of users to return or -1 for no limit.
+ *
+ * Search for users whose username or real name starts with @prefix, ignoring case.
+ *
+ * Return value: (element-type CommonUser) (transfer container): A list of #CommonUser in display order.
+ **/
+GList *
+common_user_list_find_users (CommonUserList *user_list, const gchar *prefix, gint max_results)
+{
+    g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), NULL);
+    g_return_val_if_fail (prefix != NULL, NULL);
+
+    load_users (user_list);
+
+    g_autofree gchar *folded_prefix = g_utf8_casefold (prefix, -1);
+    GList *users = NULL;
+    gint n_results = 0;
+    GSequence *all_users = GET_LIST_PRIVATE (user_list)->users;
+    for (GSequenceIter *iter = g_sequence_get_begin_iter (all_users); !g_sequence_iter_is_end (iter) && (max_results < 0 || n_results < max_results); iter = g_sequence_iter_next (iter))
+    {
+        CommonUser *user = g_sequence_get (iter);
+        if (has_prefix_casefold (common_user_get_name (user), folded_prefix) ||
+            has_prefix_casefold (common_user_get_real_name (user), folded_prefix))
+        {
+            users = g_list_prepend (users, user);
+            n_results++;
+        }
+    }
+
+    return g_list_reverse (users);
 }
 
 /**
@@ -993,12 +1856,51 @@ common_user_list_get_user_by_name (CommonUserList *user_list, const gchar *usern
     return NULL;
 }
 
+/**
+ * common_user_list_get_user_by_uid:
+ * @user_list: A #CommonUserList
+ * @uid: UID of user to get.
+ *
+ * Get infomation about a given user or #NULL if this user doesn't exist.
+ * Includes hidden and system users, unlike the list from
+ * common_user_list_get_users.
+ *
+ * Return value: (transfer full): A #CommonUser entry for the given user.
+ **/
+CommonUser *
+common_user_list_get_user_by_uid (CommonUserList *user_list, uid_t uid)
+{
+    g_return_val_if_fail (COMMON_IS_USER_LIST (user_list), NULL);
+
+    load_users (user_list);
+
+    CommonUser *user = get_user_by_uid (user_list, uid);
+    if (user)
+        return g_object_ref (user);
+
+    struct passwd *entry = getpwuid (uid);
+    if (entry != NULL)
+        return make_passwd_user (user_list, entry);
+
+    return NULL;
+}
+
 static void
 common_user_list_init (CommonUserList *user_list)
 {
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
     priv->bus = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL);
+    priv->users = g_sequence_new (NULL);
+    priv->users_by_name = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    priv->users_by_uid = g_hash_table_new (g_direct_hash, g_direct_equal);
+    priv->users_by_path = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    priv->cancellable = g_cancellable_new ();
+    priv->loading_users = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    const gchar *cache_path = g_getenv ("LIGHTDM_USER_CACHE");
+    if (cache_path)
+        priv->cache = user_cache_open (cache_path);
 }
 
 static void
@@ -1035,8 +1937,23 @@ common_user_list_finalize (GObject *object)
     CommonUserList *self = COMMON_USER_LIST (object);
     CommonUserListPrivate *priv = GET_LIST_PRIVATE (self);
 
+    if (priv->save_cache_timeout)
+        g_source_remove (priv->save_cache_timeout);
+    g_free (priv->cache_path);
+    g_clear_pointer (&priv->cache, user_cache_free);
+
+    /* Abandon any users still loading */
+    g_cancellable_cancel (priv->cancellable);
+    g_clear_object (&priv->cancellable);
+    g_hash_table_unref (priv->loading_users);
+
     /* Remove children first, they might access us */
-    g_list_free_full (priv->users, g_object_unref);
+    g_hash_table_unref (priv->users_by_name);
+    g_hash_table_unref (priv->users_by_uid);
+    g_hash_table_unref (priv->users_by_path);
+    g_list_free (priv->users_list);
+    g_sequence_foreach (priv->users, (GFunc) g_object_unref, NULL);
+    g_sequence_free (priv->users);
     g_list_free_full (priv->sessions, g_object_unref);
 
     if (priv->user_added_signal)
@@ -1118,6 +2035,22 @@ common_user_list_class_init (CommonUserListClass *klass)
                       NULL, NULL,
                       NULL,
                       G_TYPE_NONE, 1, COMMON_TYPE_USER);
+
+    /**
+     * CommonUserList::loaded:
+     * @user_list: A #CommonUserList
+     *
+     * The ::loaded signal gets emitted when an asynchronous load started with
+     * common_user_list_load_async() has completed.
+     **/
+    list_signals[LOADED] =
+        g_signal_new (USER_LIST_SIGNAL_LOADED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (CommonUserListClass, loaded),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
 }
 
 static gboolean
@@ -1334,6 +2267,15 @@ common_user_set_language (CommonUser *user, const gchar *language)
     {
         call_method (user, "SetLanguage", g_variant_new ("(s)", language), "()", NULL);
         save_string_to_dmrc (user, "Desktop", "Language", language);
+
+        /* The accounts service notifies us of changes, otherwise update from what we wrote */
+        CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+        if (!priv->path)
+        {
+            g_free (priv->language);
+            priv->language = g_strdup (language);
+            g_signal_emit (user, user_signals[CHANGED], 0);
+        }
     }
 }
 
@@ -1401,6 +2343,15 @@ common_user_set_session (CommonUser *user, const gchar *session)
     {
         call_method (user, "SetXSession", g_variant_new ("(s)", session), "()", NULL);
         save_string_to_dmrc (user, "Desktop", "Session", session);
+
+        /* The accounts service notifies us of changes, otherwise update from what we wrote */
+        CommonUserPrivate *priv = GET_USER_PRIVATE (user);
+        if (!priv->path)
+        {
+            g_free (priv->session);
+            priv->session = g_strdup (session);
+            g_signal_emit (user, user_signals[CHANGED], 0);
+        }
     }
 }
 
@@ -35,6 +35,7 @@ G_BEGIN_DECLS
 #define USER_LIST_SIGNAL_USER_ADDED   "user-added"
 #define USER_LIST_SIGNAL_USER_CHANGED "user-changed"
 #define USER_LIST_SIGNAL_USER_REMOVED "user-removed"
+#define USER_LIST_SIGNAL_LOADED       "loaded"
 
 #define USER_SIGNAL_CHANGED "changed"
 
@@ -62,6 +63,7 @@ typedef struct
     void (*user_added)(CommonUserList *user_list, CommonUser *user);
     void (*user_changed)(CommonUserList *user_list, CommonUser *user);
     void (*user_removed)(CommonUserList *user_list, CommonUser *user);
+    void (*loaded)(CommonUserList *user_list);
 } CommonUserListClass;
 
 GType common_user_list_get_type (void);
@@ -72,12 +74,26 @@ CommonUserList *common_user_list_get_instance (void);
 
 void common_user_list_cleanup (void);
 
+void common_user_list_load_async (CommonUserList *user_list);
+
+gboolean common_user_list_get_is_loaded (CommonUserList *user_list);
+
+void common_user_list_set_cache_path (CommonUserList *user_list, const gchar *path, uid_t uid, gid_t gid);
+
+gboolean common_user_list_save_cache (CommonUserList *user_list, const gchar *path, GError **error);
+
 gint common_user_list_get_length (CommonUserList *user_list);
 
 CommonUser *common_user_list_get_user_by_name (CommonUserList *user_list, const gchar *username);
 
+CommonUser *common_user_list_get_user_by_uid (CommonUserList *user_list, uid_t uid);
+
 GList *common_user_list_get_users (CommonUserList *user_list);
 
+GList *common_user_list_get_users_range (CommonUserList *user_list, guint offset, guint count);
+
+GList *common_user_list_find_users (CommonUserList *user_list, const gchar *prefix, gint max_results);
+
 const gchar *common_user_get_name (CommonUser *user);
 
 const gchar *common_user_get_real_name (CommonUser *user);
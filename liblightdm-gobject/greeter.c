@@ -12,6 +12,9 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
 #include <gio/gio.h>
 #include <gio/gunixsocketaddress.h>
 #include <security/pam_appl.h>
@@ -134,10 +137,14 @@ typedef struct
     GIOChannel *from_server_channel;
     guint from_server_watch;
 
-    /* Data read from the daemon */
+    /* Data read from the daemon, may contain several messages */
     guint8 *read_buffer;
+    gsize read_buffer_size;
     gsize n_read;
 
+    /* Idle source to handle messages read along with a synchronous reply */
+    guint dispatch_source;
+
     gsize n_responses_waiting;
     GList *responses_received;
 
@@ -171,7 +178,9 @@ G_DEFINE_TYPE (LightDMGreeter, lightdm_greeter, G_TYPE_OBJECT)
 #define GET_PRIVATE(obj) G_TYPE_INSTANCE_GET_PRIVATE ((obj), LIGHTDM_TYPE_GREETER, LightDMGreeterPrivate)
 
 #define HEADER_SIZE 8
-#define MAX_MESSAGE_LENGTH 1024
+
+/* Initial size of the read buffer, enough for several typical messages */
+#define READ_BUFFER_SIZE 4096
 #define API_VERSION 1
 
 /* Messages from the greeter to the server */
@@ -367,43 +376,24 @@ int_length (void)
     return 4;
 }
 
-static gboolean
-write_int (guint8 *buffer, gint buffer_length, guint32 value, gsize *offset, GError **error)
+static void
+write_int (GByteArray *message, guint32 value)
 {
-    if (*offset + 4 >= buffer_length)
-    {
-        g_set_error_literal (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
-                             "Not enough buffer space to write integer");
-        return FALSE;
-    }
-    buffer[*offset] = value >> 24;
-    buffer[*offset+1] = (value >> 16) & 0xFF;
-    buffer[*offset+2] = (value >> 8) & 0xFF;
-    buffer[*offset+3] = value & 0xFF;
-    *offset += 4;
-
-    return TRUE;
+    guint8 buffer[4];
+    buffer[0] = value >> 24;
+    buffer[1] = (value >> 16) & 0xFF;
+    buffer[2] = (value >> 8) & 0xFF;
+    buffer[3] = value & 0xFF;
+    g_byte_array_append (message, buffer, 4);
 }
 
-static gboolean
-write_string (guint8 *buffer, gint buffer_length, const gchar *value, gsize *offset, GError **error)
+static void
+write_string (GByteArray *message, const gchar *value)
 {
-    gint length = 0;
-    if (value)
-        length = strlen (value);
-    if (!write_int (buffer, buffer_length, length, offset, error))
-        return FALSE;
-    if (*offset + length >= buffer_length)
-    {
-        g_set_error (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
-                     "Not enough buffer space to write string of length %d octets", length);
-        return FALSE;
-    }
-    if (value)
-        memcpy (buffer + *offset, value, length);
-    *offset += length;
-
-    return TRUE;
+    gsize length = value ? strlen (value) : 0;
+    write_int (message, length);
+    if (length > 0)
+        g_byte_array_append (message, (const guint8 *) value, length);
 }
 
 static guint32
@@ -440,20 +430,14 @@ read_string (guint8 *message, gsize message_length, gsize *offset)
     return value;
 }
 
-static guint32
-string_length (const gchar *value)
-{
-    if (value)
-        return int_length () + strlen (value);
-    else
-        return int_length ();
-}
-
-static gboolean
-write_header (guint8 *buffer, gint buffer_length, guint32 id, guint32 length, gsize *offset, GError **error)
+/* Start a message, the length is filled in by send_message() */
+static GByteArray *
+start_message (guint32 id)
 {
-    return write_int (buffer, buffer_length, id, offset, error) &&
-           write_int (buffer, buffer_length, length, offset, error);
+    GByteArray *message = g_byte_array_new ();
+    write_int (message, id);
+    write_int (message, 0);
+    return message;
 }
 
 static guint32
@@ -500,6 +484,10 @@ connect_to_daemon (LightDMGreeter *greeter, GError **error)
         return FALSE;
     }
 
+    /* Messages are read until there is no more data available */
+    int fd = g_io_channel_unix_get_fd (priv->from_server_channel);
+    fcntl (fd, F_SETFL, fcntl (fd, F_GETFL) | O_NONBLOCK);
+
     priv->from_server_watch = g_io_add_watch (priv->from_server_channel, G_IO_IN, from_server_cb, greeter);
 
     if (!g_io_channel_set_encoding (priv->to_server_channel, NULL, error) ||
@@ -510,55 +498,49 @@ connect_to_daemon (LightDMGreeter *greeter, GError **error)
 }
 
 static gboolean
-send_message (LightDMGreeter *greeter, guint8 *message, gsize message_length, GError **error)
+send_message (LightDMGreeter *greeter, GByteArray *message, GError **error)
 {
     LightDMGreeterPrivate *priv = GET_PRIVATE (greeter);
 
     if (!connect_to_daemon (greeter, error))
         return FALSE;
 
-    /* Double check that we're sending well-formed messages.  If we say we're
-       sending more than we do, we end up DOS'ing lightdm as it waits for the
-       rest.  If we say we're sending less than we do, we confuse the heck out
-       of lightdm, as it starts reading headers from the middle of our
-       messages. */
-    guint32 stated_length = HEADER_SIZE + get_message_length (message, message_length);
-    if (stated_length != message_length)
-    {
-        g_set_error (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
-                     "Refusing to write malformed packet to daemon: declared size is %u, but actual size is %zu",
-                     stated_length, message_length);
-        return FALSE;
-    }
-
-    gchar *data = (gchar *) message;
-    gsize data_length = message_length;
+    /* Fill in the length now the message is complete so it always matches what is sent */
+    guint32 length = message->len - HEADER_SIZE;
+    message->data[4] = length >> 24;
+    message->data[5] = (length >> 16) & 0xFF;
+    message->data[6] = (length >> 8) & 0xFF;
+    message->data[7] = length & 0xFF;
+
+    /* Write the whole message in as few system calls as possible, waiting
+       for the daemon to read if the socket is full */
+    int fd = g_io_channel_unix_get_fd (priv->to_server_channel);
+    const guint8 *data = message->data;
+    gsize data_length = message->len;
     while (data_length > 0)
     {
-        gsize n_written;
-        g_autoptr(GError) write_error = NULL;
-        GIOStatus status = g_io_channel_write_chars (priv->to_server_channel, data, data_length, &n_written, &write_error);
-        if (write_error)
+        ssize_t n_written = write (fd, data, data_length);
+        if (n_written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                GPollFD poll_fd = { fd, G_IO_OUT, 0 };
+                g_poll (&poll_fd, 1, -1);
+                continue;
+            }
+
             g_set_error (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
                          "Failed to write to daemon: %s",
-                         write_error->message);
-        if (status == G_IO_STATUS_AGAIN)
-            continue;
-        if (status != G_IO_STATUS_NORMAL)
+                         g_strerror (errno));
             return FALSE;
+        }
         data_length -= n_written;
         data += n_written;
     }
 
-    g_debug ("Wrote %zi bytes to daemon", message_length);
-    g_autoptr(GError) flush_error = NULL;
-    if (!g_io_channel_flush (priv->to_server_channel, &flush_error))
-    {
-        g_set_error (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
-                     "Failed to write to daemon: %s",
-                     flush_error->message);
-        return FALSE;
-    }
+    g_debug ("Wrote %u bytes to daemon", message->len);
 
     return TRUE;
 }
@@ -834,105 +816,150 @@ recv_message (LightDMGreeter *greeter, gboolean block, guint8 **message, gsize *
     if (!connect_to_daemon (greeter, error))
         return FALSE;
 
-    /* Read the header, or the whole message if we already have that */
-    gsize n_to_read = HEADER_SIZE;
-    if (priv->n_read >= HEADER_SIZE)
-        n_to_read += get_message_length (priv->read_buffer, priv->n_read);
-
-    do
+    int fd = g_io_channel_unix_get_fd (priv->from_server_channel);
+    while (TRUE)
     {
-        gsize n_read;
-        g_autoptr(GError) read_error = NULL;
-        GIOStatus status = g_io_channel_read_chars (priv->from_server_channel,
-                                          (gchar *) priv->read_buffer + priv->n_read,
-                                          n_to_read - priv->n_read,
-                                          &n_read,
-                                          &read_error);
-        if (status == G_IO_STATUS_AGAIN)
+        /* Return the next message if it has already been read */
+        if (priv->n_read >= HEADER_SIZE)
         {
-            if (block)
-                continue;
+            gsize message_length = HEADER_SIZE + get_message_length (priv->read_buffer, priv->n_read);
+            if (priv->n_read >= message_length)
+            {
+                if (message)
+                {
+                    *message = g_malloc (message_length);
+                    memcpy (*message, priv->read_buffer, message_length);
+                }
+                if (length)
+                    *length = message_length;
+
+                priv->n_read -= message_length;
+                memmove (priv->read_buffer, priv->read_buffer + message_length, priv->n_read);
+
+                return TRUE;
+            }
+
+            /* Make room for a message larger than the buffer */
+            if (message_length > priv->read_buffer_size)
+            {
+                priv->read_buffer = g_realloc (priv->read_buffer, message_length);
+                priv->read_buffer_size = message_length;
+            }
         }
-        else if (status != G_IO_STATUS_NORMAL)
+
+        /* Read as much as is available, this may be several messages */
+        ssize_t n_read = read (fd, priv->read_buffer + priv->n_read, priv->read_buffer_size - priv->n_read);
+        if (n_read < 0)
         {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (!block)
+                    break;
+
+                GPollFD poll_fd = { fd, G_IO_IN, 0 };
+                g_poll (&poll_fd, 1, -1);
+                continue;
+            }
+
             g_set_error (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
                          "Failed to read from daemon: %s",
-                         read_error->message);
+                         g_strerror (errno));
+            return FALSE;
+        }
+        if (n_read == 0)
+        {
+            g_set_error_literal (error, LIGHTDM_GREETER_ERROR, LIGHTDM_GREETER_ERROR_COMMUNICATION_ERROR,
+                                 "Failed to read from daemon: Connection closed");
             return FALSE;
         }
 
         g_debug ("Read %zi bytes from daemon", n_read);
 
         priv->n_read += n_read;
-    } while (priv->n_read < n_to_read && block);
-
-    /* Stop if haven't got all the data we want */
-    if (priv->n_read != n_to_read)
-    {
-        if (message)
-            *message = NULL;
-        if (length)
-            *length = 0;
-        return TRUE;
     }
 
-    /* If have header, rerun for content */
-    if (priv->n_read == HEADER_SIZE)
+    /* Haven't got a complete message yet */
+    if (message)
+        *message = NULL;
+    if (length)
+        *length = 0;
+
+    return TRUE;
+}
+
+static gboolean
+from_server_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    LightDMGreeter *greeter = data;
+
+    /* Messages may cause the application to drop the greeter */
+    g_object_ref (greeter);
+
+    /* Process every message that has arrived */
+    gboolean result = G_SOURCE_CONTINUE;
+    while (TRUE)
     {
-        n_to_read = get_message_length (priv->read_buffer, priv->n_read);
-        if (n_to_read > 0)
+        g_autofree guint8 *message = NULL;
+        gsize message_length;
+        g_autoptr(GError) error = NULL;
+        if (!recv_message (greeter, FALSE, &message, &message_length, &error))
         {
-            priv->read_buffer = g_realloc (priv->read_buffer, HEADER_SIZE + n_to_read);
-            return recv_message (greeter, block, message, length, error);
+            // FIXME: Should push this up to the client somehow
+            g_warning ("Failed to read from daemon: %s\n", error->message);
+            result = G_SOURCE_REMOVE;
+            break;
         }
-    }
 
-    if (message)
-        *message = priv->read_buffer;
-    else
-        g_free (priv->read_buffer);
-    if (length)
-        *length = priv->n_read;
+        if (!message)
+            break;
+
+        handle_message (greeter, message, message_length);
+    }
 
-    priv->read_buffer = g_malloc (priv->n_read);
-    priv->n_read = 0;
+    g_object_unref (greeter);
 
-    return TRUE;
+    return result;
 }
 
 static gboolean
-from_server_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+dispatch_cb (gpointer data)
 {
     LightDMGreeter *greeter = data;
+    LightDMGreeterPrivate *priv = GET_PRIVATE (greeter);
 
-    /* Read one message and process it */
-    g_autofree guint8 *message = NULL;
-    gsize message_length;
-    g_autoptr(GError) error = NULL;
-    if (!recv_message (greeter, FALSE, &message, &message_length, &error))
+    priv->dispatch_source = 0;
+    if (!from_server_cb (priv->from_server_channel, G_IO_IN, greeter) && priv->from_server_watch)
     {
-        // FIXME: Should push this up to the client somehow
-        g_warning ("Failed to read from daemon: %s\n", error->message);
-        return G_SOURCE_REMOVE;
+        g_source_remove (priv->from_server_watch);
+        priv->from_server_watch = 0;
     }
 
-    if (message)
-        handle_message (greeter, message, message_length);
+    return G_SOURCE_REMOVE;
+}
 
-    return G_SOURCE_CONTINUE;
+static void
+schedule_dispatch (LightDMGreeter *greeter)
+{
+    LightDMGreeterPrivate *priv = GET_PRIVATE (greeter);
+
+    /* The daemon may have sent more messages after the reply to a synchronous
+     * request, these are already read so the watch on the socket won't see them */
+    if (priv->n_read == 0 || priv->dispatch_source != 0)
+        return;
+    priv->dispatch_source = g_idle_add (dispatch_cb, greeter);
 }
 
 static gboolean
 send_connect (LightDMGreeter *greeter, gboolean resettable, GError **error)
 {
     g_debug ("Connecting to display manager...");
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    return write_header (message, MAX_MESSAGE_LENGTH, GREETER_MESSAGE_CONNECT, string_length (VERSION) + int_length () * 2, &offset, error) &&
-           write_string (message, MAX_MESSAGE_LENGTH, VERSION, &offset, error) &&
-           write_int (message, MAX_MESSAGE_LENGTH, resettable ? 1 : 0, &offset, error) &&
-           write_int (message, MAX_MESSAGE_LENGTH, API_VERSION, &offset, error) &&
-           send_message (greeter, message, offset, error);
+    g_autoptr(GByteArray) message = start_message (GREETER_MESSAGE_CONNECT);
+    write_string (message, VERSION);
+    write_int (message, resettable ? 1 : 0);
+    write_int (message, API_VERSION);
+    return send_message (greeter, message, error);
 }
 
 static gboolean
@@ -943,11 +970,9 @@ send_start_session (LightDMGreeter *greeter, const gchar *session, GError **erro
     else
         g_debug ("Starting default session");
 
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    return write_header (message, MAX_MESSAGE_LENGTH, GREETER_MESSAGE_START_SESSION, string_length (session), &offset, error) &&
-           write_string (message, MAX_MESSAGE_LENGTH, session, &offset, error) &&
-           send_message (greeter, message, offset, error);
+    g_autoptr(GByteArray) message = start_message (GREETER_MESSAGE_START_SESSION);
+    write_string (message, session);
+    return send_message (greeter, message, error);
 }
 
 static gboolean
@@ -955,11 +980,9 @@ send_ensure_shared_data_dir (LightDMGreeter *greeter, const gchar *username, GEr
 {
     g_debug ("Ensuring data directory for user %s", username);
 
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    return write_header (message, MAX_MESSAGE_LENGTH, GREETER_MESSAGE_ENSURE_SHARED_DIR, string_length (username), &offset, error) &&
-           write_string (message, MAX_MESSAGE_LENGTH, username, &offset, error) &&
-           send_message (greeter, message, offset, error);
+    g_autoptr(GByteArray) message = start_message (GREETER_MESSAGE_ENSURE_SHARED_DIR);
+    write_string (message, username);
+    return send_message (greeter, message, error);
 }
 
 /**
@@ -1044,6 +1067,7 @@ lightdm_greeter_connect_to_daemon_sync (LightDMGreeter *greeter, GError **error)
             return FALSE;
         handle_message (greeter, message, message_length);
     } while (!request->complete);
+    schedule_dispatch (greeter);
 
     return lightdm_greeter_connect_to_daemon_finish (greeter, G_ASYNC_RESULT (request), error);
 }
@@ -1338,12 +1362,10 @@ lightdm_greeter_authenticate (LightDMGreeter *greeter, const gchar *username, GE
     }
 
     g_debug ("Starting authentication for user %s...", username);
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    return write_header (message, MAX_MESSAGE_LENGTH, GREETER_MESSAGE_AUTHENTICATE, int_length () + string_length (username), &offset, error) &&
-           write_int (message, MAX_MESSAGE_LENGTH, priv->authenticate_sequence_number, &offset, error) &&
-           write_string (message, MAX_MESSAGE_LENGTH, username, &offset, error) &&
-           send_message (greeter, message, offset, error);
+    g_autoptr(GByteArray) message = start_message (GREETER_MESSAGE_AUTHENTICATE);
+    write_int (message, priv->authenticate_sequence_number);
+    write_string (message, username);
+    return send_message (greeter, message, error);
 }
 
 /**
@@ -1372,11 +1394,9 @@ lightdm_greeter_authenticate_as_guest (LightDMGreeter *greeter, GError **error)
     priv->authentication_user = NULL;
 
     g_debug ("Starting authentication for guest account...");
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    return write_header (message, MAX_MESSAGE_LENGTH, GREETER_MESSAGE_AUTHENTICATE_AS_GUEST, int_length (), &offset, error) &&
-           write_int (message, MAX_MESSAGE_LENGTH, priv->authenticate_sequence_number, &offset, error) &&
-           send_message (greeter, message, offset, error);
+    g_autoptr(GByteArray) message = start_message (GREETER_MESSAGE_AUTHENTICATE_AS_GUEST);
+    write_int (message, priv->authenticate_sequence_number);
+    return send_message (greeter, message, error);
 }
 
 /**
@@ -1436,13 +1456,11 @@ lightdm_greeter_authenticate_remote (LightDMGreeter *greeter, const gchar *sessi
     else
         g_debug ("Starting authentication for remote session %s...", session);
 
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    return write_header (message, MAX_MESSAGE_LENGTH, GREETER_MESSAGE_AUTHENTICATE_REMOTE, int_length () + string_length (session) + string_length (username), &offset, error) &&
-           write_int (message, MAX_MESSAGE_LENGTH, priv->authenticate_sequence_number, &offset, error) &&
-           write_string (message, MAX_MESSAGE_LENGTH, session, &offset, error) &&
-           write_string (message, MAX_MESSAGE_LENGTH, username, &offset, error) &&
-           send_message (greeter, message, offset, error);
+    g_autoptr(GByteArray) message = start_message (GREETER_MESSAGE_AUTHENTICATE_REMOTE);
+    write_int (message, priv->authenticate_sequence_number);
+    write_string (message, session);
+    write_string (message, username);
+    return send_message (greeter, message, error);
 }
 
 /**
@@ -1469,25 +1487,19 @@ lightdm_greeter_respond (LightDMGreeter *greeter, const gchar *response, GError
     priv->n_responses_waiting--;
     priv->responses_received = g_list_append (priv->responses_received, g_strdup (response));
 
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
     if (priv->n_responses_waiting == 0)
     {
         g_debug ("Providing response to display manager");
 
-        guint32 msg_length = int_length ();
+        g_autoptr(GByteArray) message = start_message (GREETER_MESSAGE_CONTINUE_AUTHENTICATION);
+        write_int (message, g_list_length (priv->responses_received));
         for (GList *iter = priv->responses_received; iter; iter = iter->next)
-            msg_length += string_length ((gchar *)iter->data);
+            write_string (message, (gchar *)iter->data);
+        gboolean result = send_message (greeter, message, error);
 
-        if (!write_header (message, MAX_MESSAGE_LENGTH, GREETER_MESSAGE_CONTINUE_AUTHENTICATION, msg_length, &offset, error) ||
-            !write_int (message, MAX_MESSAGE_LENGTH, g_list_length (priv->responses_received), &offset, error))
-            return FALSE;
-        for (GList *iter = priv->responses_received; iter; iter = iter->next)
-        {
-            if (!write_string (message, MAX_MESSAGE_LENGTH, (gchar *)iter->data, &offset, error))
-                return FALSE;
-        }
-        if (!send_message (greeter, message, offset, error))
+        /* Don't leave passwords lying around in freed memory */
+        memset (message->data, 0, message->len);
+        if (!result)
             return FALSE;
 
         g_list_free_full (priv->responses_received, g_free);
@@ -1516,10 +1528,8 @@ lightdm_greeter_cancel_authentication (LightDMGreeter *greeter, GError **error)
     g_return_val_if_fail (priv->connected, FALSE);
 
     priv->cancelling_authentication = TRUE;
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    return write_header (message, MAX_MESSAGE_LENGTH, GREETER_MESSAGE_CANCEL_AUTHENTICATION, 0, &offset, error) &&
-           send_message (greeter, message, offset, error);
+    g_autoptr(GByteArray) message = start_message (GREETER_MESSAGE_CANCEL_AUTHENTICATION);
+    return send_message (greeter, message, error);
 }
 
 /**
@@ -1586,11 +1596,9 @@ lightdm_greeter_set_language (LightDMGreeter *greeter, const gchar *language, GE
 
     g_return_val_if_fail (priv->connected, FALSE);
 
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    return write_header (message, MAX_MESSAGE_LENGTH, GREETER_MESSAGE_SET_LANGUAGE, string_length (language), &offset, error) &&
-           write_string (message, MAX_MESSAGE_LENGTH, language, &offset, error) &&
-           send_message (greeter, message, offset, error);
+    g_autoptr(GByteArray) message = start_message (GREETER_MESSAGE_SET_LANGUAGE);
+    write_string (message, language);
+    return send_message (greeter, message, error);
 }
 
 /**
@@ -1678,6 +1686,7 @@ lightdm_greeter_start_session_sync (LightDMGreeter *greeter, const gchar *sessio
             return FALSE;
         handle_message (greeter, message, message_length);
     } while (!request->complete);
+    schedule_dispatch (greeter);
 
     return lightdm_greeter_start_session_finish (greeter, G_ASYNC_RESULT (request), error);
 }
@@ -1780,6 +1789,7 @@ lightdm_greeter_ensure_shared_data_dir_sync (LightDMGreeter *greeter, const gcha
             return FALSE;
         handle_message (greeter, message, message_length);
     } while (!request->complete);
+    schedule_dispatch (greeter);
 
     return lightdm_greeter_ensure_shared_data_dir_finish (greeter, G_ASYNC_RESULT (request), error);
 }
@@ -1789,7 +1799,8 @@ lightdm_greeter_init (LightDMGreeter *greeter)
 {
     LightDMGreeterPrivate *priv = GET_PRIVATE (greeter);
 
-    priv->read_buffer = g_malloc (HEADER_SIZE);
+    priv->read_buffer_size = READ_BUFFER_SIZE;
+    priv->read_buffer = g_malloc (priv->read_buffer_size);
     priv->hints = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
 }
 
@@ -1876,6 +1887,9 @@ lightdm_greeter_finalize (GObject *object)
     if (priv->from_server_watch)
         g_source_remove (priv->from_server_watch);
     priv->from_server_watch = 0;
+    if (priv->dispatch_source)
+        g_source_remove (priv->dispatch_source);
+    priv->dispatch_source = 0;
     g_clear_pointer (&priv->read_buffer, g_free);
     g_list_free_full (priv->responses_received, g_free);
     priv->responses_received = NULL;
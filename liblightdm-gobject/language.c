@@ -9,9 +9,11 @@
  */
 
 #include <string.h>
+#include <errno.h>
 #include <locale.h>
 #include <langinfo.h>
 #include <stdio.h>
+#include <glib/gstdio.h>
 #include <glib/gi18n.h>
 
 #include "lightdm/language.h"
@@ -54,15 +56,118 @@ G_DEFINE_TYPE (LightDMLanguage, lightdm_language, G_TYPE_OBJECT)
 
 #define GET_PRIVATE(obj) G_TYPE_INSTANCE_GET_PRIVATE ((obj), LIGHTDM_TYPE_LANGUAGE, LightDMLanguagePrivate)
 
+/* Where glibc installs compiled locales */
+#define LOCALE_DIR "/usr/lib/locale"
+#define LOCALE_ARCHIVE LOCALE_DIR "/locale-archive"
+#define LOCALE_ARCHIVE_MAGIC 0xde020109
+
+/* Header of the glibc locale archive, see locale/locarchive.h */
+typedef struct
+{
+    guint32 magic;
+    guint32 serial;
+    guint32 namehash_offset;
+    guint32 namehash_used;
+    guint32 namehash_size;
+    guint32 string_offset;
+    guint32 string_used;
+    guint32 string_size;
+    guint32 locrectab_offset;
+    guint32 locrectab_used;
+    guint32 locrectab_size;
+    guint32 sumhash_offset;
+    guint32 sumhash_used;
+    guint32 sumhash_size;
+} LocaleArchiveHeader;
+
+typedef struct
+{
+    guint32 hashval;
+    guint32 name_offset;
+    guint32 locrec_offset;
+} LocaleArchiveNameEntry;
+
 static gboolean have_languages = FALSE;
 static GList *languages = NULL;
 
+/* Languages indexed by get_index_key () */
+static GHashTable *languages_by_code = NULL;
+
+/* Installed locales, sorted */
+static gchar **available_locales = NULL;
+
+static gboolean
+is_utf8 (const gchar *code)
+{
+    return g_strrstr (code, ".utf8") || g_strrstr (code, ".UTF-8");
+}
+
+/* Get a key that is the same for all codes that lightdm_language_matches() considers equal */
+static gchar *
+get_index_key (const gchar *code)
+{
+    if (is_utf8 (code))
+    {
+        g_autofree gchar *prefix = g_strndup (code, strchr (code, '.') - code);
+        return g_strconcat (prefix, ".UTF-8", NULL);
+    }
+
+    return g_strdup (code);
+}
+
 static void
-update_languages (void)
+add_archive_locales (GPtrArray *codes)
 {
-    if (have_languages)
+    g_autoptr(GMappedFile) file = g_mapped_file_new (LOCALE_ARCHIVE, FALSE, NULL);
+    if (!file)
+        return;
+
+    gsize length = g_mapped_file_get_length (file);
+    const gchar *contents = g_mapped_file_get_contents (file);
+    const LocaleArchiveHeader *header = (const LocaleArchiveHeader *) contents;
+    if (length < sizeof (LocaleArchiveHeader) ||
+        header->magic != LOCALE_ARCHIVE_MAGIC ||
+        header->namehash_offset > length ||
+        header->namehash_size > (length - header->namehash_offset) / sizeof (LocaleArchiveNameEntry))
+    {
+        g_warning ("Ignoring invalid locale archive %s", LOCALE_ARCHIVE);
+        return;
+    }
+
+    const LocaleArchiveNameEntry *entries = (const LocaleArchiveNameEntry *) (contents + header->namehash_offset);
+    for (guint32 i = 0; i < header->namehash_size; i++)
+    {
+        /* Skip unused hash slots */
+        if (entries[i].locrec_offset == 0 || entries[i].name_offset >= length)
+            continue;
+
+        const gchar *name = contents + entries[i].name_offset;
+        gsize name_length = strnlen (name, length - entries[i].name_offset);
+        if (name_length > 0 && name_length < length - entries[i].name_offset)
+            g_ptr_array_add (codes, g_strndup (name, name_length));
+    }
+}
+
+static void
+add_directory_locales (GPtrArray *codes)
+{
+    g_autoptr(GDir) dir = g_dir_open (LOCALE_DIR, 0, NULL);
+    if (!dir)
         return;
 
+    const gchar *name;
+    while ((name = g_dir_read_name (dir)))
+    {
+        g_autofree gchar *path = g_build_filename (LOCALE_DIR, name, "LC_IDENTIFICATION", NULL);
+        if (g_file_test (path, G_FILE_TEST_IS_REGULAR))
+            g_ptr_array_add (codes, g_strdup (name));
+    }
+}
+
+/* Used where locales are not installed in the glibc layout */
+static void
+add_command_locales (GPtrArray *codes)
+{
     const gchar *command = "locale -a";
     g_autofree gchar *stdout_text = NULL;
     g_autofree gchar *stderr_text = NULL;
@@ -79,25 +184,166 @@ update_languages (void)
         for (int i = 0; tokens[i]; i++)
         {
             const gchar *code = g_strchug (tokens[i]);
-            if (code[0] == '\0')
-                continue;
+            if (code[0] != '\0')
+                g_ptr_array_add (codes, g_strdup (code));
+        }
+    }
+}
+
+static gint
+compare_code (gconstpointer a, gconstpointer b)
+{
+    return g_strcmp0 (*((const gchar **) a), *((const gchar **) b));
+}
+
+/* Get the installed locales, the same as 'locale -a' would return */
+static gchar **
+get_available_locales (void)
+{
+    if (available_locales)
+        return available_locales;
+
+    g_autoptr(GPtrArray) codes = g_ptr_array_new_with_free_func (g_free);
+    add_archive_locales (codes);
+    add_directory_locales (codes);
+    if (codes->len == 0)
+        add_command_locales (codes);
+    g_ptr_array_sort (codes, compare_code);
+
+    GPtrArray *unique_codes = g_ptr_array_new ();
+    for (guint i = 0; i < codes->len; i++)
+    {
+        const gchar *code = g_ptr_array_index (codes, i);
+        if (i == 0 || g_strcmp0 (code, g_ptr_array_index (codes, i - 1)) != 0)
+            g_ptr_array_add (unique_codes, g_strdup (code));
+    }
+    g_ptr_array_add (unique_codes, NULL);
+    available_locales = (gchar **) g_ptr_array_free (unique_codes, FALSE);
+
+    return available_locales;
+}
+
+/* Get a value that changes when locales are installed or removed */
+static gchar *
+get_locales_stamp (void)
+{
+    GStatBuf archive_info, dir_info;
+    gint64 archive_mtime = g_stat (LOCALE_ARCHIVE, &archive_info) == 0 ? archive_info.st_mtime : 0;
+    gint64 dir_mtime = g_stat (LOCALE_DIR, &dir_info) == 0 ? dir_info.st_mtime : 0;
+    return g_strdup_printf ("%" G_GINT64_FORMAT ".%" G_GINT64_FORMAT, archive_mtime, dir_mtime);
+}
 
+static gchar *
+get_cache_path (void)
+{
+    return g_build_filename (g_get_user_cache_dir (), "lightdm", "languages", NULL);
+}
+
+/* Names are translated, so cached names are only valid for the same message languages */
+static gchar *
+get_messages_language (void)
+{
+    return g_strjoinv (":", (gchar **) g_get_language_names ());
+}
+
+static gboolean
+load_cache (const gchar *stamp, const gchar *messages_language)
+{
+    g_autofree gchar *path = get_cache_path ();
+    g_autoptr(GKeyFile) cache = g_key_file_new ();
+    if (!g_key_file_load_from_file (cache, path, G_KEY_FILE_NONE, NULL))
+        return FALSE;
+
+    g_autofree gchar *cache_stamp = g_key_file_get_string (cache, "Cache", "locales", NULL);
+    g_autofree gchar *cache_messages_language = g_key_file_get_string (cache, "Cache", "messages-language", NULL);
+    if (g_strcmp0 (cache_stamp, stamp) != 0 || g_strcmp0 (cache_messages_language, messages_language) != 0)
+        return FALSE;
+
+    g_auto(GStrv) codes = g_key_file_get_string_list (cache, "Cache", "languages", NULL, NULL);
+    if (!codes)
+        return FALSE;
+
+    for (int i = 0; codes[i]; i++)
+    {
+        LightDMLanguage *language = g_object_new (LIGHTDM_TYPE_LANGUAGE, "code", codes[i], NULL);
+        LightDMLanguagePrivate *priv = GET_PRIVATE (language);
+        priv->name = g_key_file_get_string (cache, codes[i], "name", NULL);
+        priv->territory = g_key_file_get_string (cache, codes[i], "territory", NULL);
+        languages = g_list_append (languages, language);
+    }
+
+    return TRUE;
+}
+
+static void
+save_cache (const gchar *stamp, const gchar *messages_language)
+{
+    g_autoptr(GKeyFile) cache = g_key_file_new ();
+    g_key_file_set_string (cache, "Cache", "locales", stamp);
+    g_key_file_set_string (cache, "Cache", "messages-language", messages_language);
+
+    g_autoptr(GPtrArray) codes = g_ptr_array_new ();
+    for (GList *link = languages; link; link = link->next)
+    {
+        LightDMLanguage *language = link->data;
+        const gchar *code = lightdm_language_get_code (language);
+        g_ptr_array_add (codes, (gpointer) code);
+        g_key_file_set_string (cache, code, "name", lightdm_language_get_name (language));
+        const gchar *territory = lightdm_language_get_territory (language);
+        if (territory)
+            g_key_file_set_string (cache, code, "territory", territory);
+    }
+    g_key_file_set_string_list (cache, "Cache", "languages", (const gchar * const *) codes->pdata, codes->len);
+
+    /* Not being able to write the cache just means it's regenerated next time */
+    g_autofree gchar *path = get_cache_path ();
+    g_autofree gchar *dir = g_path_get_dirname (path);
+    g_autoptr(GError) error = NULL;
+    if (g_mkdir_with_parents (dir, 0700) < 0)
+        g_debug ("Failed to make language cache directory %s: %s", dir, g_strerror (errno));
+    else if (!g_key_file_save_to_file (cache, path, &error))
+        g_debug ("Failed to write language cache %s: %s", path, error->message);
+}
+
+static void
+update_languages (void)
+{
+    if (have_languages)
+        return;
+
+    g_autofree gchar *stamp = get_locales_stamp ();
+    g_autofree gchar *messages_language = get_messages_language ();
+    if (!load_cache (stamp, messages_language))
+    {
+        gchar **locales = get_available_locales ();
+        for (int i = 0; locales[i]; i++)
+        {
             /* Ignore the non-interesting languages */
-            if (strcmp (command, "locale -a") == 0 && !g_strrstr (code, ".utf8"))
+            if (!g_strrstr (locales[i], ".utf8"))
                 continue;
 
-            LightDMLanguage *language = g_object_new (LIGHTDM_TYPE_LANGUAGE, "code", code, NULL);
+            LightDMLanguage *language = g_object_new (LIGHTDM_TYPE_LANGUAGE, "code", locales[i], NULL);
             languages = g_list_append (languages, language);
         }
+
+        /* Looks up all the names so they are ready next time */
+        save_cache (stamp, messages_language);
     }
 
-    have_languages = TRUE;
-}
+    languages_by_code = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    for (GList *link = languages; link; link = link->next)
+    {
+        LightDMLanguage *language = link->data;
+        gchar *key = get_index_key (lightdm_language_get_code (language));
 
-static gboolean
-is_utf8 (const gchar *code)
-{
-    return g_strrstr (code, ".utf8") || g_strrstr (code, ".UTF-8");
+        /* Earlier languages take precedence, as when searching the list */
+        if (g_hash_table_contains (languages_by_code, key))
+            g_free (key);
+        else
+            g_hash_table_insert (languages_by_code, key, language);
+    }
+
+    have_languages = TRUE;
 }
 
 /* Get a valid locale name that can be passed to setlocale(), so we always can use nl_langinfo() to get language and country names. */
@@ -114,23 +360,10 @@ get_locale_name (const gchar *code)
     else
         language = g_strdup (code);
 
-    static gchar **avail_locales;
-    if (!avail_locales)
+    gchar **locales = get_available_locales ();
+    for (gint i = 0; locales[i]; i++)
     {
-        g_autofree gchar *locales = NULL;
-        g_autoptr(GError) error = NULL;
-        if (g_spawn_command_line_sync ("locale -a", &locales, NULL, NULL, &error))
-            avail_locales = g_strsplit (g_strchomp (locales), "\n", -1);
-        else
-            g_warning ("Failed to run 'locale -a': %s", error->message);
-    }
-
-    if (!avail_locales)
-        return NULL;
-
-    for (gint i = 0; avail_locales[i]; i++)
-    {
-        const gchar *loc = avail_locales[i];
+        const gchar *loc = locales[i];
         if (!g_strrstr (loc, ".utf8"))
             continue;
         if (g_str_has_prefix (loc, language))
@@ -154,14 +387,9 @@ lightdm_get_language (void)
     if (!lang)
         return NULL;
 
-    for (GList *link = lightdm_get_languages (); link; link = link->next)
-    {
-        LightDMLanguage *language = link->data;
-        if (lightdm_language_matches (language, lang))
-            return language;
-    }
-
-    return NULL;
+    update_languages ();
+    g_autofree gchar *key = get_index_key (lang);
+    return g_hash_table_lookup (languages_by_code, key);
 }
 
 /**
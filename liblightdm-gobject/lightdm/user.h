@@ -38,6 +38,7 @@ typedef struct _LightDMUserClass     LightDMUserClass;
 #define LIGHTDM_USER_LIST_SIGNAL_USER_ADDED   "user-added"
 #define LIGHTDM_USER_LIST_SIGNAL_USER_CHANGED "user-changed"
 #define LIGHTDM_USER_LIST_SIGNAL_USER_REMOVED "user-removed"
+#define LIGHTDM_USER_LIST_SIGNAL_LOADED       "loaded"
 
 #define LIGHTDM_SIGNAL_USER_CHANGED "changed"
 
@@ -75,9 +76,9 @@ struct _LightDMUserListClass
     void (*user_added)(LightDMUserList *user_list, LightDMUser *user);
     void (*user_changed)(LightDMUserList *user_list, LightDMUser *user);
     void (*user_removed)(LightDMUserList *user_list, LightDMUser *user);
+    void (*loaded)(LightDMUserList *user_list);
 
     /* Reserved */
-    void (*reserved1) (void);
     void (*reserved2) (void);
     void (*reserved3) (void);
     void (*reserved4) (void);
@@ -110,6 +111,14 @@ LightDMUser *lightdm_user_list_get_user_by_name (LightDMUserList *user_list, con
 
 GList *lightdm_user_list_get_users (LightDMUserList *user_list);
 
+GList *lightdm_user_list_get_users_range (LightDMUserList *user_list, gint offset, gint count);
+
+GList *lightdm_user_list_find_users (LightDMUserList *user_list, const gchar *prefix, gint max_results);
+
+void lightdm_user_list_load_async (LightDMUserList *user_list);
+
+gboolean lightdm_user_list_get_is_loaded (LightDMUserList *user_list);
+
 const gchar *lightdm_user_get_name (LightDMUser *user);
 
 const gchar *lightdm_user_get_real_name (LightDMUser *user);
@@ -88,6 +88,7 @@ enum
     USER_ADDED,
     USER_CHANGED,
     USER_REMOVED,
+    LOADED,
     LAST_LIST_SIGNAL
 };
 static guint list_signals[LAST_LIST_SIGNAL] = { 0 };
@@ -101,10 +102,17 @@ static guint user_signals[LAST_USER_SIGNAL] = { 0 };
 
 typedef struct
 {
-    gboolean initialized;
+    /* TRUE if listening for changes to the common list */
+    gboolean connected;
+
+    /* TRUE if lightdm_list needs to be built from the common list */
+    gboolean list_changed;
 
     /* Wrapper list, kept locally to preserve transfer-none promises */
     GList *lightdm_list;
+
+    /* Wrapper objects keyed by the CommonUser they wrap, created on demand */
+    GHashTable *lightdm_users;
 } LightDMUserListPrivate;
 
 typedef struct
@@ -149,23 +157,39 @@ wrap_common_user (CommonUser *user)
     return lightdm_user;
 }
 
+/* Get the wrapper for a user, creating it on first use */
+static LightDMUser *
+get_lightdm_user (LightDMUserList *user_list, CommonUser *common_user)
+{
+    LightDMUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    LightDMUser *lightdm_user = g_hash_table_lookup (priv->lightdm_users, common_user);
+    if (!lightdm_user)
+    {
+        lightdm_user = wrap_common_user (common_user);
+        g_hash_table_insert (priv->lightdm_users, common_user, lightdm_user);
+    }
+
+    return lightdm_user;
+}
+
 static void
 user_list_added_cb (CommonUserList *common_list, CommonUser *common_user, LightDMUserList *user_list)
 {
     LightDMUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
-    GList *common_users = common_user_list_get_users (common_list);
-    LightDMUser *lightdm_user = wrap_common_user (common_user);
-    priv->lightdm_list = g_list_insert (priv->lightdm_list, lightdm_user, g_list_index (common_users, common_user));
+    LightDMUser *lightdm_user = get_lightdm_user (user_list, common_user);
+
+    /* Rebuild the list when next asked for, so loading many users doesn't reposition the list each time */
+    priv->list_changed = TRUE;
     g_signal_emit (user_list, list_signals[USER_ADDED], 0, lightdm_user);
 }
 
 static void
 user_list_changed_cb (CommonUserList *common_list, CommonUser *common_user, LightDMUserList *user_list)
 {
-    LightDMUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
-    GList *common_users = common_user_list_get_users (common_list);
-    LightDMUser *lightdm_user = g_list_nth_data (priv->lightdm_list, g_list_index (common_users, common_user));
-    g_signal_emit (user_list, list_signals[USER_CHANGED], 0, lightdm_user);
+    /* The user may have moved if their display name changed */
+    GET_LIST_PRIVATE (user_list)->list_changed = TRUE;
+    g_signal_emit (user_list, list_signals[USER_CHANGED], 0, get_lightdm_user (user_list, common_user));
 }
 
 static void
@@ -173,43 +197,53 @@ user_list_removed_cb (CommonUserList *common_list, CommonUser *common_user, Ligh
 {
     LightDMUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
-    for (GList *link = priv->lightdm_list; link; link = link->next)
-    {
-        LightDMUser *lightdm_user = link->data;
-        LightDMUserPrivate *user_priv = GET_USER_PRIVATE (lightdm_user);
-        if (user_priv->common_user == common_user)
-        {
-            priv->lightdm_list = g_list_delete_link (priv->lightdm_list, link);
-            g_signal_emit (user_list, list_signals[USER_REMOVED], 0, lightdm_user);
-            g_object_unref (lightdm_user);
-            break;
-        }
-    }
+    LightDMUser *lightdm_user = get_lightdm_user (user_list, common_user);
+    priv->list_changed = TRUE;
+    g_signal_emit (user_list, list_signals[USER_REMOVED], 0, lightdm_user);
+    g_hash_table_remove (priv->lightdm_users, common_user);
+}
+
+static void
+user_list_loaded_cb (CommonUserList *common_list, LightDMUserList *user_list)
+{
+    g_signal_emit (user_list, list_signals[LOADED], 0);
 }
 
 static void
-initialize_user_list_if_needed (LightDMUserList *user_list)
+connect_user_list_if_needed (LightDMUserList *user_list)
 {
     LightDMUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
 
-    if (priv->initialized)
+    if (priv->connected)
         return;
 
-    GList *common_users = common_user_list_get_users (common_user_list_get_instance ());
-    for (GList *link = common_users; link; link = link->next)
-    {
-        CommonUser *user = link->data;
-        LightDMUser *lightdm_user = wrap_common_user (user);
-        priv->lightdm_list = g_list_prepend (priv->lightdm_list, lightdm_user);
-    }
-    priv->lightdm_list = g_list_reverse (priv->lightdm_list);
-
     CommonUserList *common_list = common_user_list_get_instance ();
     g_signal_connect (common_list, USER_LIST_SIGNAL_USER_ADDED, G_CALLBACK (user_list_added_cb), user_list);
     g_signal_connect (common_list, USER_LIST_SIGNAL_USER_CHANGED, G_CALLBACK (user_list_changed_cb), user_list);
     g_signal_connect (common_list, USER_LIST_SIGNAL_USER_REMOVED, G_CALLBACK (user_list_removed_cb), user_list);
+    g_signal_connect (common_list, USER_LIST_SIGNAL_LOADED, G_CALLBACK (user_list_loaded_cb), user_list);
+
+    priv->connected = TRUE;
+}
+
+static void
+update_user_list_if_needed (LightDMUserList *user_list)
+{
+    LightDMUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    connect_user_list_if_needed (user_list);
+
+    if (!priv->list_changed)
+        return;
+
+    g_list_free (priv->lightdm_list);
+    priv->lightdm_list = NULL;
+    GList *common_users = common_user_list_get_users (common_user_list_get_instance ());
+    for (GList *link = common_users; link; link = link->next)
+        priv->lightdm_list = g_list_prepend (priv->lightdm_list, get_lightdm_user (user_list, link->data));
+    priv->lightdm_list = g_list_reverse (priv->lightdm_list);
 
-    priv->initialized = TRUE;
+    priv->list_changed = FALSE;
 }
 
 /**
@@ -222,8 +256,8 @@ gint
 lightdm_user_list_get_length (LightDMUserList *user_list)
 {
     g_return_val_if_fail (LIGHTDM_IS_USER_LIST (user_list), 0);
-    initialize_user_list_if_needed (user_list);
-    return g_list_length (GET_LIST_PRIVATE (user_list)->lightdm_list);
+    connect_user_list_if_needed (user_list);
+    return common_user_list_get_length (common_user_list_get_instance ());
 }
 
 /**
@@ -239,10 +273,99 @@ GList *
 lightdm_user_list_get_users (LightDMUserList *user_list)
 {
     g_return_val_if_fail (LIGHTDM_IS_USER_LIST (user_list), NULL);
-    initialize_user_list_if_needed (user_list);
+    update_user_list_if_needed (user_list);
     return GET_LIST_PRIVATE (user_list)->lightdm_list;
 }
 
+/**
+ * lightdm_user_list_get_users_range:
+ * @user_list: A #LightDMUserList
+ * @offset: Index of the first user to get.
+ * @count: Maximum number of users to get.
+ *
+ * Get a window of the list returned by lightdm_user_list_get_users().  Only the
+ * users in the window are wrapped, so a greeter can page through a large user
+ * list without creating an object for every user up front.
+ *
+ * Return value: (element-type LightDMUser) (transfer container): A list of #LightDMUser, free with g_list_free().
+ **/
+GList *
+lightdm_user_list_get_users_range (LightDMUserList *user_list, gint offset, gint count)
+{
+    g_return_val_if_fail (LIGHTDM_IS_USER_LIST (user_list), NULL);
+    g_return_val_if_fail (offset >= 0, NULL);
+    g_return_val_if_fail (count >= 0, NULL);
+
+    connect_user_list_if_needed (user_list);
+
+    g_autoptr(GList) common_users = common_user_list_get_users_range (common_user_list_get_instance (), offset, count);
+    GList *users = NULL;
+    for (GList *link = common_users; link; link = link->next)
+        users = g_list_prepend (users, get_lightdm_user (user_list, link->data));
+
+    return g_list_reverse (users);
+}
+
+/**
+ * lightdm_user_list_find_users:
+ * @user_list: A #LightDMUserList
+ * @prefix: Text to match against the start of the username or real name.
+ * @max_results: Maximum number of users to return or -1 for no limit.
+ *
+ * Search for users whose username or real name starts with @prefix, ignoring
+ * case.  Users are returned in the same order as lightdm_user_list_get_users().
+ *
+ * Return value: (element-type LightDMUser) (transfer container): A list of #LightDMUser, free with g_list_free().
+ **/
+GList *
+lightdm_user_list_find_users (LightDMUserList *user_list, const gchar *prefix, gint max_results)
+{
+    g_return_val_if_fail (LIGHTDM_IS_USER_LIST (user_list), NULL);
+    g_return_val_if_fail (prefix != NULL, NULL);
+
+    connect_user_list_if_needed (user_list);
+
+    g_autoptr(GList) common_users = common_user_list_find_users (common_user_list_get_instance (), prefix, max_results);
+    GList *users = NULL;
+    for (GList *link = common_users; link; link = link->next)
+        users = g_list_prepend (users, get_lightdm_user (user_list, link->data));
+
+    return g_list_reverse (users);
+}
+
+/**
+ * lightdm_user_list_load_async:
+ * @user_list: A #LightDMUserList
+ *
+ * Start loading the users without blocking.  Users are reported with the
+ * #LightDMUserList::user-added signal as they arrive and
+ * #LightDMUserList::loaded is emitted once all users are known.  Until then
+ * lightdm_user_list_get_users() only returns the users loaded so far.  Does
+ * nothing if the users are already loaded.
+ **/
+void
+lightdm_user_list_load_async (LightDMUserList *user_list)
+{
+    g_return_if_fail (LIGHTDM_IS_USER_LIST (user_list));
+    common_user_list_load_async (common_user_list_get_instance ());
+    update_user_list_if_needed (user_list);
+}
+
+/**
+ * lightdm_user_list_get_is_loaded:
+ * @user_list: A #LightDMUserList
+ *
+ * Check if all users have been loaded.
+ *
+ * Return value: #TRUE if the user list is complete.
+ **/
+gboolean
+lightdm_user_list_get_is_loaded (LightDMUserList *user_list)
+{
+    g_return_val_if_fail (LIGHTDM_IS_USER_LIST (user_list), FALSE);
+    return common_user_list_get_is_loaded (common_user_list_get_instance ());
+}
+
 /**
  * lightdm_user_list_get_user_by_name:
  * @user_list: A #LightDMUserList
@@ -258,7 +381,7 @@ lightdm_user_list_get_user_by_name (LightDMUserList *user_list, const gchar *use
     g_return_val_if_fail (LIGHTDM_IS_USER_LIST (user_list), NULL);
     g_return_val_if_fail (username != NULL, NULL);
 
-    initialize_user_list_if_needed (user_list);
+    update_user_list_if_needed (user_list);
 
     for (GList *link = GET_LIST_PRIVATE (user_list)->lightdm_list; link; link = link->next)
     {
@@ -273,6 +396,10 @@ lightdm_user_list_get_user_by_name (LightDMUserList *user_list, const gchar *use
 static void
 lightdm_user_list_init (LightDMUserList *user_list)
 {
+    LightDMUserListPrivate *priv = GET_LIST_PRIVATE (user_list);
+
+    priv->lightdm_users = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_object_unref);
+    priv->list_changed = TRUE;
 }
 
 static void
@@ -310,7 +437,8 @@ lightdm_user_list_finalize (GObject *object)
     LightDMUserList *self = LIGHTDM_USER_LIST (object);
     LightDMUserListPrivate *priv = GET_LIST_PRIVATE (self);
 
-    g_list_free_full (priv->lightdm_list, g_object_unref);
+    g_list_free (priv->lightdm_list);
+    g_hash_table_unref (priv->lightdm_users);
 
     G_OBJECT_CLASS (lightdm_user_list_parent_class)->finalize (object);
 }
@@ -396,6 +524,22 @@ lightdm_user_list_class_init (LightDMUserListClass *klass)
                       NULL, NULL,
                       NULL,
                       G_TYPE_NONE, 1, LIGHTDM_TYPE_USER);
+
+    /**
+     * LightDMUserList::loaded:
+     * @user_list: A #LightDMUserList
+     *
+     * The ::loaded signal gets emitted when loading started with
+     * lightdm_user_list_load_async() has completed.
+     **/
+    list_signals[LOADED] =
+        g_signal_new (LIGHTDM_USER_LIST_SIGNAL_LOADED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (LightDMUserListClass, loaded),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
 }
 
 /**
@@ -679,6 +823,7 @@ lightdm_user_finalize (GObject *object)
     LightDMUser *self = LIGHTDM_USER (object);
     LightDMUserPrivate *priv = GET_USER_PRIVATE (self);
 
+    g_signal_handlers_disconnect_by_data (priv->common_user, self);
     g_object_unref (priv->common_user);
 
     G_OBJECT_CLASS (lightdm_user_parent_class)->finalize (object);
@@ -18,6 +18,9 @@
 
 using namespace QLightDM;
 
+/* Number of users to read from the user list each time a row past the cached ones is needed */
+static const int FETCH_BATCH_SIZE = 100;
+
 class UserItem
 {
 public:
@@ -47,12 +50,23 @@ class UsersModelPrivate {
 public:
     UsersModelPrivate(UsersModel *parent);
     virtual ~UsersModelPrivate();
-    QList<UserItem> users;
+
+    /* Number of users in the model, the same as the length of the user list */
+    int count;
+
+    /* Users read so far, the first rows of the model in the user list order */
+    mutable QList<UserItem> users;
 
     protected:
         UsersModel * const q_ptr;
 
         void loadUsers();
+        void resetUsers();
+        void fetchUsers(int row) const;
+
+        static UserItem makeUserItem(LightDMUser *ldmUser);
+        static int compareUsers(LightDMUser *a, LightDMUser *b);
+        static int findRow(LightDMUserList *user_list, LightDMUser *ldmUser);
 
         static void cb_userAdded(LightDMUserList *user_list, LightDMUser *user, gpointer data);
         static void cb_userChanged(LightDMUserList *user_list, LightDMUser *user, gpointer data);
@@ -63,6 +77,7 @@ public:
 }
 
 UsersModelPrivate::UsersModelPrivate(UsersModel* parent) :
+    count(0),
     q_ptr(parent)
 {
 #if !defined(GLIB_VERSION_2_36)
@@ -75,105 +90,156 @@ UsersModelPrivate::~UsersModelPrivate()
     g_signal_handlers_disconnect_by_data(lightdm_user_list_get_instance(), this);
 }
 
-void UsersModelPrivate::loadUsers()
+UserItem UsersModelPrivate::makeUserItem(LightDMUser *ldmUser)
 {
-    Q_Q(UsersModel);
+    UserItem user;
+    user.name = QString::fromUtf8(lightdm_user_get_name(ldmUser));
+    user.homeDirectory = QString::fromUtf8(lightdm_user_get_home_directory(ldmUser));
+    user.realName = QString::fromUtf8(lightdm_user_get_real_name(ldmUser));
+    user.image = QString::fromUtf8(lightdm_user_get_image(ldmUser));
+    user.background = QString::fromUtf8(lightdm_user_get_background(ldmUser));
+    user.session = QString::fromUtf8(lightdm_user_get_session(ldmUser));
+    user.isLoggedIn = lightdm_user_get_logged_in(ldmUser);
+    user.hasMessages = lightdm_user_get_has_messages(ldmUser);
+    user.uid = (quint64)lightdm_user_get_uid(ldmUser);
+    return user;
+}
 
-    int rowCount = lightdm_user_list_get_length(lightdm_user_list_get_instance());
+// Same order as the user list: display name then username, compared as UTF-8 bytes
+int UsersModelPrivate::compareUsers(LightDMUser *a, LightDMUser *b)
+{
+    int result = g_strcmp0(lightdm_user_get_display_name(a), lightdm_user_get_display_name(b));
+    if (result != 0) {
+        return result;
+    }
+    return g_strcmp0(lightdm_user_get_name(a), lightdm_user_get_name(b));
+}
 
-    if (rowCount == 0) {
-        return;
-    } else {
-        q->beginInsertRows(QModelIndex(), 0, rowCount-1);
-
-        const GList *items, *item;
-        items = lightdm_user_list_get_users(lightdm_user_list_get_instance());
-        for (item = items; item; item = item->next) {
-            LightDMUser *ldmUser = static_cast<LightDMUser*>(item->data);
-
-            UserItem user;
-            user.name = QString::fromUtf8(lightdm_user_get_name(ldmUser));
-            user.homeDirectory = QString::fromUtf8(lightdm_user_get_home_directory(ldmUser));
-            user.realName = QString::fromUtf8(lightdm_user_get_real_name(ldmUser));
-            user.image = QString::fromUtf8(lightdm_user_get_image(ldmUser));
-            user.background = QString::fromUtf8(lightdm_user_get_background(ldmUser));
-            user.session = QString::fromUtf8(lightdm_user_get_session(ldmUser));
-            user.isLoggedIn = lightdm_user_get_logged_in(ldmUser);
-            user.hasMessages = lightdm_user_get_has_messages(ldmUser);
-            user.uid = (quint64)lightdm_user_get_uid(ldmUser);
-            users.append(user);
+// Position of a user in the user list, or where they were if they have just been removed.
+// The list is updated before each signal so this is also the row in the model.
+int UsersModelPrivate::findRow(LightDMUserList *user_list, LightDMUser *ldmUser)
+{
+    int start = 0, end = lightdm_user_list_get_length(user_list);
+    while (start < end) {
+        int middle = start + (end - start) / 2;
+        GList *items = lightdm_user_list_get_users_range(user_list, middle, 1);
+        int result = items ? compareUsers(static_cast<LightDMUser*>(items->data), ldmUser) : 0;
+        g_list_free(items);
+        if (result < 0) {
+            start = middle + 1;
+        } else {
+            end = middle;
         }
-
-        q->endInsertRows();
     }
+    return start;
+}
+
+void UsersModelPrivate::loadUsers()
+{
+    count = lightdm_user_list_get_length(lightdm_user_list_get_instance());
+
     g_signal_connect(lightdm_user_list_get_instance(), LIGHTDM_USER_LIST_SIGNAL_USER_ADDED, G_CALLBACK (cb_userAdded), this);
     g_signal_connect(lightdm_user_list_get_instance(), LIGHTDM_USER_LIST_SIGNAL_USER_CHANGED, G_CALLBACK (cb_userChanged), this);
     g_signal_connect(lightdm_user_list_get_instance(), LIGHTDM_USER_LIST_SIGNAL_USER_REMOVED, G_CALLBACK (cb_userRemoved), this);
 }
 
+void UsersModelPrivate::resetUsers()
+{
+    Q_Q(UsersModel);
+
+    q->beginResetModel();
+    users.clear();
+    count = lightdm_user_list_get_length(lightdm_user_list_get_instance());
+    q->endResetModel();
+}
+
+// Read users from the user list until the given row is cached
+void UsersModelPrivate::fetchUsers(int row) const
+{
+    while (users.size() <= row) {
+        GList *items = lightdm_user_list_get_users_range(lightdm_user_list_get_instance(), users.size(), qMax(FETCH_BATCH_SIZE, row + 1 - users.size()));
+        if (!items) {
+            break;
+        }
+
+        for (GList *item = items; item; item = item->next) {
+            users.append(makeUserItem(static_cast<LightDMUser*>(item->data)));
+        }
+
+        g_list_free(items);
+    }
+}
+
 void UsersModelPrivate::cb_userAdded(LightDMUserList *user_list, LightDMUser *ldmUser, gpointer data)
 {
-    Q_UNUSED(user_list)
     UsersModelPrivate *that = static_cast<UsersModelPrivate*>(data);
 
-    that->q_func()->beginInsertRows(QModelIndex(), that->users.size(), that->users.size());
-
-    UserItem user;
-    user.name = QString::fromUtf8(lightdm_user_get_name(ldmUser));
-    user.homeDirectory = QString::fromUtf8(lightdm_user_get_home_directory(ldmUser));
-    user.realName = QString::fromUtf8(lightdm_user_get_real_name(ldmUser));
-    user.image = QString::fromUtf8(lightdm_user_get_image(ldmUser));
-    user.background = QString::fromUtf8(lightdm_user_get_background(ldmUser));
-    user.isLoggedIn = lightdm_user_get_logged_in(ldmUser);
-    user.hasMessages = lightdm_user_get_has_messages(ldmUser);
-    user.uid = (quint64)lightdm_user_get_uid(ldmUser);
-    that->users.append(user);
+    int row = findRow(user_list, ldmUser);
 
+    that->q_func()->beginInsertRows(QModelIndex(), row, row);
+    // Users after the cached rows are read when they are first needed
+    if (row <= that->users.size()) {
+        that->users.insert(row, makeUserItem(ldmUser));
+    }
+    that->count++;
     that->q_func()->endInsertRows();
-
 }
 
 void UsersModelPrivate::cb_userChanged(LightDMUserList *user_list, LightDMUser *ldmUser, gpointer data)
 {
-    Q_UNUSED(user_list)
     UsersModelPrivate *that = static_cast<UsersModelPrivate*>(data);
 
     QString userToChange = QString::fromUtf8(lightdm_user_get_name(ldmUser));
 
+    int oldRow = -1;
     for (int i=0;i<that->users.size();i++) {
         if (that->users[i].name == userToChange) {
-
-            that->users[i].homeDirectory = QString::fromUtf8(lightdm_user_get_home_directory(ldmUser));
-            that->users[i].realName = QString::fromUtf8(lightdm_user_get_real_name(ldmUser));
-            that->users[i].image = QString::fromUtf8(lightdm_user_get_image(ldmUser));
-            that->users[i].background = QString::fromUtf8(lightdm_user_get_background(ldmUser));
-            that->users[i].isLoggedIn = lightdm_user_get_logged_in(ldmUser);
-            that->users[i].hasMessages = lightdm_user_get_has_messages(ldmUser);
-            that->users[i].uid = (quint64)lightdm_user_get_uid(ldmUser);
-
-            QModelIndex index = that->q_ptr->createIndex(i, 0);
-            that->q_ptr->dataChanged(index, index);
+            oldRow = i;
             break;
         }
     }
+
+    // The user has moved if their display name changed
+    int row = findRow(user_list, ldmUser);
+    if (row != oldRow) {
+        if (oldRow >= 0 || row < that->users.size()) {
+            that->resetUsers();
+        }
+        return;
+    }
+
+    that->users[row] = makeUserItem(ldmUser);
+
+    QModelIndex index = that->q_ptr->createIndex(row, 0);
+    that->q_ptr->dataChanged(index, index);
 }
 
 
 void UsersModelPrivate::cb_userRemoved(LightDMUserList *user_list, LightDMUser *ldmUser, gpointer data)
 {
-    Q_UNUSED(user_list)
-
     UsersModelPrivate *that = static_cast<UsersModelPrivate*>(data);
-    QString userToRemove = QString::fromUtf8(lightdm_user_get_name(ldmUser));
 
-    for (int i=0;i<that->users.size();i++) {
-        if (that->users[i].name == userToRemove) {
-            that->q_ptr->beginRemoveRows(QModelIndex(), i, i);
-            that->users.removeAt(i);
-            that->q_ptr->endRemoveRows();
-            break;
+    int row = findRow(user_list, ldmUser);
+
+    // Cache the removed user so the row can still be read until it is gone.
+    // The user is no longer in the list so only read the users before them.
+    if (row >= that->users.size()) {
+        GList *items = lightdm_user_list_get_users_range(user_list, that->users.size(), row - that->users.size());
+        for (GList *item = items; item; item = item->next) {
+            that->users.append(makeUserItem(static_cast<LightDMUser*>(item->data)));
         }
+        g_list_free(items);
+        that->users.append(makeUserItem(ldmUser));
+    }
+    if (row >= that->users.size() || that->users[row].name != QString::fromUtf8(lightdm_user_get_name(ldmUser))) {
+        that->resetUsers();
+        return;
     }
+
+    that->q_ptr->beginRemoveRows(QModelIndex(), row, row);
+    that->users.removeAt(row);
+    that->count--;
+    that->q_ptr->endRemoveRows();
 }
 
 UsersModel::UsersModel(QObject *parent) :
@@ -207,7 +273,7 @@ int UsersModel::rowCount(const QModelIndex &parent) const
 {
     Q_D(const UsersModel);
     if (parent == QModelIndex()) {
-        return d->users.size();
+        return d->count;
     }
 
     return 0;
@@ -222,6 +288,11 @@ QVariant UsersModel::data(const QModelIndex &index, int role) const
     }
 
     int row = index.row();
+    d->fetchUsers(row);
+    if (row >= d->users.size()) {
+        return QVariant();
+    }
+
     switch (role) {
     case Qt::DisplayRole:
         return d->users[row].displayName();
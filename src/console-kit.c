@@ -75,45 +75,93 @@ get_ck_session (GDBusConnection *bus, const gchar *cookie)
     return g_steal_pointer (&session_path);
 }
 
-void
-ck_lock_session (const gchar *cookie)
+typedef struct
 {
-    g_return_if_fail (cookie != NULL);
+    GDBusConnection *bus;
+    gchar *cookie;
+    const gchar *method;
+    const gchar *description;
+} SessionCall;
 
-    g_debug ("Locking ConsoleKit session %s", cookie);
+/* Most recent call still in progress for each session, keyed by cookie */
+static GHashTable *session_calls = NULL;
+
+/* Last call made to any session if still in progress */
+static SessionCall *last_session_call = NULL;
+
+static void
+session_call_free (SessionCall *call)
+{
+    /* Only clear if a newer call hasn't replaced this one */
+    if (g_hash_table_lookup (session_calls, call->cookie) == call)
+        g_hash_table_remove (session_calls, call->cookie);
+    if (last_session_call == call)
+        last_session_call = NULL;
+
+    g_object_unref (call->bus);
+    g_free (call->cookie);
+    g_free (call);
+}
+
+static void
+session_method_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+    SessionCall *call = data;
 
     g_autoptr(GError) error = NULL;
-    g_autoptr(GDBusConnection) bus = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
+    g_autoptr(GVariant) result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
     if (error)
-        g_warning ("Failed to get system bus: %s", error->message);
-    if (!bus)
-        return;
+        g_warning ("Error %s ConsoleKit session: %s", call->description, error->message);
 
-    g_autofree gchar *session_path = get_ck_session (bus, cookie);
-    if (!session_path)
-        return;
+    session_call_free (call);
+}
 
-    g_autoptr(GVariant) result = g_dbus_connection_call_sync (bus,
-                                                              "org.freedesktop.ConsoleKit",
-                                                              session_path,
-                                                              "org.freedesktop.ConsoleKit.Session",
-                                                              "Lock",
-                                                              g_variant_new ("()"),
-                                                              G_VARIANT_TYPE ("()"),
-                                                              G_DBUS_CALL_FLAGS_NONE,
-                                                              -1,
-                                                              NULL,
-                                                              &error);
+static void
+get_session_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+    SessionCall *call = data;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
     if (error)
-        g_warning ("Error locking ConsoleKit session: %s", error->message);
+        g_warning ("Error getting ConsoleKit session: %s", error->message);
+    if (!result)
+    {
+        session_call_free (call);
+        return;
+    }
+
+    const gchar *session_path;
+    g_variant_get (result, "(&o)", &session_path);
+    g_dbus_connection_call (call->bus,
+                            "org.freedesktop.ConsoleKit",
+                            session_path,
+                            "org.freedesktop.ConsoleKit.Session",
+                            call->method,
+                            g_variant_new ("()"),
+                            G_VARIANT_TYPE ("()"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            NULL,
+                            session_method_cb,
+                            call);
 }
 
-void
-ck_unlock_session (const gchar *cookie)
+/* Calls a method on a session without waiting for the result */
+static void
+call_session_method (const gchar *cookie, const gchar *method, const gchar *description)
 {
-    g_return_if_fail (cookie != NULL);
-
-    g_debug ("Unlocking ConsoleKit session %s", cookie);
+    if (!session_calls)
+        session_calls = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    /* Same request is already on its way, so this one would have no effect.
+     * Only if nothing has been called since, e.g. activating another session in between has to be undone */
+    SessionCall *pending_call = g_hash_table_lookup (session_calls, cookie);
+    if (pending_call && pending_call == last_session_call && g_strcmp0 (pending_call->method, method) == 0)
+    {
+        g_debug ("Already %s ConsoleKit session %s", description, cookie);
+        return;
+    }
 
     g_autoptr(GError) error = NULL;
     g_autoptr(GDBusConnection) bus = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
@@ -122,56 +170,56 @@ ck_unlock_session (const gchar *cookie)
     if (!bus)
         return;
 
-    g_autofree gchar *session_path = get_ck_session (bus, cookie);
-    if (!session_path)
-        return;
+    SessionCall *call = g_malloc0 (sizeof (SessionCall));
+    call->bus = g_object_ref (bus);
+    call->cookie = g_strdup (cookie);
+    call->method = method;
+    call->description = description;
+    g_hash_table_insert (session_calls, g_strdup (cookie), call);
+    last_session_call = call;
+
+    g_dbus_connection_call (bus,
+                            "org.freedesktop.ConsoleKit",
+                            "/org/freedesktop/ConsoleKit/Manager",
+                            "org.freedesktop.ConsoleKit.Manager",
+                            "GetSessionForCookie",
+                            g_variant_new ("(s)", cookie),
+                            G_VARIANT_TYPE ("(o)"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            NULL,
+                            get_session_cb,
+                            call);
+}
 
-    g_autoptr(GVariant) result = g_dbus_connection_call_sync (bus,
-                                                              "org.freedesktop.ConsoleKit",
-                                                              session_path,
-                                                              "org.freedesktop.ConsoleKit.Session",
-                                                              "Unlock",
-                                                              g_variant_new ("()"),
-                                                              G_VARIANT_TYPE ("()"),
-                                                              G_DBUS_CALL_FLAGS_NONE,
-                                                              -1,
-                                                              NULL,
-                                                              &error);
-    if (error)
-        g_warning ("Error unlocking ConsoleKit session: %s", error->message);
+void
+ck_lock_session (const gchar *cookie)
+{
+    g_return_if_fail (cookie != NULL);
+
+    g_debug ("Locking ConsoleKit session %s", cookie);
+
+    call_session_method (cookie, "Lock", "locking");
 }
 
 void
-ck_activate_session (const gchar *cookie)
+ck_unlock_session (const gchar *cookie)
 {
     g_return_if_fail (cookie != NULL);
 
-    g_debug ("Activating ConsoleKit session %s", cookie);
+    g_debug ("Unlocking ConsoleKit session %s", cookie);
 
-    g_autoptr(GError) error = NULL;
-    g_autoptr(GDBusConnection) bus = g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, &error);
-    if (error)
-        g_warning ("Failed to get system bus: %s", error->message);
-    if (!bus)
-        return;
+    call_session_method (cookie, "Unlock", "unlocking");
+}
 
-    g_autofree gchar *session_path = get_ck_session (bus, cookie);
-    if (!session_path)
-        return;
+void
+ck_activate_session (const gchar *cookie)
+{
+    g_return_if_fail (cookie != NULL);
 
-    g_autoptr(GVariant) result = g_dbus_connection_call_sync (bus,
-                                                              "org.freedesktop.ConsoleKit",
-                                                              session_path,
-                                                              "org.freedesktop.ConsoleKit.Session",
-                                                              "Activate",
-                                                              g_variant_new ("()"),
-                                                              G_VARIANT_TYPE ("()"),
-                                                              G_DBUS_CALL_FLAGS_NONE,
-                                                              -1,
-                                                              NULL,
-                                                              &error);
-    if (error)
-        g_warning ("Error activating ConsoleKit session: %s", error->message);
+    g_debug ("Activating ConsoleKit session %s", cookie);
+
+    call_session_method (cookie, "Activate", "activating");
 }
 
 void
@@ -11,6 +11,7 @@
 #include <config.h>
 
 #include "display-manager-service.h"
+#include "timing-stats.h"
 
 enum {
     READY,
@@ -202,6 +203,8 @@ handle_display_manager_get_property (GDBusConnection       *connection,
         return get_seat_list (service);
     else if (g_strcmp0 (property_name, "Sessions") == 0)
         return get_session_list (service, NULL);
+    else if (g_strcmp0 (property_name, "Timings") == 0)
+        return timing_stats_to_variant (timing_stats_get_instance ());
 
     return NULL;
 }
@@ -263,6 +266,8 @@ handle_seat_get_property (GDBusConnection       *connection,
         return g_variant_new_boolean (seat_get_allow_guest (entry->seat));
     else if (g_strcmp0 (property_name, "Sessions") == 0)
         return get_session_list (entry->service, entry->path);
+    else if (g_strcmp0 (property_name, "Timings") == 0)
+        return timing_stats_to_variant (seat_get_timing_stats (entry->seat));
 
     return NULL;
 }
@@ -524,6 +529,7 @@ bus_acquired_cb (GDBusConnection *connection,
         "  <interface name='org.freedesktop.DisplayManager'>"
         "    <property name='Seats' type='ao' access='read'/>"
         "    <property name='Sessions' type='ao' access='read'/>"
+        "    <property name='Timings' type='a(stdadat)' access='read'/>"
         "    <method name='AddSeat'>"
         "      <arg name='type' direction='in' type='s'/>"
         "      <arg name='properties' direction='in' type='a(ss)'/>"
@@ -556,6 +562,7 @@ bus_acquired_cb (GDBusConnection *connection,
         "    <property name='CanSwitch' type='b' access='read'/>"
         "    <property name='HasGuestAccount' type='b' access='read'/>"
         "    <property name='Sessions' type='ao' access='read'/>"
+        "    <property name='Timings' type='a(stdadat)' access='read'/>"
         "    <method name='SwitchToGreeter'/>"
         "    <method name='SwitchToUser'>"
         "      <arg name='username' direction='in' type='s'/>"
@@ -22,6 +22,9 @@ static guint signals[LAST_SIGNAL] = { 0 };
 
 struct DisplayServerPrivate
 {
+    /* Monotonic time the display server was started */
+    gint64 start_time;
+
     /* TRUE when started */
     gboolean is_ready;
 
@@ -86,9 +89,17 @@ gboolean
 display_server_start (DisplayServer *server)
 {
     g_return_val_if_fail (server != NULL, FALSE);
+    server->priv->start_time = g_get_monotonic_time ();
     return DISPLAY_SERVER_GET_CLASS (server)->start (server);
 }
 
+gint64
+display_server_get_start_time (DisplayServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return server->priv->start_time;
+}
+
 gboolean
 display_server_get_is_ready (DisplayServer *server)
 {
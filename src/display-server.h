@@ -66,6 +66,8 @@ gint display_server_get_vt (DisplayServer *server);
 
 gboolean display_server_start (DisplayServer *server);
 
+gint64 display_server_get_start_time (DisplayServer *server);
+
 gboolean display_server_get_is_ready (DisplayServer *server);
 
 void display_server_connect_session (DisplayServer *server, Session *session);
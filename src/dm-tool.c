@@ -22,6 +22,57 @@ static GDBusProxy *dm_proxy, *seat_proxy = NULL;
 static gint xephyr_display_number;
 static GPid xephyr_pid;
 
+/* Get the upper bound of the histogram bucket the given percentile falls in */
+static gchar *
+get_percentile (GVariant *bounds, GVariant *buckets, guint64 count, guint percent)
+{
+    guint64 rank = (count * percent + 99) / 100;
+
+    guint64 total = 0;
+    gsize n_bounds = g_variant_n_children (bounds);
+    for (gsize i = 0; i < g_variant_n_children (buckets); i++)
+    {
+        guint64 bucket_count;
+        g_variant_get_child (buckets, i, "t", &bucket_count);
+        total += bucket_count;
+        if (total < rank)
+            continue;
+
+        gdouble bound;
+        if (i >= n_bounds)
+        {
+            g_variant_get_child (bounds, n_bounds - 1, "d", &bound);
+            return g_strdup_printf (">%.3fs", bound);
+        }
+        g_variant_get_child (bounds, i, "d", &bound);
+        return g_strdup_printf ("<=%.3fs", bound);
+    }
+
+    return g_strdup ("-");
+}
+
+static void
+print_timings (GVariant *timings)
+{
+    g_autoptr(GVariantIter) iter = NULL;
+    g_variant_get (timings, "a(stdadat)", &iter);
+    const gchar *phase;
+    guint64 count;
+    gdouble sum;
+    GVariant *bounds, *buckets;
+    while (g_variant_iter_loop (iter, "(&std@ad@at)", &phase, &count, &sum, &bounds, &buckets))
+    {
+        if (count == 0)
+            continue;
+
+        g_autofree gchar *p50 = get_percentile (bounds, buckets, count, 50);
+        g_autofree gchar *p90 = get_percentile (bounds, buckets, count, 90);
+        g_autofree gchar *p99 = get_percentile (bounds, buckets, count, 99);
+        g_print ("  %s count=%" G_GUINT64_FORMAT " mean=%.3fs p50%s p90%s p99%s\n",
+                 phase, count, sum / count, p50, p90, p99);
+    }
+}
+
 static void
 usage (void)
 {
@@ -128,6 +179,7 @@ main (int argc, char **argv)
                         "  switch-to-guest [SESSION]                            Switch to a guest session\n"
                         "  lock                                                 Lock the current seat\n"
                         "  list-seats                                           List the active seats\n"
+                        "  stats                                                Show how long seats and sessions take to start\n"
                         "  add-nested-seat [--fullscreen|--screen DIMENSIONS]   Start a nested display\n"
                         "  add-local-x-seat DISPLAY_NUMBER                      Add a local X seat\n"
                         "  add-seat TYPE [NAME=VALUE...]                        Add a dynamic seat\n");
@@ -309,7 +361,7 @@ main (int argc, char **argv)
             g_auto(GStrv) property_names = g_dbus_proxy_get_cached_property_names (proxy);
             for (int i = 0; property_names[i]; i++)
             {
-                if (strcmp (property_names[i], "Sessions") == 0)
+                if (strcmp (property_names[i], "Sessions") == 0 || strcmp (property_names[i], "Timings") == 0)
                     continue;
 
                 g_autoptr(GVariant) value = g_dbus_proxy_get_cached_property (proxy, property_names[i]);
@@ -359,6 +411,56 @@ main (int argc, char **argv)
 
         return EXIT_SUCCESS;
     }
+    else if (strcmp (command, "stats") == 0)
+    {
+        if (!g_dbus_proxy_get_name_owner (dm_proxy))
+        {
+            g_printerr ("Unable to contact display manager\n");
+            return EXIT_FAILURE;
+        }
+
+        g_autoptr(GVariant) timings = g_dbus_proxy_get_cached_property (dm_proxy, "Timings");
+        if (!timings)
+        {
+            g_printerr ("Display manager does not record timings\n");
+            return EXIT_FAILURE;
+        }
+        g_print ("All seats\n");
+        print_timings (timings);
+
+        g_autoptr(GVariant) seats = g_dbus_proxy_get_cached_property (dm_proxy, "Seats");
+        g_autoptr(GVariantIter) seat_iter = NULL;
+        g_variant_get (seats, "ao", &seat_iter);
+        const gchar *seat_path;
+        while (g_variant_iter_loop (seat_iter, "&o", &seat_path))
+        {
+            const gchar *seat_name;
+            if (g_str_has_prefix (seat_path, "/org/freedesktop/DisplayManager/"))
+                seat_name = seat_path + strlen ("/org/freedesktop/DisplayManager/");
+            else
+                seat_name = seat_path;
+
+            g_autoptr(GDBusProxy) proxy = g_dbus_proxy_new_sync (g_dbus_proxy_get_connection (dm_proxy),
+                                                                 G_DBUS_PROXY_FLAGS_NONE,
+                                                                 NULL,
+                                                                 "org.freedesktop.DisplayManager",
+                                                                 seat_path,
+                                                                 "org.freedesktop.DisplayManager.Seat",
+                                                                 NULL,
+                                                                 NULL);
+            if (!proxy || !g_dbus_proxy_get_name_owner (proxy))
+                continue;
+
+            g_autoptr(GVariant) seat_timings = g_dbus_proxy_get_cached_property (proxy, "Timings");
+            if (!seat_timings)
+                continue;
+
+            g_print ("%s\n", seat_name);
+            print_timings (seat_timings);
+        }
+
+        return EXIT_SUCCESS;
+    }
     else if (strcmp (command, "add-nested-seat") == 0)
     {
         const gchar *path = g_find_program_in_path ("Xephyr");
@@ -12,6 +12,10 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/uio.h>
 #include <gcrypt.h>
 
 #include "greeter.h"
@@ -37,8 +41,9 @@ struct GreeterPrivate
     gchar *pam_service;
     gchar *autologin_pam_service;
 
-    /* Buffer for data read from greeter */
+    /* Buffer for data read from greeter, may contain several messages */
     guint8 *read_buffer;
+    gsize read_buffer_size;
     gsize n_read;
     gboolean use_secure_memory;
 
@@ -81,6 +86,15 @@ struct GreeterPrivate
     GIOChannel *to_greeter_channel;
     GIOChannel *from_greeter_channel;
     guint from_greeter_watch;
+    guint to_greeter_watch;
+
+    /* Messages waiting to be written to the greeter */
+    GQueue outbound;
+    gsize outbound_offset;
+    gsize outbound_length;
+
+    /* TRUE if stopped reading until the greeter reads what we have sent */
+    gboolean read_paused;
 };
 
 G_DEFINE_TYPE (Greeter, greeter, G_TYPE_OBJECT)
@@ -130,6 +144,7 @@ greeter_set_file_descriptors (Greeter *greeter, int to_greeter_fd, int from_gree
     g_return_if_fail (greeter->priv->from_greeter_output < 0);
 
     greeter->priv->to_greeter_input = to_greeter_fd;
+    fcntl (to_greeter_fd, F_SETFL, fcntl (to_greeter_fd, F_GETFL) | O_NONBLOCK);
     greeter->priv->to_greeter_channel = g_io_channel_unix_new (greeter->priv->to_greeter_input);
     g_autoptr(GError) to_error = NULL;
     g_io_channel_set_encoding (greeter->priv->to_greeter_channel, NULL, &to_error);
@@ -137,6 +152,7 @@ greeter_set_file_descriptors (Greeter *greeter, int to_greeter_fd, int from_gree
         g_warning ("Failed to set encoding on to greeter channel to binary: %s\n", to_error->message);
 
     greeter->priv->from_greeter_output = from_greeter_fd;
+    fcntl (from_greeter_fd, F_SETFL, fcntl (from_greeter_fd, F_GETFL) | O_NONBLOCK);
     greeter->priv->from_greeter_channel = g_io_channel_unix_new (greeter->priv->from_greeter_output);
     g_autoptr(GError) from_error = NULL;
     g_io_channel_set_encoding (greeter->priv->from_greeter_channel, NULL, &from_error);
@@ -228,78 +244,181 @@ int_length (void)
 }
 
 #define HEADER_SIZE (sizeof (guint32) * 2)
-#define MAX_MESSAGE_LENGTH 1024
+
+/* Stop reading requests from a greeter that has this much data it hasn't read */
+#define MAX_OUTBOUND_LENGTH (256 * 1024)
+
+/* Maximum number of queued messages to write in one call */
+#define MAX_WRITE_VECTORS 16
+
+/* Initial size of the read buffer, enough for several typical messages */
+#define READ_BUFFER_SIZE 4096
+
+/* Maximum number of reads before returning to the main loop */
+#define MAX_READS_PER_WAKEUP 16
+
+static gboolean write_cb (GIOChannel *source, GIOCondition condition, gpointer data);
 
 static void
-write_message (Greeter *greeter, guint8 *message, gsize message_length)
+pause_reading (Greeter *greeter)
 {
-    gchar *data = (gchar *) message;
-    gsize data_length = message_length;
-    while (data_length > 0)
-    {
-        GIOStatus status;
-        gsize n_written;
-
-        g_autoptr(GError) error = NULL;
-        status = g_io_channel_write_chars (greeter->priv->to_greeter_channel, data, data_length, &n_written, &error);
-        if (error)
-            g_warning ("Error writing to greeter: %s", error->message);
-        if (status != G_IO_STATUS_NORMAL)
-            return;
-        data_length -= n_written;
-        data += n_written;
-    }
+    if (greeter->priv->read_paused || greeter->priv->from_greeter_watch == 0)
+        return;
 
-    g_autoptr(GError) error = NULL;
-    g_io_channel_flush (greeter->priv->to_greeter_channel, &error);
-    if (error)
-        g_warning ("Failed to flush data to greeter: %s", error->message);
+    g_debug ("Greeter not reading messages, waiting before reading more requests");
+    g_source_remove (greeter->priv->from_greeter_watch);
+    greeter->priv->from_greeter_watch = 0;
+    greeter->priv->read_paused = TRUE;
 }
 
 static void
-write_int (guint8 *buffer, gint buffer_length, guint32 value, gsize *offset)
+resume_reading (Greeter *greeter)
 {
-    if (*offset + 4 >= buffer_length)
+    if (!greeter->priv->read_paused)
         return;
-    buffer[*offset] = value >> 24;
-    buffer[*offset+1] = (value >> 16) & 0xFF;
-    buffer[*offset+2] = (value >> 8) & 0xFF;
-    buffer[*offset+3] = value & 0xFF;
-    *offset += 4;
+
+    greeter->priv->read_paused = FALSE;
+    greeter->priv->from_greeter_watch = g_io_add_watch (greeter->priv->from_greeter_channel, G_IO_IN | G_IO_HUP, read_cb, greeter);
 }
 
 static void
-write_string (guint8 *buffer, gint buffer_length, const gchar *value, gsize *offset)
+clear_outbound (Greeter *greeter)
 {
-    gint length;
-    if (value)
-        length = strlen (value);
-    else
-        length = 0;
-    write_int (buffer, buffer_length, length, offset);
-    if (*offset + length >= buffer_length)
-        return;
-    if (length > 0)
+    g_queue_foreach (&greeter->priv->outbound, (GFunc) g_bytes_unref, NULL);
+    g_queue_clear (&greeter->priv->outbound);
+    greeter->priv->outbound_offset = 0;
+    greeter->priv->outbound_length = 0;
+}
+
+static void
+flush_outbound (Greeter *greeter)
+{
+    while (!g_queue_is_empty (&greeter->priv->outbound))
     {
-        memcpy (buffer + *offset, value, length);
-        *offset += length;
+        /* Write as many queued messages as possible at once */
+        struct iovec iov[MAX_WRITE_VECTORS];
+        int n_iov = 0;
+        gsize offset = greeter->priv->outbound_offset;
+        for (GList *link = greeter->priv->outbound.head; link && n_iov < MAX_WRITE_VECTORS; link = link->next)
+        {
+            gsize size;
+            const guint8 *data = g_bytes_get_data (link->data, &size);
+            iov[n_iov].iov_base = (void *) (data + offset);
+            iov[n_iov].iov_len = size - offset;
+            n_iov++;
+            offset = 0;
+        }
+
+        ssize_t n_written = writev (greeter->priv->to_greeter_input, iov, n_iov);
+        if (n_written < 0)
+        {
+            if (errno == EINTR)
+                continue;
+
+            /* Wait until the greeter has read some data */
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+                if (greeter->priv->to_greeter_watch == 0)
+                    greeter->priv->to_greeter_watch = g_io_add_watch (greeter->priv->to_greeter_channel, G_IO_OUT, write_cb, greeter);
+                return;
+            }
+
+            g_warning ("Error writing to greeter: %s", strerror (errno));
+            clear_outbound (greeter);
+            break;
+        }
+
+        /* Drop messages that have been completely written */
+        greeter->priv->outbound_length -= n_written;
+        gsize n_remaining = n_written;
+        while (n_remaining > 0)
+        {
+            GBytes *head = g_queue_peek_head (&greeter->priv->outbound);
+            gsize head_remaining = g_bytes_get_size (head) - greeter->priv->outbound_offset;
+            if (n_remaining < head_remaining)
+            {
+                greeter->priv->outbound_offset += n_remaining;
+                break;
+            }
+
+            n_remaining -= head_remaining;
+            g_bytes_unref (g_queue_pop_head (&greeter->priv->outbound));
+            greeter->priv->outbound_offset = 0;
+        }
     }
+
+    if (greeter->priv->to_greeter_watch)
+        g_source_remove (greeter->priv->to_greeter_watch);
+    greeter->priv->to_greeter_watch = 0;
+    resume_reading (greeter);
+}
+
+static gboolean
+write_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    Greeter *greeter = data;
+
+    /* Re-added by flush_outbound() if still can't write everything */
+    greeter->priv->to_greeter_watch = 0;
+    flush_outbound (greeter);
+
+    return FALSE;
 }
 
 static void
-write_header (guint8 *buffer, gint buffer_length, guint32 id, guint32 length, gsize *offset)
+write_int (GByteArray *message, guint32 value)
 {
-    write_int (buffer, buffer_length, id, offset);
-    write_int (buffer, buffer_length, length, offset);
+    guint8 buffer[4];
+    buffer[0] = value >> 24;
+    buffer[1] = (value >> 16) & 0xFF;
+    buffer[2] = (value >> 8) & 0xFF;
+    buffer[3] = value & 0xFF;
+    g_byte_array_append (message, buffer, 4);
 }
 
-static guint32
-string_length (const gchar *value)
+static void
+write_string (GByteArray *message, const gchar *value)
 {
-    if (value == NULL)
-        return int_length ();
-    else
-        return int_length () + strlen (value);
+    gsize length = value ? strlen (value) : 0;
+    write_int (message, length);
+    if (length > 0)
+        g_byte_array_append (message, (const guint8 *) value, length);
+}
+
+/* Start a message, the length is filled in by write_message() */
+static GByteArray *
+start_message (guint32 id)
+{
+    GByteArray *message = g_byte_array_new ();
+    write_int (message, id);
+    write_int (message, 0);
+    return message;
+}
+
+static void
+write_message (Greeter *greeter, GByteArray *message)
+{
+    guint32 length = message->len - HEADER_SIZE;
+    message->data[4] = length >> 24;
+    message->data[5] = (length >> 16) & 0xFF;
+    message->data[6] = (length >> 8) & 0xFF;
+    message->data[7] = length & 0xFF;
+
+    if (greeter->priv->to_greeter_input < 0)
+    {
+        g_byte_array_unref (message);
+        return;
+    }
+
+    greeter->priv->outbound_length += message->len;
+    g_queue_push_tail (&greeter->priv->outbound, g_byte_array_free_to_bytes (message));
+
+    /* Write immediately unless already waiting for the greeter */
+    if (greeter->priv->to_greeter_watch == 0)
+        flush_outbound (greeter);
+
+    if (greeter->priv->outbound_length > MAX_OUTBOUND_LENGTH)
+        pause_reading (greeter);
 }
 
 static void
@@ -310,40 +429,34 @@ handle_connect (Greeter *greeter, const gchar *version, gboolean resettable, gui
     greeter->priv->api_version = api_version;
     greeter->priv->resettable = resettable;
 
-    guint32 env_length = 0;
     GHashTableIter iter;
-    g_hash_table_iter_init (&iter, greeter->priv->hints);
     gpointer key, value;
-    while (g_hash_table_iter_next (&iter, &key, &value))
-        env_length += string_length (key) + string_length (value);
-
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
+    GByteArray *message;
     if (api_version == 0)
     {
-        write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_CONNECTED, string_length (VERSION) + env_length, &offset);
-        write_string (message, MAX_MESSAGE_LENGTH, VERSION, &offset);
+        message = start_message (SERVER_MESSAGE_CONNECTED);
+        write_string (message, VERSION);
         g_hash_table_iter_init (&iter, greeter->priv->hints);
         while (g_hash_table_iter_next (&iter, &key, &value))
         {
-            write_string (message, MAX_MESSAGE_LENGTH, key, &offset);
-            write_string (message, MAX_MESSAGE_LENGTH, value, &offset);
+            write_string (message, key);
+            write_string (message, value);
         }
     }
     else
     {
-        write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_CONNECTED_V2, string_length (VERSION) + int_length () * 2 + env_length, &offset);
-        write_int (message, MAX_MESSAGE_LENGTH, api_version <= API_VERSION ? api_version : API_VERSION, &offset);
-        write_string (message, MAX_MESSAGE_LENGTH, VERSION, &offset);
-        write_int (message, MAX_MESSAGE_LENGTH, g_hash_table_size (greeter->priv->hints), &offset);
+        message = start_message (SERVER_MESSAGE_CONNECTED_V2);
+        write_int (message, api_version <= API_VERSION ? api_version : API_VERSION);
+        write_string (message, VERSION);
+        write_int (message, g_hash_table_size (greeter->priv->hints));
         g_hash_table_iter_init (&iter, greeter->priv->hints);
         while (g_hash_table_iter_next (&iter, &key, &value))
         {
-            write_string (message, MAX_MESSAGE_LENGTH, key, &offset);
-            write_string (message, MAX_MESSAGE_LENGTH, value, &offset);
+            write_string (message, key);
+            write_string (message, value);
         }
     }
-    write_message (greeter, message, offset);
+    write_message (greeter, message);
 
     g_signal_emit (greeter, signals[CONNECTED], 0);
 }
@@ -356,26 +469,20 @@ pam_messages_cb (Session *session, Greeter *greeter)
 
     /* Respond to d-bus query with messages */
     g_debug ("Prompt greeter with %d message(s)", messages_length);
-    guint32 size = int_length () + string_length (session_get_username (session)) + int_length ();
-    for (int i = 0; i < messages_length; i++)
-        size += int_length () + string_length (messages[i].msg);
-
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_PROMPT_AUTHENTICATION, size, &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, greeter->priv->authentication_sequence_number, &offset);
-    write_string (message, MAX_MESSAGE_LENGTH, session_get_username (session), &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, messages_length, &offset);
+    GByteArray *message = start_message (SERVER_MESSAGE_PROMPT_AUTHENTICATION);
+    write_int (message, greeter->priv->authentication_sequence_number);
+    write_string (message, session_get_username (session));
+    write_int (message, messages_length);
     int n_prompts = 0;
     for (int i = 0; i < messages_length; i++)
     {
-        write_int (message, MAX_MESSAGE_LENGTH, messages[i].msg_style, &offset);
-        write_string (message, MAX_MESSAGE_LENGTH, messages[i].msg, &offset);
+        write_int (message, messages[i].msg_style);
+        write_string (message, messages[i].msg);
 
         if (messages[i].msg_style == PAM_PROMPT_ECHO_OFF || messages[i].msg_style == PAM_PROMPT_ECHO_ON)
             n_prompts++;
     }
-    write_message (greeter, message, offset);
+    write_message (greeter, message);
 
     /* Continue immediately if nothing to respond with */
     // FIXME: Should probably give the greeter a chance to ack the message
@@ -391,22 +498,17 @@ pam_messages_cb (Session *session, Greeter *greeter)
 static void
 send_end_authentication (Greeter *greeter, guint32 sequence_number, const gchar *username, int result)
 {
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_END_AUTHENTICATION, int_length () + string_length (username) + int_length (), &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, sequence_number, &offset);
-    write_string (message, MAX_MESSAGE_LENGTH, username, &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, result, &offset);
-    write_message (greeter, message, offset);
+    GByteArray *message = start_message (SERVER_MESSAGE_END_AUTHENTICATION);
+    write_int (message, sequence_number);
+    write_string (message, username);
+    write_int (message, result);
+    write_message (greeter, message);
 }
 
 void
 greeter_idle (Greeter *greeter)
 {
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_IDLE, 0, &offset);
-    write_message (greeter, message, offset);
+    write_message (greeter, start_message (SERVER_MESSAGE_IDLE));
 }
 
 void
@@ -414,23 +516,16 @@ greeter_reset (Greeter *greeter)
 {
     g_return_if_fail (greeter != NULL);
 
+    GByteArray *message = start_message (SERVER_MESSAGE_RESET);
     GHashTableIter iter;
     g_hash_table_iter_init (&iter, greeter->priv->hints);
     gpointer key, value;
-    guint32 length = 0;
-    while (g_hash_table_iter_next (&iter, &key, &value))
-        length += string_length (key) + string_length (value);
-
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_RESET, length, &offset);
-    g_hash_table_iter_init (&iter, greeter->priv->hints);
     while (g_hash_table_iter_next (&iter, &key, &value))
     {
-        write_string (message, MAX_MESSAGE_LENGTH, key, &offset);
-        write_string (message, MAX_MESSAGE_LENGTH, value, &offset);
+        write_string (message, key);
+        write_string (message, value);
     }
-    write_message (greeter, message, offset);
+    write_message (greeter, message);
 }
 
 static void
@@ -695,11 +790,9 @@ handle_start_session (Greeter *greeter, const gchar *session)
         result = FALSE;
     }
 
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_SESSION_RESULT, int_length (), &offset);
-    write_int (message, MAX_MESSAGE_LENGTH, result ? 0 : 1, &offset);
-    write_message (greeter, message, offset);
+    GByteArray *message = start_message (SERVER_MESSAGE_SESSION_RESULT);
+    write_int (message, result ? 0 : 1);
+    write_message (greeter, message);
 }
 
 static void
@@ -730,57 +823,53 @@ handle_ensure_shared_dir (Greeter *greeter, const gchar *username)
 
     g_autofree gchar *dir = shared_data_manager_ensure_user_dir (shared_data_manager_get_instance (), username);
 
-    guint8 message[MAX_MESSAGE_LENGTH];
-    gsize offset = 0;
-    write_header (message, MAX_MESSAGE_LENGTH, SERVER_MESSAGE_SHARED_DIR_RESULT, string_length (dir), &offset);
-    write_string (message, MAX_MESSAGE_LENGTH, dir, &offset);
-    write_message (greeter, message, offset);
+    GByteArray *message = start_message (SERVER_MESSAGE_SHARED_DIR_RESULT);
+    write_string (message, dir);
+    write_message (greeter, message);
 }
 
 static guint32
-read_int (Greeter *greeter, gsize *offset)
+read_int (const guint8 *message, gsize message_length, gsize *offset)
 {
-    if (greeter->priv->n_read - *offset < sizeof (guint32))
+    if (message_length - *offset < sizeof (guint32))
     {
-        g_warning ("Not enough space for int, need %zu, got %zu", sizeof (guint32), greeter->priv->n_read - *offset);
+        g_warning ("Not enough space for int, need %zu, got %zu", sizeof (guint32), message_length - *offset);
         return 0;
     }
-    guint8 *buffer = greeter->priv->read_buffer + *offset;
+    const guint8 *buffer = message + *offset;
     guint32 value = buffer[0] << 24 | buffer[1] << 16 | buffer[2] << 8 | buffer[3];
     *offset += int_length ();
     return value;
 }
 
-static int
-get_message_length (Greeter *greeter)
+/* Get the total length of the message starting with the given header, or 0 if invalid */
+static gsize
+get_message_length (const guint8 *header)
 {
-    gsize offset;
-    int payload_length;
-
-    offset = int_length ();
-    payload_length = read_int (greeter, &offset);
+    gsize offset = int_length ();
+    guint32 payload_length = read_int (header, HEADER_SIZE, &offset);
 
-    if (HEADER_SIZE + payload_length < HEADER_SIZE)
+    if (payload_length > G_MAXSIZE - HEADER_SIZE)
     {
         g_warning ("Payload length of %u octets too long", payload_length);
-        return HEADER_SIZE;
+        return 0;
     }
 
     return HEADER_SIZE + payload_length;
 }
 
 static gchar *
-read_string_full (Greeter *greeter, gsize *offset, void* (*alloc_fn)(size_t n))
+read_string_full (const guint8 *message, gsize message_length, gsize *offset, void* (*alloc_fn)(size_t n))
 {
-    guint32 length = read_int (greeter, offset);
-    if (greeter->priv->n_read - *offset < length)
+    guint32 length = read_int (message, message_length, offset);
+    if (message_length - *offset < length)
     {
-        g_warning ("Not enough space for string, need %u, got %zu", length, greeter->priv->n_read - *offset);
+        g_warning ("Not enough space for string, need %u, got %zu", length, message_length - *offset);
         return g_strdup ("");
     }
 
     gchar *value = (*alloc_fn) (sizeof (gchar) * (length + 1));
-    memcpy (value, greeter->priv->read_buffer + *offset, length);
+    memcpy (value, message + *offset, length);
     value[length] = '\0';
     *offset += length;
 
@@ -788,131 +877,75 @@ read_string_full (Greeter *greeter, gsize *offset, void* (*alloc_fn)(size_t n))
 }
 
 static gchar *
-read_string (Greeter *greeter, gsize *offset)
+read_string (const guint8 *message, gsize message_length, gsize *offset)
 {
-    return read_string_full (greeter, offset, g_malloc);
+    return read_string_full (message, message_length, offset, g_malloc);
 }
 
 static gchar *
-read_secret (Greeter *greeter, gsize *offset)
+read_secret (Greeter *greeter, const guint8 *message, gsize message_length, gsize *offset)
 {
     if (greeter->priv->use_secure_memory)
-        return read_string_full (greeter, offset, gcry_malloc_secure);
+        return read_string_full (message, message_length, offset, gcry_malloc_secure);
     else
-        return read_string_full (greeter, offset, g_malloc);
+        return read_string_full (message, message_length, offset, g_malloc);
 }
 
+/* Handle one complete message, returns FALSE if the greeter sent something invalid */
 static gboolean
-read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+handle_message (Greeter *greeter, const guint8 *message, gsize message_length)
 {
-    Greeter *greeter = data;
-
-    if (condition == G_IO_HUP)
-    {
-        g_debug ("Greeter closed communication channel");
-        greeter->priv->from_greeter_watch = 0;
-        g_signal_emit (greeter, signals[DISCONNECTED], 0);
-        return FALSE;
-    }
-
-    gsize n_to_read = HEADER_SIZE;
-    if (greeter->priv->n_read >= HEADER_SIZE)
-    {
-        n_to_read = get_message_length (greeter);
-        if (n_to_read <= HEADER_SIZE)
-        {
-            greeter->priv->from_greeter_watch = 0;
-            return FALSE;
-        }
-    }
-
-    gsize n_read;
-    g_autoptr(GError) error = NULL;
-    GIOStatus status = g_io_channel_read_chars (greeter->priv->from_greeter_channel,
-                                                (gchar *) greeter->priv->read_buffer + greeter->priv->n_read,
-                                                n_to_read - greeter->priv->n_read,
-                                                &n_read,
-                                                &error);
-    if (error)
-        g_warning ("Error reading from greeter: %s", error->message);
-    if (status == G_IO_STATUS_EOF)
-    {
-        g_debug ("Greeter closed communication channel");
-        greeter->priv->from_greeter_watch = 0;
-        g_signal_emit (greeter, signals[DISCONNECTED], 0);
-        return FALSE;
-    }
-    else if (status != G_IO_STATUS_NORMAL)
-        return TRUE;
-
-    greeter->priv->n_read += n_read;
-    if (greeter->priv->n_read != n_to_read)
-        return TRUE;
-
-    /* If have header, rerun for content */
-    if (greeter->priv->n_read == HEADER_SIZE)
-    {
-        n_to_read = get_message_length (greeter);
-        if (n_to_read > HEADER_SIZE)
-        {
-            greeter->priv->read_buffer = secure_realloc (greeter, greeter->priv->read_buffer, n_to_read);
-            read_cb (source, condition, greeter);
-            return TRUE;
-        }
-    }
-
     gsize offset = 0;
-    int id = read_int (greeter, &offset);
-    int length = HEADER_SIZE + read_int (greeter, &offset);
+    int id = read_int (message, message_length, &offset);
+    gsize length = HEADER_SIZE + read_int (message, message_length, &offset);
     switch (id)
     {
     case GREETER_MESSAGE_CONNECT:
         {
-            g_autofree gchar *version = read_string (greeter, &offset);
+            g_autofree gchar *version = read_string (message, message_length, &offset);
             gboolean resettable = FALSE;
             if (offset < length)
-                resettable = read_int (greeter, &offset) != 0;
+                resettable = read_int (message, message_length, &offset) != 0;
             guint32 api_version = 0;
             if (offset < length)
-                api_version = read_int (greeter, &offset);
+                api_version = read_int (message, message_length, &offset);
             handle_connect (greeter, version, resettable, api_version);
         }
         break;
     case GREETER_MESSAGE_AUTHENTICATE:
         {
-            guint32 sequence_number = read_int (greeter, &offset);
-            g_autofree gchar *username = read_string (greeter, &offset);
+            guint32 sequence_number = read_int (message, message_length, &offset);
+            g_autofree gchar *username = read_string (message, message_length, &offset);
             handle_authenticate (greeter, sequence_number, username);
         }
         break;
     case GREETER_MESSAGE_AUTHENTICATE_AS_GUEST:
         {
-            guint32 sequence_number = read_int (greeter, &offset);
+            guint32 sequence_number = read_int (message, message_length, &offset);
             handle_authenticate_as_guest (greeter, sequence_number);
         }
         break;
     case GREETER_MESSAGE_AUTHENTICATE_REMOTE:
         {
-            guint32 sequence_number = read_int (greeter, &offset);
-            g_autofree gchar *session_name = read_string (greeter, &offset);
-            g_autofree gchar *username = read_string (greeter, &offset);
+            guint32 sequence_number = read_int (message, message_length, &offset);
+            g_autofree gchar *session_name = read_string (message, message_length, &offset);
+            g_autofree gchar *username = read_string (message, message_length, &offset);
             handle_authenticate_remote (greeter, session_name, username, sequence_number);
         }
         break;
     case GREETER_MESSAGE_CONTINUE_AUTHENTICATION:
         {
-            guint32 n_secrets = read_int (greeter, &offset);
+            guint32 n_secrets = read_int (message, message_length, &offset);
             guint32 max_secrets = (G_MAXUINT32 - 1) / sizeof (gchar *);
             if (n_secrets > max_secrets)
             {
                 g_warning ("Array length of %u elements too long", n_secrets);
-                greeter->priv->from_greeter_watch = 0;
                 return FALSE;
             }
             gchar **secrets = g_malloc (sizeof (gchar *) * (n_secrets + 1));
             guint32 i;
             for (i = 0; i < n_secrets; i++)
-                secrets[i] = read_secret (greeter, &offset);
+                secrets[i] = read_secret (greeter, message, message_length, &offset);
             secrets[i] = NULL;
             handle_continue_authentication (greeter, secrets);
             secure_freev (greeter, secrets);
@@ -923,19 +956,19 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
         break;
     case GREETER_MESSAGE_START_SESSION:
         {
-            g_autofree gchar *session_name = read_string (greeter, &offset);
+            g_autofree gchar *session_name = read_string (message, message_length, &offset);
             handle_start_session (greeter, session_name);
         }
         break;
     case GREETER_MESSAGE_SET_LANGUAGE:
         {
-            g_autofree gchar *language = read_string (greeter, &offset);
+            g_autofree gchar *language = read_string (message, message_length, &offset);
             handle_set_language (greeter, language);
         }
         break;
     case GREETER_MESSAGE_ENSURE_SHARED_DIR:
         {
-            g_autofree gchar *username = read_string (greeter, &offset);
+            g_autofree gchar *username = read_string (message, message_length, &offset);
             handle_ensure_shared_dir (greeter, username);
         }
         break;
@@ -944,7 +977,103 @@ read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
         break;
     }
 
-    greeter->priv->n_read = 0;
+    return TRUE;
+}
+
+/* Handle all complete messages in the read buffer and keep any partial one for later */
+static gboolean
+handle_messages (Greeter *greeter)
+{
+    gsize offset = 0;
+    gboolean result = TRUE;
+    while (result && greeter->priv->n_read - offset >= HEADER_SIZE)
+    {
+        gsize message_length = get_message_length (greeter->priv->read_buffer + offset);
+        if (message_length == 0)
+            result = FALSE;
+        else if (greeter->priv->n_read - offset < message_length)
+            break;
+        else
+        {
+            result = handle_message (greeter, greeter->priv->read_buffer + offset, message_length);
+            offset += message_length;
+        }
+    }
+
+    /* Move the start of any incomplete message to the front of the buffer,
+     * clearing the handled messages as they may have contained secrets */
+    if (offset > 0)
+    {
+        memmove (greeter->priv->read_buffer, greeter->priv->read_buffer + offset, greeter->priv->n_read - offset);
+        greeter->priv->n_read -= offset;
+        memset (greeter->priv->read_buffer + greeter->priv->n_read, 0, offset);
+    }
+
+    /* Make room for a message larger than the buffer */
+    if (greeter->priv->n_read >= HEADER_SIZE)
+    {
+        gsize message_length = get_message_length (greeter->priv->read_buffer);
+        if (message_length > greeter->priv->read_buffer_size)
+        {
+            greeter->priv->read_buffer = secure_realloc (greeter, greeter->priv->read_buffer, message_length);
+            greeter->priv->read_buffer_size = message_length;
+        }
+    }
+
+    return result;
+}
+
+static gboolean
+read_cb (GIOChannel *source, GIOCondition condition, gpointer data)
+{
+    Greeter *greeter = data;
+
+    /* Messages may cause the greeter to be stopped */
+    g_autoptr(Greeter) g = g_object_ref (greeter);
+    guint watch = greeter->priv->from_greeter_watch;
+
+    /* Read everything available, handling messages as the buffer fills */
+    gboolean closed = FALSE, valid = TRUE;
+    for (int i = 0; i < MAX_READS_PER_WAKEUP && valid; i++)
+    {
+        ssize_t n_read = read (greeter->priv->from_greeter_output,
+                               greeter->priv->read_buffer + greeter->priv->n_read,
+                               greeter->priv->read_buffer_size - greeter->priv->n_read);
+        if (n_read < 0 && errno == EINTR)
+            continue;
+        if (n_read < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+            {
+                g_warning ("Error reading from greeter: %s", strerror (errno));
+                closed = TRUE;
+            }
+            break;
+        }
+        if (n_read == 0)
+        {
+            closed = TRUE;
+            break;
+        }
+
+        greeter->priv->n_read += n_read;
+        valid = handle_messages (greeter);
+
+        /* Stop if a message caused reading to be paused */
+        if (greeter->priv->from_greeter_watch != watch)
+            return FALSE;
+    }
+
+    if (closed || !valid)
+    {
+        greeter->priv->from_greeter_watch = 0;
+        if (closed)
+        {
+            g_debug ("Greeter closed communication channel");
+            g_signal_emit (greeter, signals[DISCONNECTED], 0);
+        }
+        return FALSE;
+    }
 
     return TRUE;
 }
@@ -1006,11 +1135,14 @@ static void
 greeter_init (Greeter *greeter)
 {
     greeter->priv = G_TYPE_INSTANCE_GET_PRIVATE (greeter, GREETER_TYPE, GreeterPrivate);
-    greeter->priv->read_buffer = secure_malloc (greeter, HEADER_SIZE);
-    greeter->priv->hints = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    /* Must be set before the first secure allocation so the read buffer is always freed / reallocated by the same allocator */
     greeter->priv->use_secure_memory = config_get_boolean (config_get_instance (), "LightDM", "lock-memory");
+    greeter->priv->read_buffer_size = READ_BUFFER_SIZE;
+    greeter->priv->read_buffer = secure_malloc (greeter, greeter->priv->read_buffer_size);
+    greeter->priv->hints = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
     greeter->priv->to_greeter_input = -1;
     greeter->priv->from_greeter_output = -1;
+    g_queue_init (&greeter->priv->outbound);
 }
 
 static void
@@ -1037,6 +1169,9 @@ greeter_finalize (GObject *object)
         g_io_channel_unref (self->priv->from_greeter_channel);
     if (self->priv->from_greeter_watch)
         g_source_remove (self->priv->from_greeter_watch);
+    if (self->priv->to_greeter_watch)
+        g_source_remove (self->priv->to_greeter_watch);
+    clear_outbound (self);
 
     G_OBJECT_CLASS (greeter_parent_class)->finalize (object);
 }
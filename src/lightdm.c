@@ -20,6 +20,7 @@
 #include <fcntl.h>
 #include <sys/stat.h>
 #include <errno.h>
+#include <pwd.h>
 
 #include "configuration.h"
 #include "display-manager.h"
@@ -29,25 +30,31 @@
 #include "seat-xdmcp-session.h"
 #include "seat-xvnc.h"
 #include "x-server.h"
+#include "x-server-local.h"
 #include "process.h"
 #include "session-child.h"
+#include "session-child-pool.h"
 #include "shared-data-manager.h"
 #include "user-list.h"
 #include "login1.h"
 #include "log-file.h"
+#include "log-writer.h"
 
 static gchar *config_path = NULL;
 static GMainLoop *loop = NULL;
-static GTimer *log_timer;
-static int log_fd = -1;
 static gboolean debug = FALSE;
 
 static DisplayManager *display_manager = NULL;
 static DisplayManagerService *display_manager_service = NULL;
 static XDMCPServer *xdmcp_server = NULL;
+static SessionChildPool *xdmcp_child_pool = NULL;
 static guint xdmcp_client_count = 0;
 static VNCServer *vnc_server = NULL;
+static SessionChildPool *vnc_child_pool = NULL;
 static guint vnc_client_count = 0;
+
+/* Hosts whose next VNC connection gets a new seat rather than a detached session's lock screen */
+static GHashTable *vnc_declined_hosts = NULL;
 static gint exit_code = EXIT_SUCCESS;
 
 static gboolean update_login1_seat (Login1Seat *login1_seat);
@@ -55,61 +62,26 @@ static gboolean update_login1_seat (Login1Seat *login1_seat);
 static void
 log_cb (const gchar *log_domain, GLogLevelFlags log_level, const gchar *message, gpointer data)
 {
-    const gchar *prefix;
-    switch (log_level & G_LOG_LEVEL_MASK)
-    {
-    case G_LOG_LEVEL_ERROR:
-        prefix = "ERROR:";
-        break;
-    case G_LOG_LEVEL_CRITICAL:
-        prefix = "CRITICAL:";
-        break;
-    case G_LOG_LEVEL_WARNING:
-        prefix = "WARNING:";
-        break;
-    case G_LOG_LEVEL_MESSAGE:
-        prefix = "MESSAGE:";
-        break;
-    case G_LOG_LEVEL_INFO:
-        prefix = "INFO:";
-        break;
-    case G_LOG_LEVEL_DEBUG:
-        prefix = "DEBUG:";
-        break;
-    default:
-        prefix = "LOG:";
-        break;
-    }
+    /* Log everything to a file, and to stderr if requested */
+    log_writer_write (log_level, message);
 
-    g_autofree gchar *text = g_strdup_printf ("[%+.2fs] %s %s\n", g_timer_elapsed (log_timer, NULL), prefix, message);
-
-    /* Log everything to a file */
-    if (log_fd >= 0)
-    {
-        ssize_t n_written = write (log_fd, text, strlen (text));
-        if (n_written < 0)
-            ; /* Check result so compiler doesn't warn about it */
-    }
-
-    /* Log to stderr if requested */
-    if (debug)
-        g_printerr ("%s", text);
-    else
+    if (!debug)
         g_log_default_handler (log_domain, log_level, message, data);
 }
 
 static void
 log_init (void)
 {
-    log_timer = g_timer_new ();
-
     /* Log to a file */
     g_autofree gchar *log_dir = config_get_string (config_get_instance (), "LightDM", "log-directory");
     g_autofree gchar *path = g_build_filename (log_dir, "lightdm.log", NULL);
 
     gboolean backup_logs = config_get_boolean (config_get_instance (), "LightDM", "backup-logs");
-    log_fd = log_file_open (path, backup_logs ? LOG_MODE_BACKUP_AND_TRUNCATE : LOG_MODE_APPEND);
+    int log_fd = log_file_open (path, backup_logs ? LOG_MODE_BACKUP_AND_TRUNCATE : LOG_MODE_APPEND);
     fcntl (log_fd, F_SETFD, FD_CLOEXEC);
+    log_writer_set_rate_limit (config_get_integer (config_get_instance (), "LightDM", "log-rate-limit-interval"),
+                               config_get_integer (config_get_instance (), "LightDM", "log-rate-limit-burst"));
+    log_writer_start (log_fd, debug, config_get_boolean (config_get_instance (), "LightDM", "log-journal"));
     g_log_set_default_handler (log_cb, NULL);
 
     g_debug ("Logging to %s", path);
@@ -178,6 +150,10 @@ static void
 display_manager_stopped_cb (DisplayManager *display_manager)
 {
     g_debug ("Stopping daemon");
+    if (xdmcp_child_pool)
+        session_child_pool_stop (xdmcp_child_pool);
+    if (vnc_child_pool)
+        session_child_pool_stop (vnc_child_pool);
     g_main_loop_quit (loop);
 }
 
@@ -262,29 +238,176 @@ display_manager_seat_removed_cb (DisplayManager *display_manager, Seat *seat)
     }
 }
 
+static void
+xdmcp_seat_stopped_cb (SeatXDMCPSession *seat)
+{
+    /* Stop counting the session in the load reported to clients */
+    xdmcp_server_remove_session (xdmcp_server, seat_xdmcp_session_get_session (seat));
+}
+
 static gboolean
 xdmcp_session_cb (XDMCPServer *server, XDMCPSession *session)
 {
     g_autoptr(SeatXDMCPSession) seat = seat_xdmcp_session_new (session);
+    g_signal_connect (seat, SEAT_SIGNAL_STOPPED, G_CALLBACK (xdmcp_seat_stopped_cb), NULL);
 
     g_autofree gchar *name = g_strdup_printf ("xdmcp%d", xdmcp_client_count);
     xdmcp_client_count++;
 
     seat_set_name (SEAT (seat), name);
     set_seat_properties (SEAT (seat), NULL);
+    if (xdmcp_child_pool)
+        seat_set_child_pool (SEAT (seat), xdmcp_child_pool);
     return display_manager_add_seat (display_manager, SEAT (seat));
 }
 
+static gint
+compare_detach_time (SeatXVNC *a, SeatXVNC *b)
+{
+    gint64 time_a = seat_xvnc_get_detach_time (a), time_b = seat_xvnc_get_detach_time (b);
+    return time_a < time_b ? -1 : time_a > time_b ? 1 : 0;
+}
+
+/* Get the seats whose VNC client has disconnected, oldest first */
+static GList *
+get_detached_vnc_seats (void)
+{
+    GList *seats = NULL;
+    for (GList *link = display_manager_get_seats (display_manager); link; link = link->next)
+    {
+        Seat *seat = link->data;
+        if (IS_SEAT_XVNC (seat) && seat_xvnc_get_is_detached (SEAT_XVNC (seat)) && !seat_get_is_stopping (seat))
+            seats = g_list_insert_sorted (seats, seat, (GCompareFunc) compare_detach_time);
+    }
+
+    return seats;
+}
+
+static void
+vnc_seat_detached_cb (SeatXVNC *seat)
+{
+    gint max_detached = config_get_integer (config_get_instance (), "VNCServer", "max-detached-sessions");
+    gint max_detached_per_user = config_get_integer (config_get_instance (), "VNCServer", "max-detached-sessions-per-user");
+    const gchar *username = seat_xvnc_get_username (seat);
+
+    /* Stop the oldest sessions when over the limits */
+    GList *seats = get_detached_vnc_seats ();
+    guint n_detached = g_list_length (seats);
+    guint n_user_detached = 0;
+    for (GList *link = seats; link; link = link->next)
+        if (g_strcmp0 (seat_xvnc_get_username (SEAT_XVNC (link->data)), username) == 0)
+            n_user_detached++;
+    for (GList *link = seats; link; link = link->next)
+    {
+        SeatXVNC *detached_seat = link->data;
+        gboolean same_user = g_strcmp0 (seat_xvnc_get_username (detached_seat), username) == 0;
+
+        if (max_detached > 0 && n_detached > (guint) max_detached)
+            g_debug ("Too many detached VNC sessions, stopping seat %s", seat_get_name (SEAT (detached_seat)));
+        else if (max_detached_per_user > 0 && same_user && n_user_detached > (guint) max_detached_per_user)
+            g_debug ("Too many detached VNC sessions for %s, stopping seat %s", username, seat_get_name (SEAT (detached_seat)));
+        else
+            continue;
+
+        seat_stop (SEAT (detached_seat));
+        n_detached--;
+        if (same_user)
+            n_user_detached--;
+    }
+    g_list_free (seats);
+}
+
+static void
+vnc_seat_resume_declined_cb (SeatXVNC *seat, const gchar *remote_host)
+{
+    if (!remote_host)
+        return;
+
+    if (!vnc_declined_hosts)
+        vnc_declined_hosts = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    g_hash_table_add (vnc_declined_hosts, g_strdup (remote_host));
+}
+
+static gboolean
+resume_vnc_seat (GSocket *connection)
+{
+    g_autoptr(GSocketAddress) address = g_socket_get_remote_address (connection, NULL);
+    if (!address)
+        return FALSE;
+    g_autofree gchar *hostname = g_inet_address_to_string (g_inet_socket_address_get_address (G_INET_SOCKET_ADDRESS (address)));
+
+    /* Another user logged in at the last lock screen shown to this host, so let them log in on a new seat */
+    if (vnc_declined_hosts && g_hash_table_remove (vnc_declined_hosts, hostname))
+    {
+        g_debug ("Not resuming detached VNC session for %s, another user logged in from there", hostname);
+        return FALSE;
+    }
+
+    /* The host only picks which session's lock screen to show, so only resume when it is clear which one the client wants */
+    SeatXVNC *match = NULL;
+    GList *seats = get_detached_vnc_seats ();
+    for (GList *link = seats; link; link = link->next)
+    {
+        SeatXVNC *seat = link->data;
+        if (g_strcmp0 (seat_xvnc_get_remote_host (seat), hostname) != 0)
+            continue;
+        if (match)
+        {
+            g_debug ("Multiple detached VNC sessions from %s, not resuming", hostname);
+            match = NULL;
+            break;
+        }
+        match = seat;
+    }
+    g_list_free (seats);
+
+    return match && seat_xvnc_resume (match, connection);
+}
+
+/* Get the number of VNC clients that have not logged in yet */
+static guint
+get_n_pending_vnc_seats (void)
+{
+    guint n_pending = 0;
+    for (GList *link = display_manager_get_seats (display_manager); link; link = link->next)
+    {
+        Seat *seat = link->data;
+        if (IS_SEAT_XVNC (seat) &&
+            !seat_get_is_stopping (seat) &&
+            !seat_xvnc_get_is_detached (SEAT_XVNC (seat)) &&
+            !seat_xvnc_get_username (SEAT_XVNC (seat)))
+            n_pending++;
+    }
+
+    return n_pending;
+}
+
 static void
 vnc_connection_cb (VNCServer *server, GSocket *connection)
 {
+    if (config_get_boolean (config_get_instance (), "VNCServer", "resume-sessions") && resume_vnc_seat (connection))
+        return;
+
+    /* Each new connection starts an X server and greeter, so limit how many can be waiting at the login screen */
+    gint max_pending = config_get_integer (config_get_instance (), "VNCServer", "max-pending-connections");
+    if (max_pending > 0 && get_n_pending_vnc_seats () >= (guint) max_pending)
+    {
+        g_debug ("Too many VNC connections waiting to log in, closing new connection");
+        g_socket_close (connection, NULL);
+        return;
+    }
+
     g_autoptr(SeatXVNC) seat = seat_xvnc_new (connection);
+    g_signal_connect (seat, SEAT_XVNC_SIGNAL_DETACHED, G_CALLBACK (vnc_seat_detached_cb), NULL);
+    g_signal_connect (seat, SEAT_XVNC_SIGNAL_RESUME_DECLINED, G_CALLBACK (vnc_seat_resume_declined_cb), NULL);
 
     g_autofree gchar *name = g_strdup_printf ("vnc%d", vnc_client_count);
     vnc_client_count++;
 
     seat_set_name (SEAT (seat), name);
     set_seat_properties (SEAT (seat), NULL);
+    if (vnc_child_pool)
+        seat_set_child_pool (SEAT (seat), vnc_child_pool);
     display_manager_add_seat (display_manager, SEAT (seat));
 }
 
@@ -308,8 +431,25 @@ start_display_manager (void)
         xdmcp_server_set_listen_address (xdmcp_server, listen_address);
         g_autofree gchar *hostname = config_get_string (config_get_instance (), "XDMCPServer", "hostname");
         xdmcp_server_set_hostname (xdmcp_server, hostname);
+        xdmcp_server_set_receive_batch_size (xdmcp_server, config_get_integer (config_get_instance (), "XDMCPServer", "receive-batch-size"));
+        xdmcp_server_set_log_packets (xdmcp_server, config_get_boolean (config_get_instance (), "XDMCPServer", "log-packets"));
+        xdmcp_server_set_request_rate (xdmcp_server,
+                                       MAX (config_get_integer (config_get_instance (), "XDMCPServer", "request-rate"), 0),
+                                       MAX (config_get_integer (config_get_instance (), "XDMCPServer", "subnet-request-rate"), 0),
+                                       MAX (config_get_integer (config_get_instance (), "XDMCPServer", "request-burst"), 1));
+        xdmcp_server_set_max_pending_sessions (xdmcp_server, MAX (config_get_integer (config_get_instance (), "XDMCPServer", "max-pending-sessions"), 0));
+        xdmcp_server_set_report_load (xdmcp_server, config_get_boolean (config_get_instance (), "XDMCPServer", "report-load"));
+        g_auto(GStrv) chooser_hosts = config_get_string_list (config_get_instance (), "XDMCPServer", "chooser-hosts");
+        for (int i = 0; chooser_hosts && chooser_hosts[i]; i++)
+            xdmcp_server_add_chooser_host (xdmcp_server, chooser_hosts[i]);
+        xdmcp_server_set_chooser_poll_interval (xdmcp_server, MAX (config_get_integer (config_get_instance (), "XDMCPServer", "chooser-poll-interval"), 1));
         g_signal_connect (xdmcp_server, XDMCP_SERVER_SIGNAL_NEW_SESSION, G_CALLBACK (xdmcp_session_cb), NULL);
 
+        /* Remote seats come and go, so share one pool between them rather than each seat starting its own */
+        gint child_pool_size = config_get_integer (config_get_instance (), "XDMCPServer", "session-child-pool-size");
+        if (child_pool_size > 0)
+            xdmcp_child_pool = session_child_pool_new (child_pool_size);
+
         g_autofree gchar *key_name = config_get_string (config_get_instance (), "XDMCPServer", "key");
         g_autofree gchar *key = NULL;
         if (key_name)
@@ -361,8 +501,14 @@ start_display_manager (void)
             }
             g_autofree gchar *listen_address = config_get_string (config_get_instance (), "VNCServer", "listen-address");
             vnc_server_set_listen_address (vnc_server, listen_address);
+            vnc_server_set_listen_backlog (vnc_server, config_get_integer (config_get_instance (), "VNCServer", "listen-backlog"));
+            vnc_server_set_reuse_port (vnc_server, config_get_boolean (config_get_instance (), "VNCServer", "reuse-port"));
             g_signal_connect (vnc_server, VNC_SERVER_SIGNAL_NEW_CONNECTION, G_CALLBACK (vnc_connection_cb), NULL);
 
+            gint child_pool_size = config_get_integer (config_get_instance (), "VNCServer", "session-child-pool-size");
+            if (child_pool_size > 0)
+                vnc_child_pool = session_child_pool_new (child_pool_size);
+
             g_debug ("Starting VNC server on TCP/IP port %d", vnc_server_get_port (vnc_server));
             vnc_server_start (vnc_server);
         }
@@ -756,6 +902,8 @@ main (int argc, char **argv)
         config_set_boolean (config_get_instance (), "LightDM", "lock-memory", TRUE);
     if (!config_has_key (config_get_instance (), "LightDM", "backup-logs"))
         config_set_boolean (config_get_instance (), "LightDM", "backup-logs", TRUE);
+    if (!config_has_key (config_get_instance (), "LightDM", "log-rate-limit-interval"))
+        config_set_integer (config_get_instance (), "LightDM", "log-rate-limit-interval", 5);
     if (!config_has_key (config_get_instance (), "LightDM", "dbus-service"))
         config_set_boolean (config_get_instance (), "LightDM", "dbus-service", TRUE);
     if (!config_has_key (config_get_instance (), "Seat:*", "type"))
@@ -814,6 +962,22 @@ main (int argc, char **argv)
     }
     if (!config_has_key (config_get_instance (), "XDMCPServer", "hostname"))
         config_set_string (config_get_instance (), "XDMCPServer", "hostname", g_get_host_name ());
+    if (!config_has_key (config_get_instance (), "XDMCPServer", "receive-batch-size"))
+        config_set_integer (config_get_instance (), "XDMCPServer", "receive-batch-size", 16);
+    if (!config_has_key (config_get_instance (), "XDMCPServer", "log-packets"))
+        config_set_boolean (config_get_instance (), "XDMCPServer", "log-packets", TRUE);
+    if (!config_has_key (config_get_instance (), "XDMCPServer", "request-burst"))
+        config_set_integer (config_get_instance (), "XDMCPServer", "request-burst", 10);
+    if (!config_has_key (config_get_instance (), "XDMCPServer", "chooser-poll-interval"))
+        config_set_integer (config_get_instance (), "XDMCPServer", "chooser-poll-interval", 10);
+    if (!config_has_key (config_get_instance (), "VNCServer", "detached-session-timeout"))
+        config_set_integer (config_get_instance (), "VNCServer", "detached-session-timeout", 3600);
+    if (!config_has_key (config_get_instance (), "VNCServer", "max-detached-sessions"))
+        config_set_integer (config_get_instance (), "VNCServer", "max-detached-sessions", 100);
+    if (!config_has_key (config_get_instance (), "VNCServer", "max-detached-sessions-per-user"))
+        config_set_integer (config_get_instance (), "VNCServer", "max-detached-sessions-per-user", 1);
+    if (!config_has_key (config_get_instance (), "VNCServer", "listen-backlog"))
+        config_set_integer (config_get_instance (), "VNCServer", "listen-backlog", 128);
 
     /* Override defaults */
     if (log_dir)
@@ -849,6 +1013,9 @@ main (int argc, char **argv)
     if (getenv ("DISPLAY"))
         g_debug ("Using Xephyr for X servers");
 
+    /* Find the X server version in the background while the seats start, so it is ready by the time it is needed */
+    x_server_local_probe_version ();
+
     display_manager = display_manager_new ();
     g_signal_connect (display_manager, DISPLAY_MANAGER_SIGNAL_STOPPED, G_CALLBACK (display_manager_stopped_cb), NULL);
     g_signal_connect (display_manager, DISPLAY_MANAGER_SIGNAL_SEAT_REMOVED, G_CALLBACK (display_manager_seat_removed_cb), NULL);
@@ -866,6 +1033,20 @@ main (int argc, char **argv)
 
     shared_data_manager_start (shared_data_manager_get_instance ());
 
+    /* Keep user information cached for greeters */
+    if (config_get_boolean (config_get_instance (), "LightDM", "user-cache"))
+    {
+        g_autofree gchar *user_cache_path = g_build_filename (cache_dir_path, "user-cache", NULL);
+
+        /* Only greeters read the cache */
+        g_autofree gchar *greeter_user = config_get_string (config_get_instance (), "LightDM", "greeter-user");
+        struct passwd *greeter_entry = getpwnam (greeter_user);
+        if (greeter_entry)
+            common_user_list_set_cache_path (common_user_list_get_instance (), user_cache_path, greeter_entry->pw_uid, greeter_entry->pw_gid);
+        else
+            g_warning ("Not keeping user cache, unable to find greeter user %s", greeter_user);
+    }
+
     /* Connect to logind */
     if (login1_service_connect (login1_service_get_instance ()))
     {
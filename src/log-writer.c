@@ -0,0 +1,521 @@
+/*
+ * Copyright (C) 2026 LightDM contributors.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "log-writer.h"
+
+/* Log messages are queued in a ring buffer and written out in batches by a
+ * separate thread, so the main loop doesn't wait on the disk. Warnings and
+ * errors are waited for so they are written before anything goes wrong. */
+
+/* Number of messages that can be queued, must be a power of two */
+#define RING_SIZE 4096
+
+/* How often to write out queued messages in milliseconds */
+#define FLUSH_INTERVAL 50
+
+/* Longest to wait for messages to be written in microseconds */
+#define FLUSH_TIMEOUT G_USEC_PER_SEC
+
+/* Socket journald accepts native protocol messages on */
+#define JOURNAL_SOCKET "/run/systemd/journal/socket"
+
+#define URGENT_LOG_LEVELS (G_LOG_LEVEL_ERROR | G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_WARNING)
+
+typedef struct
+{
+    /* Queue position this entry can be filled at, or one more than that once it has been */
+    guint sequence;
+
+    /* Monotonic time the message was logged */
+    gint64 time;
+
+    GLogLevelFlags log_level;
+    gchar *message;
+} LogEntry;
+
+static LogEntry ring[RING_SIZE];
+
+/* Positions the next message will be added at and taken from */
+static guint enqueue_position = 0;
+static guint dequeue_position = 0;
+
+/* Number of messages written out, protected by flush_mutex */
+static guint written_position = 0;
+static GMutex flush_mutex;
+static GCond flush_cond;
+
+/* Number of messages dropped because the queue was full */
+static guint n_dropped = 0;
+
+/* Process the writer thread is running in, messages from forked children are written directly */
+static GPid writer_pid = 0;
+
+/* Pipe to wake the writer thread */
+static int wake_pipe[2] = { -1, -1 };
+
+/* Time logging started */
+static gint64 start_time = 0;
+
+/* Where to write messages */
+static int log_fd = -1;
+static gboolean log_to_stderr = FALSE;
+static int journal_fd = -1;
+
+/* Number of non-urgent messages allowed from a source in each interval, or 0 for no limit */
+static gint64 rate_limit_interval = 0;
+static guint rate_limit_burst = 0;
+
+struct LogRateLimit
+{
+    /* Monotonic time the current rate limit interval started */
+    gint64 interval_start;
+
+    /* Number of messages logged in this interval */
+    guint count;
+
+    /* Number of messages dropped in this interval */
+    guint suppressed;
+
+    /* Most severe level of the dropped messages */
+    GLogLevelFlags suppressed_level;
+
+    /* Prefix of the source when messages started being dropped */
+    gchar *prefix;
+
+    /* Timeout to report dropped messages when the interval ends */
+    guint report_timeout;
+};
+
+static const gchar *
+get_level_prefix (GLogLevelFlags log_level)
+{
+    switch (log_level & G_LOG_LEVEL_MASK)
+    {
+    case G_LOG_LEVEL_ERROR:
+        return "ERROR:";
+    case G_LOG_LEVEL_CRITICAL:
+        return "CRITICAL:";
+    case G_LOG_LEVEL_WARNING:
+        return "WARNING:";
+    case G_LOG_LEVEL_MESSAGE:
+        return "MESSAGE:";
+    case G_LOG_LEVEL_INFO:
+        return "INFO:";
+    case G_LOG_LEVEL_DEBUG:
+        return "DEBUG:";
+    default:
+        return "LOG:";
+    }
+}
+
+/* Syslog priority, as used by GLib */
+static gint
+get_level_priority (GLogLevelFlags log_level)
+{
+    switch (log_level & G_LOG_LEVEL_MASK)
+    {
+    case G_LOG_LEVEL_ERROR:
+        return 3;
+    case G_LOG_LEVEL_CRITICAL:
+    case G_LOG_LEVEL_WARNING:
+        return 4;
+    case G_LOG_LEVEL_MESSAGE:
+        return 5;
+    case G_LOG_LEVEL_INFO:
+        return 6;
+    default:
+        return 7;
+    }
+}
+
+static void
+format_line (GString *text, gint64 time, GLogLevelFlags log_level, const gchar *message)
+{
+    g_string_append_printf (text, "[%+.2fs] %s %s\n", (time - start_time) / (gdouble) G_USEC_PER_SEC, get_level_prefix (log_level), message);
+}
+
+static void
+write_all (int fd, const gchar *data, gsize length)
+{
+    while (length > 0)
+    {
+        ssize_t n_written = write (fd, data, length);
+        if (n_written < 0 && errno == EINTR)
+            continue;
+        if (n_written <= 0)
+            return;
+        data += n_written;
+        length -= n_written;
+    }
+}
+
+static void
+write_text (GString *text)
+{
+    if (text->len == 0)
+        return;
+
+    if (log_fd >= 0)
+        write_all (log_fd, text->str, text->len);
+    if (log_to_stderr)
+        write_all (STDERR_FILENO, text->str, text->len);
+}
+
+static void
+write_journal (GLogLevelFlags log_level, const gchar *message)
+{
+    g_autoptr(GString) data = g_string_new (NULL);
+    g_string_append_printf (data, "PRIORITY=%d\n", get_level_priority (log_level));
+    g_string_append (data, "SYSLOG_IDENTIFIER=lightdm\n");
+
+    /* Values with newlines are sent with their length */
+    if (strchr (message, '\n'))
+    {
+        guint64 length = GUINT64_TO_LE (strlen (message));
+        g_string_append (data, "MESSAGE\n");
+        g_string_append_len (data, (const gchar *) &length, sizeof (length));
+        g_string_append (data, message);
+        g_string_append_c (data, '\n');
+    }
+    else
+        g_string_append_printf (data, "MESSAGE=%s\n", message);
+
+    /* Messages are still in the log file if the journal doesn't accept them */
+    if (send (journal_fd, data->str, data->len, MSG_NOSIGNAL) < 0)
+        ; /* Check result so compiler doesn't warn about it */
+}
+
+static int
+open_journal (void)
+{
+    int fd = socket (AF_UNIX, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+    fcntl (fd, F_SETFD, FD_CLOEXEC);
+
+    struct sockaddr_un address;
+    memset (&address, 0, sizeof (address));
+    address.sun_family = AF_UNIX;
+    strncpy (address.sun_path, JOURNAL_SOCKET, sizeof (address.sun_path) - 1);
+    if (connect (fd, (struct sockaddr *) &address, sizeof (address)) < 0)
+    {
+        close (fd);
+        return -1;
+    }
+
+    return fd;
+}
+
+static gboolean
+is_running (void)
+{
+    return writer_pid != 0 && getpid () == writer_pid;
+}
+
+static void
+wake_writer (void)
+{
+    if (write (wake_pipe[1], "", 1) < 0)
+        ; /* Pipe is full, so the writer will be woken anyway */
+}
+
+static gboolean
+enqueue (gint64 time, GLogLevelFlags log_level, const gchar *message)
+{
+    guint position = g_atomic_int_get (&enqueue_position);
+    LogEntry *entry;
+    while (TRUE)
+    {
+        entry = &ring[position & (RING_SIZE - 1)];
+        gint difference = (gint) (g_atomic_int_get (&entry->sequence) - position);
+
+        /* Full, still being read from the last time round */
+        if (difference < 0)
+            return FALSE;
+
+        if (difference == 0 && g_atomic_int_compare_and_exchange ((gint *) &enqueue_position, position, position + 1))
+            break;
+
+        /* Another thread got this entry, try the next one */
+        position = g_atomic_int_get (&enqueue_position);
+    }
+
+    entry->time = time;
+    entry->log_level = log_level;
+    entry->message = g_strdup (message);
+    g_atomic_int_set (&entry->sequence, position + 1);
+
+    /* Don't wait for the next flush if starting to fill up */
+    if (position - g_atomic_int_get (&dequeue_position) == RING_SIZE / 2)
+        wake_writer ();
+
+    return TRUE;
+}
+
+static LogEntry *
+peek (void)
+{
+    LogEntry *entry = &ring[dequeue_position & (RING_SIZE - 1)];
+    if (g_atomic_int_get (&entry->sequence) != dequeue_position + 1)
+        return NULL;
+    return entry;
+}
+
+static void
+dequeue (LogEntry *entry)
+{
+    entry->message = NULL;
+    g_atomic_int_set (&entry->sequence, dequeue_position + RING_SIZE);
+    g_atomic_int_inc (&dequeue_position);
+}
+
+static void
+write_queued (GString *text)
+{
+    g_string_truncate (text, 0);
+
+    guint n_written = 0;
+    LogEntry *entry;
+    while ((entry = peek ()))
+    {
+        format_line (text, entry->time, entry->log_level, entry->message);
+        if (journal_fd >= 0)
+            write_journal (entry->log_level, entry->message);
+        g_free (entry->message);
+        dequeue (entry);
+        n_written++;
+    }
+
+    guint dropped = g_atomic_int_and (&n_dropped, 0);
+    if (dropped > 0)
+    {
+        g_autofree gchar *message = g_strdup_printf ("Log queue full, dropped %u messages", dropped);
+        format_line (text, g_get_monotonic_time (), G_LOG_LEVEL_WARNING, message);
+        if (journal_fd >= 0)
+            write_journal (G_LOG_LEVEL_WARNING, message);
+    }
+
+    write_text (text);
+
+    if (n_written > 0)
+    {
+        g_mutex_lock (&flush_mutex);
+        written_position += n_written;
+        g_cond_broadcast (&flush_cond);
+        g_mutex_unlock (&flush_mutex);
+    }
+}
+
+static gpointer
+writer_thread_cb (gpointer data)
+{
+    g_autoptr(GString) text = g_string_new (NULL);
+
+    while (TRUE)
+    {
+        /* Batch up messages unless woken early */
+        struct pollfd wake_poll = { wake_pipe[0], POLLIN, 0 };
+        if (poll (&wake_poll, 1, FLUSH_INTERVAL) > 0)
+        {
+            gchar buffer[64];
+            while (read (wake_pipe[0], buffer, sizeof (buffer)) > 0);
+        }
+
+        write_queued (text);
+    }
+
+    return NULL;
+}
+
+void
+log_writer_start (int fd, gboolean to_stderr, gboolean to_journal)
+{
+    g_return_if_fail (writer_pid == 0);
+
+    start_time = g_get_monotonic_time ();
+    log_fd = fd;
+    log_to_stderr = to_stderr;
+
+    if (to_journal)
+    {
+        journal_fd = open_journal ();
+        if (journal_fd < 0)
+            g_warning ("Failed to connect to journal at %s: %s", JOURNAL_SOCKET, strerror (errno));
+    }
+
+    for (guint i = 0; i < RING_SIZE; i++)
+        ring[i].sequence = i;
+
+    if (pipe (wake_pipe) < 0)
+    {
+        g_warning ("Failed to create log writer pipe: %s", strerror (errno));
+        return;
+    }
+    for (int i = 0; i < 2; i++)
+    {
+        fcntl (wake_pipe[i], F_SETFD, FD_CLOEXEC);
+        fcntl (wake_pipe[i], F_SETFL, O_NONBLOCK);
+    }
+
+    writer_pid = getpid ();
+    g_thread_unref (g_thread_new ("log-writer", writer_thread_cb, NULL));
+
+    /* Make sure everything is written when the daemon exits */
+    atexit (log_writer_flush);
+}
+
+void
+log_writer_write (GLogLevelFlags log_level, const gchar *message)
+{
+    gint64 time = g_get_monotonic_time ();
+
+    /* Write directly if no writer thread, e.g. in a child process before it runs its command */
+    if (!is_running ())
+    {
+        g_autoptr(GString) text = g_string_new (NULL);
+        format_line (text, time, log_level, message);
+        write_text (text);
+        return;
+    }
+
+    gboolean urgent = (log_level & URGENT_LOG_LEVELS) != 0;
+    if (!enqueue (time, log_level, message))
+    {
+        /* Problems are never dropped, make room for them */
+        if (urgent)
+        {
+            log_writer_flush ();
+            if (enqueue (time, log_level, message))
+            {
+                log_writer_flush ();
+                return;
+            }
+        }
+
+        g_atomic_int_inc (&n_dropped);
+        wake_writer ();
+        return;
+    }
+
+    if (urgent)
+        log_writer_flush ();
+}
+
+void
+log_writer_flush (void)
+{
+    if (!is_running ())
+        return;
+
+    guint target = g_atomic_int_get (&enqueue_position);
+    wake_writer ();
+
+    gint64 end_time = g_get_monotonic_time () + FLUSH_TIMEOUT;
+    g_mutex_lock (&flush_mutex);
+    while ((gint) (written_position - target) < 0)
+    {
+        if (!g_cond_wait_until (&flush_cond, &flush_mutex, end_time))
+            break;
+    }
+    g_mutex_unlock (&flush_mutex);
+}
+
+void
+log_writer_set_rate_limit (gint interval, gint burst)
+{
+    rate_limit_interval = interval > 0 ? (gint64) interval * G_USEC_PER_SEC : 0;
+    rate_limit_burst = burst > 0 ? burst : 0;
+}
+
+LogRateLimit *
+log_rate_limit_new (void)
+{
+    return g_new0 (LogRateLimit, 1);
+}
+
+static void
+report_suppressed (LogRateLimit *limit)
+{
+    if (limit->report_timeout != 0)
+        g_source_remove (limit->report_timeout);
+    limit->report_timeout = 0;
+
+    if (limit->suppressed == 0)
+        return;
+
+    g_log (G_LOG_DOMAIN, limit->suppressed_level, "%sSuppressed %u messages", limit->prefix ? limit->prefix : "", limit->suppressed);
+    limit->suppressed = 0;
+}
+
+static gboolean
+report_timeout_cb (gpointer data)
+{
+    LogRateLimit *limit = data;
+
+    limit->report_timeout = 0;
+    report_suppressed (limit);
+
+    return G_SOURCE_REMOVE;
+}
+
+gboolean
+log_rate_limit_check (LogRateLimit *limit, GLogLevelFlags log_level, const gchar *prefix)
+{
+    /* Problems are always logged */
+    if (rate_limit_interval == 0 || rate_limit_burst == 0 || (log_level & URGENT_LOG_LEVELS) != 0)
+        return TRUE;
+
+    gint64 now = g_get_monotonic_time ();
+    if (now - limit->interval_start >= rate_limit_interval)
+    {
+        report_suppressed (limit);
+        limit->interval_start = now;
+        limit->count = 0;
+    }
+
+    if (limit->count < rate_limit_burst)
+    {
+        limit->count++;
+        return TRUE;
+    }
+
+    /* Report what was dropped when the interval ends, even if the source goes quiet */
+    GLogLevelFlags level = log_level & G_LOG_LEVEL_MASK;
+    if (limit->suppressed == 0)
+    {
+        g_free (limit->prefix);
+        limit->prefix = g_strdup (prefix);
+        limit->suppressed_level = level;
+        gint64 remaining = limit->interval_start + rate_limit_interval - now;
+        limit->report_timeout = g_timeout_add ((remaining + 999) / 1000, report_timeout_cb, limit);
+    }
+    else if (level < limit->suppressed_level) /* Lower values are more severe */
+        limit->suppressed_level = level;
+    limit->suppressed++;
+
+    return FALSE;
+}
+
+void
+log_rate_limit_free (LogRateLimit *limit)
+{
+    /* Report what was dropped before the source went away */
+    report_suppressed (limit);
+    g_free (limit->prefix);
+    g_free (limit);
+}
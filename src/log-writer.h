@@ -0,0 +1,36 @@
+/*
+ * Copyright (C) 2026 LightDM contributors.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef LOG_WRITER_H_
+#define LOG_WRITER_H_
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+typedef struct LogRateLimit LogRateLimit;
+
+void log_writer_start (int fd, gboolean to_stderr, gboolean to_journal);
+
+void log_writer_write (GLogLevelFlags log_level, const gchar *message);
+
+void log_writer_flush (void);
+
+void log_writer_set_rate_limit (gint interval, gint burst);
+
+LogRateLimit *log_rate_limit_new (void);
+
+gboolean log_rate_limit_check (LogRateLimit *limit, GLogLevelFlags log_level, const gchar *prefix);
+
+void log_rate_limit_free (LogRateLimit *limit);
+
+G_END_DECLS
+
+#endif /* LOG_WRITER_H_ */
@@ -1,4 +1,5 @@
 #include "logger.h"
+#include "log-writer.h"
 
 G_DEFINE_INTERFACE (Logger, logger, G_TYPE_INVALID)
 
@@ -25,40 +26,56 @@ logger_logv (Logger *self, GLogLevelFlags log_level, const gchar *format, va_lis
     LOGGER_GET_INTERFACE (self)->logv (self, log_level, format, ap);
 }
 
+/* messages shorter than this are formatted without allocating */
+#define LOG_BUFFER_LENGTH 1024
+
 void
 logger_logv_default (Logger *self, GLogLevelFlags log_level, const gchar *format, va_list ap)
 {
-    /* figure out how long the prefix is */
-    gint tmp = logger_logprefix (self, NULL, 0);
-    if (tmp < 0)
+    /* rate limit each logger separately so a noisy one doesn't hide the others */
+    static GQuark rate_limit_quark = 0;
+    if (rate_limit_quark == 0)
+        rate_limit_quark = g_quark_from_static_string ("logger-rate-limit");
+    LogRateLimit *limit = g_object_get_qdata (G_OBJECT (self), rate_limit_quark);
+    if (!limit)
     {
-        g_error ("failed to get log prefix");
-        return;
+        limit = log_rate_limit_new ();
+        g_object_set_qdata_full (G_OBJECT (self), rate_limit_quark, limit, (GDestroyNotify) log_rate_limit_free);
     }
 
-    /* print the prefix to a variable length array (to avoid malloc) */
-    gchar pfx[tmp + 1];
-    tmp = logger_logprefix (self, pfx, sizeof(pfx));
+    /* print the prefix, only allocating if it doesn't fit */
+    gchar pfx_buffer[LOG_BUFFER_LENGTH];
+    g_autofree gchar *pfx_allocated = NULL;
+    const gchar *pfx = pfx_buffer;
+    gint tmp = logger_logprefix (self, pfx_buffer, sizeof (pfx_buffer));
+    if (tmp >= (gint) sizeof (pfx_buffer))
+    {
+        pfx_allocated = g_malloc (tmp + 1);
+        tmp = logger_logprefix (self, pfx_allocated, tmp + 1);
+        pfx = pfx_allocated;
+    }
     if (tmp < 0)
     {
         g_error ("failed to get log prefix");
         return;
     }
 
-    /* figure out how long the formatted message is */
+    if (!log_rate_limit_check (limit, log_level, pfx))
+        return;
+
+    /* print the message, only allocating if it doesn't fit */
+    gchar msg_buffer[LOG_BUFFER_LENGTH];
+    g_autofree gchar *msg_allocated = NULL;
+    const gchar *msg = msg_buffer;
     va_list ap_copy;
     va_copy (ap_copy, ap);
-    tmp = g_vsnprintf (NULL, 0, format, ap_copy);
+    tmp = g_vsnprintf (msg_buffer, sizeof (msg_buffer), format, ap_copy);
     va_end (ap_copy);
-    if (tmp < 0)
+    if (tmp >= (gint) sizeof (msg_buffer))
     {
-        g_error ("failed to format log message");
-        return;
+        msg_allocated = g_strdup_vprintf (format, ap);
+        msg = msg_allocated;
     }
-
-    /* print the message to a variable length array (to avoid malloc) */
-    gchar msg[tmp+1];
-    tmp = g_vsnprintf (msg, sizeof(msg), format, ap);
     if (tmp < 0)
     {
         g_error ("failed to format log message");
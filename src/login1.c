@@ -37,6 +37,15 @@ struct Login1ServicePrivate
     /* Seats the service is reporting */
     GList *seats;
 
+    /* Seats that have been added but are still loading properties */
+    GList *pending_seats;
+
+    /* Most recent method call still in progress for each session, keyed by session ID */
+    GHashTable *session_calls;
+
+    /* Last session call made if still in progress, compared with calls to any session */
+    gpointer last_session_call;
+
     /* Handle to signal subscription */
     guint signal_id;
 };
@@ -67,8 +76,22 @@ struct Login1SeatPrivate
 
     /* TRUE if can do session switching */
     gboolean can_multi_session;
+
+    /* Properties being fetched after being invalidated */
+    GHashTable *pending_properties;
+
+    /* Cancellable for property requests */
+    GCancellable *cancellable;
 };
 
+typedef struct
+{
+    Login1Service *service;
+    gchar *session_id;
+    const gchar *method;
+    const gchar *description;
+} SessionCall;
+
 G_DEFINE_TYPE (Login1Service, login1_service, G_TYPE_OBJECT)
 G_DEFINE_TYPE (Login1Seat, login1_seat, G_TYPE_OBJECT)
 
@@ -89,9 +112,14 @@ update_property (Login1Seat *seat, const gchar *name, GVariant *value)
 {
     if (strcmp (name, "CanGraphical") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
     {
-        seat->priv->can_graphical = g_variant_get_boolean (value);
+        gboolean can_graphical = g_variant_get_boolean (value);
+        if (can_graphical == seat->priv->can_graphical)
+            return;
+        seat->priv->can_graphical = can_graphical;
         g_signal_emit (seat, seat_signals[CAN_GRAPHICAL_CHANGED], 0);
     }
+    else if (strcmp (name, "CanMultiSession") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+        seat->priv->can_multi_session = g_variant_get_boolean (value);
     else if (strcmp (name, "ActiveSession") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE ("(so)")))
     {
         const gchar *login1_session_id;
@@ -100,6 +128,57 @@ update_property (Login1Seat *seat, const gchar *name, GVariant *value)
     }
 }
 
+typedef struct
+{
+    Login1Seat *seat;
+    gchar *name;
+} PropertyRequest;
+
+static PropertyRequest *
+property_request_new (Login1Seat *seat, const gchar *name)
+{
+    PropertyRequest *request = g_malloc0 (sizeof (PropertyRequest));
+    request->seat = g_object_ref (seat);
+    request->name = g_strdup (name);
+    return request;
+}
+
+static void
+property_request_free (PropertyRequest *request)
+{
+    g_object_unref (request->seat);
+    g_free (request->name);
+    g_free (request);
+}
+
+static void
+get_property_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+    PropertyRequest *request = data;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+    {
+        property_request_free (request);
+        return;
+    }
+
+    Login1Seat *seat = request->seat;
+    g_hash_table_remove (seat->priv->pending_properties, request->name);
+
+    if (error)
+        g_warning ("Error updating seat property %s: %s", request->name, error->message);
+    if (result)
+    {
+        g_autoptr(GVariant) v = NULL;
+        g_variant_get (result, "(v)", &v);
+        update_property (seat, request->name, v);
+    }
+
+    property_request_free (request);
+}
+
 static void
 seat_properties_changed_cb (GDBusConnection *connection,
                             const gchar *sender_name,
@@ -123,32 +202,29 @@ seat_properties_changed_cb (GDBusConnection *connection,
 
     while (g_variant_iter_loop (invalidated_properties, "&s", &name))
     {
-        g_autoptr(GError) error = NULL;
-        g_autoptr(GVariant) result = g_dbus_connection_call_sync (connection,
-                                                                  LOGIN1_SERVICE_NAME,
-                                                                  seat->priv->path,
-                                                                  "org.freedesktop.DBus.Properties",
-                                                                  "Get",
-                                                                  g_variant_new ("(ss)", "org.freedesktop.login1.Seat", name),
-                                                                  G_VARIANT_TYPE ("(v)"),
-                                                                  G_DBUS_CALL_FLAGS_NONE,
-                                                                  -1,
-                                                                  NULL,
-                                                                  &error);
-        if (error)
-            g_warning ("Error updating seat property %s: %s", name, error->message);
-        if (result)
-        {
-            g_autoptr(GVariant) v = NULL;
-            g_variant_get (result, "(v)", &v);
-            update_property (seat, name, v);
-        }
+        /* Already being fetched */
+        if (g_hash_table_contains (seat->priv->pending_properties, name))
+            continue;
+        g_hash_table_add (seat->priv->pending_properties, g_strdup (name));
+
+        g_dbus_connection_call (connection,
+                                LOGIN1_SERVICE_NAME,
+                                seat->priv->path,
+                                "org.freedesktop.DBus.Properties",
+                                "Get",
+                                g_variant_new ("(ss)", "org.freedesktop.login1.Seat", name),
+                                G_VARIANT_TYPE ("(v)"),
+                                G_DBUS_CALL_FLAGS_NONE,
+                                -1,
+                                seat->priv->cancellable,
+                                get_property_cb,
+                                property_request_new (seat, name));
     }
     g_variant_iter_free (invalidated_properties);
 }
 
 static Login1Seat *
-add_seat (Login1Service *service, const gchar *id, const gchar *path)
+create_seat (Login1Service *service, const gchar *id, const gchar *path)
 {
     Login1Seat *seat = g_object_new (LOGIN1_SEAT_TYPE, NULL);
     seat->priv->connection = g_object_ref (service->priv->connection);
@@ -166,6 +242,32 @@ add_seat (Login1Service *service, const gchar *id, const gchar *path)
                                                                 g_object_ref (seat),
                                                                 g_object_unref);
 
+    return seat;
+}
+
+static void
+set_seat_properties (Login1Seat *seat, GVariant *result)
+{
+    GVariantIter *properties;
+    g_variant_get (result, "(a{sv})", &properties);
+
+    const gchar *name;
+    GVariant *value;
+    while (g_variant_iter_loop (properties, "{&sv}", &name, &value))
+    {
+        if (strcmp (name, "CanGraphical") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+            seat->priv->can_graphical = g_variant_get_boolean (value);
+        else if (strcmp (name, "CanMultiSession") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
+            seat->priv->can_multi_session = g_variant_get_boolean (value);
+    }
+    g_variant_iter_free (properties);
+}
+
+static Login1Seat *
+add_seat (Login1Service *service, const gchar *id, const gchar *path)
+{
+    Login1Seat *seat = create_seat (service, id, path);
+
     /* Get properties for this seat */
     g_autoptr(GError) error = NULL;
     g_autoptr(GVariant) result = g_dbus_connection_call_sync (seat->priv->connection,
@@ -182,25 +284,66 @@ add_seat (Login1Service *service, const gchar *id, const gchar *path)
     if (error)
         g_warning ("Failed to get seat properties: %s", error->message);
     if (result)
-    {
-        GVariantIter *properties;
-        g_variant_get (result, "(a{sv})", &properties);
+        set_seat_properties (seat, result);
 
-        const gchar *name;
-        GVariant *value;
-        while (g_variant_iter_loop (properties, "{&sv}", &name, &value))
-        {
-            if (strcmp (name, "CanGraphical") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
-                seat->priv->can_graphical = g_variant_get_boolean (value);
-            else if (strcmp (name, "CanMultiSession") == 0 && g_variant_is_of_type (value, G_VARIANT_TYPE_BOOLEAN))
-                seat->priv->can_multi_session = g_variant_get_boolean (value);
-        }
-        g_variant_iter_free (properties);
+    service->priv->seats = g_list_append (service->priv->seats, seat);
+
+    return seat;
+}
+
+static Login1Seat *
+find_pending_seat (Login1Service *service, const gchar *id)
+{
+    for (GList *link = service->priv->pending_seats; link; link = link->next)
+    {
+        Login1Seat *seat = link->data;
+        if (strcmp (seat->priv->id, id) == 0)
+            return seat;
     }
 
+    return NULL;
+}
+
+static void
+get_seat_properties_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+    g_autoptr(Login1Seat) seat = data;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    if (error)
+        g_warning ("Failed to get seat properties: %s", error->message);
+    if (result)
+        set_seat_properties (seat, result);
+
+    /* Seat is only reported once its properties are known */
+    Login1Service *service = login1_service_get_instance ();
+    service->priv->pending_seats = g_list_remove (service->priv->pending_seats, seat);
     service->priv->seats = g_list_append (service->priv->seats, seat);
+    g_signal_emit (service, service_signals[SEAT_ADDED], 0, seat);
+}
 
-    return seat;
+static void
+add_seat_async (Login1Service *service, const gchar *id, const gchar *path)
+{
+    Login1Seat *seat = create_seat (service, id, path);
+
+    service->priv->pending_seats = g_list_append (service->priv->pending_seats, seat);
+    g_dbus_connection_call (seat->priv->connection,
+                            LOGIN1_SERVICE_NAME,
+                            path,
+                            "org.freedesktop.DBus.Properties",
+                            "GetAll",
+                            g_variant_new ("(s)", "org.freedesktop.login1.Seat"),
+                            G_VARIANT_TYPE ("(a{sv})"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            seat->priv->cancellable,
+                            get_seat_properties_cb,
+                            g_object_ref (seat));
 }
 
 static void
@@ -219,21 +362,27 @@ signal_cb (GDBusConnection *connection,
         const gchar *id, *path;
         g_variant_get (parameters, "(&s&o)", &id, &path);
 
-        Login1Seat *seat = login1_service_get_seat (service, id);
-        if (!seat)
-        {
-            seat = add_seat (service, id, path);
-            g_signal_emit (service, service_signals[SEAT_ADDED], 0, seat);
-        }
+        if (!login1_service_get_seat (service, id) && !find_pending_seat (service, id))
+            add_seat_async (service, id, path);
     }
     else if (strcmp (signal_name, "SeatRemoved") == 0)
     {
         const gchar *id, *path;
         g_variant_get (parameters, "(&s&o)", &id, &path);
 
+        g_autoptr(Login1Seat) pending_seat = find_pending_seat (service, id);
+        if (pending_seat)
+        {
+            /* Never reported, so just stop loading it */
+            g_cancellable_cancel (pending_seat->priv->cancellable);
+            service->priv->pending_seats = g_list_remove (service->priv->pending_seats, pending_seat);
+            return;
+        }
+
         g_autoptr(Login1Seat) seat = login1_service_get_seat (service, id);
         if (seat)
         {
+            g_cancellable_cancel (seat->priv->cancellable);
             service->priv->seats = g_list_remove (service->priv->seats, seat);
             g_signal_emit (service, service_signals[SEAT_REMOVED], 0, seat);
         }
@@ -324,6 +473,67 @@ login1_service_get_seat (Login1Service *service, const gchar *id)
     return NULL;
 }
 
+static void
+session_call_free (SessionCall *call)
+{
+    g_object_unref (call->service);
+    g_free (call->session_id);
+    g_free (call);
+}
+
+static void
+session_call_cb (GObject *object, GAsyncResult *res, gpointer data)
+{
+    SessionCall *call = data;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GVariant) result = g_dbus_connection_call_finish (G_DBUS_CONNECTION (object), res, &error);
+    if (error)
+        g_warning ("Error %s login1 session: %s", call->description, error->message);
+
+    /* Only clear if a newer call hasn't replaced this one */
+    if (g_hash_table_lookup (call->service->priv->session_calls, call->session_id) == call)
+        g_hash_table_remove (call->service->priv->session_calls, call->session_id);
+    if (call->service->priv->last_session_call == call)
+        call->service->priv->last_session_call = NULL;
+
+    session_call_free (call);
+}
+
+static void
+call_session_method (Login1Service *service, const gchar *method, const gchar *description, const gchar *session_id)
+{
+    /* Same request is already on its way, so this one would have no effect.
+     * Only if nothing has been called since, e.g. activating another session in between has to be undone */
+    SessionCall *pending_call = g_hash_table_lookup (service->priv->session_calls, session_id);
+    if (pending_call && pending_call == service->priv->last_session_call && g_strcmp0 (pending_call->method, method) == 0)
+    {
+        g_debug ("Already %s login1 session %s", description, session_id);
+        return;
+    }
+
+    SessionCall *call = g_malloc0 (sizeof (SessionCall));
+    call->service = g_object_ref (service);
+    call->session_id = g_strdup (session_id);
+    call->method = method;
+    call->description = description;
+    g_hash_table_insert (service->priv->session_calls, g_strdup (session_id), call);
+    service->priv->last_session_call = call;
+
+    g_dbus_connection_call (service->priv->connection,
+                            LOGIN1_SERVICE_NAME,
+                            LOGIN1_OBJECT_NAME,
+                            LOGIN1_MANAGER_INTERFACE_NAME,
+                            method,
+                            g_variant_new ("(s)", session_id),
+                            G_VARIANT_TYPE ("()"),
+                            G_DBUS_CALL_FLAGS_NONE,
+                            -1,
+                            NULL,
+                            session_call_cb,
+                            call);
+}
+
 void
 login1_service_lock_session (Login1Service *service, const gchar *session_id)
 {
@@ -335,20 +545,7 @@ login1_service_lock_session (Login1Service *service, const gchar *session_id)
     if (!session_id)
         return;
 
-    g_autoptr(GError) error = NULL;
-    g_autoptr(GVariant) result = g_dbus_connection_call_sync (service->priv->connection,
-                                                              LOGIN1_SERVICE_NAME,
-                                                              LOGIN1_OBJECT_NAME,
-                                                              LOGIN1_MANAGER_INTERFACE_NAME,
-                                                              "LockSession",
-                                                              g_variant_new ("(s)", session_id),
-                                                              G_VARIANT_TYPE ("()"),
-                                                              G_DBUS_CALL_FLAGS_NONE,
-                                                              -1,
-                                                              NULL,
-                                                              &error);
-    if (error)
-        g_warning ("Error locking login1 session: %s", error->message);
+    call_session_method (service, "LockSession", "locking", session_id);
 }
 
 void
@@ -362,20 +559,7 @@ login1_service_unlock_session (Login1Service *service, const gchar *session_id)
     if (!session_id)
         return;
 
-    g_autoptr(GError) error = NULL;
-    g_autoptr(GVariant) result = g_dbus_connection_call_sync (service->priv->connection,
-                                                              LOGIN1_SERVICE_NAME,
-                                                              LOGIN1_OBJECT_NAME,
-                                                              LOGIN1_MANAGER_INTERFACE_NAME,
-                                                              "UnlockSession",
-                                                              g_variant_new ("(s)", session_id),
-                                                              G_VARIANT_TYPE ("()"),
-                                                              G_DBUS_CALL_FLAGS_NONE,
-                                                              -1,
-                                                              NULL,
-                                                              &error);
-    if (error)
-        g_warning ("Error unlocking login1 session: %s", error->message);
+    call_session_method (service, "UnlockSession", "unlocking", session_id);
 }
 
 void
@@ -389,20 +573,7 @@ login1_service_activate_session (Login1Service *service, const gchar *session_id
     if (!session_id)
         return;
 
-    g_autoptr(GError) error = NULL;
-    g_autoptr(GVariant) result = g_dbus_connection_call_sync (service->priv->connection,
-                                                              LOGIN1_SERVICE_NAME,
-                                                              LOGIN1_OBJECT_NAME,
-                                                              LOGIN1_MANAGER_INTERFACE_NAME,
-                                                              "ActivateSession",
-                                                              g_variant_new ("(s)", session_id),
-                                                              G_VARIANT_TYPE ("()"),
-                                                              G_DBUS_CALL_FLAGS_NONE,
-                                                              -1,
-                                                              NULL,
-                                                              &error);
-    if (error)
-        g_warning ("Error activating login1 session: %s", error->message);
+    call_session_method (service, "ActivateSession", "activating", session_id);
 }
 
 void
@@ -416,26 +587,14 @@ login1_service_terminate_session (Login1Service *service, const gchar *session_i
     if (!session_id)
         return;
 
-    g_autoptr(GError) error = NULL;
-    g_autoptr(GVariant) result = g_dbus_connection_call_sync (service->priv->connection,
-                                                              LOGIN1_SERVICE_NAME,
-                                                              LOGIN1_OBJECT_NAME,
-                                                              LOGIN1_MANAGER_INTERFACE_NAME,
-                                                              "TerminateSession",
-                                                              g_variant_new ("(s)", session_id),
-                                                              G_VARIANT_TYPE ("()"),
-                                                              G_DBUS_CALL_FLAGS_NONE,
-                                                              -1,
-                                                              NULL,
-                                                              &error);
-    if (error)
-        g_warning ("Error terminating login1 session: %s", error->message);
+    call_session_method (service, "TerminateSession", "terminating", session_id);
 }
 
 static void
 login1_service_init (Login1Service *service)
 {
     service->priv = G_TYPE_INSTANCE_GET_PRIVATE (service, LOGIN1_SERVICE_TYPE, Login1ServicePrivate);
+    service->priv->session_calls = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
 }
 
 static void
@@ -444,6 +603,13 @@ login1_service_finalize (GObject *object)
     Login1Service *self = LOGIN1_SERVICE (object);
 
     g_list_free_full (self->priv->seats, g_object_unref);
+    for (GList *link = self->priv->pending_seats; link; link = link->next)
+    {
+        Login1Seat *seat = link->data;
+        g_cancellable_cancel (seat->priv->cancellable);
+    }
+    g_list_free_full (self->priv->pending_seats, g_object_unref);
+    g_hash_table_unref (self->priv->session_calls);
     g_dbus_connection_signal_unsubscribe (self->priv->connection, self->priv->signal_id);
     g_clear_object (&self->priv->connection);
 
@@ -502,6 +668,8 @@ static void
 login1_seat_init (Login1Seat *seat)
 {
     seat->priv = G_TYPE_INSTANCE_GET_PRIVATE (seat, LOGIN1_SEAT_TYPE, Login1SeatPrivate);
+    seat->priv->pending_properties = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    seat->priv->cancellable = g_cancellable_new ();
 }
 
 static void
@@ -511,6 +679,9 @@ login1_seat_finalize (GObject *object)
 
     g_clear_pointer (&self->priv->id, g_free);
     g_clear_pointer (&self->priv->path, g_free);
+    g_hash_table_unref (self->priv->pending_properties);
+    g_cancellable_cancel (self->priv->cancellable);
+    g_clear_object (&self->priv->cancellable);
     g_dbus_connection_signal_unsubscribe (self->priv->connection, self->priv->signal_id);
     g_clear_object (&self->priv->connection);
 
@@ -11,6 +11,7 @@
 
 #include <stdlib.h>
 #include <sys/wait.h>
+#include <gio/gio.h>
 
 #include "plymouth.h"
 
@@ -79,9 +80,18 @@ plymouth_deactivate (void)
 {
     g_debug ("Deactivating Plymouth");
     is_active = FALSE;
+    /* Plymouth has to release the VT before the X server is started on it */
     plymouth_run_command ("deactivate", NULL);
 }
 
+static void
+quit_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    g_autoptr(GError) error = NULL;
+    if (!g_subprocess_wait_check_finish (G_SUBPROCESS (object), result, &error))
+        g_debug ("Failed to quit Plymouth: %s", error->message);
+}
+
 void
 plymouth_quit (gboolean retain_splash)
 {
@@ -92,8 +102,18 @@ plymouth_quit (gboolean retain_splash)
 
     have_pinged = TRUE;
     is_running = FALSE;
+
+    /* Nothing waits for Plymouth to exit, so don't block the main loop on it */
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GSubprocess) subprocess = NULL;
     if (retain_splash)
-        plymouth_run_command ("quit --retain-splash", NULL);
+        subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, &error, "plymouth", "quit", "--retain-splash", NULL);
     else
-        plymouth_run_command ("quit", NULL);
+        subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_NONE, &error, "plymouth", "quit", NULL);
+    if (!subprocess)
+    {
+        g_debug ("Could not run plymouth quit: %s", error->message);
+        return;
+    }
+    g_subprocess_wait_check_async (subprocess, NULL, quit_cb, NULL);
 }
@@ -12,8 +12,28 @@
 #include <string.h>
 
 #include "seat-xdmcp-session.h"
+#include "configuration.h"
 #include "x-server-remote.h"
 
+typedef enum
+{
+    /* Display has sent a KeepAlive or answered a check recently */
+    XDMCP_DISPLAY_RESPONDING,
+
+    /* Waiting for the X server to answer a check */
+    XDMCP_DISPLAY_CHECKING,
+
+    /* X server didn't answer and the seat is being stopped */
+    XDMCP_DISPLAY_NOT_RESPONDING
+} XDMCPDisplayState;
+
+static const gchar *display_state_names[] =
+{
+    "responding",
+    "checking",
+    "not responding"
+};
+
 struct SeatXDMCPSessionPrivate
 {
     /* Session being serviced */
@@ -21,6 +41,18 @@ struct SeatXDMCPSessionPrivate
 
     /* X server using XDMCP connection */
     XServerRemote *x_server;
+
+    /* Seconds without contact before checking the display is still there */
+    guint keep_alive_timeout;
+
+    /* Timer to check for contact from the display */
+    guint keep_alive_check;
+
+    /* Whether the display is known to still be there */
+    XDMCPDisplayState display_state;
+
+    /* Time the X server last responded to a check */
+    gint64 x_server_response_time;
 };
 
 G_DEFINE_TYPE (SeatXDMCPSession, seat_xdmcp_session, SEAT_TYPE)
@@ -30,10 +62,72 @@ seat_xdmcp_session_new (XDMCPSession *session)
 {
     SeatXDMCPSession *seat = g_object_new (SEAT_XDMCP_SESSION_TYPE, NULL);
     seat->priv->session = g_object_ref (session);
+    seat->priv->keep_alive_timeout = MAX (config_get_integer (config_get_instance (), "XDMCPServer", "keep-alive-timeout"), 0);
 
     return seat;
 }
 
+XDMCPSession *
+seat_xdmcp_session_get_session (SeatXDMCPSession *seat)
+{
+    g_return_val_if_fail (seat != NULL, NULL);
+    return seat->priv->session;
+}
+
+gint64
+seat_xdmcp_session_get_last_contact_time (SeatXDMCPSession *seat)
+{
+    g_return_val_if_fail (seat != NULL, 0);
+    return MAX (xdmcp_session_get_last_keep_alive_time (seat->priv->session), seat->priv->x_server_response_time);
+}
+
+static void
+set_display_state (SeatXDMCPSession *seat, XDMCPDisplayState state)
+{
+    if (seat->priv->display_state == state)
+        return;
+
+    l_debug (seat, "XDMCP display state changed from %s to %s", display_state_names[seat->priv->display_state], display_state_names[state]);
+    seat->priv->display_state = state;
+}
+
+static void
+x_server_check_cb (XServer *x_server, gboolean responding, gpointer data)
+{
+    g_autoptr(SeatXDMCPSession) seat = data;
+
+    if (responding)
+    {
+        seat->priv->x_server_response_time = g_get_monotonic_time ();
+        set_display_state (seat, XDMCP_DISPLAY_RESPONDING);
+        return;
+    }
+
+    set_display_state (seat, XDMCP_DISPLAY_NOT_RESPONDING);
+    l_debug (seat, "XDMCP display is not responding, stopping seat");
+    seat_stop (SEAT (seat));
+}
+
+static gboolean
+keep_alive_check_cb (gpointer data)
+{
+    SeatXDMCPSession *seat = data;
+
+    if (seat->priv->display_state != XDMCP_DISPLAY_RESPONDING || seat_get_is_stopping (SEAT (seat)))
+        return G_SOURCE_CONTINUE;
+
+    gint64 last_contact_time = seat_xdmcp_session_get_last_contact_time (seat);
+    if (g_get_monotonic_time () - last_contact_time < (gint64) seat->priv->keep_alive_timeout * G_USEC_PER_SEC)
+        return G_SOURCE_CONTINUE;
+
+    /* Displays only send KeepAlive when idle, so check a display in use is still there before giving up on it */
+    l_debug (seat, "No KeepAlive from XDMCP display in %u seconds, checking X server", seat->priv->keep_alive_timeout);
+    set_display_state (seat, XDMCP_DISPLAY_CHECKING);
+    x_server_check_responding (X_SERVER (seat->priv->x_server), seat->priv->keep_alive_timeout, x_server_check_cb, g_object_ref (seat));
+
+    return G_SOURCE_CONTINUE;
+}
+
 static DisplayServer *
 seat_xdmcp_session_create_display_server (Seat *seat, Session *session)
 {
@@ -49,6 +143,10 @@ seat_xdmcp_session_create_display_server (Seat *seat, Session *session)
 
     SEAT_XDMCP_SESSION (seat)->priv->x_server = x_server_remote_new (host, xdmcp_session_get_display_number (SEAT_XDMCP_SESSION (seat)->priv->session), authority);
 
+    /* Reclaim the seat if the display goes away without telling us */
+    if (SEAT_XDMCP_SESSION (seat)->priv->keep_alive_timeout > 0)
+        SEAT_XDMCP_SESSION (seat)->priv->keep_alive_check = g_timeout_add_seconds (MAX (SEAT_XDMCP_SESSION (seat)->priv->keep_alive_timeout / 2, 1), keep_alive_check_cb, seat);
+
     return g_object_ref (DISPLAY_SERVER (SEAT_XDMCP_SESSION (seat)->priv->x_server));
 }
 
@@ -63,6 +161,8 @@ seat_xdmcp_session_finalize (GObject *object)
 {
     SeatXDMCPSession *self = SEAT_XDMCP_SESSION (object);
 
+    if (self->priv->keep_alive_check)
+        g_source_remove (self->priv->keep_alive_check);
     g_clear_object (&self->priv->session);
     g_clear_object (&self->priv->x_server);
 
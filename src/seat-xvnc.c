@@ -10,11 +10,21 @@
  */
 
 #include <string.h>
+#include <errno.h>
+#include <glib/gstdio.h>
+#include <gio/gunixsocketaddress.h>
 
 #include "seat-xvnc.h"
 #include "x-server-xvnc.h"
 #include "configuration.h"
 
+enum {
+    DETACHED,
+    RESUME_DECLINED,
+    LAST_SIGNAL
+};
+static guint signals[LAST_SIGNAL] = { 0 };
+
 G_DEFINE_TYPE (SeatXVNC, seat_xvnc, SEAT_TYPE)
 
 struct SeatXVNCPrivate
@@ -22,18 +32,240 @@ struct SeatXVNCPrivate
     /* VNC connection */
     GSocket *connection;
 
+    /* Host the VNC connection came from */
+    gchar *remote_host;
+
     /* X server using VNC connection */
     XServerXVNC *x_server;
+
+    /* TRUE if the X server and session are kept when the VNC client disconnects */
+    gboolean resumable;
+
+    /* Relay between the VNC connection and the X server when resumable */
+    GCancellable *relay_cancellable;
+
+    /* Greeter a resuming client has to log in with to get back to the session */
+    GreeterSession *lock_screen;
+
+    /* Time the client disconnected, or 0 if connected */
+    gint64 detach_time;
+
+    /* Timeout to stop the seat when no client connects */
+    guint detach_timeout;
 };
 
+static gchar *
+get_remote_host (GSocket *connection)
+{
+    g_autoptr(GSocketAddress) address = g_socket_get_remote_address (connection, NULL);
+    if (!address)
+        return NULL;
+    return g_inet_address_to_string (g_inet_socket_address_get_address (G_INET_SOCKET_ADDRESS (address)));
+}
+
 SeatXVNC *seat_xvnc_new (GSocket *connection)
 {
     SeatXVNC *seat = g_object_new (SEAT_XVNC_TYPE, NULL);
     seat->priv->connection = g_object_ref (connection);
+    seat->priv->remote_host = get_remote_host (connection);
+    seat->priv->resumable = config_get_boolean (config_get_instance (), "VNCServer", "resume-sessions");
 
     return seat;
 }
 
+const gchar *
+seat_xvnc_get_remote_host (SeatXVNC *seat)
+{
+    g_return_val_if_fail (seat != NULL, NULL);
+    return seat->priv->remote_host;
+}
+
+gboolean
+seat_xvnc_get_is_detached (SeatXVNC *seat)
+{
+    g_return_val_if_fail (seat != NULL, FALSE);
+    return seat->priv->detach_time != 0;
+}
+
+gint64
+seat_xvnc_get_detach_time (SeatXVNC *seat)
+{
+    g_return_val_if_fail (seat != NULL, 0);
+    return seat->priv->detach_time;
+}
+
+static Session *
+find_user_session (SeatXVNC *seat)
+{
+    for (GList *link = seat_get_sessions (SEAT (seat)); link; link = link->next)
+    {
+        Session *session = link->data;
+        if (!IS_GREETER_SESSION (session) && !session_get_is_stopping (session))
+            return session;
+    }
+
+    return NULL;
+}
+
+const gchar *
+seat_xvnc_get_username (SeatXVNC *seat)
+{
+    g_return_val_if_fail (seat != NULL, NULL);
+
+    Session *session = find_user_session (seat);
+    return session ? session_get_username (session) : NULL;
+}
+
+static gboolean
+detach_timeout_cb (gpointer data)
+{
+    SeatXVNC *seat = data;
+
+    l_debug (seat, "No VNC client reconnected, stopping seat");
+    seat->priv->detach_timeout = 0;
+    seat_stop (SEAT (seat));
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+detach (SeatXVNC *seat)
+{
+    /* Nothing to come back to if not logged in */
+    Session *session = find_user_session (seat);
+    if (!session || seat_get_is_stopping (SEAT (seat)))
+    {
+        seat_stop (SEAT (seat));
+        return;
+    }
+
+    l_debug (seat, "VNC client disconnected, keeping session for %s", session_get_username (session));
+    g_clear_object (&seat->priv->connection);
+    seat->priv->detach_time = g_get_monotonic_time ();
+
+    /* The next client gets a new lock screen */
+    if (seat->priv->lock_screen && !session_get_is_stopping (SESSION (seat->priv->lock_screen)))
+        session_stop (SESSION (seat->priv->lock_screen));
+
+    gint timeout = config_get_integer (config_get_instance (), "VNCServer", "detached-session-timeout");
+    if (timeout > 0)
+        seat->priv->detach_timeout = g_timeout_add_seconds (timeout, detach_timeout_cb, seat);
+
+    g_signal_emit (seat, signals[DETACHED], 0);
+}
+
+static void
+relay_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    g_autoptr(SeatXVNC) seat = data;
+
+    g_autoptr(GError) error = NULL;
+    if (!g_io_stream_splice_finish (result, &error))
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            return;
+        l_debug (seat, "VNC connection closed: %s", error->message);
+    }
+
+    g_clear_object (&seat->priv->relay_cancellable);
+    detach (seat);
+}
+
+static void
+x_server_connect_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    g_autoptr(SeatXVNC) seat = data;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GSocketConnection) x_server_connection = g_socket_client_connect_finish (G_SOCKET_CLIENT (object), result, &error);
+    if (!x_server_connection)
+    {
+        if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+            return;
+        l_warning (seat, "Failed to connect to Xvnc socket: %s", error->message);
+        seat_stop (SEAT (seat));
+        return;
+    }
+
+    g_autoptr(GSocketConnection) client_connection = g_socket_connection_factory_create_connection (seat->priv->connection);
+    g_io_stream_splice_async (G_IO_STREAM (client_connection), G_IO_STREAM (x_server_connection),
+                              G_IO_STREAM_SPLICE_CLOSE_STREAM1 | G_IO_STREAM_SPLICE_CLOSE_STREAM2,
+                              G_PRIORITY_DEFAULT, seat->priv->relay_cancellable, relay_cb, g_object_ref (seat));
+}
+
+/* Pass the VNC connection through to the X server */
+static void
+start_relay (SeatXVNC *seat)
+{
+    seat->priv->relay_cancellable = g_cancellable_new ();
+
+    g_autoptr(GSocketClient) client = g_socket_client_new ();
+    g_autoptr(GSocketAddress) address = g_unix_socket_address_new (x_server_xvnc_get_socket_path (seat->priv->x_server));
+    g_socket_client_connect_async (client, G_SOCKET_CONNECTABLE (address), seat->priv->relay_cancellable, x_server_connect_cb, g_object_ref (seat));
+}
+
+static void
+lock_screen_connected_cb (Greeter *greeter, SeatXVNC *seat)
+{
+    g_signal_handlers_disconnect_by_func (greeter, lock_screen_connected_cb, seat);
+
+    /* The client only sees the display once the lock screen is covering the session */
+    l_debug (seat, "Lock screen ready, relaying VNC connection");
+    start_relay (seat);
+}
+
+gboolean
+seat_xvnc_resume (SeatXVNC *seat, GSocket *connection)
+{
+    g_return_val_if_fail (seat != NULL, FALSE);
+    g_return_val_if_fail (connection != NULL, FALSE);
+
+    if (!seat_xvnc_get_is_detached (seat) || seat_get_is_stopping (SEAT (seat)))
+        return FALSE;
+
+    Session *session = find_user_session (seat);
+    if (!session)
+        return FALSE;
+
+    /* The session is only returned to once the greeter has authenticated its user */
+    l_debug (seat, "New VNC connection for detached session, starting lock screen");
+    GreeterSession *lock_screen = seat_lock_session (SEAT (seat), session);
+    if (!lock_screen)
+        return FALSE;
+    seat->priv->lock_screen = g_object_ref (lock_screen);
+    g_signal_connect (greeter_session_get_greeter (lock_screen), GREETER_SIGNAL_CONNECTED, G_CALLBACK (lock_screen_connected_cb), seat);
+
+    if (seat->priv->detach_timeout)
+        g_source_remove (seat->priv->detach_timeout);
+    seat->priv->detach_timeout = 0;
+    seat->priv->detach_time = 0;
+
+    seat->priv->connection = g_object_ref (connection);
+    g_free (seat->priv->remote_host);
+    seat->priv->remote_host = get_remote_host (connection);
+
+    return TRUE;
+}
+
+static void
+x_server_ready_cb (DisplayServer *display_server, SeatXVNC *seat)
+{
+    g_signal_handlers_disconnect_by_func (display_server, x_server_ready_cb, seat);
+    start_relay (seat);
+}
+
+static gchar *
+get_socket_path (guint display_number)
+{
+    g_autofree gchar *run_dir = config_get_string (config_get_instance (), "LightDM", "run-directory");
+    g_autofree gchar *dir = g_build_filename (run_dir, "vnc", NULL);
+    if (g_mkdir_with_parents (dir, S_IRWXU) < 0)
+        g_warning ("Failed to make VNC socket directory %s: %s", dir, strerror (errno));
+
+    g_autofree gchar *name = g_strdup_printf ("%u", display_number);
+    return g_build_filename (dir, name, NULL);
+}
+
 static void
 seat_xvnc_setup (Seat *seat)
 {
@@ -56,7 +288,16 @@ seat_xvnc_create_display_server (Seat *seat, Session *session)
     g_autofree gchar *number = g_strdup_printf ("%d", x_server_get_display_number (X_SERVER (x_server)));
     g_autoptr(XAuthority) cookie = x_authority_new_local_cookie (number);
     x_server_set_authority (X_SERVER (x_server), cookie);
-    x_server_xvnc_set_socket (x_server, g_socket_get_fd (SEAT_XVNC (seat)->priv->connection));
+    if (SEAT_XVNC (seat)->priv->resumable)
+    {
+        /* Xvnc listens on a private socket and the connection is relayed once it is ready */
+        g_autofree gchar *socket_path = get_socket_path (x_server_get_display_number (X_SERVER (x_server)));
+        g_unlink (socket_path);
+        x_server_xvnc_set_socket_path (x_server, socket_path);
+        g_signal_connect (x_server, DISPLAY_SERVER_SIGNAL_READY, G_CALLBACK (x_server_ready_cb), seat);
+    }
+    else
+        x_server_xvnc_set_socket (x_server, g_socket_get_fd (SEAT_XVNC (seat)->priv->connection));
 
     const gchar *command = config_get_string (config_get_instance (), "VNCServer", "command");
     if (command)
@@ -87,29 +328,104 @@ seat_xvnc_run_script (Seat *seat, DisplayServer *display_server, Process *script
 {
     XServerXVNC *x_server = X_SERVER_XVNC (display_server);
 
-    GInetSocketAddress *address = G_INET_SOCKET_ADDRESS (g_socket_get_remote_address (SEAT_XVNC (seat)->priv->connection, NULL));
-    g_autofree gchar *hostname = g_inet_address_to_string (g_inet_socket_address_get_address (address));
     const gchar *path = x_server_local_get_authority_file_path (X_SERVER_LOCAL (x_server));
 
-    process_set_env (script, "REMOTE_HOST", hostname);
+    if (SEAT_XVNC (seat)->priv->remote_host)
+        process_set_env (script, "REMOTE_HOST", SEAT_XVNC (seat)->priv->remote_host);
     process_set_env (script, "DISPLAY", x_server_get_address (X_SERVER (x_server)));
     process_set_env (script, "XAUTHORITY", path);
 
     SEAT_CLASS (seat_xvnc_parent_class)->run_script (seat, display_server, script);
 }
 
+static gboolean
+decline_resume_cb (gpointer data)
+{
+    g_autoptr(SeatXVNC) seat = data;
+
+    if (!seat->priv->connection || seat_get_is_stopping (SEAT (seat)))
+        return G_SOURCE_REMOVE;
+
+    g_signal_emit (seat, signals[RESUME_DECLINED], 0, seat->priv->remote_host);
+    if (seat->priv->relay_cancellable)
+        g_cancellable_cancel (seat->priv->relay_cancellable);
+    g_clear_object (&seat->priv->relay_cancellable);
+    g_socket_close (seat->priv->connection, NULL);
+    detach (seat);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+seat_xvnc_display_server_in_use (Seat *seat, Session *greeter_session, const gchar *username)
+{
+    SeatXVNC *self = SEAT_XVNC (seat);
+
+    if (!self->priv->lock_screen || greeter_session != SESSION (self->priv->lock_screen) || !self->priv->connection)
+        return;
+
+    /* The client is part way through a VNC session with this X server so it can't be moved to another one.
+     * Disconnect it once the greeter has been told, and give the next connection from this host a new seat */
+    l_debug (self, "%s logged in at lock screen, disconnecting VNC client so it can start a new session", username);
+    g_idle_add (decline_resume_cb, g_object_ref (self));
+}
+
+static void
+seat_xvnc_session_removed (Seat *seat, Session *session)
+{
+    SeatXVNC *self = SEAT_XVNC (seat);
+
+    if (self->priv->lock_screen && session == SESSION (self->priv->lock_screen))
+    {
+        g_signal_handlers_disconnect_matched (greeter_session_get_greeter (self->priv->lock_screen), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
+        g_clear_object (&self->priv->lock_screen);
+
+        /* Drop a client that was still waiting for the lock screen */
+        if (self->priv->connection && !self->priv->relay_cancellable)
+        {
+            l_debug (self, "Lock screen stopped before VNC client connected");
+            g_socket_close (self->priv->connection, NULL);
+            detach (self);
+        }
+    }
+}
+
 static void
 seat_xvnc_init (SeatXVNC *seat)
 {
     seat->priv = G_TYPE_INSTANCE_GET_PRIVATE (seat, SEAT_XVNC_TYPE, SeatXVNCPrivate);
 }
 
+static void
+seat_xvnc_stop (Seat *seat)
+{
+    SeatXVNC *self = SEAT_XVNC (seat);
+
+    if (self->priv->relay_cancellable)
+        g_cancellable_cancel (self->priv->relay_cancellable);
+    g_clear_object (&self->priv->relay_cancellable);
+    if (self->priv->detach_timeout)
+        g_source_remove (self->priv->detach_timeout);
+    self->priv->detach_timeout = 0;
+
+    SEAT_CLASS (seat_xvnc_parent_class)->stop (seat);
+}
+
 static void
 seat_xvnc_session_finalize (GObject *object)
 {
     SeatXVNC *self = SEAT_XVNC (object);
 
+    if (self->priv->detach_timeout)
+        g_source_remove (self->priv->detach_timeout);
+    g_clear_object (&self->priv->relay_cancellable);
+    if (self->priv->lock_screen)
+        g_signal_handlers_disconnect_matched (greeter_session_get_greeter (self->priv->lock_screen), G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, self);
+    g_clear_object (&self->priv->lock_screen);
     g_clear_object (&self->priv->connection);
+    g_clear_pointer (&self->priv->remote_host, g_free);
+    if (self->priv->x_server && x_server_xvnc_get_socket_path (self->priv->x_server))
+        g_unlink (x_server_xvnc_get_socket_path (self->priv->x_server));
     g_clear_object (&self->priv->x_server);
 
     G_OBJECT_CLASS (seat_xvnc_parent_class)->finalize (object);
@@ -124,7 +440,27 @@ seat_xvnc_class_init (SeatXVNCClass *klass)
     seat_class->setup = seat_xvnc_setup;
     seat_class->create_display_server = seat_xvnc_create_display_server;
     seat_class->run_script = seat_xvnc_run_script;
+    seat_class->display_server_in_use = seat_xvnc_display_server_in_use;
+    seat_class->stop = seat_xvnc_stop;
+    seat_class->session_removed = seat_xvnc_session_removed;
     object_class->finalize = seat_xvnc_session_finalize;
 
     g_type_class_add_private (klass, sizeof (SeatXVNCPrivate));
+
+    signals[DETACHED] =
+        g_signal_new (SEAT_XVNC_SIGNAL_DETACHED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (SeatXVNCClass, detached),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 0);
+    signals[RESUME_DECLINED] =
+        g_signal_new (SEAT_XVNC_SIGNAL_RESUME_DECLINED,
+                      G_TYPE_FROM_CLASS (klass),
+                      G_SIGNAL_RUN_LAST,
+                      G_STRUCT_OFFSET (SeatXVNCClass, resume_declined),
+                      NULL, NULL,
+                      NULL,
+                      G_TYPE_NONE, 1, G_TYPE_STRING);
 }
@@ -17,8 +17,12 @@
 
 G_BEGIN_DECLS
 
+#define SEAT_XVNC_SIGNAL_DETACHED "detached"
+#define SEAT_XVNC_SIGNAL_RESUME_DECLINED "resume-declined"
+
 #define SEAT_XVNC_TYPE (seat_xvnc_get_type())
 #define SEAT_XVNC(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), SEAT_XVNC_TYPE, SeatXVNC))
+#define IS_SEAT_XVNC(obj) (G_TYPE_CHECK_INSTANCE_TYPE ((obj), SEAT_XVNC_TYPE))
 
 typedef struct SeatXVNCPrivate SeatXVNCPrivate;
 
@@ -31,6 +35,9 @@ typedef struct
 typedef struct
 {
     SeatClass parent_class;
+
+    void (*detached)(SeatXVNC *seat);
+    void (*resume_declined)(SeatXVNC *seat, const gchar *remote_host);
 } SeatXVNCClass;
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (SeatXVNC, g_object_unref)
@@ -39,6 +46,16 @@ GType seat_xvnc_get_type (void);
 
 SeatXVNC *seat_xvnc_new (GSocket *connection);
 
+const gchar *seat_xvnc_get_remote_host (SeatXVNC *seat);
+
+const gchar *seat_xvnc_get_username (SeatXVNC *seat);
+
+gboolean seat_xvnc_get_is_detached (SeatXVNC *seat);
+
+gint64 seat_xvnc_get_detach_time (SeatXVNC *seat);
+
+gboolean seat_xvnc_resume (SeatXVNC *seat, GSocket *connection);
+
 G_END_DECLS
 
 #endif /* SEAT_XVNC_H_ */
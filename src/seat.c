@@ -11,6 +11,7 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <signal.h>
 #include <sys/wait.h>
 
 #include "seat.h"
@@ -18,6 +19,7 @@
 #include "guest-account.h"
 #include "greeter-session.h"
 #include "session-config.h"
+#include "session-child-pool.h"
 
 enum {
     SESSION_ADDED,
@@ -68,6 +70,25 @@ struct SeatPrivate
 
     /* The greeter to be started to replace the current one */
     GreeterSession *replacement_greeter;
+
+    /* Scripts that are running */
+    GList *scripts;
+
+    /* Session children started in advance */
+    SessionChildPool *child_pool;
+
+    /* TRUE if the child pool is shared with other seats */
+    gboolean shared_child_pool;
+
+    /* Monotonic time the seat was started, used to report startup time */
+    gint64 start_time;
+
+    /* How long the steps of starting display servers and sessions took */
+    TimingStats *timing_stats;
+
+    /* TRUE once the startup times have been reported */
+    gboolean display_server_ready_reported;
+    gboolean session_run_reported;
 };
 
 static void seat_logger_iface_init (LoggerInterface *iface);
@@ -83,11 +104,38 @@ typedef struct
 } SeatModule;
 static GHashTable *seat_modules = NULL;
 
+/* Longest time in seconds to wait for a script while the seat is stopping, so a hung script can't stop it forever */
+#define STOP_SCRIPT_TIMEOUT 5
+
+/* Called when a script completes, object is what the script was run for */
+typedef void (*ScriptCallback)(Seat *seat, gboolean success, gpointer object);
+
+typedef struct
+{
+    Seat *seat;
+
+    /* Script being run */
+    Process *process;
+    gchar *command;
+
+    /* Function to call when complete */
+    ScriptCallback callback;
+    gpointer object;
+
+    /* Timeout to stop the script and the monotonic time it expires */
+    guint timeout;
+    gint64 timeout_end;
+
+    /* TRUE if the script was stopped due to the timeout */
+    gboolean timed_out;
+} ScriptRequest;
+
 // FIXME: Make a get_display_server() that re-uses display servers if supported
 static DisplayServer *create_display_server (Seat *seat, Session *session);
 static gboolean start_display_server (Seat *seat, DisplayServer *display_server);
 static GreeterSession *create_greeter_session (Seat *seat);
 static void start_session (Seat *seat, Session *session);
+static void check_stopped (Seat *seat);
 
 static void
 free_seat_module (gpointer data)
@@ -197,12 +245,27 @@ seat_set_share_display_server (Seat *seat, gboolean share_display_server)
     seat->priv->share_display_server = share_display_server;
 }
 
+void
+seat_set_child_pool (Seat *seat, SessionChildPool *child_pool)
+{
+    g_return_if_fail (seat != NULL);
+
+    g_clear_object (&seat->priv->child_pool);
+    seat->priv->child_pool = child_pool ? g_object_ref (child_pool) : NULL;
+    seat->priv->shared_child_pool = child_pool != NULL;
+}
+
 gboolean
 seat_start (Seat *seat)
 {
     g_return_val_if_fail (seat != NULL, FALSE);
 
     l_debug (seat, "Starting");
+    seat->priv->start_time = g_get_monotonic_time ();
+
+    gint child_pool_size = seat_get_integer_property (seat, "session-child-pool-size");
+    if (child_pool_size > 0 && !seat->priv->child_pool)
+        seat->priv->child_pool = session_child_pool_new (child_pool_size);
 
     SEAT_GET_CLASS (seat)->setup (seat);
     seat->priv->started = SEAT_GET_CLASS (seat)->start (seat);
@@ -210,6 +273,13 @@ seat_start (Seat *seat)
     return seat->priv->started;
 }
 
+TimingStats *
+seat_get_timing_stats (Seat *seat)
+{
+    g_return_val_if_fail (seat != NULL, NULL);
+    return seat->priv->timing_stats;
+}
+
 GList *
 seat_get_sessions (Seat *seat)
 {
@@ -344,10 +414,115 @@ seat_get_allow_guest (Seat *seat)
     return seat_get_boolean_property (seat, "allow-guest") && guest_account_is_installed ();
 }
 
+static void
+script_request_complete (ScriptRequest *request, gboolean success)
+{
+    Seat *seat = request->seat;
+
+    seat->priv->scripts = g_list_remove (seat->priv->scripts, request);
+    if (request->timeout)
+        g_source_remove (request->timeout);
+    request->timeout = 0;
+    g_signal_handlers_disconnect_matched (request->process, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, request);
+
+    request->callback (seat, success, request->object);
+
+    /* Seat may have been waiting for this script to stop */
+    check_stopped (seat);
+
+    g_object_unref (request->process);
+    g_free (request->command);
+    if (request->object)
+        g_object_unref (request->object);
+    g_object_unref (seat);
+    g_free (request);
+}
+
+static void
+script_stopped_cb (Process *process, ScriptRequest *request)
+{
+    gboolean result = FALSE;
+    int exit_status = process_get_exit_status (process);
+    if (request->timed_out)
+        l_debug (request->seat, "Script %s timed out", request->command);
+    else if (WIFEXITED (exit_status))
+    {
+        l_debug (request->seat, "Exit status of %s: %d", request->command, WEXITSTATUS (exit_status));
+        result = WEXITSTATUS (exit_status) == EXIT_SUCCESS;
+    }
+
+    script_request_complete (request, result);
+}
+
 static gboolean
-run_script (Seat *seat, DisplayServer *display_server, const gchar *script_name, User *user)
+script_timeout_cb (gpointer data)
 {
-    g_autoptr(Process) script = process_new (NULL, NULL);
+    ScriptRequest *request = data;
+
+    request->timeout = 0;
+    request->timed_out = TRUE;
+
+    /* Completes when the process is reaped */
+    const gchar *kill_policy = seat_get_string_property (request->seat, "script-kill-policy");
+    l_debug (request->seat, "Stopping script %s, did not complete in time", request->command);
+    if (g_strcmp0 (kill_policy, "kill") == 0)
+        process_signal (request->process, SIGKILL);
+    else
+        process_stop (request->process);
+
+    return FALSE;
+}
+
+static void
+set_script_timeout (ScriptRequest *request, gint timeout)
+{
+    if (request->timeout)
+        g_source_remove (request->timeout);
+    request->timeout = g_timeout_add_seconds (timeout, script_timeout_cb, request);
+    request->timeout_end = g_get_monotonic_time () + timeout * G_USEC_PER_SEC;
+}
+
+/* Make sure scripts complete in a bounded time once the seat is stopping */
+static void
+limit_script_timeouts (Seat *seat)
+{
+    gint64 stop_end = g_get_monotonic_time () + STOP_SCRIPT_TIMEOUT * G_USEC_PER_SEC;
+    for (GList *link = seat->priv->scripts; link; link = link->next)
+    {
+        ScriptRequest *request = link->data;
+        if (!request->timed_out && (request->timeout == 0 || request->timeout_end > stop_end))
+        {
+            l_debug (seat, "Waiting at most %d seconds for script %s", STOP_SCRIPT_TIMEOUT, request->command);
+            set_script_timeout (request, STOP_SCRIPT_TIMEOUT);
+        }
+    }
+}
+
+static ScriptRequest *
+find_script_request (Seat *seat, gpointer object)
+{
+    for (GList *link = seat->priv->scripts; link; link = link->next)
+    {
+        ScriptRequest *request = link->data;
+        if (request->object == object)
+            return request;
+    }
+
+    return NULL;
+}
+
+/* Runs a script without blocking and calls callback when it completes, or
+ * immediately if there is no script to run */
+static void
+run_script (Seat *seat, DisplayServer *display_server, const gchar *script_name, User *user, ScriptCallback callback, gpointer object)
+{
+    if (!script_name)
+    {
+        callback (seat, TRUE, object);
+        return;
+    }
+
+    Process *script = process_new (NULL, NULL);
 
     process_set_command (script, script_name);
 
@@ -377,18 +552,26 @@ run_script (Seat *seat, DisplayServer *display_server, const gchar *script_name,
 
     SEAT_GET_CLASS (seat)->run_script (seat, display_server, script);
 
-    gboolean result = FALSE;
-    if (process_start (script, TRUE))
+    ScriptRequest *request = g_malloc0 (sizeof (ScriptRequest));
+    request->seat = g_object_ref (seat);
+    request->process = script;
+    request->command = g_strdup (script_name);
+    request->callback = callback;
+    request->object = object ? g_object_ref (object) : NULL;
+    seat->priv->scripts = g_list_append (seat->priv->scripts, request);
+
+    g_signal_connect (script, PROCESS_SIGNAL_STOPPED, G_CALLBACK (script_stopped_cb), request);
+    if (!process_start (script, FALSE))
     {
-        int exit_status = process_get_exit_status (script);
-        if (WIFEXITED (exit_status))
-        {
-            l_debug (seat, "Exit status of %s: %d", script_name, WEXITSTATUS (exit_status));
-            result = WEXITSTATUS (exit_status) == EXIT_SUCCESS;
-        }
+        script_request_complete (request, FALSE);
+        return;
     }
 
-    return result;
+    gint timeout = seat_get_integer_property (seat, "script-timeout");
+    if (seat->priv->stopping && (timeout <= 0 || timeout > STOP_SCRIPT_TIMEOUT))
+        timeout = STOP_SCRIPT_TIMEOUT;
+    if (timeout > 0)
+        set_script_timeout (request, timeout);
 }
 
 static void
@@ -415,7 +598,8 @@ check_stopped (Seat *seat)
     if (seat->priv->stopping &&
         !seat->priv->stopped &&
         g_list_length (seat->priv->display_servers) == 0 &&
-        g_list_length (seat->priv->sessions) == 0)
+        g_list_length (seat->priv->sessions) == 0 &&
+        seat->priv->scripts == NULL)
     {
         seat->priv->stopped = TRUE;
         l_debug (seat, "Stopped");
@@ -424,17 +608,9 @@ check_stopped (Seat *seat)
 }
 
 static void
-display_server_stopped_cb (DisplayServer *display_server, Seat *seat)
+display_stopped_script_cb (Seat *seat, gboolean success, gpointer data)
 {
-    l_debug (seat, "Display server stopped");
-
-    /* Run a script right after stopping the display server */
-    const gchar *script = seat_get_string_property (seat, "display-stopped-script");
-    if (script)
-        run_script (seat, NULL, script, NULL);
-
-    g_signal_handlers_disconnect_matched (display_server, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
-    seat->priv->display_servers = g_list_remove (seat->priv->display_servers, display_server);
+    DisplayServer *display_server = data;
 
     if (seat->priv->stopping || !seat->priv->started)
     {
@@ -487,6 +663,19 @@ display_server_stopped_cb (DisplayServer *display_server, Seat *seat)
     g_object_unref (display_server);
 }
 
+static void
+display_server_stopped_cb (DisplayServer *display_server, Seat *seat)
+{
+    l_debug (seat, "Display server stopped");
+
+    g_signal_handlers_disconnect_matched (display_server, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
+    seat->priv->display_servers = g_list_remove (seat->priv->display_servers, display_server);
+
+    /* Run a script right after stopping the display server */
+    const gchar *script = seat_get_string_property (seat, "display-stopped-script");
+    run_script (seat, NULL, script, NULL, display_stopped_script_cb, display_server);
+}
+
 static gboolean
 can_share_display_server (Seat *seat, DisplayServer *display_server)
 {
@@ -520,6 +709,24 @@ find_resettable_greeter (Seat *seat)
     return NULL;
 }
 
+/* Get a user session that is running on a display server */
+static Session *
+find_running_user_session (Seat *seat, DisplayServer *display_server)
+{
+    for (GList *link = seat->priv->sessions; link; link = link->next)
+    {
+        Session *session = link->data;
+
+        if (!IS_GREETER_SESSION (session) &&
+            session_get_display_server (session) == display_server &&
+            session_get_is_run (session) &&
+            !session_get_is_stopping (session))
+            return session;
+    }
+
+    return NULL;
+}
+
 static void
 set_greeter_hints (Seat *seat, Greeter *greeter)
 {
@@ -603,7 +810,8 @@ start_session (Seat *seat, Session *session)
     if (IS_GREETER_SESSION (session))
     {
         l_debug (seat, "Failed to start greeter");
-        display_server_stop (session_get_display_server (session));
+        if (!find_running_user_session (seat, session_get_display_server (session)))
+            display_server_stop (session_get_display_server (session));
         return;
     }
 
@@ -612,14 +820,15 @@ start_session (Seat *seat, Session *session)
 }
 
 static void
-run_session (Seat *seat, Session *session)
+session_setup_script_cb (Seat *seat, gboolean success, gpointer data)
 {
-    const gchar *script;
-    if (IS_GREETER_SESSION (session))
-        script = seat_get_string_property (seat, "greeter-setup-script");
-    else
-        script = seat_get_string_property (seat, "session-setup-script");
-    if (script && !run_script (seat, session_get_display_server (session), script, session_get_user (session)))
+    Session *session = data;
+
+    /* Session may have stopped while the script was running */
+    if (session_get_is_stopping (session) || !g_list_find (seat->priv->sessions, session))
+        return;
+
+    if (!success)
     {
         l_debug (seat, "Switching to greeter due to failed setup script");
         switch_to_greeter_from_failed_session (seat, session);
@@ -634,6 +843,13 @@ run_session (Seat *seat, Session *session)
 
     session_run (session);
 
+    if (!seat->priv->session_run_reported)
+    {
+        seat->priv->session_run_reported = TRUE;
+        l_debug (seat, "First %s started %.3fs after seat start", IS_GREETER_SESSION (session) ? "greeter" : "session",
+                 (g_get_monotonic_time () - seat->priv->start_time) / (gdouble) G_USEC_PER_SEC);
+    }
+
     // FIXME: Wait until the session is ready
 
     if (session == seat->priv->session_to_activate)
@@ -654,6 +870,21 @@ run_session (Seat *seat, Session *session)
     }
 }
 
+static void
+run_session (Seat *seat, Session *session)
+{
+    /* Already running setup script for this session */
+    if (find_script_request (seat, session))
+        return;
+
+    const gchar *script;
+    if (IS_GREETER_SESSION (session))
+        script = seat_get_string_property (seat, "greeter-setup-script");
+    else
+        script = seat_get_string_property (seat, "session-setup-script");
+    run_script (seat, session_get_display_server (session), script, session_get_user (session), session_setup_script_cb, session);
+}
+
 static Session *
 find_user_session (Seat *seat, const gchar *username, Session *ignore_session)
 {
@@ -674,6 +905,28 @@ find_user_session (Seat *seat, const gchar *username, Session *ignore_session)
     return NULL;
 }
 
+static void
+greeter_connected_cb (Greeter *greeter, Seat *seat)
+{
+    /* Only time the first connection, greeters can reconnect when reset */
+    g_signal_handlers_disconnect_by_func (greeter, greeter_connected_cb, seat);
+
+    for (GList *link = seat->priv->sessions; link; link = link->next)
+    {
+        Session *session = link->data;
+        if (!IS_GREETER_SESSION (session) || greeter_session_get_greeter (GREETER_SESSION (session)) != greeter)
+            continue;
+
+        /* Greeter start is up to running the greeter, connect is from then until it talks to us */
+        gint64 run_time = session_get_run_time (session);
+        if (run_time == 0)
+            break;
+        timing_stats_add (seat->priv->timing_stats, TIMING_PHASE_GREETER_START, run_time - session_get_start_time (session));
+        timing_stats_add_since (seat->priv->timing_stats, TIMING_PHASE_GREETER_CONNECT, run_time);
+        break;
+    }
+}
+
 static void
 greeter_active_username_changed_cb (Greeter *greeter, GParamSpec *pspec, Seat *seat)
 {
@@ -716,29 +969,11 @@ session_authentication_complete_cb (Session *session, Seat *seat)
 }
 
 static void
-session_stopped_cb (Session *session, Seat *seat)
+session_cleanup_script_cb (Seat *seat, gboolean success, gpointer data)
 {
-    l_debug (seat, "Session stopped");
-
-    g_signal_handlers_disconnect_matched (session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
-    seat->priv->sessions = g_list_remove (seat->priv->sessions, session);
-    if (session == seat->priv->active_session)
-        g_clear_object (&seat->priv->active_session);
-    if (session == seat->priv->next_session)
-        g_clear_object (&seat->priv->next_session);
-    if (session == seat->priv->session_to_activate)
-        g_clear_object (&seat->priv->session_to_activate);
-
+    Session *session = data;
     DisplayServer *display_server = session_get_display_server (session);
 
-    /* Cleanup */
-    if (!IS_GREETER_SESSION (session))
-    {
-        const gchar *script = seat_get_string_property (seat, "session-cleanup-script");
-        if (script)
-            run_script (seat, display_server, script, session_get_user (session));
-    }
-
     /* We were waiting for this session, but it didn't start :( */
     // FIXME: Start a greeter on this?
     if (session == seat->priv->session_to_activate)
@@ -779,8 +1014,8 @@ session_stopped_cb (Session *session, Seat *seat)
         {
             Session *s = link->data;
 
-            /* Skip this session and sessions on other display servers */
-            if (s == session || session_get_display_server (s) != display_server || session_get_is_stopping (s))
+            /* Skip this session, sessions on other display servers and sessions already running */
+            if (s == session || session_get_display_server (s) != display_server || session_get_is_stopping (s) || session_get_is_run (s))
                 continue;
 
             if (session_get_is_authenticated (s))
@@ -800,7 +1035,8 @@ session_stopped_cb (Session *session, Seat *seat)
     else if (IS_GREETER_SESSION (session) &&
         !greeter_get_start_session (greeter_session_get_greeter (GREETER_SESSION (session))) &&
         g_list_length (seat->priv->display_servers) == 1 &&
-        g_list_nth_data (seat->priv->display_servers, 0) == display_server)
+        g_list_nth_data (seat->priv->display_servers, 0) == display_server &&
+        !find_running_user_session (seat, display_server))
     {
         l_debug (seat, "Stopping; failed to start a greeter");
         seat_stop (seat);
@@ -828,6 +1064,27 @@ session_stopped_cb (Session *session, Seat *seat)
     }
 }
 
+static void
+session_stopped_cb (Session *session, Seat *seat)
+{
+    l_debug (seat, "Session stopped");
+
+    g_signal_handlers_disconnect_matched (session, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, seat);
+    seat->priv->sessions = g_list_remove (seat->priv->sessions, session);
+    if (session == seat->priv->active_session)
+        g_clear_object (&seat->priv->active_session);
+    if (session == seat->priv->next_session)
+        g_clear_object (&seat->priv->next_session);
+    if (session == seat->priv->session_to_activate)
+        g_clear_object (&seat->priv->session_to_activate);
+
+    /* Cleanup */
+    const gchar *script = NULL;
+    if (!IS_GREETER_SESSION (session))
+        script = seat_get_string_property (seat, "session-cleanup-script");
+    run_script (seat, session_get_display_server (session), script, session_get_user (session), session_cleanup_script_cb, session);
+}
+
 static void
 set_session_env (Session *session)
 {
@@ -864,6 +1121,8 @@ create_session (Seat *seat, gboolean autostart)
     g_signal_connect (session, SESSION_SIGNAL_STOPPED, G_CALLBACK (session_stopped_cb), seat);
 
     set_session_env (session);
+    session_set_child_pool (session, seat->priv->child_pool);
+    session_set_timing_stats (session, seat->priv->timing_stats);
 
     g_signal_emit (seat, signals[SESSION_ADDED], 0, session);
 
@@ -1146,8 +1405,18 @@ greeter_start_session_cb (Greeter *greeter, SessionType type, const gchar *sessi
         return TRUE;
     }
 
-    /* If can re-use the display server, stop the greeter first */
+    /* A greeter sharing a display server with a user session can only return to that session */
     Session *greeter_session = get_greeter_session (seat, greeter);
+    if (greeter_session && find_running_user_session (seat, session_get_display_server (greeter_session)))
+    {
+        l_debug (seat, "Not starting session for %s, display server is in use by another user", username);
+        session_stop (session);
+        g_clear_object (&seat->priv->session_to_activate);
+        SEAT_GET_CLASS (seat)->display_server_in_use (seat, greeter_session, username);
+        return FALSE;
+    }
+
+    /* If can re-use the display server, stop the greeter first */
     if (greeter_session)
     {
         DisplayServer *display_server = session_get_display_server (greeter_session);
@@ -1203,11 +1472,20 @@ create_greeter_session (Seat *seat)
     session_set_config (SESSION (greeter_session), session_config);
     seat->priv->sessions = g_list_append (seat->priv->sessions, SESSION (greeter_session));
     g_signal_connect (greeter, GREETER_SIGNAL_ACTIVE_USERNAME_CHANGED, G_CALLBACK (greeter_active_username_changed_cb), seat);
+    g_signal_connect (greeter, GREETER_SIGNAL_CONNECTED, G_CALLBACK (greeter_connected_cb), seat);
     g_signal_connect (greeter_session, SESSION_SIGNAL_AUTHENTICATION_COMPLETE, G_CALLBACK (session_authentication_complete_cb), seat);
     g_signal_connect (greeter_session, SESSION_SIGNAL_STOPPED, G_CALLBACK (session_stopped_cb), seat);
 
     set_session_env (SESSION (greeter_session));
+    session_set_child_pool (SESSION (greeter_session), seat->priv->child_pool);
+    session_set_timing_stats (SESSION (greeter_session), seat->priv->timing_stats);
     session_set_env (SESSION (greeter_session), "XDG_SESSION_CLASS", "greeter");
+    if (config_get_boolean (config_get_instance (), "LightDM", "user-cache"))
+    {
+        g_autofree gchar *cache_dir = config_get_string (config_get_instance (), "LightDM", "cache-directory");
+        g_autofree gchar *user_cache_path = g_build_filename (cache_dir, "user-cache", NULL);
+        session_set_env (SESSION (greeter_session), "LIGHTDM_USER_CACHE", user_cache_path);
+    }
 
     session_set_pam_service (SESSION (greeter_session), seat_get_string_property (seat, "pam-greeter-service"));
     if (getuid () == 0)
@@ -1273,11 +1551,15 @@ find_session_for_display_server (Seat *seat, DisplayServer *display_server)
 }
 
 static void
-display_server_ready_cb (DisplayServer *display_server, Seat *seat)
+display_setup_script_cb (Seat *seat, gboolean success, gpointer data)
 {
-    /* Run setup script */
-    const gchar *script = seat_get_string_property (seat, "display-setup-script");
-    if (script && !run_script (seat, display_server, script, NULL))
+    DisplayServer *display_server = data;
+
+    /* Display server may have stopped while the script was running */
+    if (display_server_get_is_stopping (display_server) || !g_list_find (seat->priv->display_servers, display_server))
+        return;
+
+    if (!success)
     {
         l_debug (seat, "Stopping display server due to failed setup script");
         display_server_stop (display_server);
@@ -1308,6 +1590,23 @@ display_server_ready_cb (DisplayServer *display_server, Seat *seat)
     }
 }
 
+static void
+display_server_ready_cb (DisplayServer *display_server, Seat *seat)
+{
+    timing_stats_add_since (seat->priv->timing_stats, TIMING_PHASE_DISPLAY_SERVER_START, display_server_get_start_time (display_server));
+
+    if (!seat->priv->display_server_ready_reported)
+    {
+        seat->priv->display_server_ready_reported = TRUE;
+        l_debug (seat, "First display server ready %.3fs after seat start",
+                 (g_get_monotonic_time () - seat->priv->start_time) / (gdouble) G_USEC_PER_SEC);
+    }
+
+    /* Run setup script */
+    const gchar *script = seat_get_string_property (seat, "display-setup-script");
+    run_script (seat, display_server, script, NULL, display_setup_script_cb, display_server);
+}
+
 static DisplayServer *
 create_display_server (Seat *seat, Session *session)
 {
@@ -1582,6 +1881,35 @@ seat_lock (Seat *seat, const gchar *username)
     }
 }
 
+GreeterSession *
+seat_lock_session (Seat *seat, Session *session)
+{
+    g_return_val_if_fail (seat != NULL, NULL);
+    g_return_val_if_fail (session != NULL, NULL);
+
+    DisplayServer *display_server = session_get_display_server (session);
+    if (!display_server || !can_share_display_server (seat, display_server))
+        return NULL;
+
+    l_debug (seat, "Showing lock screen for %s", session_get_username (session));
+
+    GreeterSession *greeter_session = create_greeter_session (seat);
+    if (!greeter_session)
+        return NULL;
+    Greeter *greeter = greeter_session_get_greeter (greeter_session);
+
+    greeter_set_hint (greeter, "lock-screen", "true");
+    greeter_set_hint (greeter, "select-user", session_get_username (session));
+
+    /* Run on top of the session, which is locked when the greeter becomes active */
+    session_set_display_server (SESSION (greeter_session), display_server);
+    g_clear_object (&seat->priv->session_to_activate);
+    seat->priv->session_to_activate = g_object_ref (SESSION (greeter_session));
+    start_session (seat, SESSION (greeter_session));
+
+    return greeter_session;
+}
+
 void
 seat_stop (Seat *seat)
 {
@@ -1592,6 +1920,9 @@ seat_stop (Seat *seat)
 
     l_debug (seat, "Stopping");
     seat->priv->stopping = TRUE;
+    limit_script_timeouts (seat);
+    if (seat->priv->child_pool && !seat->priv->shared_child_pool)
+        session_child_pool_stop (seat->priv->child_pool);
     SEAT_GET_CLASS (seat)->stop (seat);
 }
 
@@ -1724,6 +2055,11 @@ seat_real_display_server_is_used (Seat *seat, DisplayServer *display_server)
     return FALSE;
 }
 
+static void
+seat_real_display_server_in_use (Seat *seat, Session *greeter_session, const gchar *username)
+{
+}
+
 static GreeterSession *
 seat_real_create_greeter_session (Seat *seat)
 {
@@ -1822,6 +2158,7 @@ seat_init (Seat *seat)
     seat->priv = G_TYPE_INSTANCE_GET_PRIVATE (seat, SEAT_TYPE, SeatPrivate);
     seat->priv->properties = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
     seat->priv->share_display_server = TRUE;
+    seat->priv->timing_stats = timing_stats_new ();
 }
 
 static void
@@ -1847,6 +2184,8 @@ seat_finalize (GObject *object)
     g_clear_object (&self->priv->next_session);
     g_clear_object (&self->priv->session_to_activate);
     g_clear_object (&self->priv->replacement_greeter);
+    g_clear_object (&self->priv->child_pool);
+    g_clear_object (&self->priv->timing_stats);
 
     G_OBJECT_CLASS (seat_parent_class)->finalize (object);
 }
@@ -1866,6 +2205,7 @@ seat_class_init (SeatClass *klass)
     klass->get_active_session = seat_real_get_active_session;
     klass->set_next_session = seat_real_set_next_session;
     klass->run_script = seat_real_run_script;
+    klass->display_server_in_use = seat_real_display_server_in_use;
     klass->stop = seat_real_stop;
 
     object_class->finalize = seat_finalize;
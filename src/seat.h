@@ -53,6 +53,7 @@ typedef struct
     void (*set_next_session)(Seat *seat, Session *session);
     Session *(*get_active_session)(Seat *seat);
     void (*run_script)(Seat *seat, DisplayServer *display_server, Process *script);
+    void (*display_server_in_use)(Seat *seat, Session *greeter_session, const gchar *username);
     void (*stop)(Seat *seat);
 
     void (*session_added)(Seat *seat, Session *session);
@@ -87,8 +88,12 @@ void seat_set_supports_multi_session (Seat *seat, gboolean supports_multi_sessio
 
 void seat_set_share_display_server (Seat *seat, gboolean share_display_server);
 
+void seat_set_child_pool (Seat *seat, SessionChildPool *child_pool);
+
 gboolean seat_start (Seat *seat);
 
+TimingStats *seat_get_timing_stats (Seat *seat);
+
 GList *seat_get_sessions (Seat *seat);
 
 void seat_set_active_session (Seat *seat, Session *session);
@@ -117,6 +122,8 @@ gboolean seat_switch_to_guest (Seat *seat, const gchar *session_name);
 
 gboolean seat_lock (Seat *seat, const gchar *username);
 
+GreeterSession *seat_lock_session (Seat *seat, Session *session);
+
 void seat_stop (Seat *seat);
 
 gboolean seat_get_is_stopping (Seat *seat);
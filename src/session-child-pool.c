@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2026 LightDM contributors.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+
+#include "session-child-pool.h"
+
+/* Session children started in advance. Each one has been exec'd and is
+ * blocked waiting for the protocol version and configuration to be written
+ * down its pipe, so they are not tied to any particular session. */
+
+typedef struct
+{
+    SessionChildPool *pool;
+
+    /* Process ID */
+    GPid pid;
+
+    /* Pipes to talk to the child */
+    int to_child_input;
+    int from_child_output;
+
+    /* Watch on the child */
+    guint child_watch;
+} PooledChild;
+
+struct SessionChildPoolPrivate
+{
+    /* Number of children to keep waiting */
+    guint size;
+
+    /* Children waiting to be used */
+    GQueue children;
+
+    /* Idle source to start more children */
+    guint refill_source;
+
+    /* TRUE if no longer providing children */
+    gboolean stopped;
+};
+
+G_DEFINE_TYPE (SessionChildPool, session_child_pool, G_TYPE_OBJECT)
+
+gboolean
+session_child_spawn (GPid *pid, int *to_child_input, int *from_child_output)
+{
+    /* Create pipes to talk to the child */
+    int to_child_pipe[2], from_child_pipe[2];
+    if (pipe (to_child_pipe) < 0 || pipe (from_child_pipe) < 0)
+    {
+        g_warning ("Failed to create pipe to communicate with session process: %s", strerror (errno));
+        return FALSE;
+    }
+    int to_child_output = to_child_pipe[0];
+    int from_child_input = from_child_pipe[1];
+
+    /* Don't allow the daemon end of the pipes to be accessed in child processes */
+    fcntl (to_child_pipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl (from_child_pipe[0], F_SETFD, FD_CLOEXEC);
+
+    /* Run the child */
+    g_autofree gchar *arg0 = g_strdup_printf ("%d", to_child_output);
+    g_autofree gchar *arg1 = g_strdup_printf ("%d", from_child_input);
+    GPid child_pid = fork ();
+    if (child_pid == 0)
+    {
+        /* Run us again in session child mode */
+        execlp ("lightdm",
+                "lightdm",
+                "--session-child",
+                arg0, arg1, NULL);
+        _exit (EXIT_FAILURE);
+    }
+
+    /* Close the ends of the pipes we don't need */
+    close (to_child_output);
+    close (from_child_input);
+
+    if (child_pid < 0)
+    {
+        g_debug ("Failed to fork session child process: %s", strerror (errno));
+        close (to_child_pipe[1]);
+        close (from_child_pipe[0]);
+        return FALSE;
+    }
+
+    *pid = child_pid;
+    *to_child_input = to_child_pipe[1];
+    *from_child_output = from_child_pipe[0];
+
+    return TRUE;
+}
+
+static void
+close_child (PooledChild *child)
+{
+    if (child->to_child_input >= 0)
+        close (child->to_child_input);
+    child->to_child_input = -1;
+    if (child->from_child_output >= 0)
+        close (child->from_child_output);
+    child->from_child_output = -1;
+}
+
+static void
+child_watch_cb (GPid pid, gint status, gpointer data)
+{
+    PooledChild *child = data;
+    SessionChildPool *pool = child->pool;
+
+    /* Not refilled here, so a child that can't start doesn't cause a fork loop */
+    g_debug ("Pooled session child %d stopped", pid);
+
+    g_queue_remove (&pool->priv->children, child);
+    close_child (child);
+    g_free (child);
+}
+
+static gboolean
+refill_cb (gpointer data)
+{
+    SessionChildPool *pool = data;
+
+    pool->priv->refill_source = 0;
+
+    while (!pool->priv->stopped && g_queue_get_length (&pool->priv->children) < pool->priv->size)
+    {
+        PooledChild *child = g_malloc0 (sizeof (PooledChild));
+        child->pool = pool;
+        if (!session_child_spawn (&child->pid, &child->to_child_input, &child->from_child_output))
+        {
+            g_free (child);
+            break;
+        }
+
+        g_debug ("Started pooled session child %d", child->pid);
+        child->child_watch = g_child_watch_add (child->pid, child_watch_cb, child);
+        g_queue_push_tail (&pool->priv->children, child);
+    }
+
+    return FALSE;
+}
+
+static void
+schedule_refill (SessionChildPool *pool)
+{
+    if (pool->priv->stopped || pool->priv->refill_source != 0)
+        return;
+
+    /* Start children when the daemon is otherwise idle so logins aren't delayed */
+    pool->priv->refill_source = g_idle_add_full (G_PRIORITY_LOW, refill_cb, pool, NULL);
+}
+
+SessionChildPool *
+session_child_pool_new (guint size)
+{
+    SessionChildPool *pool = g_object_new (SESSION_CHILD_POOL_TYPE, NULL);
+    pool->priv->size = size;
+    schedule_refill (pool);
+    return pool;
+}
+
+gboolean
+session_child_pool_take (SessionChildPool *pool, GPid *pid, int *to_child_input, int *from_child_output)
+{
+    g_return_val_if_fail (pool != NULL, FALSE);
+
+    if (pool->priv->stopped)
+        return FALSE;
+
+    schedule_refill (pool);
+
+    PooledChild *child = g_queue_pop_head (&pool->priv->children);
+    if (!child)
+        return FALSE;
+
+    /* Caller is now responsible for the child */
+    g_source_remove (child->child_watch);
+    *pid = child->pid;
+    *to_child_input = child->to_child_input;
+    *from_child_output = child->from_child_output;
+    g_free (child);
+
+    return TRUE;
+}
+
+void
+session_child_pool_stop (SessionChildPool *pool)
+{
+    g_return_if_fail (pool != NULL);
+
+    if (pool->priv->stopped)
+        return;
+    pool->priv->stopped = TRUE;
+
+    if (pool->priv->refill_source)
+        g_source_remove (pool->priv->refill_source);
+    pool->priv->refill_source = 0;
+
+    /* Children quit when their pipe closes, and are removed once they have stopped */
+    for (GList *link = pool->priv->children.head; link; link = link->next)
+        close_child (link->data);
+}
+
+static void
+session_child_pool_init (SessionChildPool *pool)
+{
+    pool->priv = G_TYPE_INSTANCE_GET_PRIVATE (pool, SESSION_CHILD_POOL_TYPE, SessionChildPoolPrivate);
+    g_queue_init (&pool->priv->children);
+}
+
+static void
+session_child_pool_finalize (GObject *object)
+{
+    SessionChildPool *self = SESSION_CHILD_POOL (object);
+
+    if (self->priv->refill_source)
+        g_source_remove (self->priv->refill_source);
+    PooledChild *child;
+    while ((child = g_queue_pop_head (&self->priv->children)))
+    {
+        /* Nothing is left to reap the children, so stop them now */
+        g_source_remove (child->child_watch);
+        close_child (child);
+        kill (child->pid, SIGKILL);
+        waitpid (child->pid, NULL, 0);
+        g_free (child);
+    }
+
+    G_OBJECT_CLASS (session_child_pool_parent_class)->finalize (object);
+}
+
+static void
+session_child_pool_class_init (SessionChildPoolClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = session_child_pool_finalize;
+
+    g_type_class_add_private (klass, sizeof (SessionChildPoolPrivate));
+}
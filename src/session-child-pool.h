@@ -0,0 +1,50 @@
+/*
+ * Copyright (C) 2026 LightDM contributors.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef SESSION_CHILD_POOL_H_
+#define SESSION_CHILD_POOL_H_
+
+#include <glib-object.h>
+
+typedef struct SessionChildPool SessionChildPool;
+
+G_BEGIN_DECLS
+
+#define SESSION_CHILD_POOL_TYPE (session_child_pool_get_type())
+#define SESSION_CHILD_POOL(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), SESSION_CHILD_POOL_TYPE, SessionChildPool))
+
+typedef struct SessionChildPoolPrivate SessionChildPoolPrivate;
+
+struct SessionChildPool
+{
+    GObject                  parent_instance;
+    SessionChildPoolPrivate *priv;
+};
+
+typedef struct
+{
+    GObjectClass parent_class;
+} SessionChildPoolClass;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (SessionChildPool, g_object_unref)
+
+GType session_child_pool_get_type (void);
+
+gboolean session_child_spawn (GPid *pid, int *to_child_input, int *from_child_output);
+
+SessionChildPool *session_child_pool_new (guint size);
+
+gboolean session_child_pool_take (SessionChildPool *pool, GPid *pid, int *to_child_input, int *from_child_output);
+
+void session_child_pool_stop (SessionChildPool *pool);
+
+G_END_DECLS
+
+#endif /* SESSION_CHILD_POOL_H_ */
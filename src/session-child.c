@@ -43,6 +43,9 @@ static gboolean do_authenticate;
 static gboolean authentication_complete = FALSE;
 static pam_handle_t *pam_handle;
 
+/* Time spent waiting for the daemon to answer PAM prompts, so it can be left out of PAM timings */
+static gint64 conversation_time = 0;
+
 /* Maximum length of a string to pass between daemon and session */
 #define MAX_STRING_LENGTH 65535
 
@@ -139,10 +142,14 @@ pam_conv_cb (int msg_length, const struct pam_message **msg, struct pam_response
     }
 
     /* Get response */
+    gint64 response_start_time = g_get_monotonic_time ();
     int error;
     read_data (&error, sizeof (error));
     if (error != PAM_SUCCESS)
+    {
+        conversation_time += g_get_monotonic_time () - response_start_time;
         return error;
+    }
     struct pam_response *response = calloc (msg_length, sizeof (struct pam_response));
     for (int i = 0; i < msg_length; i++)
     {
@@ -152,11 +159,27 @@ pam_conv_cb (int msg_length, const struct pam_message **msg, struct pam_response
         r->resp = read_string_full (malloc);
         read_data (&r->resp_retcode, sizeof (r->resp_retcode));
     }
+    conversation_time += g_get_monotonic_time () - response_start_time;
 
     *resp = response;
     return PAM_SUCCESS;
 }
 
+/* Start timing a PAM call */
+static gint64
+get_time (void)
+{
+    conversation_time = 0;
+    return g_get_monotonic_time ();
+}
+
+/* Get how long PAM took since get_time(), not counting time spent waiting on the user */
+static gint64
+get_duration (gint64 start_time)
+{
+    return MAX (g_get_monotonic_time () - start_time - conversation_time, 0);
+}
+
 static void
 signal_cb (int signum)
 {
@@ -281,7 +304,11 @@ session_child_run (int argc, char **argv)
 
     /* Read a version number so we can handle upgrades (i.e. a newer version of session child is run for an old daemon */
     int version;
-    read_data (&version, sizeof (version));
+    if (read_data (&version, sizeof (version)) <= 0)
+    {
+        /* Pre-started child that is no longer required */
+        return EXIT_SUCCESS;
+    }
 
     g_autofree gchar *service = read_string ();
     g_autofree gchar *username = read_string ();
@@ -295,7 +322,9 @@ session_child_run (int argc, char **argv)
 
     /* Setup PAM */
     struct pam_conv conversation = { pam_conv_cb, NULL };
+    gint64 pam_start_time = get_time ();
     int result = pam_start (service, username, &conversation, &pam_handle);
+    pam_start_time = get_duration (pam_start_time);
     if (result != PAM_SUCCESS)
     {
         g_printerr ("Failed to start PAM: %s", pam_strerror (NULL, result));
@@ -326,11 +355,14 @@ session_child_run (int argc, char **argv)
 
     /* Authenticate */
     int authentication_result = PAM_SUCCESS;
+    gint64 pam_authenticate_time = -1, pam_acct_mgmt_time = -1;
     if (do_authenticate)
     {
         const gchar *new_username;
 
+        pam_authenticate_time = get_time ();
         authentication_result = pam_authenticate (pam_handle, 0);
+        pam_authenticate_time = get_duration (pam_authenticate_time);
 
         /* See what user we ended up as */
         if (pam_get_item (pam_handle, PAM_USER, (const void **) &new_username) != PAM_SUCCESS)
@@ -372,7 +404,11 @@ session_child_run (int argc, char **argv)
 
         /* Check account is valid */
         if (authentication_result == PAM_SUCCESS)
+        {
+            pam_acct_mgmt_time = get_time ();
             authentication_result = pam_acct_mgmt (pam_handle, 0);
+            pam_acct_mgmt_time = get_duration (pam_acct_mgmt_time);
+        }
         if (authentication_result == PAM_NEW_AUTHTOK_REQD)
             authentication_result = pam_chauthtok (pam_handle, PAM_CHANGE_EXPIRED_AUTHTOK);
     }
@@ -437,6 +473,12 @@ session_child_run (int argc, char **argv)
     write_data (&auth_complete, sizeof (auth_complete));
     write_data (&authentication_result, sizeof (authentication_result));
     write_string (authentication_result_string);
+    if (version >= 4)
+    {
+        write_data (&pam_start_time, sizeof (pam_start_time));
+        write_data (&pam_authenticate_time, sizeof (pam_authenticate_time));
+        write_data (&pam_acct_mgmt_time, sizeof (pam_acct_mgmt_time));
+    }
 
     /* Check we got a valid user */
     if (!username)
@@ -520,6 +562,7 @@ session_child_run (int argc, char **argv)
     }
 
     /* Set credentials */
+    gint64 pam_open_session_time = get_time ();
     result = pam_setcred (pam_handle, PAM_ESTABLISH_CRED);
     if (result != PAM_SUCCESS)
     {
@@ -536,6 +579,7 @@ session_child_run (int argc, char **argv)
         pam_end (pam_handle, 0);
         return EXIT_FAILURE;
     }
+    pam_open_session_time = get_duration (pam_open_session_time);
 
     /* Open a connection to the system bus for ConsoleKit - we must keep it open or CK will close the session */
     g_autoptr(GError) error = NULL;
@@ -551,6 +595,8 @@ session_child_run (int argc, char **argv)
     /* Check what logind session we are, or fallback to ConsoleKit */
     const gchar *login1_session_id = pam_getenv (pam_handle, "XDG_SESSION_ID");
     g_autofree gchar *console_kit_cookie = NULL;
+    if (version >= 4)
+        write_data (&pam_open_session_time, sizeof (pam_open_session_time));
     if (login1_session_id)
     {
         write_string (login1_session_id);
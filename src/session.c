@@ -56,6 +56,17 @@ struct SessionPrivate
     guint from_child_watch;
     guint child_watch;
 
+    /* Pool to take a pre-started child from */
+    SessionChildPool *child_pool;
+
+    /* Statistics to record timings in */
+    TimingStats *timing_stats;
+
+    /* Monotonic times the session was started, run and stopped */
+    gint64 start_time;
+    gint64 run_time;
+    gint64 stop_time;
+
     /* User to authenticate as */
     gchar *username;
 
@@ -167,6 +178,28 @@ session_set_pam_service (Session *session, const gchar *pam_service)
     session->priv->pam_service = g_strdup (pam_service);
 }
 
+void
+session_set_child_pool (Session *session, SessionChildPool *child_pool)
+{
+    g_return_if_fail (session != NULL);
+    g_clear_object (&session->priv->child_pool);
+    session->priv->child_pool = child_pool ? g_object_ref (child_pool) : NULL;
+}
+
+void
+session_set_timing_stats (Session *session, TimingStats *timing_stats)
+{
+    g_return_if_fail (session != NULL);
+    g_clear_object (&session->priv->timing_stats);
+    session->priv->timing_stats = timing_stats ? g_object_ref (timing_stats) : NULL;
+}
+
+static void
+add_timing (Session *session, TimingPhase phase, gint64 duration)
+{
+    timing_stats_add (session->priv->timing_stats ? session->priv->timing_stats : timing_stats_get_instance (), phase, duration);
+}
+
 void
 session_set_username (Session *session, const gchar *username)
 {
@@ -420,6 +453,9 @@ session_watch_cb (GPid pid, gint status, gpointer data)
 
     session->priv->child_watch = 0;
 
+    if (session->priv->stop_time != 0)
+        add_timing (session, TIMING_PHASE_SESSION_STOP, g_get_monotonic_time () - session->priv->stop_time);
+
     if (WIFEXITED (status))
         l_debug (session, "Exited with return value %d", WEXITSTATUS (status));
     else if (WIFSIGNALED (status))
@@ -487,6 +523,13 @@ from_child_cb (GIOChannel *source, GIOCondition condition, gpointer data)
         read_from_child (session, &session->priv->authentication_result, sizeof (session->priv->authentication_result));
         g_free (session->priv->authentication_result_string);
         session->priv->authentication_result_string = read_string_from_child (session);
+        gint64 pam_start_time = -1, pam_authenticate_time = -1, pam_acct_mgmt_time = -1;
+        read_from_child (session, &pam_start_time, sizeof (pam_start_time));
+        read_from_child (session, &pam_authenticate_time, sizeof (pam_authenticate_time));
+        read_from_child (session, &pam_acct_mgmt_time, sizeof (pam_acct_mgmt_time));
+        add_timing (session, TIMING_PHASE_PAM_START, pam_start_time);
+        add_timing (session, TIMING_PHASE_PAM_AUTHENTICATE, pam_authenticate_time);
+        add_timing (session, TIMING_PHASE_PAM_ACCT_MGMT, pam_acct_mgmt_time);
 
         l_debug (session, "Authentication complete with return value %d: %s", session->priv->authentication_result, session->priv->authentication_result_string);
 
@@ -524,6 +567,13 @@ session_start (Session *session)
     return SESSION_GET_CLASS (session)->start (session);
 }
 
+gint64
+session_get_start_time (Session *session)
+{
+    g_return_val_if_fail (session != NULL, 0);
+    return session->priv->start_time;
+}
+
 gboolean
 session_get_is_started (Session *session)
 {
@@ -543,27 +593,11 @@ session_real_start (Session *session)
 {
     g_return_val_if_fail (session->priv->pid == 0, FALSE);
 
+    session->priv->start_time = g_get_monotonic_time ();
+
     if (session->priv->display_server)
         display_server_connect_session (session->priv->display_server, session);
 
-    /* Create pipes to talk to the child */
-    int to_child_pipe[2], from_child_pipe[2];
-    if (pipe (to_child_pipe) < 0 || pipe (from_child_pipe) < 0)
-    {
-        g_warning ("Failed to create pipe to communicate with session process: %s", strerror (errno));
-        return FALSE;
-    }
-    int to_child_output = to_child_pipe[0];
-    session->priv->to_child_input = to_child_pipe[1];
-    session->priv->from_child_output = from_child_pipe[0];
-    int from_child_input = from_child_pipe[1];
-    session->priv->from_child_channel = g_io_channel_unix_new (session->priv->from_child_output);
-    session->priv->from_child_watch = g_io_add_watch (session->priv->from_child_channel, G_IO_IN | G_IO_HUP, from_child_cb, session);
-
-    /* Don't allow the daemon end of the pipes to be accessed in child processes */
-    fcntl (session->priv->to_child_input, F_SETFD, FD_CLOEXEC);
-    fcntl (session->priv->from_child_output, F_SETFD, FD_CLOEXEC);
-
     /* Create the guest account if it is one */
     if (session->priv->is_guest && session->priv->username == NULL)
     {
@@ -572,25 +606,13 @@ session_real_start (Session *session)
             return FALSE;
     }
 
-    /* Run the child */
-    g_autofree gchar *arg0 = g_strdup_printf ("%d", to_child_output);
-    g_autofree gchar *arg1 = g_strdup_printf ("%d", from_child_input);
-    session->priv->pid = fork ();
-    if (session->priv->pid == 0)
-    {
-        /* Run us again in session child mode */
-        execlp ("lightdm",
-                "lightdm",
-                "--session-child",
-                arg0, arg1, NULL);
-        _exit (EXIT_FAILURE);
-    }
-
-    if (session->priv->pid < 0)
-    {
-        g_debug ("Failed to fork session child process: %s", strerror (errno));
+    /* Use a child that is already running if possible, otherwise run a new one */
+    if (!(session->priv->child_pool &&
+          session_child_pool_take (session->priv->child_pool, &session->priv->pid, &session->priv->to_child_input, &session->priv->from_child_output)) &&
+        !session_child_spawn (&session->priv->pid, &session->priv->to_child_input, &session->priv->from_child_output))
         return FALSE;
-    }
+    session->priv->from_child_channel = g_io_channel_unix_new (session->priv->from_child_output);
+    session->priv->from_child_watch = g_io_add_watch (session->priv->from_child_channel, G_IO_IN | G_IO_HUP, from_child_cb, session);
 
     /* Hold a reference on this object until the child process terminates so we
      * can handle the watch callback even if it is no longer used. Otherwise a
@@ -601,12 +623,8 @@ session_real_start (Session *session)
     session->priv->authentication_started = TRUE;
     session->priv->child_watch = g_child_watch_add (session->priv->pid, session_watch_cb, session);
 
-    /* Close the ends of the pipes we don't need */
-    close (to_child_output);
-    close (from_child_input);
-
     /* Indicate what version of the protocol we are using */
-    int version = 3;
+    int version = 4;
     write_data (session, &version, sizeof (version));
 
     /* Send configuration */
@@ -719,6 +737,13 @@ session_run (Session *session)
     return SESSION_GET_CLASS (session)->run (session);
 }
 
+gint64
+session_get_run_time (Session *session)
+{
+    g_return_val_if_fail (session != NULL, 0);
+    return session->priv->run_time;
+}
+
 gboolean
 session_get_is_run (Session *session)
 {
@@ -738,6 +763,7 @@ session_real_run (Session *session)
     display_server_connect_session (session->priv->display_server, session);
 
     session->priv->command_run = TRUE;
+    session->priv->run_time = g_get_monotonic_time ();
 
     g_autofree gchar *command = g_strjoinv (" ", session->priv->argv);
     l_debug (session, "Running command %s", command);
@@ -811,8 +837,12 @@ session_real_run (Session *session)
     for (gsize i = 0; i < argc; i++)
         write_string (session, session->priv->argv[i]);
 
+    gint64 pam_open_session_time = -1;
+    read_from_child (session, &pam_open_session_time, sizeof (pam_open_session_time));
+    add_timing (session, TIMING_PHASE_PAM_OPEN_SESSION, pam_open_session_time);
     session->priv->login1_session_id = read_string_from_child (session);
     session->priv->console_kit_cookie = read_string_from_child (session);
+    add_timing (session, TIMING_PHASE_SESSION_EXEC, g_get_monotonic_time () - session->priv->run_time);
 }
 
 void
@@ -862,6 +892,7 @@ session_stop (Session *session)
     if (session->priv->stopping)
         return;
     session->priv->stopping = TRUE;
+    session->priv->stop_time = g_get_monotonic_time ();
 
     /* Kill remaining processes in our logind session to avoid them leaking
      * to the user session (they share the same $DISPLAY) */
@@ -927,6 +958,8 @@ session_finalize (GObject *object)
 
     g_clear_object (&self->priv->config);
     g_clear_object (&self->priv->display_server);
+    g_clear_object (&self->priv->child_pool);
+    g_clear_object (&self->priv->timing_stats);
     if (self->priv->pid)
         kill (self->priv->pid, SIGKILL);
     close (self->priv->to_child_input);
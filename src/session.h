@@ -31,6 +31,8 @@ typedef enum
 #include "logger.h"
 #include "log-file.h"
 #include "greeter.h"
+#include "session-child-pool.h"
+#include "timing-stats.h"
 
 G_BEGIN_DECLS
 
@@ -80,6 +82,10 @@ const gchar *session_get_session_type (Session *session);
 
 void session_set_pam_service (Session *session, const gchar *pam_service);
 
+void session_set_child_pool (Session *session, SessionChildPool *child_pool);
+
+void session_set_timing_stats (Session *session, TimingStats *timing_stats);
+
 void session_set_username (Session *session, const gchar *username);
 
 void session_set_do_authenticate (Session *session, gboolean do_authenticate);
@@ -117,6 +123,8 @@ User *session_get_user (Session *session);
 
 gboolean session_start (Session *session);
 
+gint64 session_get_start_time (Session *session);
+
 gboolean session_get_is_started (Session *session);
 
 const gchar *session_get_username (Session *session);
@@ -141,6 +149,8 @@ const gchar *session_get_authentication_result_string (Session *session);
 
 void session_run (Session *session);
 
+gint64 session_get_run_time (Session *session);
+
 gboolean session_get_is_run (Session *session);
 
 void session_lock (Session *session);
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2026 LightDM contributors.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#include "timing-stats.h"
+
+/* Histograms of how long each step of starting seats and sessions takes.
+ * Seats have their own statistics, which are also added to the totals kept
+ * by the instance. */
+
+static const gchar *phase_names[TIMING_PHASE_COUNT] =
+{
+    "display-server-start",
+    "greeter-start",
+    "greeter-connect",
+    "pam-start",
+    "pam-authenticate",
+    "pam-acct-mgmt",
+    "pam-open-session",
+    "session-exec",
+    "session-stop"
+};
+
+/* Upper bounds of the histogram buckets in microseconds, with a final bucket for anything longer */
+static const gint64 bucket_bounds[] =
+{
+    1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+    1000000, 2500000, 5000000, 10000000, 30000000, 60000000
+};
+#define N_BUCKETS (G_N_ELEMENTS (bucket_bounds) + 1)
+
+typedef struct
+{
+    guint64 count;
+
+    /* Total of all durations in microseconds */
+    gint64 sum;
+
+    guint64 buckets[N_BUCKETS];
+} Histogram;
+
+struct TimingStatsPrivate
+{
+    Histogram histograms[TIMING_PHASE_COUNT];
+};
+
+G_DEFINE_TYPE (TimingStats, timing_stats, G_TYPE_OBJECT)
+
+static TimingStats *stats_instance = NULL;
+
+TimingStats *
+timing_stats_get_instance (void)
+{
+    if (!stats_instance)
+        stats_instance = timing_stats_new ();
+    return stats_instance;
+}
+
+TimingStats *
+timing_stats_new (void)
+{
+    return g_object_new (TIMING_STATS_TYPE, NULL);
+}
+
+static void
+add_to_histogram (Histogram *histogram, gint64 duration)
+{
+    histogram->count++;
+    histogram->sum += duration;
+
+    guint i;
+    for (i = 0; i < G_N_ELEMENTS (bucket_bounds) && duration > bucket_bounds[i]; i++);
+    histogram->buckets[i]++;
+}
+
+void
+timing_stats_add (TimingStats *stats, TimingPhase phase, gint64 duration)
+{
+    g_return_if_fail (stats != NULL);
+    g_return_if_fail (phase < TIMING_PHASE_COUNT);
+
+    if (duration < 0)
+        return;
+
+    add_to_histogram (&stats->priv->histograms[phase], duration);
+    if (stats != timing_stats_get_instance ())
+        add_to_histogram (&timing_stats_get_instance ()->priv->histograms[phase], duration);
+}
+
+void
+timing_stats_add_since (TimingStats *stats, TimingPhase phase, gint64 start_time)
+{
+    if (start_time == 0)
+        return;
+    timing_stats_add (stats, phase, g_get_monotonic_time () - start_time);
+}
+
+GVariant *
+timing_stats_to_variant (TimingStats *stats)
+{
+    g_return_val_if_fail (stats != NULL, NULL);
+
+    GVariantBuilder builder;
+    g_variant_builder_init (&builder, G_VARIANT_TYPE ("a(stdadat)"));
+    for (int i = 0; i < TIMING_PHASE_COUNT; i++)
+    {
+        Histogram *histogram = &stats->priv->histograms[i];
+
+        GVariantBuilder bounds_builder, buckets_builder;
+        g_variant_builder_init (&bounds_builder, G_VARIANT_TYPE ("ad"));
+        for (guint j = 0; j < G_N_ELEMENTS (bucket_bounds); j++)
+            g_variant_builder_add (&bounds_builder, "d", bucket_bounds[j] / (gdouble) G_USEC_PER_SEC);
+        g_variant_builder_init (&buckets_builder, G_VARIANT_TYPE ("at"));
+        for (guint j = 0; j < N_BUCKETS; j++)
+            g_variant_builder_add (&buckets_builder, "t", histogram->buckets[j]);
+
+        g_variant_builder_add (&builder, "(stdadat)",
+                               phase_names[i],
+                               histogram->count,
+                               histogram->sum / (gdouble) G_USEC_PER_SEC,
+                               &bounds_builder,
+                               &buckets_builder);
+    }
+
+    return g_variant_builder_end (&builder);
+}
+
+static void
+timing_stats_init (TimingStats *stats)
+{
+    stats->priv = G_TYPE_INSTANCE_GET_PRIVATE (stats, TIMING_STATS_TYPE, TimingStatsPrivate);
+}
+
+static void
+timing_stats_class_init (TimingStatsClass *klass)
+{
+    g_type_class_add_private (klass, sizeof (TimingStatsPrivate));
+}
@@ -0,0 +1,66 @@
+/*
+ * Copyright (C) 2026 LightDM contributors.
+ *
+ * This program is free software: you can redistribute it and/or modify it under
+ * the terms of the GNU General Public License as published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option) any later
+ * version. See http://www.gnu.org/copyleft/gpl.html the full text of the
+ * license.
+ */
+
+#ifndef TIMING_STATS_H_
+#define TIMING_STATS_H_
+
+#include <glib-object.h>
+
+typedef struct TimingStats TimingStats;
+
+G_BEGIN_DECLS
+
+#define TIMING_STATS_TYPE (timing_stats_get_type())
+#define TIMING_STATS(obj) (G_TYPE_CHECK_INSTANCE_CAST ((obj), TIMING_STATS_TYPE, TimingStats))
+
+typedef enum
+{
+    TIMING_PHASE_DISPLAY_SERVER_START,
+    TIMING_PHASE_GREETER_START,
+    TIMING_PHASE_GREETER_CONNECT,
+    TIMING_PHASE_PAM_START,
+    TIMING_PHASE_PAM_AUTHENTICATE,
+    TIMING_PHASE_PAM_ACCT_MGMT,
+    TIMING_PHASE_PAM_OPEN_SESSION,
+    TIMING_PHASE_SESSION_EXEC,
+    TIMING_PHASE_SESSION_STOP,
+    TIMING_PHASE_COUNT
+} TimingPhase;
+
+typedef struct TimingStatsPrivate TimingStatsPrivate;
+
+struct TimingStats
+{
+    GObject             parent_instance;
+    TimingStatsPrivate *priv;
+};
+
+typedef struct
+{
+    GObjectClass parent_class;
+} TimingStatsClass;
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (TimingStats, g_object_unref)
+
+GType timing_stats_get_type (void);
+
+TimingStats *timing_stats_get_instance (void);
+
+TimingStats *timing_stats_new (void);
+
+void timing_stats_add (TimingStats *stats, TimingPhase phase, gint64 duration);
+
+void timing_stats_add_since (TimingStats *stats, TimingPhase phase, gint64 start_time);
+
+GVariant *timing_stats_to_variant (TimingStats *stats);
+
+G_END_DECLS
+
+#endif /* TIMING_STATS_H_ */
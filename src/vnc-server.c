@@ -9,6 +9,8 @@
  * license.
  */
 
+#include <sys/socket.h>
+#include <netinet/in.h>
 #include <gio/gio.h>
 
 #include "vnc-server.h"
@@ -19,6 +21,9 @@ enum {
 };
 static guint signals[LAST_SIGNAL] = { 0 };
 
+/* Maximum connections to accept before letting other sources run */
+#define MAX_ACCEPTS_PER_WAKEUP 64
+
 struct VNCServerPrivate
 {
     /* Port to listen on */
@@ -27,8 +32,18 @@ struct VNCServerPrivate
     /* Address to listen on */
     gchar *listen_address;
 
+    /* Number of connections the kernel queues before they are accepted */
+    gint listen_backlog;
+
+    /* TRUE if other processes can listen on the same port */
+    gboolean reuse_port;
+
     /* Listening sockets */
     GSocket *socket, *socket6;
+    GSource *source, *source6;
+
+    /* Cancellable for resolving the listen address */
+    GCancellable *cancellable;
 };
 
 G_DEFINE_TYPE (VNCServer, vnc_server, G_TYPE_OBJECT)
@@ -69,19 +84,42 @@ vnc_server_get_listen_address (VNCServer *server)
     return server->priv->listen_address;
 }
 
+void
+vnc_server_set_listen_backlog (VNCServer *server, gint backlog)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->listen_backlog = backlog;
+}
+
+void
+vnc_server_set_reuse_port (VNCServer *server, gboolean reuse_port)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->reuse_port = reuse_port;
+}
+
 static gboolean
 read_cb (GSocket *socket, GIOCondition condition, VNCServer *server)
 {
-    g_autoptr(GError) error = NULL;
-    g_autoptr(GSocket) client_socket = g_socket_accept (socket, NULL, &error);
-    if (error)
-        g_warning ("Failed to get connection from from VNC socket: %s", error->message);
-
-    if (client_socket)
+    /* Take all the waiting connections, so a burst of clients isn't handled one per main loop iteration */
+    for (int i = 0; i < MAX_ACCEPTS_PER_WAKEUP; i++)
     {
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GSocket) client_socket = g_socket_accept (socket, NULL, &error);
+        if (!client_socket)
+        {
+            if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+                g_warning ("Failed to get connection from from VNC socket: %s", error->message);
+            break;
+        }
+
         GInetSocketAddress *address = G_INET_SOCKET_ADDRESS (g_socket_get_remote_address (client_socket, NULL));
-        g_autofree gchar *hostname = g_inet_address_to_string (g_inet_socket_address_get_address (address));
-        g_debug ("Got VNC connection from %s:%d", hostname, g_inet_socket_address_get_port (address));
+        if (address)
+        {
+            g_autofree gchar *hostname = g_inet_address_to_string (g_inet_socket_address_get_address (address));
+            g_debug ("Got VNC connection from %s:%d", hostname, g_inet_socket_address_get_port (address));
+            g_object_unref (address);
+        }
 
         g_signal_emit (server, signals[NEW_CONNECTION], 0, client_socket);
     }
@@ -90,23 +128,35 @@ read_cb (GSocket *socket, GIOCondition condition, VNCServer *server)
 }
 
 static GSocket *
-open_tcp_socket (GSocketFamily family, guint port, const gchar *listen_address, GError **error)
+open_tcp_socket (VNCServer *server, GSocketFamily family, GInetAddress *listen_address, GError **error)
 {
     g_autoptr(GSocket) socket = g_socket_new (family, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, error);
     if (!socket)
         return NULL;
 
+    /* Accept until there are no more connections waiting */
+    g_socket_set_blocking (socket, FALSE);
+
+    /* Allow IPv4 and IPv6 listeners on the same port */
+    if (family == G_SOCKET_FAMILY_IPV6)
+        g_socket_set_option (socket, IPPROTO_IPV6, IPV6_V6ONLY, 1, NULL);
+
+#ifdef SO_REUSEPORT
+    if (server->priv->reuse_port && !g_socket_set_option (socket, SOL_SOCKET, SO_REUSEPORT, 1, error))
+        return NULL;
+#endif
+
+    if (server->priv->listen_backlog > 0)
+        g_socket_set_listen_backlog (socket, server->priv->listen_backlog);
+
     g_autoptr(GSocketAddress) address = NULL;
     if (listen_address)
+        address = g_inet_socket_address_new (listen_address, server->priv->port);
+    else
     {
-        GList *addresses = g_resolver_lookup_by_name (g_resolver_get_default (), listen_address, NULL, error);
-        if (!addresses)
-            return NULL;
-        address = g_inet_socket_address_new (addresses->data, port);
-        g_resolver_free_addresses (addresses);
+        g_autoptr(GInetAddress) any_address = g_inet_address_new_any (family);
+        address = g_inet_socket_address_new (any_address, server->priv->port);
     }
-    else
-        address = g_inet_socket_address_new (g_inet_address_new_any (family), port);
     if (!g_socket_bind (socket, address, TRUE, error) ||
         !g_socket_listen (socket, error))
         return NULL;
@@ -114,37 +164,88 @@ open_tcp_socket (GSocketFamily family, guint port, const gchar *listen_address,
     return g_steal_pointer (&socket);
 }
 
-gboolean
-vnc_server_start (VNCServer *server)
+static GSource *
+add_socket_source (VNCServer *server, GSocket *socket)
 {
-    g_return_val_if_fail (server != NULL, FALSE);
+    GSource *source = g_socket_create_source (socket, G_IO_IN, NULL);
+    g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
+    g_source_attach (source, NULL);
+    return source;
+}
+
+static gboolean
+open_sockets (VNCServer *server, GInetAddress *ipv4_address, GInetAddress *ipv6_address)
+{
+    /* Only listen on the address families the listen address resolved to */
+    gboolean any_address = server->priv->listen_address == NULL;
 
-    g_autoptr(GError) ipv4_error = NULL;
-    server->priv->socket = open_tcp_socket (G_SOCKET_FAMILY_IPV4, server->priv->port, server->priv->listen_address, &ipv4_error);
-    if (ipv4_error)
-        g_warning ("Failed to create IPv4 VNC socket: %s", ipv4_error->message);
+    if (any_address || ipv4_address)
+    {
+        g_autoptr(GError) ipv4_error = NULL;
+        server->priv->socket = open_tcp_socket (server, G_SOCKET_FAMILY_IPV4, ipv4_address, &ipv4_error);
+        if (ipv4_error)
+            g_warning ("Failed to create IPv4 VNC socket: %s", ipv4_error->message);
+        if (server->priv->socket)
+            server->priv->source = add_socket_source (server, server->priv->socket);
+    }
 
-    if (server->priv->socket)
+    if (any_address || ipv6_address)
     {
-        GSource *source = g_socket_create_source (server->priv->socket, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        g_autoptr(GError) ipv6_error = NULL;
+        server->priv->socket6 = open_tcp_socket (server, G_SOCKET_FAMILY_IPV6, ipv6_address, &ipv6_error);
+        if (ipv6_error)
+            g_warning ("Failed to create IPv6 VNC socket: %s", ipv6_error->message);
+        if (server->priv->socket6)
+            server->priv->source6 = add_socket_source (server, server->priv->socket6);
     }
 
-    g_autoptr(GError) ipv6_error = NULL;
-    server->priv->socket6 = open_tcp_socket (G_SOCKET_FAMILY_IPV6, server->priv->port, server->priv->listen_address, &ipv6_error);
-    if (ipv6_error)
-        g_warning ("Failed to create IPv6 VNC socket: %s", ipv6_error->message);
+    return server->priv->socket || server->priv->socket6;
+}
+
+static void
+resolve_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    VNCServer *server = data;
+
+    g_autoptr(GError) error = NULL;
+    GList *addresses = g_resolver_lookup_by_name_finish (G_RESOLVER (object), result, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+    g_clear_object (&server->priv->cancellable);
+    if (!addresses)
+    {
+        g_warning ("Failed to resolve VNC listen address %s: %s", server->priv->listen_address, error->message);
+        return;
+    }
 
-    if (server->priv->socket6)
+    /* Use the first address of each family */
+    GInetAddress *ipv4_address = NULL, *ipv6_address = NULL;
+    for (GList *link = addresses; link; link = link->next)
     {
-        GSource *source = g_socket_create_source (server->priv->socket6, G_IO_IN, NULL);
-        g_source_set_callback (source, (GSourceFunc) read_cb, server, NULL);
-        g_source_attach (source, NULL);
+        GInetAddress *address = link->data;
+        if (g_inet_address_get_family (address) == G_SOCKET_FAMILY_IPV4 && !ipv4_address)
+            ipv4_address = address;
+        else if (g_inet_address_get_family (address) == G_SOCKET_FAMILY_IPV6 && !ipv6_address)
+            ipv6_address = address;
     }
 
-    if (!server->priv->socket && !server->priv->socket6)
-        return FALSE;
+    if (!open_sockets (server, ipv4_address, ipv6_address))
+        g_warning ("Failed to listen for VNC connections on %s", server->priv->listen_address);
+    g_resolver_free_addresses (addresses);
+}
+
+gboolean
+vnc_server_start (VNCServer *server)
+{
+    g_return_val_if_fail (server != NULL, FALSE);
+
+    if (!server->priv->listen_address)
+        return open_sockets (server, NULL, NULL);
+
+    /* Resolve without blocking the daemon, sockets are opened when done */
+    g_autoptr(GResolver) resolver = g_resolver_get_default ();
+    server->priv->cancellable = g_cancellable_new ();
+    g_resolver_lookup_by_name_async (resolver, server->priv->listen_address, server->priv->cancellable, resolve_cb, server);
 
     return TRUE;
 }
@@ -161,7 +262,16 @@ vnc_server_finalize (GObject *object)
 {
     VNCServer *self = VNC_SERVER (object);
 
+    if (self->priv->cancellable)
+        g_cancellable_cancel (self->priv->cancellable);
+    g_clear_object (&self->priv->cancellable);
     g_clear_pointer (&self->priv->listen_address, g_free);
+    if (self->priv->source)
+        g_source_destroy (self->priv->source);
+    g_clear_pointer (&self->priv->source, g_source_unref);
+    if (self->priv->source6)
+        g_source_destroy (self->priv->source6);
+    g_clear_pointer (&self->priv->source6, g_source_unref);
     g_clear_object (&self->priv->socket);
     g_clear_object (&self->priv->socket6);
 
@@ -48,6 +48,10 @@ void vnc_server_set_listen_address (VNCServer *server, const gchar *listen_addre
 
 const gchar *vnc_server_get_listen_address (VNCServer *server);
 
+void vnc_server_set_listen_backlog (VNCServer *server, gint backlog);
+
+void vnc_server_set_reuse_port (VNCServer *server, gboolean reuse_port);
+
 gboolean vnc_server_start (VNCServer *server);
 
 G_END_DECLS
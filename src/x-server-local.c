@@ -15,7 +15,15 @@
 #include <sys/stat.h>
 #include <errno.h>
 #include <glib/gstdio.h>
+#include <glib-unix.h>
+#include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
 #include <stdlib.h>
+#include <unistd.h>
+#include <signal.h>
+#ifdef __linux__
+#include <sys/inotify.h>
+#endif
 
 #include "x-server-local.h"
 #include "configuration.h"
@@ -75,7 +83,29 @@ G_DEFINE_TYPE_WITH_CODE (XServerLocal, x_server_local, X_SERVER_TYPE,
 
 static gchar *version = NULL;
 static guint version_major = 0, version_minor = 0;
-static GList *display_numbers = NULL;
+static gboolean probing_version = FALSE;
+
+/* Highest display number tracked in the bitmaps, X uses TCP port 6000 + display number */
+#define MAX_DISPLAY_NUMBER 59535
+#define DISPLAY_BITMAP_WORDS ((MAX_DISPLAY_NUMBER + 32) / 32)
+
+/* Display numbers reserved for X servers we run */
+static guint32 reserved_displays[DISPLAY_BITMAP_WORDS];
+
+/* Display numbers with a /tmp/.X%d-lock file */
+static guint32 locked_displays[DISPLAY_BITMAP_WORDS];
+
+/* Display numbers with a /tmp/.X11-unix/X%d socket */
+static guint32 socket_displays[DISPLAY_BITMAP_WORDS];
+
+/* Process IDs read from lock files, keyed by display number */
+static GHashTable *lock_pids = NULL;
+
+/* inotify watch keeping the lock and socket bitmaps up to date, -1 if not available */
+static int display_watch_fd = -1;
+static int lock_dir_wd = -1;
+static int socket_dir_wd = -1;
+static gboolean display_watch_started = FALSE;
 
 #define XORG_VERSION_PREFIX "X.Org X Server "
 
@@ -88,28 +118,169 @@ find_version (const gchar *line)
     return g_strdup (line + strlen (XORG_VERSION_PREFIX));
 }
 
+static void
+set_version (const gchar *value)
+{
+    g_free (version);
+    version = g_strdup (value);
+
+    g_auto(GStrv) tokens = g_strsplit (version ? version : "", ".", 3);
+    guint n_tokens = g_strv_length (tokens);
+    version_major = n_tokens > 0 ? atoi (tokens[0]) : 0;
+    version_minor = n_tokens > 1 ? atoi (tokens[1]) : 0;
+}
+
+static void
+set_version_from_output (const gchar *stderr_text)
+{
+    g_autofree gchar *value = NULL;
+    g_auto(GStrv) lines = g_strsplit (stderr_text, "\n", -1);
+    for (int i = 0; lines[i] && !value; i++)
+        value = find_version (lines[i]);
+    set_version (value);
+}
+
+static gchar *
+get_version_cache_path (void)
+{
+    g_autofree gchar *cache_dir = config_get_string (config_get_instance (), "LightDM", "cache-directory");
+    if (!cache_dir)
+        return NULL;
+    return g_build_filename (cache_dir, "xorg-version", NULL);
+}
+
+/* Get the values that change when the X server is replaced */
+static gboolean
+get_x_binary_info (gchar **path, guint64 *inode, gint64 *mtime)
+{
+    *path = g_find_program_in_path ("X");
+    if (!*path)
+        return FALSE;
+
+    GStatBuf info;
+    if (g_stat (*path, &info) < 0)
+    {
+        g_clear_pointer (path, g_free);
+        return FALSE;
+    }
+    *inode = info.st_ino;
+    *mtime = info.st_mtime;
+
+    return TRUE;
+}
+
+static gboolean
+load_version_cache (void)
+{
+    g_autofree gchar *cache_path = get_version_cache_path ();
+    g_autoptr(GKeyFile) cache = g_key_file_new ();
+    if (!cache_path || !g_key_file_load_from_file (cache, cache_path, G_KEY_FILE_NONE, NULL))
+        return FALSE;
+
+    g_autofree gchar *path = NULL;
+    guint64 inode;
+    gint64 mtime;
+    if (!get_x_binary_info (&path, &inode, &mtime))
+        return FALSE;
+
+    g_autofree gchar *cache_binary = g_key_file_get_string (cache, "X", "path", NULL);
+    g_autofree gchar *cache_version = g_key_file_get_string (cache, "X", "version", NULL);
+    if (g_strcmp0 (cache_binary, path) != 0 ||
+        g_key_file_get_uint64 (cache, "X", "inode", NULL) != inode ||
+        g_key_file_get_int64 (cache, "X", "mtime", NULL) != mtime ||
+        !cache_version)
+        return FALSE;
+
+    g_debug ("Using cached X server version %s", cache_version);
+    set_version (cache_version);
+
+    return TRUE;
+}
+
+static void
+save_version_cache (void)
+{
+    g_autofree gchar *path = NULL;
+    guint64 inode;
+    gint64 mtime;
+    g_autofree gchar *cache_path = get_version_cache_path ();
+    if (!version || !cache_path || !get_x_binary_info (&path, &inode, &mtime))
+        return;
+
+    g_autoptr(GKeyFile) cache = g_key_file_new ();
+    g_key_file_set_string (cache, "X", "path", path);
+    g_key_file_set_uint64 (cache, "X", "inode", inode);
+    g_key_file_set_int64 (cache, "X", "mtime", mtime);
+    g_key_file_set_string (cache, "X", "version", version);
+
+    /* Not being able to write the cache just means the version is probed again next time */
+    g_autoptr(GError) error = NULL;
+    if (!g_key_file_save_to_file (cache, cache_path, &error))
+        g_debug ("Failed to write X server version cache %s: %s", cache_path, error->message);
+}
+
+static void
+version_probe_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    GSubprocess *subprocess = G_SUBPROCESS (object);
+
+    probing_version = FALSE;
+
+    g_autofree gchar *stderr_text = NULL;
+    g_autoptr(GError) error = NULL;
+    if (!g_subprocess_communicate_utf8_finish (subprocess, result, NULL, &stderr_text, &error))
+    {
+        g_debug ("Failed to get X server version: %s", error->message);
+        return;
+    }
+
+    /* Already found if a seat needed it before the probe finished */
+    if (version || !g_subprocess_get_successful (subprocess))
+        return;
+
+    set_version_from_output (stderr_text);
+    if (version)
+    {
+        g_debug ("Got X server version %s", version);
+        save_version_cache ();
+    }
+}
+
+void
+x_server_local_probe_version (void)
+{
+    if (version || probing_version || load_version_cache ())
+        return;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GSubprocess) subprocess = g_subprocess_new (G_SUBPROCESS_FLAGS_STDOUT_SILENCE | G_SUBPROCESS_FLAGS_STDERR_PIPE, &error, "X", "-version", NULL);
+    if (!subprocess)
+    {
+        g_debug ("Failed to run X to get version: %s", error->message);
+        return;
+    }
+
+    probing_version = TRUE;
+    g_subprocess_communicate_utf8_async (subprocess, NULL, NULL, version_probe_cb, NULL);
+}
+
 const gchar *
 x_server_local_get_version (void)
 {
-    if (version)
+    if (version || load_version_cache ())
         return version;
 
+    /* Only reached if needed before x_server_local_probe_version () completed */
     g_autofree gchar *stderr_text = NULL;
     gint exit_status;
     if (!g_spawn_command_line_sync ("X -version", NULL, &stderr_text, &exit_status, NULL))
         return NULL;
     if (exit_status == EXIT_SUCCESS)
     {
-        g_auto(GStrv) lines = g_strsplit (stderr_text, "\n", -1);
-        for (int i = 0; lines[i] && !version; i++)
-            version = find_version (lines[i]);
+        set_version_from_output (stderr_text);
+        save_version_cache ();
     }
 
-    g_auto(GStrv) tokens = g_strsplit (version, ".", 3);
-    guint n_tokens = g_strv_length (tokens);
-    version_major = n_tokens > 0 ? atoi (tokens[0]) : 0;
-    version_minor = n_tokens > 1 ? atoi (tokens[1]) : 0;
-
     return version;
 }
 
@@ -123,43 +294,307 @@ x_server_local_version_compare (guint major, guint minor)
         return version_major - major;
 }
 
+static gboolean
+bitmap_get (const guint32 *bitmap, guint number)
+{
+    return number <= MAX_DISPLAY_NUMBER && (bitmap[number / 32] & (1u << (number % 32))) != 0;
+}
+
+static void
+bitmap_set (guint32 *bitmap, guint number, gboolean value)
+{
+    if (number > MAX_DISPLAY_NUMBER)
+        return;
+    if (value)
+        bitmap[number / 32] |= 1u << (number % 32);
+    else
+        bitmap[number / 32] &= ~(1u << (number % 32));
+}
+
+/* Get the first number from minimum that isn't set, skipping whole words at a time */
+static guint
+bitmap_find_clear (const guint32 *bitmap, guint minimum)
+{
+    guint number = minimum;
+    while (number <= MAX_DISPLAY_NUMBER)
+    {
+        guint32 word = bitmap[number / 32] | ((1u << (number % 32)) - 1);
+        if (word != G_MAXUINT32)
+            return (number / 32) * 32 + g_bit_nth_lsf (~word, -1);
+        number = (number / 32 + 1) * 32;
+    }
+
+    return number;
+}
+
+static gboolean
+parse_display_number (const gchar *text, gsize length, guint *number)
+{
+    if (length == 0 || length > 5)
+        return FALSE;
+
+    guint value = 0;
+    for (gsize i = 0; i < length; i++)
+    {
+        if (!g_ascii_isdigit (text[i]))
+            return FALSE;
+        value = value * 10 + g_ascii_digit_value (text[i]);
+    }
+    if (value > MAX_DISPLAY_NUMBER)
+        return FALSE;
+
+    *number = value;
+    return TRUE;
+}
+
+/* Get the display number from a lock file name of the form .X%d-lock */
+static gboolean
+parse_lock_name (const gchar *name, guint *number)
+{
+    if (!g_str_has_prefix (name, ".X") || !g_str_has_suffix (name, "-lock"))
+        return FALSE;
+    gsize length = strlen (name);
+    if (length < strlen (".X-lock"))
+        return FALSE;
+    return parse_display_number (name + strlen (".X"), length - strlen (".X-lock"), number);
+}
+
+/* Get the display number from a socket name of the form X%d */
+static gboolean
+parse_socket_name (const gchar *name, guint *number)
+{
+    if (name[0] != 'X')
+        return FALSE;
+    return parse_display_number (name + 1, strlen (name) - 1, number);
+}
+
+static void
+set_display_locked (guint number, gboolean locked)
+{
+    bitmap_set (locked_displays, number, locked);
+
+    /* Lock file has changed, so read it again when needed */
+    g_hash_table_remove (lock_pids, GUINT_TO_POINTER (number));
+}
+
+static void
+scan_lock_files (void)
+{
+    memset (locked_displays, 0, sizeof (locked_displays));
+    g_hash_table_remove_all (lock_pids);
+
+    g_autoptr(GDir) dir = g_dir_open ("/tmp", 0, NULL);
+    if (!dir)
+        return;
+    const gchar *name;
+    while ((name = g_dir_read_name (dir)))
+    {
+        guint number;
+        if (parse_lock_name (name, &number))
+            bitmap_set (locked_displays, number, TRUE);
+    }
+}
+
+static void
+scan_sockets (void)
+{
+    memset (socket_displays, 0, sizeof (socket_displays));
+
+    g_autoptr(GDir) dir = g_dir_open ("/tmp/.X11-unix", 0, NULL);
+    if (!dir)
+        return;
+    const gchar *name;
+    while ((name = g_dir_read_name (dir)))
+    {
+        guint number;
+        if (parse_socket_name (name, &number))
+            bitmap_set (socket_displays, number, TRUE);
+    }
+}
+
+#ifdef __linux__
+static void
+watch_sockets (void)
+{
+    socket_dir_wd = inotify_add_watch (display_watch_fd, "/tmp/.X11-unix", IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    scan_sockets ();
+}
+
+static gboolean
+display_watch_cb (gint fd, GIOCondition condition, gpointer data)
+{
+    gchar buffer[4096] __attribute__ ((aligned (__alignof__ (struct inotify_event))));
+    ssize_t n_read;
+    while ((n_read = read (fd, buffer, sizeof (buffer))) > 0)
+    {
+        for (gchar *p = buffer; p < buffer + n_read; )
+        {
+            const struct inotify_event *event = (const struct inotify_event *) p;
+            p += sizeof (struct inotify_event) + event->len;
+
+            /* Missed events, so start again */
+            if (event->mask & IN_Q_OVERFLOW)
+            {
+                scan_lock_files ();
+                scan_sockets ();
+                continue;
+            }
+
+            if (event->wd == socket_dir_wd && (event->mask & IN_IGNORED))
+            {
+                socket_dir_wd = -1;
+                memset (socket_displays, 0, sizeof (socket_displays));
+                continue;
+            }
+
+            if (event->len == 0)
+                continue;
+
+            gboolean present = (event->mask & (IN_CREATE | IN_MOVED_TO)) != 0;
+            guint number;
+            if (event->wd == lock_dir_wd && (event->mask & IN_ISDIR) && strcmp (event->name, ".X11-unix") == 0)
+            {
+                if (present && socket_dir_wd < 0)
+                    watch_sockets ();
+            }
+            else if (event->wd == lock_dir_wd && parse_lock_name (event->name, &number))
+                set_display_locked (number, present);
+            else if (event->wd == socket_dir_wd && parse_socket_name (event->name, &number))
+                bitmap_set (socket_displays, number, present);
+        }
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+#endif
+
+static void
+start_display_watch (void)
+{
+    if (display_watch_started)
+        return;
+    display_watch_started = TRUE;
+
+    lock_pids = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+#ifdef __linux__
+    /* Watch before scanning so no changes are missed */
+    display_watch_fd = inotify_init1 (IN_NONBLOCK | IN_CLOEXEC);
+    if (display_watch_fd >= 0)
+        lock_dir_wd = inotify_add_watch (display_watch_fd, "/tmp", IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    if (lock_dir_wd < 0)
+    {
+        g_debug ("Failed to watch for X server lock files, checking lock files directly: %s", g_strerror (errno));
+        if (display_watch_fd >= 0)
+            close (display_watch_fd);
+        display_watch_fd = -1;
+        return;
+    }
+    g_unix_fd_add (display_watch_fd, G_IO_IN, display_watch_cb, NULL);
+
+    scan_lock_files ();
+    watch_sockets ();
+#endif
+}
+
+/* Check if the process holding a display lock is still running */
+static gboolean
+lock_is_valid (guint display_number)
+{
+    gpointer value;
+    if (!g_hash_table_lookup_extended (lock_pids, GUINT_TO_POINTER (display_number), NULL, &value))
+    {
+        g_autofree gchar *path = g_strdup_printf ("/tmp/.X%d-lock", display_number);
+        g_autofree gchar *data = NULL;
+        if (!g_file_get_contents (path, &data, NULL, NULL))
+            return g_file_test (path, G_FILE_TEST_EXISTS);
+        value = GINT_TO_POINTER (atoi (g_strstrip (data)));
+
+        /* The lock file may not have been written yet, so only remember complete ones */
+        if (GPOINTER_TO_INT (value) != 0)
+            g_hash_table_insert (lock_pids, GUINT_TO_POINTER (display_number), value);
+    }
+
+    /* Ignore the lock if the contents are invalid or the process doesn't exist */
+    int pid = GPOINTER_TO_INT (value);
+    errno = 0;
+    if (pid < 0 || (kill (pid, 0) < 0 && errno == ESRCH))
+        return FALSE;
+
+    return TRUE;
+}
+
+/* Check if an X server is accepting connections on a display socket, one
+ * that crashed or was killed can leave its socket behind */
+static gboolean
+socket_is_valid (guint display_number)
+{
+    g_autoptr(GSocket) socket = g_socket_new (G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, NULL);
+    if (!socket)
+        return TRUE;
+    g_socket_set_blocking (socket, FALSE);
+
+    g_autofree gchar *path = g_strdup_printf ("/tmp/.X11-unix/X%d", display_number);
+    g_autoptr(GSocketAddress) address = g_unix_socket_address_new (path);
+    g_autoptr(GError) error = NULL;
+    if (g_socket_connect (socket, address, NULL, &error))
+        return TRUE;
+
+    /* Nothing is listening, or the socket has been removed since we were notified */
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CONNECTION_REFUSED) ||
+        g_error_matches (error, G_IO_ERROR, G_IO_ERROR_NOT_FOUND))
+        return FALSE;
+
+    /* Otherwise the server is busy (e.g. a full backlog) or we can't tell, so assume it is in use */
+    return TRUE;
+}
+
 static gboolean
 display_number_in_use (guint display_number)
 {
     /* See if we know we are managing a server with that number */
-    for (GList *link = display_numbers; link; link = link->next)
+    if (bitmap_get (reserved_displays, display_number))
+        return TRUE;
+
+    /* Without the watch see if an X server that we don't know of has a lock on that number */
+    if (display_watch_fd < 0 || display_number > MAX_DISPLAY_NUMBER)
     {
-        guint number = GPOINTER_TO_UINT (link->data);
-        if (number == display_number)
-            return TRUE;
+        g_autofree gchar *path = g_strdup_printf ("/tmp/.X%d-lock", display_number);
+        return g_file_test (path, G_FILE_TEST_EXISTS) && lock_is_valid (display_number);
     }
 
-    /* See if an X server that we don't know of has a lock on that number */
-    g_autofree gchar *path = g_strdup_printf ("/tmp/.X%d-lock", display_number);
-    gboolean in_use = g_file_test (path, G_FILE_TEST_EXISTS);
+    if (bitmap_get (locked_displays, display_number))
+        return lock_is_valid (display_number);
+    if (bitmap_get (socket_displays, display_number))
+        return socket_is_valid (display_number);
 
-    /* See if that lock file is valid, ignore it if the contents are invalid or the process doesn't exist */
-    g_autofree gchar *data = NULL;
-    if (in_use && g_file_get_contents (path, &data, NULL, NULL))
+    /* Check for a lock created since the last notification was processed */
+    g_autofree gchar *path = g_strdup_printf ("/tmp/.X%d-lock", display_number);
+    if (g_file_test (path, G_FILE_TEST_EXISTS))
     {
-        int pid = atoi (g_strstrip (data));
-
-        errno = 0;
-        if (pid < 0 || (kill (pid, 0) < 0 && errno == ESRCH))
-            in_use = FALSE;
+        set_display_locked (display_number, TRUE);
+        return lock_is_valid (display_number);
     }
 
-    return in_use;
+    return FALSE;
 }
 
 guint
 x_server_local_get_unused_display_number (void)
 {
+    start_display_watch ();
+
     guint number = config_get_integer (config_get_instance (), "LightDM", "minimum-display-number");
-    while (display_number_in_use (number))
+    while (TRUE)
+    {
+        number = bitmap_find_clear (reserved_displays, number);
+        if (!display_number_in_use (number))
+            break;
         number++;
+    }
 
-    display_numbers = g_list_append (display_numbers, GUINT_TO_POINTER (number));
+    /* Reserved immediately so seats created before this X server starts get a different number */
+    bitmap_set (reserved_displays, number, TRUE);
 
     return number;
 }
@@ -167,15 +602,7 @@ x_server_local_get_unused_display_number (void)
 void
 x_server_local_release_display_number (guint display_number)
 {
-    for (GList *link = display_numbers; link; link = link->next)
-    {
-        guint number = GPOINTER_TO_UINT (link->data);
-        if (number == display_number)
-        {
-            display_numbers = g_list_delete_link (display_numbers, link);
-            return;
-        }
-    }
+    bitmap_set (reserved_displays, display_number, FALSE);
 }
 
 XServerLocal *
@@ -42,6 +42,8 @@ typedef struct
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (XServerLocal, g_object_unref)
 
+void x_server_local_probe_version (void);
+
 const gchar *x_server_local_get_version (void);
 
 gint x_server_local_version_compare (guint major, guint minor);
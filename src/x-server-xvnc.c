@@ -25,6 +25,9 @@ struct XServerXVNCPrivate
     /* File descriptor to use for standard input */
     gint socket_fd;
 
+    /* Socket to listen for VNC connections on instead of using standard input */
+    gchar *socket_path;
+
     /* Geometry and colour depth */
     gint width, height, depth;
 };
@@ -54,6 +57,21 @@ x_server_xvnc_get_socket (XServerXVNC *server)
     return server->priv->socket_fd;
 }
 
+void
+x_server_xvnc_set_socket_path (XServerXVNC *server, const gchar *path)
+{
+    g_return_if_fail (server != NULL);
+    g_free (server->priv->socket_path);
+    server->priv->socket_path = g_strdup (path);
+}
+
+const gchar *
+x_server_xvnc_get_socket_path (XServerXVNC *server)
+{
+    g_return_val_if_fail (server != NULL, NULL);
+    return server->priv->socket_path;
+}
+
 void
 x_server_xvnc_set_geometry (XServerXVNC *server, gint width, gint height)
 {
@@ -75,9 +93,17 @@ x_server_xvnc_run (Process *process, gpointer user_data)
     XServerXVNC *server = user_data;
 
     /* Connect input */
-    dup2 (server->priv->socket_fd, STDIN_FILENO);
-    dup2 (server->priv->socket_fd, STDOUT_FILENO);
-    close (server->priv->socket_fd);
+    if (server->priv->socket_fd >= 0)
+    {
+        dup2 (server->priv->socket_fd, STDIN_FILENO);
+        dup2 (server->priv->socket_fd, STDOUT_FILENO);
+        close (server->priv->socket_fd);
+
+        /* GSocket always makes the connection non-blocking, but Xvnc expects blocking IO in inetd mode */
+        int flags = fcntl (STDIN_FILENO, F_GETFL);
+        if (flags >= 0)
+            fcntl (STDIN_FILENO, F_SETFL, flags & ~O_NONBLOCK);
+    }
 
     /* Set SIGUSR1 to ignore so the X server can indicate it when it is ready */
     signal (SIGUSR1, SIG_IGN);
@@ -106,7 +132,11 @@ x_server_xvnc_add_args (XServerLocal *x_server, GString *command)
 {
     XServerXVNC *server = X_SERVER_XVNC (x_server);
 
-    g_string_append (command, " -inetd");
+    /* Listening on a socket keeps the server running when the client disconnects */
+    if (server->priv->socket_path)
+        g_string_append_printf (command, " -rfbunixpath %s -rfbport -1", server->priv->socket_path);
+    else
+        g_string_append (command, " -inetd");
 
     if (server->priv->width > 0 && server->priv->height > 0)
         g_string_append_printf (command, " -geometry %dx%d", server->priv->width, server->priv->height);
@@ -119,14 +149,26 @@ static void
 x_server_xvnc_init (XServerXVNC *server)
 {
     server->priv = G_TYPE_INSTANCE_GET_PRIVATE (server, X_SERVER_XVNC_TYPE, XServerXVNCPrivate);
+    server->priv->socket_fd = -1;
     server->priv->width = 1024;
     server->priv->height = 768;
     server->priv->depth = 8;
 }
 
+static void
+x_server_xvnc_finalize (GObject *object)
+{
+    XServerXVNC *self = X_SERVER_XVNC (object);
+
+    g_clear_pointer (&self->priv->socket_path, g_free);
+
+    G_OBJECT_CLASS (x_server_xvnc_parent_class)->finalize (object);
+}
+
 static void
 x_server_xvnc_class_init (XServerXVNCClass *klass)
 {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
     XServerLocalClass *x_server_local_class = X_SERVER_LOCAL_CLASS (klass);
     DisplayServerClass *display_server_class = DISPLAY_SERVER_CLASS (klass);
 
@@ -134,6 +176,7 @@ x_server_xvnc_class_init (XServerXVNCClass *klass)
     x_server_local_class->get_log_stdout = x_server_xvnc_get_log_stdout;
     x_server_local_class->add_args = x_server_xvnc_add_args;
     display_server_class->get_can_share = x_server_xvnc_get_can_share;
+    object_class->finalize = x_server_xvnc_finalize;
 
     g_type_class_add_private (klass, sizeof (XServerXVNCPrivate));
 }
@@ -47,6 +47,10 @@ void x_server_xvnc_set_socket (XServerXVNC *server, int fd);
 
 int x_server_xvnc_get_socket (XServerXVNC *server);
 
+void x_server_xvnc_set_socket_path (XServerXVNC *server, const gchar *path);
+
+const gchar *x_server_xvnc_get_socket_path (XServerXVNC *server);
+
 void x_server_xvnc_set_geometry (XServerXVNC *server, gint width, gint height);
 
 void x_server_xvnc_set_depth (XServerXVNC *server, gint depth);
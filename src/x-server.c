@@ -10,8 +10,11 @@
  */
 
 #include <config.h>
+#include <stdlib.h>
 #include <string.h>
 #include <xcb/xcb.h>
+#include <xcb/xcbext.h>
+#include <glib-unix.h>
 
 #include "x-server.h"
 #include "configuration.h"
@@ -29,6 +32,13 @@ struct XServerPrivate
 
     /* Connection to this X server */
     xcb_connection_t *connection;
+
+    /* Request being used to check the server is responding */
+    guint check_sequence;
+    guint check_watch;
+    guint check_timeout;
+    XServerCheckCallback check_callback;
+    gpointer check_data;
 };
 
 G_DEFINE_TYPE (XServer, x_server, DISPLAY_SERVER_TYPE)
@@ -90,6 +100,90 @@ x_server_get_authority (XServer *server)
     return server->priv->authority;
 }
 
+static void
+finish_check (XServer *server, gboolean responding)
+{
+    if (server->priv->check_watch)
+        g_source_remove (server->priv->check_watch);
+    server->priv->check_watch = 0;
+    if (server->priv->check_timeout)
+        g_source_remove (server->priv->check_timeout);
+    server->priv->check_timeout = 0;
+
+    XServerCheckCallback callback = server->priv->check_callback;
+    gpointer data = server->priv->check_data;
+    server->priv->check_callback = NULL;
+    server->priv->check_data = NULL;
+    callback (server, responding, data);
+}
+
+static gboolean
+check_read_cb (gint fd, GIOCondition condition, gpointer data)
+{
+    XServer *server = data;
+
+    /* Check first, as a failed connection is reported as having a reply */
+    if (xcb_connection_has_error (server->priv->connection))
+    {
+        l_debug (server, "Connection to X server lost");
+        server->priv->check_watch = 0;
+        finish_check (server, FALSE);
+        return G_SOURCE_REMOVE;
+    }
+
+    void *reply = NULL;
+    xcb_generic_error_t *error = NULL;
+    if (xcb_poll_for_reply (server->priv->connection, server->priv->check_sequence, &reply, &error))
+    {
+        /* An error reply still shows the server is there, but no reply at all means the request was lost */
+        gboolean responding = reply != NULL || error != NULL;
+        if (!responding)
+            l_debug (server, "X server check got no reply");
+        free (reply);
+        free (error);
+        server->priv->check_watch = 0;
+        finish_check (server, responding);
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+check_timeout_cb (gpointer data)
+{
+    XServer *server = data;
+
+    l_debug (server, "X server did not respond");
+    server->priv->check_timeout = 0;
+    finish_check (server, FALSE);
+
+    return G_SOURCE_REMOVE;
+}
+
+void
+x_server_check_responding (XServer *server, guint timeout, XServerCheckCallback callback, gpointer data)
+{
+    g_return_if_fail (server != NULL);
+    g_return_if_fail (callback != NULL);
+    g_return_if_fail (server->priv->check_callback == NULL);
+
+    /* Nothing to check if not connected */
+    if (!server->priv->connection)
+    {
+        callback (server, TRUE, data);
+        return;
+    }
+
+    /* Make a round trip without blocking, as the server may be on a host that has gone away */
+    server->priv->check_callback = callback;
+    server->priv->check_data = data;
+    server->priv->check_sequence = xcb_get_input_focus (server->priv->connection).sequence;
+    xcb_flush (server->priv->connection);
+    server->priv->check_watch = g_unix_fd_add (xcb_get_file_descriptor (server->priv->connection), G_IO_IN | G_IO_HUP | G_IO_ERR, check_read_cb, server);
+    server->priv->check_timeout = g_timeout_add_seconds (timeout, check_timeout_cb, server);
+}
+
 static const gchar *
 x_server_get_session_type (DisplayServer *server)
 {
@@ -189,6 +283,10 @@ x_server_finalize (GObject *object)
     g_clear_pointer (&self->priv->hostname, g_free);
     g_clear_pointer (&self->priv->address, g_free);
     g_clear_object (&self->priv->authority);
+    if (self->priv->check_watch)
+        g_source_remove (self->priv->check_watch);
+    if (self->priv->check_timeout)
+        g_source_remove (self->priv->check_timeout);
     if (self->priv->connection)
         xcb_disconnect (self->priv->connection);
     self->priv->connection = NULL;
@@ -40,6 +40,8 @@ typedef struct
 
 G_DEFINE_AUTOPTR_CLEANUP_FUNC (XServer, g_object_unref)
 
+typedef void (*XServerCheckCallback) (XServer *server, gboolean responding, gpointer data);
+
 GType x_server_get_type (void);
 
 void x_server_set_hostname (XServer *server, const gchar *hostname);
@@ -60,6 +62,8 @@ void x_server_set_authority (XServer *server, XAuthority *authority);
 
 XAuthority *x_server_get_authority (XServer *server);
 
+void x_server_check_responding (XServer *server, guint timeout, XServerCheckCallback callback, gpointer data);
+
 G_END_DECLS
 
 #endif /* X_SERVER_H_ */
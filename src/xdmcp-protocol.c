@@ -15,13 +15,86 @@
 #include "xdmcp-protocol.h"
 #include "x-authority.h"
 
+/* Decoded packets are allocated from blocks of this size */
+#define ARENA_BLOCK_SIZE 4096
+
+struct XDMCPPacketArena
+{
+    /* Blocks of memory, the current block is first */
+    GSList *blocks;
+
+    /* Size and amount used of current block */
+    gsize block_size;
+    gsize block_used;
+};
+
 typedef struct
 {
     const guint8 *data;
     guint16 remaining;
     gboolean overflow;
+
+    /* Arena to allocate from or NULL to use the heap */
+    XDMCPPacketArena *arena;
 } PacketReader;
 
+XDMCPPacketArena *
+xdmcp_packet_arena_new (void)
+{
+    return g_malloc0 (sizeof (XDMCPPacketArena));
+}
+
+static gpointer
+arena_alloc (XDMCPPacketArena *arena, gsize size)
+{
+    /* Keep allocations aligned for any type */
+    size = (size + 15) & ~(gsize) 15;
+
+    if (!arena->blocks || arena->block_used + size > arena->block_size)
+    {
+        arena->block_size = MAX (size, ARENA_BLOCK_SIZE);
+        arena->block_used = 0;
+        arena->blocks = g_slist_prepend (arena->blocks, g_malloc (arena->block_size));
+    }
+
+    gpointer data = (guint8 *) arena->blocks->data + arena->block_used;
+    arena->block_used += size;
+
+    return data;
+}
+
+void
+xdmcp_packet_arena_reset (XDMCPPacketArena *arena)
+{
+    g_return_if_fail (arena != NULL);
+
+    /* Keep the most recent block for reuse */
+    if (arena->blocks)
+    {
+        g_slist_free_full (arena->blocks->next, g_free);
+        arena->blocks->next = NULL;
+    }
+    arena->block_used = 0;
+}
+
+void
+xdmcp_packet_arena_free (XDMCPPacketArena *arena)
+{
+    if (!arena)
+        return;
+    g_slist_free_full (arena->blocks, g_free);
+    g_free (arena);
+}
+
+static gpointer
+reader_alloc (PacketReader *reader, gsize size)
+{
+    if (reader->arena)
+        return arena_alloc (reader->arena, size);
+    else
+        return g_malloc (size);
+}
+
 static guint8
 read_card8 (PacketReader *reader)
 {
@@ -54,7 +127,7 @@ static void
 read_data (PacketReader *reader, XDMCPData *data)
 {
     data->length = read_card16 (reader);
-    data->data = g_malloc (sizeof (guint8) * data->length);
+    data->data = reader_alloc (reader, sizeof (guint8) * data->length);
     for (guint16 i = 0; i < data->length; i++)
         data->data[i] = read_card8 (reader);
 }
@@ -63,7 +136,7 @@ static gchar *
 read_string (PacketReader *reader)
 {
     guint16 length = read_card16 (reader);
-    gchar *string = g_malloc (sizeof (gchar) * (length + 1));
+    gchar *string = reader_alloc (reader, sizeof (gchar) * (length + 1));
     guint16 i;
     for (i = 0; i < length; i++)
         string[i] = (gchar) read_card8 (reader);
@@ -76,7 +149,7 @@ static gchar **
 read_string_array (PacketReader *reader)
 {
     guint8 n_strings = read_card8 (reader);
-    gchar **strings = g_malloc (sizeof (gchar *) * (n_strings + 1));
+    gchar **strings = reader_alloc (reader, sizeof (gchar *) * (n_strings + 1));
     guint8 i;
     for (i = 0; i < n_strings; i++)
         strings[i] = read_string (reader);
@@ -155,13 +228,14 @@ xdmcp_packet_alloc (XDMCPOpcode opcode)
     return packet;
 }
 
-XDMCPPacket *
-xdmcp_packet_decode (const guint8 *data, gsize data_length)
+static XDMCPPacket *
+decode_packet (const guint8 *data, gsize data_length, XDMCPPacketArena *arena)
 {
     PacketReader reader;
     reader.data = data;
     reader.remaining = data_length;
     reader.overflow = FALSE;
+    reader.arena = arena;
 
     guint16 version = read_card16 (&reader);
     guint16 opcode = read_card16 (&reader);
@@ -183,7 +257,9 @@ xdmcp_packet_decode (const guint8 *data, gsize data_length)
         return NULL;
     }
 
-    XDMCPPacket *packet = xdmcp_packet_alloc (opcode);
+    XDMCPPacket *packet = reader_alloc (&reader, sizeof (XDMCPPacket));
+    memset (packet, 0, sizeof (XDMCPPacket));
+    packet->opcode = opcode;
     gboolean failed = FALSE;
     switch (packet->opcode)
     {
@@ -209,7 +285,7 @@ xdmcp_packet_decode (const guint8 *data, gsize data_length)
     case XDMCP_Request:
         packet->Request.display_number = read_card16 (&reader);
         packet->Request.n_connections = read_card8 (&reader);
-        packet->Request.connections = g_malloc (sizeof (XDMCPConnection) * packet->Request.n_connections);
+        packet->Request.connections = reader_alloc (&reader, sizeof (XDMCPConnection) * packet->Request.n_connections);
         for (int i = 0; i < packet->Request.n_connections; i++)
             packet->Request.connections[i].type = read_card16 (&reader);
         if (read_card8 (&reader) != packet->Request.n_connections)
@@ -277,13 +353,27 @@ xdmcp_packet_decode (const guint8 *data, gsize data_length)
     }
     if (failed)
     {
-        xdmcp_packet_free (packet);
+        if (!arena)
+            xdmcp_packet_free (packet);
         return NULL;
     }
 
     return packet;
 }
 
+XDMCPPacket *
+xdmcp_packet_decode (const guint8 *data, gsize data_length)
+{
+    return decode_packet (data, data_length, NULL);
+}
+
+XDMCPPacket *
+xdmcp_packet_decode_in_arena (const guint8 *data, gsize data_length, XDMCPPacketArena *arena)
+{
+    g_return_val_if_fail (arena != NULL, NULL);
+    return decode_packet (data, data_length, arena);
+}
+
 gssize
 xdmcp_packet_encode (XDMCPPacket *packet, guint8 *data, gsize max_length)
 {
@@ -136,10 +136,22 @@ typedef struct
     };
 } XDMCPPacket;
 
+/* Memory that decoded packets can be allocated from and released together */
+typedef struct XDMCPPacketArena XDMCPPacketArena;
+
 XDMCPPacket *xdmcp_packet_alloc (XDMCPOpcode opcode);
 
 XDMCPPacket *xdmcp_packet_decode (const guchar *data, gsize length);
 
+/* Packets decoded in an arena are freed by xdmcp_packet_arena_reset(), not xdmcp_packet_free() */
+XDMCPPacket *xdmcp_packet_decode_in_arena (const guchar *data, gsize length, XDMCPPacketArena *arena);
+
+XDMCPPacketArena *xdmcp_packet_arena_new (void);
+
+void xdmcp_packet_arena_reset (XDMCPPacketArena *arena);
+
+void xdmcp_packet_arena_free (XDMCPPacketArena *arena);
+
 gssize xdmcp_packet_encode (XDMCPPacket *packet, guchar *data, gsize length);
 
 gchar *xdmcp_packet_tostring (XDMCPPacket *packet);
@@ -9,8 +9,11 @@
  * license.
  */
 
+#define _GNU_SOURCE
 #include <stdlib.h>
 #include <string.h>
+#include <errno.h>
+#include <sys/socket.h>
 #include <X11/X.h>
 #define HASXDMAUTH
 #include <X11/Xdmcp.h>
@@ -49,13 +52,130 @@ struct XDMCPServerPrivate
 
     /* Active XDMCP sessions */
     GHashTable *sessions;
+
+    /* Maximum number of packets to receive at once */
+    guint receive_batch_size;
+
+    /* Buffers to receive packets into */
+    guint8 *receive_buffers;
+
+    /* Memory received packets are decoded into */
+    XDMCPPacketArena *arena;
+
+    /* TRUE if log the contents of every packet */
+    gboolean log_packets;
+
+    /* Number of packets handled, ignored as invalid and dropped by the kernel on each socket */
+    guint64 n_packets_handled;
+    guint64 n_packets_invalid;
+    guint32 n_packets_dropped, n_packets_dropped6;
+
+    /* Queries and requests per second allowed from each address and subnet, or 0 for no limit */
+    guint address_rate;
+    guint subnet_rate;
+
+    /* Number of queries and requests allowed in a burst */
+    guint request_burst;
+
+    /* Token buckets for each address and subnet */
+    GHashTable *buckets;
+    gint64 last_prune_time;
+
+    /* Number of packets ignored due to rate limiting */
+    guint64 n_packets_limited;
+
+    /* Maximum number of sessions waiting for a Manage, or 0 for no limit */
+    guint max_pending_sessions;
+
+    /* Sessions waiting for a Manage, oldest first */
+    GQueue pending_sessions;
+
+    /* Number of sessions that have been managed and not yet ended */
+    guint n_active_sessions;
+
+    /* TRUE if report the load on this host in Willing responses */
+    gboolean report_load;
+
+    /* Load on this host and when it was last checked */
+    XDMCPLoad load;
+    gint64 load_time;
+
+    /* Other hosts to send indirect queries to if they are less loaded */
+    GList *chooser_hosts;
+
+    /* Seconds between checking the load of the other hosts */
+    guint chooser_poll_interval;
+    guint chooser_poll_timeout;
+
+    /* Cancellable for looking up the addresses of the other hosts */
+    GCancellable *chooser_cancellable;
 };
 
+typedef struct
+{
+    /* Number of running sessions */
+    guint n_sessions;
+
+    /* One minute load average */
+    gdouble load_average;
+
+    /* Available memory in MiB */
+    guint64 free_memory;
+} XDMCPLoad;
+
+typedef struct
+{
+    XDMCPServer *server;
+
+    /* Name as configured */
+    gchar *name;
+
+    /* Address to send XDMCP packets to or NULL if not yet resolved */
+    GSocketAddress *address;
+
+    /* Time the last query was sent or 0 if it has been answered */
+    gint64 query_time;
+
+    /* Load last reported by this host */
+    XDMCPLoad load;
+
+    /* Time load last reported or 0 if never */
+    gint64 load_time;
+} ChooserHost;
+
+typedef struct
+{
+    /* Requests allowed before rate limiting */
+    gdouble tokens;
+
+    /* Rate tokens are added at */
+    guint rate;
+
+    /* Time tokens last updated */
+    gint64 last_time;
+} TokenBucket;
+
 G_DEFINE_TYPE (XDMCPServer, xdmcp_server, G_TYPE_OBJECT)
 
 /* Maximum number of milliseconds client will resend manage requests before giving up */
 #define MANAGE_TIMEOUT 126000
 
+/* Largest packet accepted */
+#define MAX_PACKET_LENGTH 1024
+
+/* Limit on the number of packets received at once */
+#define MAX_RECEIVE_BATCH_SIZE 64
+
+/* Maximum number of addresses and subnets to track for rate limiting */
+#define MAX_TOKEN_BUCKETS 4096
+
+/* Buckets shared by all addresses and by all subnets that can't be tracked */
+#define ADDRESS_OVERFLOW_BUCKET_KEY "*"
+#define SUBNET_OVERFLOW_BUCKET_KEY "*/"
+
+/* Number of poll intervals without a response before a chooser host is ignored */
+#define CHOOSER_HOST_TIMEOUT_POLLS 3
+
 /* Address sort support structure */
 typedef struct
 {
@@ -131,6 +251,106 @@ xdmcp_server_get_status (XDMCPServer *server)
     return server->priv->status;
 }
 
+void
+xdmcp_server_set_receive_batch_size (XDMCPServer *server, guint size)
+{
+    g_return_if_fail (server != NULL);
+    /* The receive buffers are sized for the batch when the server starts */
+    g_return_if_fail (server->priv->receive_buffers == NULL);
+    server->priv->receive_batch_size = CLAMP (size, 1, MAX_RECEIVE_BATCH_SIZE);
+}
+
+void
+xdmcp_server_set_log_packets (XDMCPServer *server, gboolean log_packets)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->log_packets = log_packets;
+}
+
+guint64
+xdmcp_server_get_n_packets_handled (XDMCPServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return server->priv->n_packets_handled;
+}
+
+guint64
+xdmcp_server_get_n_packets_invalid (XDMCPServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return server->priv->n_packets_invalid;
+}
+
+guint64
+xdmcp_server_get_n_packets_dropped (XDMCPServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return (guint64) server->priv->n_packets_dropped + server->priv->n_packets_dropped6;
+}
+
+guint64
+xdmcp_server_get_n_packets_limited (XDMCPServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return server->priv->n_packets_limited;
+}
+
+void
+xdmcp_server_set_request_rate (XDMCPServer *server, guint address_rate, guint subnet_rate, guint burst)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->address_rate = address_rate;
+    server->priv->subnet_rate = subnet_rate;
+    server->priv->request_burst = MAX (burst, 1);
+}
+
+void
+xdmcp_server_set_max_pending_sessions (XDMCPServer *server, guint max_pending_sessions)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->max_pending_sessions = max_pending_sessions;
+}
+
+guint
+xdmcp_server_get_n_pending_sessions (XDMCPServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return g_queue_get_length (&server->priv->pending_sessions);
+}
+
+void
+xdmcp_server_set_report_load (XDMCPServer *server, gboolean report_load)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->report_load = report_load;
+}
+
+void
+xdmcp_server_add_chooser_host (XDMCPServer *server, const gchar *name)
+{
+    g_return_if_fail (server != NULL);
+    g_return_if_fail (name != NULL);
+
+    ChooserHost *host = g_malloc0 (sizeof (ChooserHost));
+    host->server = server;
+    host->name = g_strdup (name);
+    server->priv->chooser_hosts = g_list_append (server->priv->chooser_hosts, host);
+}
+
+void
+xdmcp_server_set_chooser_poll_interval (XDMCPServer *server, guint interval)
+{
+    g_return_if_fail (server != NULL);
+    server->priv->chooser_poll_interval = MAX (interval, 1);
+}
+
+guint
+xdmcp_server_get_n_active_sessions (XDMCPServer *server)
+{
+    g_return_val_if_fail (server != NULL, 0);
+    return server->priv->n_active_sessions;
+}
+
 void
 xdmcp_server_set_key (XDMCPServer *server, const gchar *key)
 {
@@ -139,19 +359,51 @@ xdmcp_server_set_key (XDMCPServer *server, const gchar *key)
     server->priv->key = g_strdup (key);
 }
 
+/* Stop waiting for a session to be managed */
+static void
+remove_pending_session (XDMCPServer *server, XDMCPSession *session)
+{
+    if (session->priv->inactive_timeout)
+        g_source_remove (session->priv->inactive_timeout);
+    session->priv->inactive_timeout = 0;
+
+    if (session->priv->pending_link)
+        g_queue_delete_link (&server->priv->pending_sessions, session->priv->pending_link);
+    session->priv->pending_link = NULL;
+}
+
 static gboolean
 session_timeout_cb (XDMCPSession *session)
 {
+    XDMCPServer *server = session->priv->server;
+
     session->priv->inactive_timeout = 0;
 
     g_debug ("Timing out unmanaged session %d", session->priv->id);
-    g_hash_table_remove (session->priv->server->priv->sessions, GINT_TO_POINTER ((gint) session->priv->id));
+    remove_pending_session (server, session);
+    g_hash_table_remove (server->priv->sessions, GINT_TO_POINTER ((gint) session->priv->id));
     return FALSE;
 }
 
+static gboolean
+have_max_pending_sessions (XDMCPServer *server)
+{
+    return server->priv->max_pending_sessions > 0 &&
+           g_queue_get_length (&server->priv->pending_sessions) >= server->priv->max_pending_sessions;
+}
+
 static XDMCPSession *
 add_session (XDMCPServer *server)
 {
+    /* Make room by dropping the session that has been waiting longest */
+    while (have_max_pending_sessions (server))
+    {
+        XDMCPSession *oldest = g_queue_peek_head (&server->priv->pending_sessions);
+        g_debug ("Dropping unmanaged session %d, too many pending sessions", oldest->priv->id);
+        remove_pending_session (server, oldest);
+        g_hash_table_remove (server->priv->sessions, GINT_TO_POINTER ((gint) oldest->priv->id));
+    }
+
     guint16 id;
     do
     {
@@ -162,6 +414,8 @@ add_session (XDMCPServer *server)
     session->priv->server = server;
     g_hash_table_insert (server->priv->sessions, GINT_TO_POINTER ((gint) id), g_object_ref (session));
     session->priv->inactive_timeout = g_timeout_add (MANAGE_TIMEOUT, (GSourceFunc) session_timeout_cb, session);
+    g_queue_push_tail (&server->priv->pending_sessions, session);
+    session->priv->pending_link = server->priv->pending_sessions.tail;
 
     return session;
 }
@@ -172,6 +426,100 @@ get_session (XDMCPServer *server, guint16 id)
     return g_hash_table_lookup (server->priv->sessions, GINT_TO_POINTER ((gint) id));
 }
 
+void
+xdmcp_server_remove_session (XDMCPServer *server, XDMCPSession *session)
+{
+    g_return_if_fail (server != NULL);
+    g_return_if_fail (session != NULL);
+
+    if (get_session (server, session->priv->id) != session)
+        return;
+
+    g_debug ("Removing XDMCP session %d", session->priv->id);
+    remove_pending_session (server, session);
+    if (session->priv->started)
+        server->priv->n_active_sessions--;
+    g_hash_table_remove (server->priv->sessions, GINT_TO_POINTER ((gint) session->priv->id));
+}
+
+/* Check the load on this host, at most once a second */
+static const XDMCPLoad *
+get_load (XDMCPServer *server)
+{
+    server->priv->load.n_sessions = server->priv->n_active_sessions;
+
+    gint64 now = g_get_monotonic_time ();
+    if (server->priv->load_time != 0 && now - server->priv->load_time < G_USEC_PER_SEC)
+        return &server->priv->load;
+    server->priv->load_time = now;
+
+    g_autofree gchar *loadavg = NULL;
+    if (g_file_get_contents ("/proc/loadavg", &loadavg, NULL, NULL))
+        server->priv->load.load_average = g_ascii_strtod (loadavg, NULL);
+
+    g_autofree gchar *meminfo = NULL;
+    if (g_file_get_contents ("/proc/meminfo", &meminfo, NULL, NULL))
+    {
+        const gchar *line = strstr (meminfo, "MemAvailable:");
+        if (line)
+            server->priv->load.free_memory = g_ascii_strtoull (line + strlen ("MemAvailable:"), NULL, 10) / 1024;
+    }
+
+    return &server->priv->load;
+}
+
+static gchar *
+load_to_string (const XDMCPLoad *load)
+{
+    gchar load_average[G_ASCII_DTOSTR_BUF_SIZE];
+    g_ascii_formatd (load_average, sizeof (load_average), "%.2f", load->load_average);
+    return g_strdup_printf ("sessions=%u load=%s free-memory=%" G_GUINT64_FORMAT "M", load->n_sessions, load_average, load->free_memory);
+}
+
+/* Get the load reported in a Willing status, returns FALSE if none reported */
+static gboolean
+parse_load (const gchar *status, XDMCPLoad *load)
+{
+    const gchar *sessions = strstr (status, "sessions=");
+    if (!sessions)
+        return FALSE;
+    load->n_sessions = g_ascii_strtoull (sessions + strlen ("sessions="), NULL, 10);
+
+    const gchar *load_average = strstr (status, "load=");
+    load->load_average = load_average ? g_ascii_strtod (load_average + strlen ("load="), NULL) : 0;
+
+    const gchar *free_memory = strstr (status, "free-memory=");
+    load->free_memory = free_memory ? g_ascii_strtoull (free_memory + strlen ("free-memory="), NULL, 10) : 0;
+
+    return TRUE;
+}
+
+/* Order hosts by how loaded they are */
+static gint
+compare_load (const XDMCPLoad *a, const XDMCPLoad *b)
+{
+    if (a->n_sessions != b->n_sessions)
+        return a->n_sessions < b->n_sessions ? -1 : 1;
+    if (a->load_average != b->load_average)
+        return a->load_average < b->load_average ? -1 : 1;
+    return 0;
+}
+
+static const gchar *
+get_willing_status (XDMCPServer *server, gchar **status)
+{
+    if (!server->priv->report_load)
+        return server->priv->status;
+
+    g_autofree gchar *load_text = load_to_string (get_load (server));
+    if (server->priv->status[0] != '\0')
+        *status = g_strdup_printf ("%s %s", server->priv->status, load_text);
+    else
+        *status = g_steal_pointer (&load_text);
+
+    return *status;
+}
+
 static gchar *
 socket_address_to_string (GSocketAddress *address)
 {
@@ -180,10 +528,15 @@ socket_address_to_string (GSocketAddress *address)
 }
 
 static void
-send_packet (GSocket *socket, GSocketAddress *address, XDMCPPacket *packet)
+send_packet (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XDMCPPacket *packet)
 {
-    g_autofree gchar *address_string = socket_address_to_string (address);
-    g_debug ("Send %s to %s", xdmcp_packet_tostring (packet), address_string);
+    /* Only format packets when needed as this is expensive when there are many clients */
+    if (server->priv->log_packets)
+    {
+        g_autofree gchar *packet_string = xdmcp_packet_tostring (packet);
+        g_autofree gchar *address_string = socket_address_to_string (address);
+        g_debug ("Send %s to %s", packet_string, address_string);
+    }
 
     guint8 data[1024];
     gssize n_written = xdmcp_packet_encode (packet, data, 1024);
@@ -225,12 +578,19 @@ handle_query (XDMCPServer *server, GSocket *socket, GSocketAddress *address, gch
     }
 
     XDMCPPacket *response;
-    if (authentication_name)
+    if (authentication_name && have_max_pending_sessions (server))
+    {
+        response = xdmcp_packet_alloc (XDMCP_Unwilling);
+        response->Unwilling.hostname = g_strdup (server->priv->hostname);
+        response->Unwilling.status = g_strdup ("Too many pending sessions, try again later");
+    }
+    else if (authentication_name)
     {
+        g_autofree gchar *status = NULL;
         response = xdmcp_packet_alloc (XDMCP_Willing);
         response->Willing.authentication_name = g_strdup (authentication_name);
         response->Willing.hostname = g_strdup (server->priv->hostname);
-        response->Willing.status = g_strdup (server->priv->status);
+        response->Willing.status = g_strdup (get_willing_status (server, &status));
     }
     else
     {
@@ -242,7 +602,7 @@ handle_query (XDMCPServer *server, GSocket *socket, GSocketAddress *address, gch
             response->Unwilling.status = g_strdup ("No matching authentication");
     }
 
-    send_packet (socket, address, response);
+    send_packet (server, socket, address, response);
 
     xdmcp_packet_free (response);
 }
@@ -282,6 +642,210 @@ handle_forward_query (XDMCPServer *server, GSocket *socket, GSocketAddress *addr
     handle_query (server, socket, client_address, packet->ForwardQuery.authentication_names);
 }
 
+static GSocket *
+get_socket_for_family (XDMCPServer *server, GSocketFamily family)
+{
+    return family == G_SOCKET_FAMILY_IPV6 ? server->priv->socket6 : server->priv->socket;
+}
+
+/* Pick the least loaded host to answer a query, or NULL if this host is best */
+static ChooserHost *
+choose_host (XDMCPServer *server, GSocketFamily family)
+{
+    gint64 now = g_get_monotonic_time ();
+    gint64 max_age = (gint64) CHOOSER_HOST_TIMEOUT_POLLS * server->priv->chooser_poll_interval * G_USEC_PER_SEC;
+
+    ChooserHost *best_host = NULL;
+    const XDMCPLoad *best_load = get_load (server);
+    for (GList *link = server->priv->chooser_hosts; link; link = link->next)
+    {
+        ChooserHost *host = link->data;
+
+        /* Ignore hosts that aren't responding or can't be forwarded to */
+        if (host->load_time == 0 || now - host->load_time > max_age)
+            continue;
+        if (g_socket_address_get_family (host->address) != family || !get_socket_for_family (server, family))
+            continue;
+
+        if (compare_load (&host->load, best_load) < 0)
+        {
+            best_host = host;
+            best_load = &host->load;
+        }
+    }
+
+    return best_host;
+}
+
+static void
+handle_indirect_query (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XDMCPPacket *packet)
+{
+    GInetAddress *client_address = g_inet_socket_address_get_address (G_INET_SOCKET_ADDRESS (address));
+    ChooserHost *host = choose_host (server, g_inet_address_get_family (client_address));
+    if (!host)
+    {
+        handle_query (server, socket, address, packet->Query.authentication_names);
+        return;
+    }
+
+    /* Have the less loaded host answer the client directly */
+    g_debug ("Forwarding indirect query to less loaded host %s", host->name);
+    guint16 port = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (address));
+    XDMCPPacket *forward = xdmcp_packet_alloc (XDMCP_ForwardQuery);
+    forward->ForwardQuery.client_address.length = g_inet_address_get_native_size (client_address);
+    forward->ForwardQuery.client_address.data = g_malloc (forward->ForwardQuery.client_address.length);
+    memcpy (forward->ForwardQuery.client_address.data, g_inet_address_to_bytes (client_address), forward->ForwardQuery.client_address.length);
+    forward->ForwardQuery.client_port.length = 2;
+    forward->ForwardQuery.client_port.data = g_malloc (2);
+    forward->ForwardQuery.client_port.data[0] = port >> 8;
+    forward->ForwardQuery.client_port.data[1] = port & 0xFF;
+    forward->ForwardQuery.authentication_names = g_strdupv (packet->Query.authentication_names);
+    send_packet (server, get_socket_for_family (server, g_socket_address_get_family (host->address)), host->address, forward);
+    xdmcp_packet_free (forward);
+}
+
+static ChooserHost *
+find_chooser_host (XDMCPServer *server, GSocketAddress *address)
+{
+    GInetSocketAddress *inet_address = G_INET_SOCKET_ADDRESS (address);
+    for (GList *link = server->priv->chooser_hosts; link; link = link->next)
+    {
+        ChooserHost *host = link->data;
+        if (!host->address)
+            continue;
+        GInetSocketAddress *host_address = G_INET_SOCKET_ADDRESS (host->address);
+        if (g_inet_socket_address_get_port (host_address) == g_inet_socket_address_get_port (inet_address) &&
+            g_inet_address_equal (g_inet_socket_address_get_address (host_address), g_inet_socket_address_get_address (inet_address)))
+            return host;
+    }
+
+    return NULL;
+}
+
+static void
+handle_chooser_host_response (XDMCPServer *server, GSocketAddress *address, const gchar *status, gboolean willing)
+{
+    ChooserHost *host = find_chooser_host (server, address);
+    if (!host)
+    {
+        g_debug ("Ignoring XDMCP response from unknown host");
+        return;
+    }
+
+    /* Only accept one response to each query, and only while it is recent, so
+     * spoofed packets can't make a host appear less loaded whenever they like */
+    gint64 now = g_get_monotonic_time ();
+    if (host->query_time == 0 || now - host->query_time > (gint64) server->priv->chooser_poll_interval * G_USEC_PER_SEC)
+    {
+        g_debug ("Ignoring unexpected XDMCP response from chooser host %s", host->name);
+        return;
+    }
+    host->query_time = 0;
+
+    /* Unwilling hosts are treated as not responding so queries aren't sent to them */
+    if (willing && parse_load (status, &host->load))
+        host->load_time = now;
+    else
+        host->load_time = 0;
+}
+
+static void
+send_chooser_query (XDMCPServer *server, ChooserHost *host)
+{
+    GSocket *socket = get_socket_for_family (server, g_socket_address_get_family (host->address));
+    if (!socket)
+        return;
+
+    /* The answer arrives as a Willing packet. Other hosts are expected to share our key */
+    XDMCPPacket *query = xdmcp_packet_alloc (XDMCP_Query);
+    query->Query.authentication_names = g_new0 (gchar *, 2);
+    if (server->priv->key)
+        query->Query.authentication_names[0] = g_strdup (get_authentication_name (server));
+    send_packet (server, socket, host->address, query);
+    xdmcp_packet_free (query);
+
+    host->query_time = g_get_monotonic_time ();
+}
+
+static gboolean
+chooser_poll_cb (XDMCPServer *server)
+{
+    /* Ask each host for its load */
+    for (GList *link = server->priv->chooser_hosts; link; link = link->next)
+    {
+        ChooserHost *host = link->data;
+        if (host->address)
+            send_chooser_query (server, host);
+    }
+
+    return TRUE;
+}
+
+static void
+chooser_host_free (ChooserHost *host)
+{
+    g_free (host->name);
+    g_clear_object (&host->address);
+    g_free (host);
+}
+
+static void
+chooser_host_resolved_cb (GObject *object, GAsyncResult *result, gpointer data)
+{
+    ChooserHost *host = data;
+
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GSocketAddress) address = g_socket_address_enumerator_next_finish (G_SOCKET_ADDRESS_ENUMERATOR (object), result, &error);
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        return;
+
+    XDMCPServer *server = host->server;
+    if (!address)
+    {
+        g_warning ("Ignoring XDMCP chooser host %s: %s", host->name, error ? error->message : "No address found");
+        server->priv->chooser_hosts = g_list_remove (server->priv->chooser_hosts, host);
+        chooser_host_free (host);
+        return;
+    }
+
+    host->address = g_steal_pointer (&address);
+    send_chooser_query (server, host);
+}
+
+static void
+start_chooser (XDMCPServer *server)
+{
+    if (!server->priv->chooser_hosts)
+        return;
+
+    /* Look up the hosts in the background, each is queried once it has an address */
+    server->priv->chooser_cancellable = g_cancellable_new ();
+    GList *link = server->priv->chooser_hosts;
+    while (link)
+    {
+        ChooserHost *host = link->data;
+        GList *next_link = link->next;
+
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GSocketConnectable) connectable = g_network_address_parse (host->name, server->priv->port, &error);
+        if (connectable)
+        {
+            g_autoptr(GSocketAddressEnumerator) enumerator = g_socket_connectable_enumerate (connectable);
+            g_socket_address_enumerator_next_async (enumerator, server->priv->chooser_cancellable, chooser_host_resolved_cb, host);
+        }
+        else
+        {
+            g_warning ("Ignoring XDMCP chooser host %s: %s", host->name, error->message);
+            server->priv->chooser_hosts = g_list_delete_link (server->priv->chooser_hosts, link);
+            chooser_host_free (host);
+        }
+
+        link = next_link;
+    }
+
+    server->priv->chooser_poll_timeout = g_timeout_add_seconds (server->priv->chooser_poll_interval, (GSourceFunc) chooser_poll_cb, server);
+}
+
 static guint8
 atox (char c)
 {
@@ -496,7 +1060,7 @@ handle_request (XDMCPServer *server, GSocket *socket, GSocketAddress *address, X
         response->Decline.authentication_name = g_steal_pointer (&authentication_name);
         response->Decline.authentication_data.data = g_steal_pointer (&authentication_data);
         response->Decline.authentication_data.length = authentication_data_length;
-        send_packet (socket, address, response);
+        send_packet (server, socket, address, response);
         xdmcp_packet_free (response);
         return;
     }
@@ -582,7 +1146,7 @@ handle_request (XDMCPServer *server, GSocket *socket, GSocketAddress *address, X
     response->Accept.authorization_name = g_steal_pointer (&authorization_name);
     response->Accept.authorization_data.data = g_steal_pointer (&authorization_data);
     response->Accept.authorization_data.length = authorization_data_length;
-    send_packet (socket, address, response);
+    send_packet (server, socket, address, response);
     xdmcp_packet_free (response);
 }
 
@@ -594,7 +1158,7 @@ handle_manage (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XD
     {
         XDMCPPacket *response = xdmcp_packet_alloc (XDMCP_Refuse);
         response->Refuse.session_id = packet->Manage.session_id;
-        send_packet (socket, address, response);
+        send_packet (server, socket, address, response);
         xdmcp_packet_free (response);
         return;
     }
@@ -616,21 +1180,24 @@ handle_manage (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XD
         g_debug ("Received Manage for display number %d, but Request was %d", packet->Manage.display_number, session->priv->display_number);
         response = xdmcp_packet_alloc (XDMCP_Refuse);
         response->Refuse.session_id = packet->Manage.session_id;
-        send_packet (socket, address, response);
+        send_packet (server, socket, address, response);
         xdmcp_packet_free (response);
     }
 
     session->priv->display_class = g_strdup (packet->Manage.display_class);
 
+    /* Keep the session while it is being started, it is removed if the seat fails */
+    g_object_ref (session);
     gboolean result = FALSE;
     g_signal_emit (server, signals[NEW_SESSION], 0, session, &result);
-    if (result)
+    if (result && get_session (server, session->priv->id) == session)
     {
         /* Cancel the inactive timer */
-        if (session->priv->inactive_timeout)
-            g_source_remove (session->priv->inactive_timeout);
+        remove_pending_session (server, session);
 
         session->priv->started = TRUE;
+        session->priv->last_keep_alive_time = g_get_monotonic_time ();
+        server->priv->n_active_sessions++;
     }
     else
     {
@@ -639,9 +1206,10 @@ handle_manage (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XD
         response = xdmcp_packet_alloc (XDMCP_Failed);
         response->Failed.session_id = packet->Manage.session_id;
         response->Failed.status = g_strdup_printf ("Failed to connect to display :%d", packet->Manage.display_number);
-        send_packet (socket, address, response);
+        send_packet (server, socket, address, response);
         xdmcp_packet_free (response);
     }
+    g_object_unref (session);
 }
 
 static void
@@ -651,71 +1219,267 @@ handle_keep_alive (XDMCPServer *server, GSocket *socket, GSocketAddress *address
     XDMCPSession *session;
     gboolean alive = FALSE;
 
+    /* Only sessions that are running are alive, sessions are removed when they end */
     session = get_session (server, packet->KeepAlive.session_id);
-    if (session)
-        alive = TRUE; // FIXME: xdmcp_session_get_alive (session);
+    if (session && session->priv->started)
+    {
+        session->priv->last_keep_alive_time = g_get_monotonic_time ();
+        alive = TRUE;
+    }
 
     response = xdmcp_packet_alloc (XDMCP_Alive);
     response->Alive.session_running = alive;
     response->Alive.session_id = alive ? packet->KeepAlive.session_id : 0;
-    send_packet (socket, address, response);
+    send_packet (server, socket, address, response);
     xdmcp_packet_free (response);
 }
 
+static void
+prune_buckets (XDMCPServer *server, gint64 now)
+{
+    /* Only check occasionally, as this is expensive when many addresses are being tracked */
+    if (now - server->priv->last_prune_time < G_USEC_PER_SEC)
+        return;
+    server->priv->last_prune_time = now;
+
+    /* Forget buckets that have refilled, they are the same as new ones */
+    GHashTableIter iter;
+    g_hash_table_iter_init (&iter, server->priv->buckets);
+    gpointer value;
+    while (g_hash_table_iter_next (&iter, NULL, &value))
+    {
+        TokenBucket *bucket = value;
+        if (bucket->tokens + (gdouble) (now - bucket->last_time) * bucket->rate / G_USEC_PER_SEC >= server->priv->request_burst)
+            g_hash_table_iter_remove (&iter);
+    }
+}
+
+static gboolean
+take_token (XDMCPServer *server, const gchar *key, const gchar *overflow_key, guint rate)
+{
+    if (rate == 0)
+        return TRUE;
+
+    gint64 now = g_get_monotonic_time ();
+    TokenBucket *bucket = g_hash_table_lookup (server->priv->buckets, key);
+    if (bucket)
+    {
+        bucket->tokens = MIN (server->priv->request_burst, bucket->tokens + (gdouble) (now - bucket->last_time) * rate / G_USEC_PER_SEC);
+        bucket->last_time = now;
+    }
+    else
+    {
+        if (g_hash_table_size (server->priv->buckets) >= MAX_TOKEN_BUCKETS)
+            prune_buckets (server, now);
+
+        /* If still tracking too many then share a bucket rather than let them through unlimited */
+        if (g_hash_table_size (server->priv->buckets) >= MAX_TOKEN_BUCKETS && strcmp (key, overflow_key) != 0)
+            return take_token (server, overflow_key, overflow_key, rate);
+
+        bucket = g_malloc0 (sizeof (TokenBucket));
+        bucket->tokens = server->priv->request_burst;
+        bucket->rate = rate;
+        bucket->last_time = now;
+        g_hash_table_insert (server->priv->buckets, g_strdup (key), bucket);
+    }
+
+    if (bucket->tokens < 1)
+        return FALSE;
+    bucket->tokens -= 1;
+
+    return TRUE;
+}
+
+/* Get the IPv4 address for an IPv4-mapped IPv6 address (::ffff:a.b.c.d) so they are limited the same as IPv4 */
+static GInetAddress *
+unmap_address (GInetAddress *address)
+{
+    static const guint8 ipv4_mapped_prefix[12] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF };
+    const guint8 *data = g_inet_address_to_bytes (address);
+    if (g_inet_address_get_family (address) == G_SOCKET_FAMILY_IPV6 && memcmp (data, ipv4_mapped_prefix, sizeof (ipv4_mapped_prefix)) == 0)
+        return g_inet_address_new_from_bytes (data + sizeof (ipv4_mapped_prefix), G_SOCKET_FAMILY_IPV4);
+
+    return g_object_ref (address);
+}
+
+/* Get the /24 IPv4 or /64 IPv6 network an address is on */
+static gchar *
+get_subnet (GInetAddress *address)
+{
+    gsize length = g_inet_address_get_native_size (address);
+    gsize prefix_length = length == 4 ? 3 : 8;
+    guint8 data[16];
+    memcpy (data, g_inet_address_to_bytes (address), length);
+    memset (data + prefix_length, 0, length - prefix_length);
+
+    g_autoptr(GInetAddress) subnet = g_inet_address_new_from_bytes (data, g_inet_address_get_family (address));
+    g_autofree gchar *subnet_text = g_inet_address_to_string (subnet);
+    return g_strdup_printf ("%s/%zu", subnet_text, prefix_length * 8);
+}
+
+/* Check if a query or request from this address is within the rate limits */
+static gboolean
+check_request_rate (XDMCPServer *server, GSocketAddress *address)
+{
+    if (server->priv->address_rate == 0 && server->priv->subnet_rate == 0)
+        return TRUE;
+
+    g_autoptr(GInetAddress) inet_address = unmap_address (g_inet_socket_address_get_address (G_INET_SOCKET_ADDRESS (address)));
+    g_autofree gchar *address_text = g_inet_address_to_string (inet_address);
+    g_autofree gchar *subnet_text = get_subnet (inet_address);
+    return take_token (server, address_text, ADDRESS_OVERFLOW_BUCKET_KEY, server->priv->address_rate) &&
+           take_token (server, subnet_text, SUBNET_OVERFLOW_BUCKET_KEY, server->priv->subnet_rate);
+}
+
+static void
+handle_packet (XDMCPServer *server, GSocket *socket, GSocketAddress *address, XDMCPPacket *packet)
+{
+    if (server->priv->log_packets)
+    {
+        g_autofree gchar *packet_string = xdmcp_packet_tostring (packet);
+        g_autofree gchar *address_string = socket_address_to_string (address);
+        g_debug ("Got %s from %s", packet_string, address_string);
+    }
+
+    /* Limit packets that cause responses or allocate sessions */
+    switch (packet->opcode)
+    {
+    case XDMCP_BroadcastQuery:
+    case XDMCP_Query:
+    case XDMCP_IndirectQuery:
+    case XDMCP_ForwardQuery:
+    case XDMCP_Request:
+        if (!check_request_rate (server, address))
+        {
+            if (server->priv->log_packets)
+                g_debug ("Ignoring XDMCP packet, rate limit exceeded");
+            server->priv->n_packets_limited++;
+            return;
+        }
+        break;
+    default:
+        break;
+    }
+
+    switch (packet->opcode)
+    {
+    case XDMCP_BroadcastQuery:
+    case XDMCP_Query:
+        handle_query (server, socket, address, packet->Query.authentication_names);
+        break;
+    case XDMCP_IndirectQuery:
+        handle_indirect_query (server, socket, address, packet);
+        break;
+    case XDMCP_Willing:
+        handle_chooser_host_response (server, address, packet->Willing.status, TRUE);
+        break;
+    case XDMCP_Unwilling:
+        handle_chooser_host_response (server, address, packet->Unwilling.status, FALSE);
+        break;
+    case XDMCP_ForwardQuery:
+        handle_forward_query (server, socket, address, packet);
+        break;
+    case XDMCP_Request:
+        handle_request (server, socket, address, packet);
+        break;
+    case XDMCP_Manage:
+        handle_manage (server, socket, address, packet);
+        break;
+    case XDMCP_KeepAlive:
+        handle_keep_alive (server, socket, address, packet);
+        break;
+    default:
+        g_warning ("Got unexpected XDMCP packet %d", packet->opcode);
+        break;
+    }
+}
+
+/* Get the number of packets the kernel has dropped on this socket since it was opened */
+static void
+update_dropped_count (XDMCPServer *server, GSocket *socket, struct msghdr *header)
+{
+#ifdef SO_RXQ_OVFL
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR (header); cmsg; cmsg = CMSG_NXTHDR (header, cmsg))
+    {
+        if (cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SO_RXQ_OVFL)
+            continue;
+
+        guint32 n_dropped;
+        memcpy (&n_dropped, CMSG_DATA (cmsg), sizeof (n_dropped));
+        guint32 *count = socket == server->priv->socket6 ? &server->priv->n_packets_dropped6 : &server->priv->n_packets_dropped;
+        if (n_dropped != *count)
+            g_debug ("%u XDMCP packets dropped as socket buffer full", n_dropped - *count);
+        *count = n_dropped;
+    }
+#endif
+}
+
 static gboolean
 read_cb (GSocket *socket, GIOCondition condition, XDMCPServer *server)
 {
-    GSocketAddress *address;
-    gchar data[1024];
-    g_autoptr(GError) error = NULL;
-    gssize n_read;
+    /* Receive as many packets as are waiting, up to the batch size */
+    struct mmsghdr messages[MAX_RECEIVE_BATCH_SIZE];
+    struct iovec vectors[MAX_RECEIVE_BATCH_SIZE];
+    struct sockaddr_storage addresses[MAX_RECEIVE_BATCH_SIZE];
+    union
+    {
+        struct cmsghdr header;
+        guint8 data[CMSG_SPACE (sizeof (guint32))];
+    } controls[MAX_RECEIVE_BATCH_SIZE];
+    guint batch_size = server->priv->receive_batch_size;
+    memset (messages, 0, sizeof (struct mmsghdr) * batch_size);
+    for (guint i = 0; i < batch_size; i++)
+    {
+        vectors[i].iov_base = server->priv->receive_buffers + i * MAX_PACKET_LENGTH;
+        vectors[i].iov_len = MAX_PACKET_LENGTH;
+        messages[i].msg_hdr.msg_name = &addresses[i];
+        messages[i].msg_hdr.msg_namelen = sizeof (addresses[i]);
+        messages[i].msg_hdr.msg_iov = &vectors[i];
+        messages[i].msg_hdr.msg_iovlen = 1;
+        messages[i].msg_hdr.msg_control = &controls[i];
+        messages[i].msg_hdr.msg_controllen = sizeof (controls[i]);
+    }
 
-    n_read = g_socket_receive_from (socket, &address, data, 1024, NULL, &error);
-    if (error)
-        g_warning ("Failed to read from XDMCP socket: %s", error->message);
+    int n_messages;
+    do
+    {
+        n_messages = recvmmsg (g_socket_get_fd (socket), messages, batch_size, MSG_DONTWAIT, NULL);
+    } while (n_messages < 0 && errno == EINTR);
+    if (n_messages < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK)
+            g_warning ("Failed to read from XDMCP socket: %s", strerror (errno));
+        return TRUE;
+    }
 
-    if (n_read > 0)
+    for (int i = 0; i < n_messages; i++)
     {
-        XDMCPPacket *packet;
+        update_dropped_count (server, socket, &messages[i].msg_hdr);
 
-        packet = xdmcp_packet_decode ((guint8 *)data, n_read);
-        if (packet)
+        if (messages[i].msg_hdr.msg_flags & MSG_TRUNC)
         {
-            g_autofree gchar *packet_string = NULL;
-            g_autofree gchar *address_string = NULL;
-
-            packet_string = xdmcp_packet_tostring (packet);
-            address_string = socket_address_to_string (address);
-            g_debug ("Got %s from %s", packet_string, address_string);
-
-            switch (packet->opcode)
-            {
-            case XDMCP_BroadcastQuery:
-            case XDMCP_Query:
-            case XDMCP_IndirectQuery:
-                handle_query (server, socket, address, packet->Query.authentication_names);
-                break;
-            case XDMCP_ForwardQuery:
-                handle_forward_query (server, socket, address, packet);
-                break;
-            case XDMCP_Request:
-                handle_request (server, socket, address, packet);
-                break;
-            case XDMCP_Manage:
-                handle_manage (server, socket, address, packet);
-                break;
-            case XDMCP_KeepAlive:
-                handle_keep_alive (server, socket, address, packet);
-                break;
-            default:
-                g_warning ("Got unexpected XDMCP packet %d", packet->opcode);
-                break;
-            }
+            g_debug ("Ignoring XDMCP packet longer than %d octets", MAX_PACKET_LENGTH);
+            server->priv->n_packets_invalid++;
+            continue;
+        }
 
-            xdmcp_packet_free (packet);
+        g_autoptr(GSocketAddress) address = g_socket_address_new_from_native (&addresses[i], messages[i].msg_hdr.msg_namelen);
+        XDMCPPacket *packet = NULL;
+        if (address && messages[i].msg_len > 0)
+            packet = xdmcp_packet_decode_in_arena (vectors[i].iov_base, messages[i].msg_len, server->priv->arena);
+        if (!packet)
+        {
+            server->priv->n_packets_invalid++;
+            continue;
         }
+
+        handle_packet (server, socket, address, packet);
+        server->priv->n_packets_handled++;
     }
 
+    /* Packets are only used while being handled */
+    xdmcp_packet_arena_reset (server->priv->arena);
+
     return TRUE;
 }
 
@@ -746,6 +1510,11 @@ open_udp_socket (GSocketFamily family, guint port, const gchar *listen_address,
     if (!result)
         return NULL;
 
+#ifdef SO_RXQ_OVFL
+    /* Report how many packets are dropped when we can't keep up */
+    g_socket_set_option (socket, SOL_SOCKET, SO_RXQ_OVFL, 1, NULL);
+#endif
+
     return g_steal_pointer (&socket);
 }
 
@@ -754,6 +1523,8 @@ xdmcp_server_start (XDMCPServer *server)
 {
     g_return_val_if_fail (server != NULL, FALSE);
 
+    server->priv->receive_buffers = g_malloc (MAX_PACKET_LENGTH * server->priv->receive_batch_size);
+
     g_autoptr(GError) ipv4_error = NULL;
     server->priv->socket = open_udp_socket (G_SOCKET_FAMILY_IPV4, server->priv->port, server->priv->listen_address, &ipv4_error);
     if (ipv4_error)
@@ -781,6 +1552,8 @@ xdmcp_server_start (XDMCPServer *server)
     if (!server->priv->socket && !server->priv->socket6)
         return FALSE;
 
+    start_chooser (server);
+
     return TRUE;
 }
 
@@ -793,6 +1566,13 @@ xdmcp_server_init (XDMCPServer *server)
     server->priv->hostname = g_strdup ("");
     server->priv->status = g_strdup ("");
     server->priv->sessions = g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL, g_object_unref);
+    server->priv->receive_batch_size = 16;
+    server->priv->arena = xdmcp_packet_arena_new ();
+    server->priv->log_packets = TRUE;
+    server->priv->request_burst = 1;
+    server->priv->buckets = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+    g_queue_init (&server->priv->pending_sessions);
+    server->priv->chooser_poll_interval = 10;
 }
 
 static void
@@ -806,7 +1586,17 @@ xdmcp_server_finalize (GObject *object)
     g_clear_pointer (&self->priv->hostname, g_free);
     g_clear_pointer (&self->priv->status, g_free);
     g_clear_pointer (&self->priv->key, g_free);
+    g_queue_clear (&self->priv->pending_sessions);
     g_clear_pointer (&self->priv->sessions, g_hash_table_unref);
+    g_clear_pointer (&self->priv->buckets, g_hash_table_unref);
+    if (self->priv->chooser_poll_timeout)
+        g_source_remove (self->priv->chooser_poll_timeout);
+    if (self->priv->chooser_cancellable)
+        g_cancellable_cancel (self->priv->chooser_cancellable);
+    g_clear_object (&self->priv->chooser_cancellable);
+    g_list_free_full (self->priv->chooser_hosts, (GDestroyNotify) chooser_host_free);
+    g_clear_pointer (&self->priv->receive_buffers, g_free);
+    g_clear_pointer (&self->priv->arena, xdmcp_packet_arena_free);
 
     G_OBJECT_CLASS (xdmcp_server_parent_class)->finalize (object);
 }
@@ -60,6 +60,34 @@ const gchar *xdmcp_server_get_status (XDMCPServer *server);
 
 void xdmcp_server_set_key (XDMCPServer *server, const gchar *key);
 
+void xdmcp_server_set_receive_batch_size (XDMCPServer *server, guint size);
+
+void xdmcp_server_set_log_packets (XDMCPServer *server, gboolean log_packets);
+
+guint64 xdmcp_server_get_n_packets_handled (XDMCPServer *server);
+
+guint64 xdmcp_server_get_n_packets_invalid (XDMCPServer *server);
+
+guint64 xdmcp_server_get_n_packets_dropped (XDMCPServer *server);
+
+guint64 xdmcp_server_get_n_packets_limited (XDMCPServer *server);
+
+void xdmcp_server_set_request_rate (XDMCPServer *server, guint address_rate, guint subnet_rate, guint burst);
+
+void xdmcp_server_set_max_pending_sessions (XDMCPServer *server, guint max_pending_sessions);
+
+guint xdmcp_server_get_n_pending_sessions (XDMCPServer *server);
+
+void xdmcp_server_set_report_load (XDMCPServer *server, gboolean report_load);
+
+void xdmcp_server_add_chooser_host (XDMCPServer *server, const gchar *name);
+
+void xdmcp_server_set_chooser_poll_interval (XDMCPServer *server, guint interval);
+
+guint xdmcp_server_get_n_active_sessions (XDMCPServer *server);
+
+void xdmcp_server_remove_session (XDMCPServer *server, XDMCPSession *session);
+
 gboolean xdmcp_server_start (XDMCPServer *server);
 
 G_END_DECLS
@@ -27,10 +27,16 @@ struct XDMCPSessionPrivate
 
     guint inactive_timeout;
 
+    /* Link in the servers list of sessions waiting to be managed */
+    GList *pending_link;
+
     XAuthority *authority;
 
     gboolean started;
 
+    /* Time last KeepAlive (or Manage) received from the display */
+    gint64 last_keep_alive_time;
+
     guint16 display_number;
 
     gchar *display_class;
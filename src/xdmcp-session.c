@@ -66,6 +66,13 @@ xdmcp_session_get_display_class (XDMCPSession *session)
     return session->priv->display_class;
 }
 
+gint64
+xdmcp_session_get_last_keep_alive_time (XDMCPSession *session)
+{
+    g_return_val_if_fail (session != NULL, 0);
+    return session->priv->last_keep_alive_time;
+}
+
 static void
 xdmcp_session_init (XDMCPSession *session)
 {
@@ -51,6 +51,8 @@ guint16 xdmcp_session_get_display_number (XDMCPSession *session);
 
 const gchar *xdmcp_session_get_display_class (XDMCPSession *session);
 
+gint64 xdmcp_session_get_last_keep_alive_time (XDMCPSession *session);
+
 G_END_DECLS
 
 #endif /* XDMCP_SESSION_H_ */
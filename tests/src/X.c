@@ -229,6 +229,9 @@ request_cb (const gchar *name, GHashTable *params)
         signal (SIGUSR1, handler);
     }
 
+    else if (strcmp (name, "IGNORE-REQUESTS") == 0)
+        x_server_set_ignore_requests (xserver, TRUE);
+
     else if (strcmp (name, "SEND-QUERY") == 0)
     {
         if (!xdmcp_client_start (xdmcp_client))
@@ -242,6 +245,19 @@ request_cb (const gchar *name, GHashTable *params)
         xdmcp_client_send_query (xdmcp_client, authentication_names);
     }
 
+    else if (strcmp (name, "SEND-INDIRECT-QUERY") == 0)
+    {
+        if (!xdmcp_client_start (xdmcp_client))
+            quit (EXIT_FAILURE);
+
+        const gchar *authentication_names_list = g_hash_table_lookup (params, "AUTHENTICATION-NAMES");
+        if (!authentication_names_list)
+            authentication_names_list = "";
+        g_auto(GStrv) authentication_names = g_strsplit (authentication_names_list, " ", -1);
+
+        xdmcp_client_send_indirect_query (xdmcp_client, authentication_names);
+    }
+
     else if (strcmp (name, "SEND-REQUEST") == 0)
     {
         int request_display_number = display_number;
@@ -371,6 +387,7 @@ main (int argc, char **argv)
     gboolean do_xdmcp = FALSE;
     guint xdmcp_port = 0;
     const gchar *xdmcp_host = NULL;
+    const gchar *xdmcp_from = NULL;
     const gchar *seat = NULL;
     const gchar *mir_id = NULL;
     for (int i = 1; i < argc; i++)
@@ -434,6 +451,11 @@ main (int argc, char **argv)
             listen_tcp = TRUE;
             i++;
         }
+        else if (strcmp (arg, "-from") == 0)
+        {
+            xdmcp_from = argv[i+1];
+            i++;
+        }
         else if (strcmp (arg, "-broadcast") == 0)
         {
             do_xdmcp = TRUE;
@@ -484,6 +506,7 @@ main (int argc, char **argv)
                         "-nr                    (Ubuntu-specific) Synonym for -background none\n"
                         "-query host-name       Contact named host for XDMCP\n"
                         "-broadcast             Broadcast for XDMCP\n"
+                        "-from local-address    Send XDMCP packets from this address\n"
                         "-port port-num         UDP port number to send messages to\n"
                         "-seat string           seat to run on\n"
                         "-mir id                Mir ID to use\n"
@@ -592,6 +615,8 @@ main (int argc, char **argv)
             xdmcp_client_set_hostname (xdmcp_client, xdmcp_host);
         if (xdmcp_port > 0)
             xdmcp_client_set_port (xdmcp_client, xdmcp_port);
+        if (xdmcp_from)
+            xdmcp_client_set_local_address (xdmcp_client, xdmcp_from);
         g_signal_connect (xdmcp_client, XDMCP_CLIENT_SIGNAL_WILLING, G_CALLBACK (xdmcp_willing_cb), NULL);
         g_signal_connect (xdmcp_client, XDMCP_CLIENT_SIGNAL_UNWILLING, G_CALLBACK (xdmcp_unwilling_cb), NULL);
         g_signal_connect (xdmcp_client, XDMCP_CLIENT_SIGNAL_ACCEPT, G_CALLBACK (xdmcp_accept_cb), NULL);
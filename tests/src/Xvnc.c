@@ -7,6 +7,7 @@
 #include <fcntl.h>
 #include <errno.h>
 #include <gio/gio.h>
+#include <gio/gunixsocketaddress.h>
 #include <glib-unix.h>
 
 #include "status.h"
@@ -84,6 +85,48 @@ client_disconnected_cb (XServer *server, XClient *client)
     g_signal_handlers_disconnect_matched (client, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, NULL);
 }
 
+static gboolean
+vnc_client_data_cb (GSocket *socket, GIOCondition condition, gpointer data)
+{
+    gchar buffer[1024];
+    g_autoptr(GError) error = NULL;
+    gssize n_read = g_socket_receive (socket, buffer, 1023, NULL, &error);
+    if (n_read < 0)
+        g_warning ("Error reading from VNC client: %s", error->message);
+
+    /* Client protocol messages are ignored, the connection is kept until the client goes away */
+    if (n_read <= 0)
+    {
+        g_socket_close (socket, NULL);
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+vnc_accept_cb (GSocket *socket, GIOCondition condition, gpointer data)
+{
+    g_autoptr(GError) error = NULL;
+    g_autoptr(GSocket) client_socket = g_socket_accept (socket, NULL, &error);
+    if (!client_socket)
+    {
+        g_warning ("Failed to accept VNC connection: %s", error->message);
+        return G_SOURCE_CONTINUE;
+    }
+
+    /* Send server protocol version to client */
+    const gchar *version = "RFB 003.007\n";
+    if (g_socket_send (client_socket, version, strlen (version), NULL, &error) < 0)
+        g_warning ("Failed to write to VNC client: %s", error->message);
+
+    GSource *source = g_socket_create_source (client_socket, G_IO_IN, NULL);
+    g_source_set_callback (source, (GSourceFunc) vnc_client_data_cb, NULL, NULL);
+    g_source_attach (source, NULL);
+
+    return G_SOURCE_CONTINUE;
+}
+
 static gboolean
 vnc_data_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
 {
@@ -148,6 +191,7 @@ main (int argc, char **argv)
     g_unix_signal_add (SIGHUP, sighup_cb, NULL);
 
     gboolean use_inetd = FALSE;
+    const gchar *unix_path = NULL;
     gboolean has_option = FALSE;
     const gchar *geometry = "640x480";
     gint depth = 8;
@@ -187,6 +231,15 @@ main (int argc, char **argv)
         {
             use_inetd = TRUE;
         }
+        else if (strcmp (arg, "-rfbunixpath") == 0)
+        {
+            unix_path = argv[i+1];
+            i++;
+        }
+        else if (strcmp (arg, "-rfbport") == 0)
+        {
+            i++;
+        }
         else if (strcmp (arg, "-option") == 0)
         {
             has_option = TRUE;
@@ -199,7 +252,9 @@ main (int argc, char **argv)
                         "-nolisten protocol     Don't listen on protocol\n"
                         "-geometry WxH          Set framebuffer width & height\n"
                         "-depth D               Set framebuffer depth\n"
-                        "-inetd                 Xvnc is launched by inetd\n",
+                        "-inetd                 Xvnc is launched by inetd\n"
+                        "-rfbunixpath path      Listen for VNC connections on a Unix socket\n"
+                        "-rfbport port          TCP port to listen for VNC connections on\n",
                         arg, argv[0]);
             return EXIT_FAILURE;
         }
@@ -223,9 +278,26 @@ main (int argc, char **argv)
         if (!g_io_add_watch (g_io_channel_unix_new (STDIN_FILENO), G_IO_IN, vnc_data_cb, NULL))
             return EXIT_FAILURE;
     }
+    else if (unix_path)
+    {
+        g_autoptr(GError) error = NULL;
+        GSocket *vnc_socket = g_socket_new (G_SOCKET_FAMILY_UNIX, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_DEFAULT, &error);
+        g_autoptr(GSocketAddress) address = g_unix_socket_address_new (unix_path);
+        if (!vnc_socket ||
+            !g_socket_bind (vnc_socket, address, TRUE, &error) ||
+            !g_socket_listen (vnc_socket, &error))
+        {
+            g_printerr ("Failed to listen on VNC socket %s: %s\n", unix_path, error->message);
+            return EXIT_FAILURE;
+        }
+
+        GSource *source = g_socket_create_source (vnc_socket, G_IO_IN, NULL);
+        g_source_set_callback (source, (GSourceFunc) vnc_accept_cb, NULL, NULL);
+        g_source_attach (source, NULL);
+    }
     else
     {
-        g_printerr ("Only supported in -inetd mode\n");
+        g_printerr ("Only supported in -inetd or -rfbunixpath mode\n");
         return EXIT_FAILURE;
     }
 
@@ -24,9 +24,11 @@
 #include <utmpx.h>
 #ifdef __linux__
 #include <linux/vt.h>
+#include <sys/inotify.h>
 #endif
 #include <glib.h>
 #include <xcb/xcb.h>
+#include <xcb/xcbext.h>
 #include <gio/gunixsocketaddress.h>
 
 #if HAVE_LIBAUDIT
@@ -210,6 +212,9 @@ redirect_path (const gchar *path)
     if (g_str_has_prefix (path, "/usr/share/lightdm"))
         return g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "usr", "share", "lightdm", path + strlen ("/usr/share/lightdm"), NULL);
 
+    if (g_str_has_prefix (path, "/usr/lib/locale"))
+        return g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "usr", "lib", "locale", path + strlen ("/usr/lib/locale"), NULL);
+
     return g_strdup (path);
 }
 
@@ -374,6 +379,17 @@ opendir (const char *name)
     return _opendir (new_path);
 }
 
+#ifdef __linux__
+int
+inotify_add_watch (int fd, const char *pathname, uint32_t mask)
+{
+    int (*_inotify_add_watch) (int fd, const char *pathname, uint32_t mask) = dlsym (RTLD_NEXT, "inotify_add_watch");
+
+    g_autofree gchar *new_path = redirect_path (pathname);
+    return _inotify_add_watch (fd, new_path, mask);
+}
+#endif
+
 int
 mkdir (const char *pathname, mode_t mode)
 {
@@ -492,7 +508,7 @@ bind (int sockfd, const struct sockaddr *addr, socklen_t addrlen)
         break;
     case AF_INET:
         port = ntohs (((const struct sockaddr_in *) addr)->sin_port);
-        redirected_port = find_port_redirect (port);
+        redirected_port = port != 0 ? find_port_redirect (port) : 0;
         memcpy (&temp_addr_in, addr, sizeof (struct sockaddr_in));
         modified_addr = (struct sockaddr *) &temp_addr_in;
         if (redirected_port != 0)
@@ -502,7 +518,7 @@ bind (int sockfd, const struct sockaddr *addr, socklen_t addrlen)
         break;
     case AF_INET6:
         port = ntohs (((const struct sockaddr_in6 *) addr)->sin6_port);
-        redirected_port = find_port_redirect (port);
+        redirected_port = port != 0 ? find_port_redirect (port) : 0;
         memcpy (&temp_addr_in6, addr, sizeof (struct sockaddr_in6));
         modified_addr = (struct sockaddr *) &temp_addr_in6;
         if (redirected_port != 0)
@@ -514,6 +530,10 @@ bind (int sockfd, const struct sockaddr *addr, socklen_t addrlen)
 
     int retval = _bind (sockfd, modified_addr, addrlen);
 
+    /* Any free port was requested, so there's nothing to redirect later */
+    if (port == 0)
+        return retval;
+
     socklen_t temp_addr_len;
     switch (addr->sa_family)
     {
@@ -590,6 +610,25 @@ connect (int sockfd, const struct sockaddr *addr, socklen_t addrlen)
     return _connect (sockfd, modified_addr, addrlen);
 }
 
+int
+listen (int sockfd, int backlog)
+{
+    int (*_listen) (int sockfd, int backlog) = dlsym (RTLD_NEXT, "listen");
+
+    /* Only the daemon listens on TCP sockets */
+    struct sockaddr_storage addr;
+    socklen_t addr_len = sizeof (addr);
+    if (getsockname (sockfd, (struct sockaddr *) &addr, &addr_len) == 0 &&
+        (addr.ss_family == AF_INET || addr.ss_family == AF_INET6))
+    {
+        connect_status ();
+        if (g_key_file_get_boolean (config, "test-socket-config", "check-listen", NULL))
+            status_notify ("SOCKET LISTEN FAMILY=%s BACKLOG=%d", addr.ss_family == AF_INET ? "IPV4" : "IPV6", backlog);
+    }
+
+    return _listen (sockfd, backlog);
+}
+
 ssize_t
 sendto (int sockfd, const void *buf, size_t len, int flags, const struct sockaddr *dest_addr, socklen_t addrlen)
 {
@@ -649,6 +688,44 @@ close (int fd)
 }
 #endif
 
+/* Identifies a version of a file */
+typedef struct
+{
+    gboolean loaded;
+    dev_t dev;
+    ino_t ino;
+    off_t size;
+    struct timespec mtime;
+} FileStamp;
+
+/* Check if a file is different since it was last loaded, so large files aren't parsed on every lookup */
+static gboolean
+file_changed (const gchar *path, FileStamp *stamp)
+{
+    FileStamp new_stamp;
+    memset (&new_stamp, 0, sizeof (new_stamp));
+    new_stamp.loaded = TRUE;
+
+    struct stat file_stat;
+    if (stat (path, &file_stat) == 0)
+    {
+        new_stamp.dev = file_stat.st_dev;
+        new_stamp.ino = file_stat.st_ino;
+        new_stamp.size = file_stat.st_size;
+        new_stamp.mtime = file_stat.st_mtim;
+    }
+
+    gboolean changed = !stamp->loaded ||
+                       new_stamp.dev != stamp->dev ||
+                       new_stamp.ino != stamp->ino ||
+                       new_stamp.size != stamp->size ||
+                       new_stamp.mtime.tv_sec != stamp->mtime.tv_sec ||
+                       new_stamp.mtime.tv_nsec != stamp->mtime.tv_nsec;
+    *stamp = new_stamp;
+
+    return changed;
+}
+
 static void
 free_user (gpointer data)
 {
@@ -665,11 +742,15 @@ free_user (gpointer data)
 static void
 load_passwd_file (void)
 {
+    g_autofree gchar *path = g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "etc", "passwd", NULL);
+    static FileStamp stamp;
+    if (!file_changed (path, &stamp))
+        return;
+
     g_list_free_full (user_entries, free_user);
     user_entries = NULL;
     getpwent_link = NULL;
 
-    g_autofree gchar *path = g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "etc", "passwd", NULL);
     g_autofree gchar *data = NULL;
     g_autoptr(GError) error = NULL;
     if (!g_file_get_contents (path, &data, NULL, &error))
@@ -695,9 +776,10 @@ load_passwd_file (void)
             entry->pw_gecos = g_strdup (fields[4]);
             entry->pw_dir = g_strdup (fields[5]);
             entry->pw_shell = g_strdup (fields[6]);
-            user_entries = g_list_append (user_entries, entry);
+            user_entries = g_list_prepend (user_entries, entry);
         }
     }
+    user_entries = g_list_reverse (user_entries);
 }
 
 struct passwd *
@@ -776,10 +858,14 @@ free_group (gpointer data)
 static void
 load_group_file (void)
 {
+    g_autofree gchar *path = g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "etc", "group", NULL);
+    static FileStamp stamp;
+    if (!file_changed (path, &stamp))
+        return;
+
     g_list_free_full (group_entries, free_group);
     group_entries = NULL;
 
-    g_autofree gchar *path = g_build_filename (g_getenv ("LIGHTDM_TEST_ROOT"), "etc", "group", NULL);
     g_autofree gchar *data = NULL;
     g_autoptr(GError) error = NULL;
     if (!g_file_get_contents (path, &data, NULL, &error))
@@ -802,9 +888,10 @@ load_group_file (void)
             entry->gr_passwd = g_strdup (fields[1]);
             entry->gr_gid = atoi (fields[2]);
             entry->gr_mem = g_strsplit (fields[3], ",", -1);
-            group_entries = g_list_append (group_entries, entry);
+            group_entries = g_list_prepend (group_entries, entry);
         }
     }
+    group_entries = g_list_reverse (group_entries);
 }
 
 struct group *
@@ -1617,6 +1704,7 @@ struct xcb_connection_t
     gchar *display;
     int error;
     GSocket *socket;
+    unsigned int sequence;
 };
 
 xcb_connection_t *
@@ -1625,6 +1713,8 @@ xcb_connect_to_display_with_auth_info (const char *display, xcb_auth_info_t *aut
     xcb_connection_t *c = malloc (sizeof (xcb_connection_t));
     c->display = g_strdup (display);
     c->error = 0;
+    c->socket = NULL;
+    c->sequence = 0;
 
     if (display == NULL)
         display = getenv ("DISPLAY");
@@ -1676,6 +1766,57 @@ xcb_connection_has_error (xcb_connection_t *c)
     return c->error;
 }
 
+int
+xcb_get_file_descriptor (xcb_connection_t *c)
+{
+    return c->socket ? g_socket_get_fd (c->socket) : -1;
+}
+
+int
+xcb_flush (xcb_connection_t *c)
+{
+    return c->error == 0;
+}
+
+xcb_get_input_focus_cookie_t
+xcb_get_input_focus (xcb_connection_t *c)
+{
+    /* The test X server answers this with REPLY unless told to ignore requests */
+    const gchar *request = "GET-INPUT-FOCUS";
+    if (c->socket && g_socket_send (c->socket, request, strlen (request), NULL, NULL) < 0)
+        c->error = XCB_CONN_ERROR;
+
+    xcb_get_input_focus_cookie_t cookie = { ++c->sequence };
+    return cookie;
+}
+
+int
+xcb_poll_for_reply (xcb_connection_t *c, unsigned int request, void **reply, xcb_generic_error_t **error)
+{
+    *reply = NULL;
+    if (error)
+        *error = NULL;
+
+    if (!c->socket)
+        return 0;
+
+    /* Detect the X server going away, other data from the server is ignored */
+    gchar buffer[1024];
+    gssize n_read = g_socket_receive_with_blocking (c->socket, buffer, sizeof (buffer) - 1, FALSE, NULL, NULL);
+    if (n_read == 0)
+        c->error = XCB_CONN_ERROR;
+    if (n_read <= 0)
+        return 0;
+
+    buffer[n_read] = '\0';
+    if (!strstr (buffer, "REPLY"))
+        return 0;
+
+    /* The contents of the reply aren't used */
+    *reply = calloc (1, sizeof (xcb_get_input_focus_reply_t));
+    return 1;
+}
+
 void
 xcb_disconnect (xcb_connection_t *c)
 {
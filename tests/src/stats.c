@@ -0,0 +1,102 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stats.h"
+
+/* Order doubles, for sorting values with g_array_sort */
+gint
+stats_compare_double (gconstpointer a, gconstpointer b)
+{
+    gdouble value_a = *((const gdouble *) a), value_b = *((const gdouble *) b);
+    return value_a < value_b ? -1 : value_a > value_b ? 1 : 0;
+}
+
+/* Get a percentile from sorted values using the nearest rank */
+gdouble
+stats_get_percentile (GArray *values, guint percentile)
+{
+    if (values->len == 0)
+        return 0;
+    guint rank = (values->len * percentile + 99) / 100;
+    if (rank < 1)
+        rank = 1;
+    return g_array_index (values, gdouble, rank - 1);
+}
+
+/* Get a memory value of a process in kB (e.g. VmRSS), or -1 if unknown */
+gint
+stats_get_process_memory (pid_t pid, const gchar *name)
+{
+    g_autofree gchar *path = g_strdup_printf ("/proc/%d/status", pid);
+    g_autofree gchar *data = NULL;
+    if (!g_file_get_contents (path, &data, NULL, NULL))
+        return -1;
+
+    g_auto(GStrv) lines = g_strsplit (data, "\n", -1);
+    for (int i = 0; lines[i]; i++)
+        if (g_str_has_prefix (lines[i], name) && lines[i][strlen (name)] == ':')
+            return atoi (lines[i] + strlen (name) + 1);
+
+    return -1;
+}
+
+/* Get the fields of the stat file of a process that follow the command name */
+static gchar **
+get_process_stat (pid_t pid)
+{
+    g_autofree gchar *path = g_strdup_printf ("/proc/%d/stat", pid);
+    g_autofree gchar *data = NULL;
+    if (!g_file_get_contents (path, &data, NULL, NULL))
+        return NULL;
+
+    /* The command name is in brackets and may contain spaces */
+    const gchar *c = strrchr (data, ')');
+    if (!c || c[1] == '\0')
+        return NULL;
+
+    return g_strsplit (c + 2, " ", -1);
+}
+
+/* Get the user and system time a process has used in seconds, or 0 if unknown */
+gdouble
+stats_get_process_cpu_time (pid_t pid)
+{
+    g_auto(GStrv) fields = get_process_stat (pid);
+    if (!fields || g_strv_length (fields) < 13)
+        return 0;
+
+    /* utime and stime are fields 14 and 15 of the stat file */
+    gint64 ticks = g_ascii_strtoll (fields[11], NULL, 10) + g_ascii_strtoll (fields[12], NULL, 10);
+    return ticks / (gdouble) sysconf (_SC_CLK_TCK);
+}
+
+/* Get the parent of a process, or 0 if unknown */
+pid_t
+stats_get_process_parent (pid_t pid)
+{
+    g_auto(GStrv) fields = get_process_stat (pid);
+    if (!fields || g_strv_length (fields) < 2)
+        return 0;
+
+    /* The state is field 3 of the stat file, followed by the parent */
+    return atoi (fields[1]);
+}
+
+/* Check if a process was run with the given argument */
+gboolean
+stats_process_has_argument (pid_t pid, const gchar *argument)
+{
+    g_autofree gchar *path = g_strdup_printf ("/proc/%d/cmdline", pid);
+    g_autofree gchar *data = NULL;
+    gsize data_length;
+    if (!g_file_get_contents (path, &data, &data_length, NULL))
+        return FALSE;
+
+    for (gsize offset = 0; offset < data_length; offset += strlen (data + offset) + 1)
+        if (strcmp (data + offset, argument) == 0)
+            return TRUE;
+
+    return FALSE;
+}
@@ -0,0 +1,27 @@
+#ifndef STATS_H_
+#define STATS_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <sys/types.h>
+#include <glib.h>
+
+gint stats_compare_double (gconstpointer a, gconstpointer b);
+
+gdouble stats_get_percentile (GArray *values, guint percentile);
+
+gint stats_get_process_memory (pid_t pid, const gchar *name);
+
+gdouble stats_get_process_cpu_time (pid_t pid);
+
+pid_t stats_get_process_parent (pid_t pid);
+
+gboolean stats_process_has_argument (pid_t pid, const gchar *argument);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* STATS_H_ */
@@ -229,6 +229,15 @@ request_cb (const gchar *name, GHashTable *params)
     else if (strcmp (name, "START-SESSION") == 0)
         lightdm_greeter_start_session (greeter, g_hash_table_lookup (params, "SESSION"), NULL, start_session_finished, NULL);
 
+    else if (strcmp (name, "START-SESSION-SYNC") == 0)
+    {
+        g_autoptr(GError) error = NULL;
+        if (lightdm_greeter_start_session_sync (greeter, g_hash_table_lookup (params, "SESSION"), &error))
+            status_notify ("%s SESSION-STARTED", greeter_id);
+        else
+            status_notify ("%s SESSION-FAILED ERROR=%s", greeter_id, error->message);
+    }
+
     else if (strcmp (name, "LOG-DEFAULT-SESSION") == 0)
         status_notify ("%s LOG-DEFAULT-SESSION SESSION=%s", greeter_id, lightdm_greeter_get_default_session_hint (greeter));
 
@@ -315,6 +324,19 @@ request_cb (const gchar *name, GHashTable *params)
         }
     }
 
+    else if (strcmp (name, "LOG-USER-ROW") == 0)
+    {
+        const gchar *username = g_hash_table_lookup (params, "USERNAME");
+        GList *users = lightdm_user_list_get_users (lightdm_user_list_get_instance ());
+        int row = 0;
+        for (GList *link = users; link; link = link->next, row++)
+        {
+            LightDMUser *user = link->data;
+            if (strcmp (lightdm_user_get_name (user), username) == 0)
+                status_notify ("%s LOG-USER-ROW USERNAME=%s ROW=%d", greeter_id, username, row);
+        }
+    }
+
     else if (strcmp (name, "LOG-SESSIONS") == 0)
     {
         GList *sessions = lightdm_get_sessions ();
@@ -326,6 +348,15 @@ request_cb (const gchar *name, GHashTable *params)
         }
     }
 
+    else if (strcmp (name, "LOG-LANGUAGES") == 0)
+    {
+        for (GList *link = lightdm_get_languages (); link; link = link->next)
+        {
+            LightDMLanguage *language = link->data;
+            status_notify ("%s LOG-LANGUAGE CODE=%s", greeter_id, lightdm_language_get_code (language));
+        }
+    }
+
     else if (strcmp (name, "GET-CAN-SUSPEND") == 0)
     {
         gboolean can_suspend = lightdm_get_can_suspend ();
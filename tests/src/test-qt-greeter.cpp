@@ -189,6 +189,17 @@ request_cb (const gchar *name, GHashTable *params)
         }
     }
 
+    else if (strcmp (name, "LOG-USER-ROW") == 0)
+    {
+        const gchar *username = (const gchar *) g_hash_table_lookup (params, "USERNAME");
+        for (int i = 0; i < users_model->rowCount (QModelIndex ()); i++)
+        {
+            QString name = users_model->data (users_model->index (i, 0), QLightDM::UsersModel::NameRole).toString ();
+            if (name == username)
+                status_notify ("%s LOG-USER-ROW USERNAME=%s ROW=%d", greeter_id, qPrintable (name), i);
+        }
+    }
+
     else if (strcmp (name, "LOG-SESSIONS") == 0)
     {
         QStringList names;
@@ -10,6 +10,10 @@
 #include <gio/gunixsocketaddress.h>
 #include <unistd.h>
 #include <pwd.h>
+#include <utime.h>
+
+#include "stats.h"
+#include "x-common.h"
 
 /* Timeout in ms waiting for the status we expect */
 static int status_timeout_ms = 4000;
@@ -23,6 +27,8 @@ static GKeyFile *config;
 static GSocket *status_socket = NULL;
 static gchar *status_socket_name = NULL;
 static GList *statuses = NULL;
+/* Statuses that are not checked against the script */
+static GRegex *ignore_statuses = NULL;
 typedef struct
 {
     gchar *text;
@@ -60,6 +66,7 @@ typedef struct
     gboolean hidden;
 } AccountsUser;
 static GList *accounts_users = NULL;
+static GHashTable *accounts_users_by_uid = NULL;
 typedef struct
 {
     gchar *cookie;
@@ -103,6 +110,48 @@ typedef struct
 } StatusClient;
 static GList *status_clients = NULL;
 
+/* Phases of a login recorded when benchmarking, each is the first status matching the pattern */
+enum
+{
+    PHASE_X_READY,
+    PHASE_GREETER_CONNECTED,
+    PHASE_FIRST_PROMPT,
+    PHASE_AUTHENTICATED,
+    PHASE_SESSION_STARTED,
+    N_BENCHMARK_PHASES
+};
+typedef struct
+{
+    const gchar *name;
+    const gchar *pattern;
+} BenchmarkPhase;
+static const BenchmarkPhase benchmark_phases[N_BENCHMARK_PHASES] =
+{
+    { "x-ready",           "^(XSERVER|XMIR)-[^ ]+ INDICATE-READY" },
+    { "greeter-connected", "^GREETER-[^ ]+ CONNECTED-TO-DAEMON" },
+    { "first-prompt",      "^GREETER-[^ ]+ SHOW-PROMPT " },
+    { "authenticated",     "^GREETER-[^ ]+ AUTHENTICATION-COMPLETE .*AUTHENTICATED=TRUE" },
+    { "session-started",   "^SESSION-[^ ]+ START " }
+};
+
+/* Monotonic time the daemon was started and each phase was reached, 0 if not reached */
+static gint64 daemon_start_time = 0;
+static gint64 benchmark_phase_times[N_BENCHMARK_PHASES];
+static gchar *benchmark_script_name = NULL;
+
+/* Start times of intervals marked with BENCHMARK-START, keyed by name */
+static GHashTable *benchmark_marks = NULL;
+
+/* Extra values to record in the benchmark log, in order measured */
+static GString *benchmark_values = NULL;
+
+/* Another XDMCP host for the daemon to choose between, and the load it reports */
+static GSocket *xdmcp_host_socket = NULL;
+static gchar *xdmcp_host_status = NULL;
+
+/* First UID used for users made with generated-users */
+#define GENERATED_USER_UID 10000
+
 static void ready (void);
 static void quit (int status);
 static gboolean status_timeout_cb (gpointer data);
@@ -192,11 +241,221 @@ watch_process (pid_t pid)
     return process;
 }
 
+/* Append the times of this run to the log given in LIGHTDM_TEST_BENCHMARK_LOG */
+static void
+write_benchmark_result (void)
+{
+    const gchar *log_path = g_getenv ("LIGHTDM_TEST_BENCHMARK_LOG");
+    if (!log_path || daemon_start_time == 0)
+        return;
+
+    g_autoptr(GString) line = g_string_new (benchmark_script_name);
+    for (int i = 0; i < N_BENCHMARK_PHASES; i++)
+        if (benchmark_phase_times[i] != 0)
+            g_string_append_printf (line, " %s=%.6f", benchmark_phases[i].name, (benchmark_phase_times[i] - daemon_start_time) / (gdouble) G_USEC_PER_SEC);
+
+    /* Time from the greeter being usable to the user's session starting */
+    gint64 greeter_time = benchmark_phase_times[PHASE_GREETER_CONNECTED], session_time = benchmark_phase_times[PHASE_SESSION_STARTED];
+    if (greeter_time != 0 && session_time != 0)
+        g_string_append_printf (line, " greeter-to-session=%.6f", (session_time - greeter_time) / (gdouble) G_USEC_PER_SEC);
+    if (benchmark_values)
+        g_string_append (line, benchmark_values->str);
+    g_string_append_c (line, '\n');
+
+    FILE *log_file = fopen (log_path, "a");
+    if (!log_file)
+    {
+        g_printerr ("Failed to open benchmark log %s: %s\n", log_path, strerror (errno));
+        return;
+    }
+    fputs (line->str, log_file);
+    fclose (log_file);
+}
+
+static void
+add_benchmark_value (const gchar *name, gdouble value)
+{
+    if (!benchmark_values)
+        benchmark_values = g_string_new ("");
+    g_string_append_printf (benchmark_values, " %s=%.6f", name, value);
+}
+
+/* Count the daemon's session children that are waiting in a pool, and those
+ * that are running a session now but were waiting the last time this was
+ * called. Only children taken from a pool can be in the second group. */
+static void
+count_session_children (gint *n_idle, gint *n_reused)
+{
+    static GHashTable *idle_children = NULL;
+
+    *n_idle = 0;
+    *n_reused = 0;
+    if (!lightdm_process)
+        return;
+
+    g_autoptr(GHashTable) parents = g_hash_table_new (g_direct_hash, g_direct_equal);
+    g_autoptr(GDir) dir = g_dir_open ("/proc", 0, NULL);
+    const gchar *name;
+    while (dir && (name = g_dir_read_name (dir)))
+    {
+        pid_t pid = atoi (name);
+        if (pid > 0)
+            g_hash_table_insert (parents, GINT_TO_POINTER (pid), GINT_TO_POINTER (stats_get_process_parent (pid)));
+    }
+
+    GHashTable *new_idle_children = g_hash_table_new (g_direct_hash, g_direct_equal);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init (&iter, parents);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+    {
+        pid_t pid = GPOINTER_TO_INT (key);
+        if (GPOINTER_TO_INT (value) != lightdm_process->pid || !stats_process_has_argument (pid, "--session-child"))
+            continue;
+
+        /* Children running a session have the session process as a child */
+        gboolean is_running = FALSE;
+        GHashTableIter child_iter;
+        gpointer child_parent;
+        g_hash_table_iter_init (&child_iter, parents);
+        while (!is_running && g_hash_table_iter_next (&child_iter, NULL, &child_parent))
+            is_running = GPOINTER_TO_INT (child_parent) == pid;
+
+        if (!is_running)
+        {
+            (*n_idle)++;
+            g_hash_table_add (new_idle_children, key);
+        }
+        else if (idle_children && g_hash_table_contains (idle_children, key))
+            (*n_reused)++;
+    }
+
+    g_clear_pointer (&idle_children, g_hash_table_unref);
+    idle_children = new_idle_children;
+}
+
+static gboolean
+xdmcp_host_read_cb (GSocket *socket, GIOCondition condition, gpointer data)
+{
+    guint8 buffer[1024];
+    g_autoptr(GSocketAddress) address = NULL;
+    gssize n_read = g_socket_receive_from (socket, &address, (gchar *) buffer, sizeof (buffer), NULL, NULL);
+    if (n_read < 6)
+        return G_SOURCE_CONTINUE;
+
+    gsize offset = 0;
+    read_card16 (buffer, n_read, X_BYTE_ORDER_MSB, &offset); /* Version */
+    guint16 opcode = read_card16 (buffer, n_read, X_BYTE_ORDER_MSB, &offset);
+    read_card16 (buffer, n_read, X_BYTE_ORDER_MSB, &offset); /* Length */
+
+    /* Answer polls from the daemon with our load */
+    if (opcode == 2) /* Query */
+    {
+        guint8 willing[1024];
+        gsize length = 0;
+        write_card16 (willing, sizeof (willing), X_BYTE_ORDER_MSB, 1, &length); /* Version */
+        write_card16 (willing, sizeof (willing), X_BYTE_ORDER_MSB, 5, &length); /* Willing */
+        write_card16 (willing, sizeof (willing), X_BYTE_ORDER_MSB, 2 + 2 + strlen ("other-host") + 2 + strlen (xdmcp_host_status), &length);
+        write_card16 (willing, sizeof (willing), X_BYTE_ORDER_MSB, 0, &length); /* Authentication name */
+        write_card16 (willing, sizeof (willing), X_BYTE_ORDER_MSB, strlen ("other-host"), &length);
+        write_string (willing, sizeof (willing), "other-host", &length);
+        write_card16 (willing, sizeof (willing), X_BYTE_ORDER_MSB, strlen (xdmcp_host_status), &length);
+        write_string (willing, sizeof (willing), xdmcp_host_status, &length);
+        g_socket_send_to (socket, address, (const gchar *) willing, length, NULL, NULL);
+    }
+    /* Report the client the daemon wants us to answer */
+    else if (opcode == 4) /* ForwardQuery */
+    {
+        guint16 address_length = read_card16 (buffer, n_read, X_BYTE_ORDER_MSB, &offset);
+        if (address_length != 4 || offset + address_length > (gsize) n_read)
+            return G_SOURCE_CONTINUE;
+        g_autoptr(GInetAddress) client_address = g_inet_address_new_from_bytes (buffer + offset, G_SOCKET_FAMILY_IPV4);
+        g_autofree gchar *client_address_text = g_inet_address_to_string (client_address);
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER XDMCP-HOST GOT-FORWARD-QUERY CLIENT-ADDRESS=%s", client_address_text);
+        check_status (status_text);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+record_benchmark_phase (const gchar *status)
+{
+    if (daemon_start_time == 0)
+        return;
+
+    for (int i = 0; i < N_BENCHMARK_PHASES; i++)
+        if (benchmark_phase_times[i] == 0 && g_regex_match_simple (benchmark_phases[i].pattern, status, 0, 0))
+            benchmark_phase_times[i] = g_get_monotonic_time ();
+}
+
+/* Print statistics for each phase in a benchmark log */
+static int
+benchmark_report (const gchar *log_path)
+{
+    g_autofree gchar *data = NULL;
+    g_autoptr(GError) error = NULL;
+    if (!g_file_get_contents (log_path, &data, NULL, &error))
+    {
+        g_printerr ("Failed to read benchmark log: %s\n", error->message);
+        return EXIT_FAILURE;
+    }
+
+    /* Phases in the order they are first seen */
+    g_autoptr(GPtrArray) names = g_ptr_array_new ();
+    g_autoptr(GHashTable) phase_values = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, (GDestroyNotify) g_array_unref);
+    g_auto(GStrv) lines = g_strsplit (data, "\n", -1);
+    for (int i = 0; lines[i]; i++)
+    {
+        g_auto(GStrv) tokens = g_strsplit (lines[i], " ", -1);
+        for (int j = 1; tokens[0] && tokens[j]; j++)
+        {
+            gchar *value = strchr (tokens[j], '=');
+            if (!value)
+                continue;
+            *value = '\0';
+            value++;
+
+            GArray *values = g_hash_table_lookup (phase_values, tokens[j]);
+            if (!values)
+            {
+                gchar *name = g_strdup (tokens[j]);
+                values = g_array_new (FALSE, FALSE, sizeof (gdouble));
+                g_hash_table_insert (phase_values, name, values);
+                g_ptr_array_add (names, name);
+            }
+            gdouble v = g_ascii_strtod (value, NULL);
+            g_array_append_val (values, v);
+        }
+    }
+
+    for (guint i = 0; i < names->len; i++)
+    {
+        const gchar *name = g_ptr_array_index (names, i);
+        GArray *values = g_hash_table_lookup (phase_values, name);
+        g_array_sort (values, stats_compare_double);
+        g_print ("PHASE=%s RUNS=%u MIN=%.6f P50=%.6f P90=%.6f P99=%.6f MAX=%.6f\n",
+                 name, values->len,
+                 stats_get_percentile (values, 0),
+                 stats_get_percentile (values, 50),
+                 stats_get_percentile (values, 90),
+                 stats_get_percentile (values, 99),
+                 stats_get_percentile (values, 100));
+    }
+
+    return EXIT_SUCCESS;
+}
+
 static void
 quit (int status)
 {
     if (!stop)
+    {
         exit_status = status;
+        if (status == EXIT_SUCCESS)
+            write_benchmark_result ();
+    }
     stop = TRUE;
 
     /* Stop all the children */
@@ -436,6 +695,8 @@ handle_command (const gchar *command)
             quit (EXIT_FAILURE);
         }
         lightdm_process = watch_process (lightdm_pid);
+        if (daemon_start_time == 0)
+            daemon_start_time = g_get_monotonic_time ();
 
         check_status ("RUNNER DAEMON-START");
     }
@@ -621,6 +882,44 @@ handle_command (const gchar *command)
 
         check_status (status->str);
     }
+    else if (strcmp (name, "LIST-TIMINGS") == 0)
+    {
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GVariant) result = g_dbus_connection_call_sync (g_bus_get_sync (G_BUS_TYPE_SYSTEM, NULL, NULL),
+                                                                  "org.freedesktop.DisplayManager",
+                                                                  "/org/freedesktop/DisplayManager",
+                                                                  "org.freedesktop.DBus.Properties",
+                                                                  "Get",
+                                                                  g_variant_new ("(ss)", "org.freedesktop.DisplayManager", "Timings"),
+                                                                  G_VARIANT_TYPE ("(v)"),
+                                                                  G_DBUS_CALL_FLAGS_NONE,
+                                                                  G_MAXINT,
+                                                                  NULL,
+                                                                  &error);
+
+        g_autoptr(GString) status = g_string_new ("RUNNER LIST-TIMINGS");
+        if (result)
+        {
+            g_autoptr(GVariant) value = NULL;
+            g_variant_get (result, "(v)", &value);
+
+            /* Only the counts are reported, the durations vary between runs */
+            GVariantIter *iter;
+            g_variant_get (value, "a(stdadat)", &iter);
+
+            const gchar *phase;
+            guint64 count;
+            while (g_variant_iter_loop (iter, "(&stdadat)", &phase, &count, NULL, NULL, NULL))
+            {
+                g_autofree gchar *key = g_ascii_strup (phase, -1);
+                g_string_append_printf (status, " %s=%" G_GUINT64_FORMAT, key, count);
+            }
+        }
+        else
+            g_string_append_printf (status, " ERROR=%s", error->message);
+
+        check_status (status->str);
+    }
     else if (strcmp (name, "SEAT-CAN-SWITCH") == 0)
     {
         g_autoptr(GError) error = NULL;
@@ -778,6 +1077,233 @@ handle_command (const gchar *command)
             g_hash_table_insert (children, GINT_TO_POINTER (process->pid), process);
         }
     }
+    else if (strcmp (name, "START-XDMCP-HOST") == 0)
+    {
+        g_free (xdmcp_host_status);
+        xdmcp_host_status = g_strdup (g_hash_table_lookup (params, "STATUS"));
+        if (!xdmcp_host_status)
+            xdmcp_host_status = g_strdup ("");
+
+        /* Not run through libsystem, so this is the port the daemon sends to */
+        const gchar *v = g_hash_table_lookup (params, "PORT");
+        g_autoptr(GError) error = NULL;
+        g_autoptr(GInetAddress) inet_address = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+        g_autoptr(GSocketAddress) address = g_inet_socket_address_new (inet_address, v ? atoi (v) : 0);
+        xdmcp_host_socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_UDP, &error);
+        if (!xdmcp_host_socket || !g_socket_bind (xdmcp_host_socket, address, TRUE, &error))
+        {
+            g_printerr ("Failed to start XDMCP host: %s\n", error->message);
+            quit (EXIT_FAILURE);
+        }
+        else
+        {
+            GSource *source = g_socket_create_source (xdmcp_host_socket, G_IO_IN, NULL);
+            g_source_set_callback (source, (GSourceFunc) xdmcp_host_read_cb, NULL, NULL);
+            g_source_attach (source, NULL);
+        }
+    }
+    else if (strcmp (name, "SET-XDMCP-HOST-STATUS") == 0)
+    {
+        g_free (xdmcp_host_status);
+        xdmcp_host_status = g_strdup (g_hash_table_lookup (params, "STATUS"));
+        if (!xdmcp_host_status)
+            xdmcp_host_status = g_strdup ("");
+    }
+    else if (strcmp (name, "START-XDMCP-LOAD") == 0)
+    {
+        const gchar *load_args = g_hash_table_lookup (params, "ARGS");
+        if (!load_args)
+            load_args = "";
+        /* Options from the environment override the script so soak tests can be scaled up */
+        const gchar *extra_args = g_getenv ("LIGHTDM_TEST_XDMCP_LOAD_ARGS");
+        if (!extra_args)
+            extra_args = "";
+        g_autofree gchar *command_line = g_strdup_printf ("%s/tests/src/xdmcp-load --daemon-pid %d %s %s", BUILDDIR, lightdm_process ? lightdm_process->pid : 0, load_args, extra_args);
+
+        gchar **argv;
+        GPid pid;
+        g_autoptr(GError) error = NULL;
+        if (!g_shell_parse_argv (command_line, NULL, &argv, &error) ||
+            !g_spawn_async (NULL, argv, NULL, G_SPAWN_DO_NOT_REAP_CHILD, NULL, NULL, &pid, &error))
+        {
+            g_printerr ("Error starting XDMCP load generator: %s", error->message);
+            quit (EXIT_FAILURE);
+        }
+        else
+        {
+            Process *process = watch_process (pid);
+            g_hash_table_insert (children, GINT_TO_POINTER (process->pid), process);
+        }
+    }
+    else if (strcmp (name, "BENCHMARK-START") == 0)
+    {
+        const gchar *mark_name = g_hash_table_lookup (params, "NAME");
+        if (!benchmark_marks)
+            benchmark_marks = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_free);
+        gint64 *time = g_malloc (sizeof (gint64));
+        *time = g_get_monotonic_time ();
+        g_hash_table_insert (benchmark_marks, g_strdup (mark_name), time);
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER BENCHMARK-START NAME=%s", mark_name);
+        check_status (status_text);
+    }
+    else if (strcmp (name, "BENCHMARK-STOP") == 0)
+    {
+        const gchar *mark_name = g_hash_table_lookup (params, "NAME");
+        gint64 *time = benchmark_marks ? g_hash_table_lookup (benchmark_marks, mark_name) : NULL;
+        if (time)
+            add_benchmark_value (mark_name, (g_get_monotonic_time () - *time) / (gdouble) G_USEC_PER_SEC);
+        else
+            g_warning ("Unknown benchmark interval %s", mark_name);
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER BENCHMARK-STOP NAME=%s", mark_name);
+        check_status (status_text);
+    }
+    else if (strcmp (name, "LOG-DAEMON-RSS") == 0)
+    {
+        gint rss = lightdm_process ? stats_get_process_memory (lightdm_process->pid, "VmRSS") : -1;
+        if (rss >= 0)
+            add_benchmark_value ("daemon-rss-kb", rss);
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER DAEMON-RSS KB=%d", rss);
+        check_status (status_text);
+    }
+    else if (strcmp (name, "CHECK-DAEMON-LOG") == 0)
+    {
+        const gchar *match = g_hash_table_lookup (params, "MATCH");
+
+        /* Count the lines in the daemon log that match */
+        g_autofree gchar *path = g_build_filename (temp_dir, "var", "log", "lightdm", "lightdm.log", NULL);
+        g_autofree gchar *data = NULL;
+        g_autoptr(GRegex) regex = g_regex_new (match ? match : "", 0, 0, NULL);
+        int n_matches = 0;
+        if (regex && g_file_get_contents (path, &data, NULL, NULL))
+        {
+            g_auto(GStrv) lines = g_strsplit (data, "\n", -1);
+            for (int i = 0; lines[i]; i++)
+                if (lines[i][0] != '\0' && g_regex_match (regex, lines[i], 0, NULL))
+                    n_matches++;
+        }
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER CHECK-DAEMON-LOG MATCHES=%d", n_matches);
+        check_status (status_text);
+    }
+    else if (strcmp (name, "LIST-SESSION-CHILDREN") == 0)
+    {
+        gint n_idle, n_reused;
+        count_session_children (&n_idle, &n_reused);
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER LIST-SESSION-CHILDREN IDLE=%d REUSED=%d", n_idle, n_reused);
+        check_status (status_text);
+    }
+    else if (strcmp (name, "ADD-PASSWD-USER") == 0)
+    {
+        /* Append in place so the change is seen as a write to the password file */
+        const gchar *username = g_hash_table_lookup (params, "USERNAME");
+        const gchar *uid_text = g_hash_table_lookup (params, "UID");
+        guint uid = uid_text ? atoi (uid_text) : 2000;
+        const gchar *real_name = g_hash_table_lookup (params, "REAL-NAME");
+        g_autofree gchar *path = g_build_filename (temp_dir, "etc", "passwd", NULL);
+        FILE *passwd_file = fopen (path, "a");
+        if (passwd_file)
+        {
+            fprintf (passwd_file, "%s:password:%d:%d:%s:%s/home/%s:/bin/sh\n", username, uid, uid, real_name ? real_name : username, temp_dir, username);
+            fclose (passwd_file);
+        }
+        else
+            g_warning ("Failed to open %s: %s", path, strerror (errno));
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER ADD-PASSWD-USER USERNAME=%s", username);
+        check_status (status_text);
+    }
+    else if (strcmp (name, "DELETE-PASSWD-USER") == 0)
+    {
+        /* Rewrite in place so the change is seen as a write to the password file */
+        const gchar *username = g_hash_table_lookup (params, "USERNAME");
+        g_autofree gchar *path = g_build_filename (temp_dir, "etc", "passwd", NULL);
+        g_autofree gchar *data = NULL;
+        g_autoptr(GError) error = NULL;
+        if (g_file_get_contents (path, &data, NULL, &error))
+        {
+            g_autofree gchar *prefix = g_strdup_printf ("%s:", username);
+            g_auto(GStrv) lines = g_strsplit (data, "\n", -1);
+            FILE *passwd_file = fopen (path, "w");
+            if (passwd_file)
+            {
+                for (int i = 0; lines[i]; i++)
+                    if (lines[i][0] != '\0' && !g_str_has_prefix (lines[i], prefix))
+                        fprintf (passwd_file, "%s\n", lines[i]);
+                fclose (passwd_file);
+            }
+            else
+                g_warning ("Failed to open %s: %s", path, strerror (errno));
+        }
+        else
+            g_warning ("Failed to read %s: %s", path, error->message);
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER DELETE-PASSWD-USER USERNAME=%s", username);
+        check_status (status_text);
+    }
+    else if (strcmp (name, "UPDATE-DMRC") == 0)
+    {
+        /* Change the language in a .dmrc, optionally keeping the old modification time so a cache can't see the change */
+        const gchar *username = g_hash_table_lookup (params, "USERNAME");
+        const gchar *language = g_hash_table_lookup (params, "LANGUAGE");
+        gboolean keep_mtime = g_strcmp0 (g_hash_table_lookup (params, "KEEP-MTIME"), "TRUE") == 0;
+        g_autofree gchar *path = g_build_filename (temp_dir, "home", username, ".dmrc", NULL);
+
+        GStatBuf dmrc_stat;
+        time_t mtime = g_stat (path, &dmrc_stat) == 0 ? dmrc_stat.st_mtime : time (NULL);
+
+        g_autoptr(GKeyFile) dmrc_file = g_key_file_new ();
+        g_key_file_load_from_file (dmrc_file, path, G_KEY_FILE_NONE, NULL);
+        g_key_file_set_string (dmrc_file, "Desktop", "Language", language);
+        g_autofree gchar *data = g_key_file_to_data (dmrc_file, NULL, NULL);
+        g_file_set_contents (path, data, -1, NULL);
+
+        /* Move the time well forward otherwise so the change is seen within the same second */
+        struct utimbuf times;
+        times.actime = mtime;
+        times.modtime = keep_mtime ? mtime : mtime + 60;
+        if (utime (path, &times) < 0)
+            g_warning ("Failed to set modification time of %s: %s", path, strerror (errno));
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER UPDATE-DMRC USERNAME=%s", username);
+        check_status (status_text);
+    }
+    else if (strcmp (name, "ADD-LOCALE") == 0)
+    {
+        /* Install a compiled locale, optionally keeping the old modification time so a cache can't see the change */
+        const gchar *locale_name = g_hash_table_lookup (params, "NAME");
+        gboolean keep_mtime = g_strcmp0 (g_hash_table_lookup (params, "KEEP-MTIME"), "TRUE") == 0;
+        g_autofree gchar *dir = g_build_filename (temp_dir, "usr", "lib", "locale", NULL);
+        g_autofree gchar *locale_dir = g_build_filename (dir, locale_name, NULL);
+        g_autofree gchar *path = g_build_filename (locale_dir, "LC_IDENTIFICATION", NULL);
+
+        GStatBuf dir_stat;
+        time_t mtime = g_stat (dir, &dir_stat) == 0 ? dir_stat.st_mtime : time (NULL);
+
+        g_mkdir_with_parents (locale_dir, 0755);
+        g_file_set_contents (path, "", -1, NULL);
+
+        /* Move the time well forward otherwise so the change is seen within the same second */
+        struct utimbuf times;
+        times.actime = mtime;
+        times.modtime = keep_mtime ? mtime : mtime + 60;
+        if (utime (dir, &times) < 0)
+            g_warning ("Failed to set modification time of %s: %s", dir, strerror (errno));
+
+        g_autofree gchar *status_text = g_strdup_printf ("RUNNER ADD-LOCALE NAME=%s", locale_name);
+        check_status (status_text);
+    }
+    else if (strcmp (name, "DELETE-USER-CACHE") == 0)
+    {
+        g_autofree gchar *path = g_build_filename (temp_dir, "cache", "user-cache", NULL);
+        if (g_unlink (path) < 0)
+            g_warning ("Failed to delete %s: %s", path, strerror (errno));
+
+        check_status ("RUNNER DELETE-USER-CACHE");
+    }
     else if (strcmp (name, "ADD-USER") == 0)
     {
         const gchar *username = g_hash_table_lookup (params, "USERNAME");
@@ -896,6 +1422,7 @@ handle_command (const gchar *command)
              g_str_has_prefix (name, "XSERVER-") ||
              g_str_has_prefix (name, "XMIR-") ||
              g_str_has_prefix (name, "XVNC-") ||
+             strcmp (name, "VNC-CLIENT") == 0 ||
              strcmp (name, "UNITY-SYSTEM-COMPOSITOR") == 0)
     {
         for (GList *link = status_clients; link; link = link->next)
@@ -956,10 +1483,20 @@ check_status (const gchar *status)
         return;
 
     statuses = g_list_append (statuses, g_strdup (status));
+    record_benchmark_phase (status);
 
     if (getenv ("DEBUG"))
         g_print ("%s\n", status);
 
+    /* Load tests generate too many statuses to script, but they still show the test is progressing */
+    if (ignore_statuses && g_regex_match (ignore_statuses, status, 0, NULL))
+    {
+        if (status_timeout)
+            g_source_remove (status_timeout);
+        status_timeout = g_timeout_add (status_timeout_ms, status_timeout_cb, NULL);
+        return;
+    }
+
     /* Try and match against expected */
     g_autofree gchar *prefix = get_prefix (status);
     gboolean result = FALSE;
@@ -1906,14 +2443,9 @@ start_login1_daemon (void)
 static AccountsUser *
 get_accounts_user_by_uid (guint uid)
 {
-    for (GList *link = accounts_users; link; link = link->next)
-    {
-        AccountsUser *u = link->data;
-        if (u->uid == uid)
-            return u;
-    }
-
-    return NULL;
+    if (!accounts_users_by_uid)
+        return NULL;
+    return g_hash_table_lookup (accounts_users_by_uid, GUINT_TO_POINTER (uid));
 }
 
 static AccountsUser *
@@ -2138,6 +2670,11 @@ load_passwd_file (void)
     g_file_get_contents (path, &data, NULL, NULL);
     g_auto(GStrv) lines = g_strsplit (data, "\n", -1);
 
+    if (!accounts_users_by_uid)
+        accounts_users_by_uid = g_hash_table_new (g_direct_hash, g_direct_equal);
+
+    /* Collected separately so large password files don't take quadratic time */
+    GList *new_users = NULL;
     for (int i = 0; lines[i]; i++)
     {
         g_auto(GStrv) fields = g_strsplit (lines[i], ":", -1);
@@ -2152,7 +2689,8 @@ load_passwd_file (void)
         if (!user)
         {
             user = g_malloc0 (sizeof (AccountsUser));
-            accounts_users = g_list_append (accounts_users, user);
+            new_users = g_list_prepend (new_users, user);
+            g_hash_table_insert (accounts_users_by_uid, GUINT_TO_POINTER (uid), user);
 
             /* Only allow users in whitelist */
             user->hidden = FALSE;
@@ -2193,6 +2731,7 @@ load_passwd_file (void)
             accounts_user_set_hidden (user, user->hidden, FALSE);
         }
     }
+    accounts_users = g_list_concat (accounts_users, g_list_reverse (new_users));
 }
 
 static void
@@ -2307,6 +2846,45 @@ start_accounts_service_daemon (void)
                     NULL);
 }
 
+/* 1x1 transparent PNG, used as a face icon for generated users */
+static const guchar face_icon_data[] =
+{
+    0x89, 0x50, 0x4e, 0x47, 0x0d, 0x0a, 0x1a, 0x0a, 0x00, 0x00, 0x00, 0x0d,
+    0x49, 0x48, 0x44, 0x52, 0x00, 0x00, 0x00, 0x01, 0x00, 0x00, 0x00, 0x01,
+    0x08, 0x06, 0x00, 0x00, 0x00, 0x1f, 0x15, 0xc4, 0x89, 0x00, 0x00, 0x00,
+    0x0b, 0x49, 0x44, 0x41, 0x54, 0x78, 0x9c, 0x63, 0x60, 0x00, 0x02, 0x00,
+    0x00, 0x05, 0x00, 0x01, 0x7a, 0x5e, 0xab, 0x3f, 0x00, 0x00, 0x00, 0x00,
+    0x49, 0x45, 0x4e, 0x44, 0xae, 0x42, 0x60, 0x82
+};
+
+/* Add a synthetic user with a home directory, .dmrc and face icon */
+static void
+add_generated_user (const gchar *home_dir, int index, GString *passwd_data, GString *group_data)
+{
+    g_autofree gchar *user_name = g_strdup_printf ("generated-user%d", index);
+    guint uid = GENERATED_USER_UID + index;
+
+    g_autofree gchar *path = g_build_filename (home_dir, user_name, NULL);
+    g_mkdir_with_parents (path, 0755);
+
+    /* Vary the settings so the user list has different values to load */
+    g_autoptr(GKeyFile) dmrc_file = g_key_file_new ();
+    g_key_file_set_string (dmrc_file, "Desktop", "Session", index % 2 == 0 ? "default" : "alternative");
+    if (index % 3 == 0)
+        g_key_file_set_string (dmrc_file, "Desktop", "Language", "en_AU.utf8");
+    if (index % 5 == 0)
+        g_key_file_set_string (dmrc_file, "Desktop", "Layout", "us");
+    g_autofree gchar *dmrc_path = g_build_filename (path, ".dmrc", NULL);
+    g_autofree gchar *dmrc_data = g_key_file_to_data (dmrc_file, NULL, NULL);
+    g_file_set_contents (dmrc_path, dmrc_data, -1, NULL);
+
+    g_autofree gchar *face_path = g_build_filename (path, ".face", NULL);
+    g_file_set_contents (face_path, (const gchar *) face_icon_data, sizeof (face_icon_data), NULL);
+
+    g_string_append_printf (passwd_data, "%s:password:%d:%d:Generated User %d:%s/%s:/bin/sh\n", user_name, uid, uid, index, home_dir, user_name);
+    g_string_append_printf (group_data, "%s:x:%d:%s\n", user_name, uid, user_name);
+}
+
 static void
 ready (void)
 {
@@ -2402,9 +2980,13 @@ main (int argc, char **argv)
     if (argc != 3)
     {
         g_printerr ("Usage %s SCRIPT-NAME GREETER\n", argv[0]);
+        g_printerr ("      %s --benchmark-report LOG\n", argv[0]);
         quit (EXIT_FAILURE);
     }
+    if (strcmp (argv[1], "--benchmark-report") == 0)
+        return benchmark_report (argv[2]);
     const gchar *script_name = argv[1];
+    benchmark_script_name = g_strdup (script_name);
     g_autofree gchar *config_file = g_strdup_printf ("%s.conf", script_name);
     config_path = g_build_filename (SRCDIR, "tests", "scripts", config_file, NULL);
 
@@ -2701,6 +3283,12 @@ main (int argc, char **argv)
         /* Add group file entry */
         g_string_append_printf (group_data, "%s:x:%d:%s\n", users[i].user_name, users[i].uid, users[i].user_name);
     }
+
+    /* Make a large population of users for scale tests */
+    gint n_generated_users = g_key_file_get_integer (config, "test-runner-config", "generated-users", NULL);
+    for (int i = 0; i < n_generated_users; i++)
+        add_generated_user (home_dir, i, passwd_data, group_data);
+
     g_autofree gchar *passwd_path = g_build_filename (temp_dir, "etc", "passwd", NULL);
     g_file_set_contents (passwd_path, passwd_data->str, -1, NULL);
 
@@ -2713,6 +3301,18 @@ main (int argc, char **argv)
     if (g_key_file_has_key (config, "test-runner-config", "timeout", NULL))
         status_timeout_ms = g_key_file_get_integer (config, "test-runner-config", "timeout", NULL) * 1000;
 
+    g_autofree gchar *ignore_statuses_pattern = g_key_file_get_string (config, "test-runner-config", "ignore-statuses", NULL);
+    if (ignore_statuses_pattern)
+    {
+        g_autoptr(GError) error = NULL;
+        ignore_statuses = g_regex_new (ignore_statuses_pattern, G_REGEX_ANCHORED, 0, &error);
+        if (!ignore_statuses)
+        {
+            g_printerr ("Invalid ignore-statuses pattern: %s\n", error->message);
+            quit (EXIT_FAILURE);
+        }
+    }
+
     /* Start D-Bus services */
     if (!g_key_file_get_boolean (config, "test-runner-config", "disable-upower", NULL))
         start_upower_daemon ();
@@ -1,4 +1,5 @@
 #include <stdlib.h>
+#include <unistd.h>
 #include <glib.h>
 #include <glib-object.h>
 
@@ -20,7 +21,7 @@ main (int argc, char **argv)
 
     if (argc < 2)
     {
-        g_printerr ("Usage: %s text [return-value]\n", argv[0]);
+        g_printerr ("Usage: %s text [return-value] [delay]\n", argv[0]);
         return EXIT_FAILURE;
     }
 
@@ -30,6 +31,10 @@ main (int argc, char **argv)
         g_string_append_printf (status_text, " USER=%s", g_getenv ("USER"));
     status_notify ("%s", status_text->str);
 
+    /* Take time to complete so timeouts can be checked */
+    if (argc > 3)
+        sleep (atoi (argv[3]));
+
     if (argc > 2)
         return atoi (argv[2]);
     else
@@ -7,8 +7,82 @@
 
 #include "status.h"
 
+static GMainLoop *loop;
+static int exit_status = EXIT_SUCCESS;
+
 static GKeyFile *config;
 
+/* Connection to the VNC server */
+static GSocket *vnc_socket = NULL;
+
+/* TRUE once the server has sent its protocol version */
+static gboolean connected = FALSE;
+
+static void
+quit (int status)
+{
+    exit_status = status;
+    g_main_loop_quit (loop);
+}
+
+static gboolean
+socket_read_cb (GSocket *s, GIOCondition condition, gpointer data)
+{
+    gchar buffer[1024];
+    g_autoptr(GError) error = NULL;
+    gssize n_read = g_socket_receive (vnc_socket, buffer, 1023, NULL, &error);
+    if (n_read < 0)
+    {
+        g_warning ("Unable to receive on VNC socket: %s", error->message);
+        quit (EXIT_FAILURE);
+        return G_SOURCE_REMOVE;
+    }
+
+    if (n_read == 0)
+    {
+        status_notify ("VNC-CLIENT DISCONNECTED");
+        quit (EXIT_SUCCESS);
+        return G_SOURCE_REMOVE;
+    }
+
+    /* Only the protocol version is handled, anything else is ignored */
+    if (connected)
+        return G_SOURCE_CONTINUE;
+    connected = TRUE;
+
+    buffer[n_read] = '\0';
+    if (g_str_has_suffix (buffer, "\n"))
+        buffer[n_read-1] = '\0';
+    status_notify ("VNC-CLIENT CONNECTED VERSION=\"%s\"", buffer);
+
+    snprintf (buffer, 1024, "RFB 003.003\n");
+    gssize n_sent = g_socket_send (vnc_socket, buffer, strlen (buffer), NULL, &error);
+    if (n_sent != strlen (buffer))
+    {
+        g_warning ("Unable to send on VNC socket: %s", error ? error->message : "short write");
+        quit (EXIT_FAILURE);
+        return G_SOURCE_REMOVE;
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+request_cb (const gchar *name, GHashTable *params)
+{
+    if (!name)
+    {
+        g_main_loop_quit (loop);
+        return;
+    }
+
+    if (strcmp (name, "DISCONNECT") == 0)
+    {
+        g_socket_close (vnc_socket, NULL);
+        quit (EXIT_SUCCESS);
+    }
+}
+
 int
 main (int argc, char **argv)
 {
@@ -16,7 +90,9 @@ main (int argc, char **argv)
     g_type_init ();
 #endif
 
-    status_connect (NULL, NULL);
+    loop = g_main_loop_new (NULL, FALSE);
+
+    status_connect (request_cb, "VNC-CLIENT");
 
     status_notify ("VNC-CLIENT START");
 
@@ -26,56 +102,26 @@ main (int argc, char **argv)
     status_notify ("VNC-CLIENT CONNECT");
 
     g_autoptr(GError) error = NULL;
-    g_autoptr(GSocket) socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, &error);
-    if (!socket)
+    vnc_socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM, G_SOCKET_PROTOCOL_TCP, &error);
+    if (!vnc_socket)
     {
         g_warning ("Unable to make VNC socket: %s", error->message);
         return EXIT_FAILURE;
     }
 
     g_autoptr(GSocketAddress) address = g_inet_socket_address_new (g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4), 5900);
-    gboolean result = g_socket_connect (socket, address, NULL, &error);
+    gboolean result = g_socket_connect (vnc_socket, address, NULL, &error);
     if (!result)
     {
         g_warning ("Unable to connect VNC socket: %s", error->message);
         return EXIT_FAILURE;
     }
 
-    gchar buffer[1024];
-    gssize n_read = g_socket_receive (socket, buffer, 1023, NULL, &error);
-    if (n_read <= 0)
-    {
-        g_warning ("Unable to receive on VNC socket: %s", error->message);
-        return EXIT_FAILURE;
-    }
-
-    buffer[n_read] = '\0';
-    if (g_str_has_suffix (buffer, "\n"))
-        buffer[n_read-1] = '\0';
-    status_notify ("VNC-CLIENT CONNECTED VERSION=\"%s\"", buffer);
-
-    snprintf (buffer, 1024, "RFB 003.003\n");
-    gssize n_sent = g_socket_send (socket, buffer, strlen (buffer), NULL, &error);
-    if (n_sent != strlen (buffer))
-    {
-        g_warning ("Unable to send on VNC socket: %s", error->message);
-        return EXIT_FAILURE;
-    }
+    GSource *source = g_socket_create_source (vnc_socket, G_IO_IN, NULL);
+    g_source_set_callback (source, (GSourceFunc) socket_read_cb, NULL, NULL);
+    g_source_attach (source, NULL);
 
-    while (TRUE)
-    {
-        gssize n_read = g_socket_receive (socket, buffer, 1023, NULL, &error);
-        if (n_read < 0)
-        {
-            g_warning ("Unable to receive on VNC socket: %s", error->message);
-            return EXIT_FAILURE;
-        }
-
-        if (n_read == 0)
-        {
-            status_notify ("VNC-CLIENT DISCONNECTED");
-            return EXIT_SUCCESS;
-        }
-    }
+    g_main_loop_run (loop);
 
+    return exit_status;
 }
@@ -32,7 +32,11 @@ struct XServerPrivate
     gchar *socket_path;
     GSocket *socket;
     GIOChannel *channel;
+    guint watch;
     GHashTable *clients;
+
+    /* TRUE if requests are not answered, as if the server has hung */
+    gboolean ignore_requests;
 };
 
 struct XClientPrivate
@@ -40,6 +44,7 @@ struct XClientPrivate
     XServer *server;
     GSocket *socket;
     GIOChannel *channel;
+    guint watch;
 };
 
 enum
@@ -79,9 +84,21 @@ x_client_init (XClient *client)
     client->priv = G_TYPE_INSTANCE_GET_PRIVATE (client, x_client_get_type (), XClientPrivate);
 }
 
+static void
+x_client_finalize (GObject *object)
+{
+    XClient *client = (XClient *) object;
+    if (client->priv->watch)
+        g_source_remove (client->priv->watch);
+    g_clear_object (&client->priv->socket);
+    G_OBJECT_CLASS (x_client_parent_class)->finalize (object);
+}
+
 static void
 x_client_class_init (XClientClass *klass)
 {
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    object_class->finalize = x_client_finalize;
     g_type_class_add_private (klass, sizeof (XClientPrivate));
 
     x_client_signals[X_CLIENT_DISCONNECTED] =
@@ -106,25 +123,38 @@ static gboolean
 client_read_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
 {
     XClient *client = data;
+    XServer *server = client->priv->server;
+
+    gchar buffer[1024];
+    g_autoptr(GError) error = NULL;
+    gssize n_read = g_socket_receive_with_blocking (client->priv->socket, buffer, sizeof (buffer) - 1, FALSE, NULL, &error);
+    if (n_read < 0 && g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+        return G_SOURCE_CONTINUE;
 
-    g_autofree gchar *d = NULL;
-    gsize d_length;
-    if (g_io_channel_read_to_end (channel, &d, &d_length, NULL) == G_IO_STATUS_NORMAL && d_length == 0)
+    /* Answer the round trip requests made by the xcb stub in libsystem */
+    if (n_read > 0)
     {
-        XServer *server = client->priv->server;
+        buffer[n_read] = '\0';
+        if (!server->priv->ignore_requests && strstr (buffer, "GET-INPUT-FOCUS"))
+        {
+            const gchar *reply = "REPLY";
+            if (send (g_io_channel_unix_get_fd (client->priv->channel), reply, strlen (reply), 0) != strlen (reply))
+                g_printerr ("Failed to send REPLY: %s\n", strerror (errno));
+        }
+        return G_SOURCE_CONTINUE;
+    }
 
-        g_signal_emit (client, x_client_signals[X_CLIENT_DISCONNECTED], 0);
-        g_signal_emit (server, x_server_signals[X_SERVER_CLIENT_DISCONNECTED], 0, client);
+    /* Client has disconnected */
+    client->priv->watch = 0;
+    g_signal_emit (client, x_client_signals[X_CLIENT_DISCONNECTED], 0);
+    g_signal_emit (server, x_server_signals[X_SERVER_CLIENT_DISCONNECTED], 0, client);
 
-        g_hash_table_remove (server->priv->clients, client->priv->channel);
+    g_hash_table_remove (server->priv->clients, client->priv->channel);
 
-        if (g_hash_table_size (server->priv->clients) == 0)
-            g_signal_emit (server, x_server_signals[X_SERVER_RESET], 0);
+    if (g_hash_table_size (server->priv->clients) == 0)
+        g_signal_emit (server, x_server_signals[X_SERVER_RESET], 0);
 
-        return G_SOURCE_REMOVE;
-    }
-
-    return G_SOURCE_CONTINUE;
+    return G_SOURCE_REMOVE;
 }
 
 static gboolean
@@ -137,13 +167,16 @@ socket_connect_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
     if (error)
         g_warning ("Error accepting connection: %s", strerror (errno));
     if (!data_socket)
+    {
+        server->priv->watch = 0;
         return FALSE;
+    }
 
     XClient *client = g_object_new (x_client_get_type (), NULL);
     client->priv->server = server;
     client->priv->socket = g_steal_pointer (&data_socket);
     client->priv->channel = g_io_channel_unix_new (g_socket_get_fd (client->priv->socket));
-    g_io_add_watch (client->priv->channel, G_IO_IN | G_IO_HUP, client_read_cb, client);
+    client->priv->watch = g_io_add_watch (client->priv->channel, G_IO_IN | G_IO_HUP, client_read_cb, client);
     g_hash_table_insert (server->priv->clients, client->priv->channel, client);
 
     g_signal_emit (server, x_server_signals[X_SERVER_CLIENT_CONNECTED], 0, client);
@@ -167,11 +200,17 @@ x_server_start (XServer *server)
         return FALSE;
     }
     server->priv->channel = g_io_channel_unix_new (g_socket_get_fd (server->priv->socket));
-    g_io_add_watch (server->priv->channel, G_IO_IN, socket_connect_cb, server);
+    server->priv->watch = g_io_add_watch (server->priv->channel, G_IO_IN, socket_connect_cb, server);
 
     return TRUE;
 }
 
+void
+x_server_set_ignore_requests (XServer *server, gboolean ignore_requests)
+{
+    server->priv->ignore_requests = ignore_requests;
+}
+
 gsize
 x_server_get_n_clients (XServer *server)
 {
@@ -191,6 +230,15 @@ x_server_finalize (GObject *object)
     XServer *server = (XServer *) object;
     if (server->priv->socket_path)
         unlink (server->priv->socket_path);
+    g_clear_pointer (&server->priv->socket_path, g_free);
+
+    /* Close all connections so clients see the server go away */
+    if (server->priv->watch)
+        g_source_remove (server->priv->watch);
+    g_clear_pointer (&server->priv->clients, g_hash_table_unref);
+    g_clear_pointer (&server->priv->channel, g_io_channel_unref);
+    g_clear_object (&server->priv->socket);
+
     G_OBJECT_CLASS (x_server_parent_class)->finalize (object);
 }
 
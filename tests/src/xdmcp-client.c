@@ -35,7 +35,9 @@ struct XDMCPClientPrivate
 {
     gchar *host;
     gint port;
+    gchar *local_address;
     GSocket *socket;
+    guint watch;
     gchar *authentication_names;
     gchar *authorization_name;
     gint authorization_data_length;
@@ -193,6 +195,7 @@ xdmcp_data_cb (GIOChannel *channel, GIOCondition condition, gpointer data)
     else if (n_read == 0)
     {
         g_debug ("EOF");
+        client->priv->watch = 0;
         return FALSE;
     }
     else
@@ -266,6 +269,13 @@ xdmcp_client_set_port (XDMCPClient *client, guint16 port)
     client->priv->port = port;
 }
 
+void
+xdmcp_client_set_local_address (XDMCPClient *client, const gchar *local_address)
+{
+    g_free (client->priv->local_address);
+    client->priv->local_address = g_strdup (local_address);
+}
+
 gboolean
 xdmcp_client_start (XDMCPClient *client)
 {
@@ -279,6 +289,18 @@ xdmcp_client_start (XDMCPClient *client)
     if (!client->priv->socket)
         return FALSE;
 
+    /* Send from a chosen address, e.g. another loopback address to appear as a different host */
+    if (client->priv->local_address)
+    {
+        g_autoptr(GInetAddress) inet_address = g_inet_address_new_from_string (client->priv->local_address);
+        g_autoptr(GSocketAddress) local_address = inet_address ? g_inet_socket_address_new (inet_address, 0) : NULL;
+        if (!local_address || !g_socket_bind (client->priv->socket, local_address, TRUE, &error))
+        {
+            g_warning ("Unable to bind XDMCP socket to %s: %s", client->priv->local_address, error ? error->message : "Invalid address");
+            return FALSE;
+        }
+    }
+
     GSocketConnectable *address = g_network_address_new (client->priv->host, client->priv->port);
     GSocketAddressEnumerator *enumerator = g_socket_connectable_enumerate (address);
     while (TRUE)
@@ -296,7 +318,9 @@ xdmcp_client_start (XDMCPClient *client)
             continue;
         }
 
-        g_io_add_watch (g_io_channel_unix_new (g_socket_get_fd (client->priv->socket)), G_IO_IN, xdmcp_data_cb, client);
+        GIOChannel *channel = g_io_channel_unix_new (g_socket_get_fd (client->priv->socket));
+        client->priv->watch = g_io_add_watch (channel, G_IO_IN, xdmcp_data_cb, client);
+        g_io_channel_unref (channel);
 
         return TRUE;
     }
@@ -459,10 +483,14 @@ static void
 xdmcp_client_finalize (GObject *object)
 {
     XDMCPClient *client = (XDMCPClient *) object;
+    if (client->priv->watch)
+        g_source_remove (client->priv->watch);
     g_clear_pointer (&client->priv->host, g_free);
+    g_clear_pointer (&client->priv->local_address, g_free);
     g_clear_object (&client->priv->socket);
     g_clear_pointer (&client->priv->authorization_name, g_free);
     g_clear_pointer (&client->priv->authorization_data, g_free);
+    G_OBJECT_CLASS (xdmcp_client_parent_class)->finalize (object);
 }
 
 static void
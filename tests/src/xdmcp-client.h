@@ -85,6 +85,8 @@ void xdmcp_client_set_hostname (XDMCPClient *client, const gchar *hostname);
 
 void xdmcp_client_set_port (XDMCPClient *client, guint16 port);
 
+void xdmcp_client_set_local_address (XDMCPClient *client, const gchar *local_address);
+
 gboolean xdmcp_client_start (XDMCPClient *client);
 
 GInetAddress *xdmcp_client_get_local_address (XDMCPClient *client);
@@ -0,0 +1,553 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+#include "stats.h"
+#include "status.h"
+#include "x-server.h"
+#include "xdmcp-client.h"
+
+/* Simulates many XDMCP terminals logging into the daemon at once.
+ * Each terminal runs a test X server in this process, so the daemon and the
+ * greeters it starts connect to it as they would a real remote X server. */
+
+/* Retransmit timeouts, as used by the X server */
+#define RETRY_TIMEOUT_INITIAL 2
+#define RETRY_TIMEOUT_MAXIMUM 32
+#define MAXIMUM_RETRIES 5
+
+/* Time to wait for replies when checking for leaked sessions */
+#define LEAK_CHECK_TIMEOUT 3
+
+/* Time between progress reports */
+#define PROGRESS_INTERVAL 10
+
+typedef enum
+{
+    TERMINAL_WAITING,
+    TERMINAL_QUERY,
+    TERMINAL_REQUEST,
+    TERMINAL_MANAGE,
+    TERMINAL_RUNNING,
+    TERMINAL_STOPPED,
+    TERMINAL_FAILED
+} TerminalState;
+
+typedef struct
+{
+    guint16 display_number;
+    TerminalState state;
+
+    XDMCPClient *client;
+    XServer *xserver;
+
+    /* Session provided by the daemon */
+    guint32 session_id;
+
+    /* Time the first Request was sent */
+    gint64 request_time;
+
+    /* Retransmission of the last message */
+    guint retry_timeout;
+    guint retry_interval;
+    guint n_retries;
+
+    /* Timers while the session is running */
+    guint keep_alive_timeout;
+    guint stop_timeout;
+
+    /* TRUE if the daemon reported the session had ended while running */
+    gboolean session_lost;
+
+    /* TRUE if the daemon still reported the session after the terminal stopped */
+    gboolean leaked;
+} Terminal;
+
+static GMainLoop *loop;
+
+/* Options */
+static const gchar *host = "127.0.0.1";
+static guint16 port = XDMCP_PORT;
+static GInetAddress *address = NULL;
+static guint n_terminals = 100;
+static gdouble arrival_rate = 10;
+static gdouble loss_percent = 0;
+static guint keep_alive_interval = 10;
+static guint duration = 60;
+static guint settle_time = 5;
+static guint first_display_number = 100;
+static GPid daemon_pid = 0;
+
+static Terminal *terminals = NULL;
+static guint n_started = 0;
+static guint n_finished = 0;
+static gint64 start_time = 0;
+
+/* TRUE once all terminals have stopped and remaining sessions are being checked */
+static gboolean checking_leaks = FALSE;
+
+/* Seconds from Request to Accept */
+static GArray *accept_latencies = NULL;
+
+/* Counts of why terminals failed */
+static GHashTable *failures = NULL;
+
+/* Daemon resource use when the run started */
+static gdouble start_cpu_time = 0;
+static gint start_rss = 0;
+
+static gboolean
+drop_packet (void)
+{
+    return loss_percent > 0 && g_random_double_range (0, 100) < loss_percent;
+}
+
+static gdouble
+get_time (void)
+{
+    return (g_get_monotonic_time () - start_time) / (gdouble) G_USEC_PER_SEC;
+}
+
+static void
+write_report (void)
+{
+    guint n_managed = 0, n_lost = 0, n_leaked = 0;
+    for (guint i = 0; i < n_terminals; i++)
+    {
+        Terminal *terminal = &terminals[i];
+        if (terminal->session_id != 0 && terminal->state == TERMINAL_STOPPED)
+            n_managed++;
+        if (terminal->session_lost)
+            n_lost++;
+        if (terminal->leaked)
+            n_leaked++;
+    }
+    guint n_failed = n_terminals - n_managed;
+
+    gdouble run_time = get_time ();
+    gdouble cpu_time = stats_get_process_cpu_time (daemon_pid) - start_cpu_time;
+
+    g_array_sort (accept_latencies, stats_compare_double);
+
+    g_print ("Terminals: %u (%.1f/s, %.1f%% packet loss, KeepAlive every %us, %us sessions)\n",
+             n_terminals, arrival_rate, loss_percent, keep_alive_interval, duration);
+    g_print ("Run time: %.1fs\n", run_time);
+    g_print ("Managed: %u (%.1f%%)\n", n_managed, n_terminals > 0 ? n_managed * 100.0 / n_terminals : 0);
+    g_print ("Failed: %u\n", n_failed);
+    GHashTableIter iter;
+    gpointer key, value;
+    g_hash_table_iter_init (&iter, failures);
+    while (g_hash_table_iter_next (&iter, &key, &value))
+        g_print ("  %s: %d\n", (const gchar *) key, GPOINTER_TO_INT (value));
+    g_print ("Sessions lost while running: %u\n", n_lost);
+    g_print ("Sessions leaked after stopping: %u\n", n_leaked);
+    g_print ("Request to Accept: MIN=%.3f P50=%.3f P90=%.3f P99=%.3f MAX=%.3f\n",
+             stats_get_percentile (accept_latencies, 0),
+             stats_get_percentile (accept_latencies, 50),
+             stats_get_percentile (accept_latencies, 90),
+             stats_get_percentile (accept_latencies, 99),
+             stats_get_percentile (accept_latencies, 100));
+    if (daemon_pid != 0)
+    {
+        g_print ("Daemon CPU: %.2fs (%.1f%%)\n", cpu_time, run_time > 0 ? cpu_time * 100 / run_time : 0);
+        g_print ("Daemon memory: START=%dkB END=%dkB PEAK=%dkB\n", start_rss, stats_get_process_memory (daemon_pid, "VmRSS"), stats_get_process_memory (daemon_pid, "VmHWM"));
+    }
+
+    status_notify ("XDMCP-LOAD COMPLETE TERMINALS=%u MANAGED=%u FAILED=%u LOST=%u LEAKED=%u", n_terminals, n_managed, n_failed, n_lost, n_leaked);
+}
+
+static gboolean
+leak_check_timeout_cb (gpointer data)
+{
+    write_report ();
+    g_main_loop_quit (loop);
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+leak_check_cb (gpointer data)
+{
+    /* Sessions should have been removed when their X server went away */
+    checking_leaks = TRUE;
+    for (guint i = 0; i < n_terminals; i++)
+    {
+        Terminal *terminal = &terminals[i];
+        if (terminal->state == TERMINAL_STOPPED)
+            xdmcp_client_send_keep_alive (terminal->client, terminal->display_number, terminal->session_id);
+    }
+    g_timeout_add_seconds (LEAK_CHECK_TIMEOUT, leak_check_timeout_cb, NULL);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+finish_terminal (Terminal *terminal)
+{
+    if (terminal->retry_timeout)
+        g_source_remove (terminal->retry_timeout);
+    terminal->retry_timeout = 0;
+    if (terminal->keep_alive_timeout)
+        g_source_remove (terminal->keep_alive_timeout);
+    terminal->keep_alive_timeout = 0;
+    if (terminal->stop_timeout)
+        g_source_remove (terminal->stop_timeout);
+    terminal->stop_timeout = 0;
+
+    /* Closes all connections, which the daemon sees as the X server stopping */
+    g_clear_object (&terminal->xserver);
+
+    n_finished++;
+    if (n_finished == n_terminals)
+        g_timeout_add_seconds (settle_time, leak_check_cb, NULL);
+}
+
+static void
+fail_terminal (Terminal *terminal, const gchar *reason)
+{
+    if (terminal->state == TERMINAL_FAILED || terminal->state == TERMINAL_STOPPED)
+        return;
+
+    terminal->state = TERMINAL_FAILED;
+    gint count = GPOINTER_TO_INT (g_hash_table_lookup (failures, reason));
+    g_hash_table_insert (failures, (gpointer) reason, GINT_TO_POINTER (count + 1));
+
+    finish_terminal (terminal);
+}
+
+static void
+send_message (Terminal *terminal)
+{
+    if (drop_packet ())
+        return;
+
+    switch (terminal->state)
+    {
+    case TERMINAL_QUERY:
+        xdmcp_client_send_query (terminal->client, NULL);
+        break;
+    case TERMINAL_REQUEST:
+    {
+        GInetAddress *addresses[2] = { address, NULL };
+        gchar *authorization_names[2] = { (gchar *) "MIT-MAGIC-COOKIE-1", NULL };
+        xdmcp_client_send_request (terminal->client, terminal->display_number, addresses, "", NULL, 0, authorization_names, "");
+        break;
+    }
+    case TERMINAL_MANAGE:
+        xdmcp_client_send_manage (terminal->client, terminal->session_id, terminal->display_number, "");
+        break;
+    default:
+        break;
+    }
+}
+
+static gboolean
+retry_cb (gpointer data)
+{
+    Terminal *terminal = data;
+
+    terminal->retry_timeout = 0;
+    terminal->n_retries++;
+    if (terminal->n_retries > MAXIMUM_RETRIES)
+    {
+        switch (terminal->state)
+        {
+        case TERMINAL_QUERY:
+            fail_terminal (terminal, "No Willing");
+            break;
+        case TERMINAL_REQUEST:
+            fail_terminal (terminal, "No Accept");
+            break;
+        default:
+            fail_terminal (terminal, "Display not connected");
+            break;
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+    send_message (terminal);
+    terminal->retry_interval = MIN (terminal->retry_interval * 2, RETRY_TIMEOUT_MAXIMUM);
+    terminal->retry_timeout = g_timeout_add_seconds (terminal->retry_interval, retry_cb, terminal);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+set_state (Terminal *terminal, TerminalState state)
+{
+    terminal->state = state;
+
+    if (terminal->retry_timeout)
+        g_source_remove (terminal->retry_timeout);
+    terminal->retry_timeout = 0;
+    terminal->n_retries = 0;
+    terminal->retry_interval = RETRY_TIMEOUT_INITIAL;
+
+    send_message (terminal);
+    terminal->retry_timeout = g_timeout_add_seconds (terminal->retry_interval, retry_cb, terminal);
+}
+
+static gboolean
+keep_alive_cb (gpointer data)
+{
+    Terminal *terminal = data;
+
+    if (!drop_packet ())
+        xdmcp_client_send_keep_alive (terminal->client, terminal->display_number, terminal->session_id);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+stop_cb (gpointer data)
+{
+    Terminal *terminal = data;
+
+    terminal->stop_timeout = 0;
+    terminal->state = TERMINAL_STOPPED;
+    finish_terminal (terminal);
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+xdmcp_willing_cb (XDMCPClient *client, XDMCPWilling *message, Terminal *terminal)
+{
+    if (drop_packet () || terminal->state != TERMINAL_QUERY)
+        return;
+
+    terminal->request_time = g_get_monotonic_time ();
+    set_state (terminal, TERMINAL_REQUEST);
+}
+
+static void
+xdmcp_unwilling_cb (XDMCPClient *client, XDMCPUnwilling *message, Terminal *terminal)
+{
+    if (drop_packet () || terminal->state != TERMINAL_QUERY)
+        return;
+
+    fail_terminal (terminal, "Unwilling");
+}
+
+static void
+xdmcp_accept_cb (XDMCPClient *client, XDMCPAccept *message, Terminal *terminal)
+{
+    if (drop_packet () || terminal->state != TERMINAL_REQUEST)
+        return;
+
+    gdouble latency = (g_get_monotonic_time () - terminal->request_time) / (gdouble) G_USEC_PER_SEC;
+    g_array_append_val (accept_latencies, latency);
+
+    terminal->session_id = message->session_id;
+    set_state (terminal, TERMINAL_MANAGE);
+}
+
+static void
+xdmcp_decline_cb (XDMCPClient *client, XDMCPDecline *message, Terminal *terminal)
+{
+    if (drop_packet () || terminal->state != TERMINAL_REQUEST)
+        return;
+
+    fail_terminal (terminal, "Declined");
+}
+
+static void
+xdmcp_failed_cb (XDMCPClient *client, XDMCPFailed *message, Terminal *terminal)
+{
+    if (drop_packet () || terminal->state != TERMINAL_MANAGE)
+        return;
+
+    fail_terminal (terminal, "Failed");
+}
+
+static void
+xdmcp_alive_cb (XDMCPClient *client, XDMCPAlive *message, Terminal *terminal)
+{
+    if (checking_leaks)
+    {
+        if (message->session_running)
+            terminal->leaked = TRUE;
+        return;
+    }
+
+    if (drop_packet () || terminal->state != TERMINAL_RUNNING)
+        return;
+
+    if (!message->session_running)
+        terminal->session_lost = TRUE;
+}
+
+static void
+client_connected_cb (XServer *server, XClient *client, Terminal *terminal)
+{
+    x_client_send_success (client);
+
+    /* The daemon connecting is the only acknowledgement of a Manage */
+    if (terminal->state != TERMINAL_MANAGE)
+        return;
+
+    terminal->state = TERMINAL_RUNNING;
+    if (terminal->retry_timeout)
+        g_source_remove (terminal->retry_timeout);
+    terminal->retry_timeout = 0;
+    terminal->keep_alive_timeout = g_timeout_add_seconds (keep_alive_interval, keep_alive_cb, terminal);
+    terminal->stop_timeout = g_timeout_add_seconds (duration, stop_cb, terminal);
+}
+
+static void
+client_disconnected_cb (XServer *server, XClient *client)
+{
+    g_signal_handlers_disconnect_matched (client, G_SIGNAL_MATCH_DATA, 0, 0, NULL, NULL, NULL);
+}
+
+static void
+start_terminal (Terminal *terminal)
+{
+    terminal->xserver = x_server_new (terminal->display_number);
+    g_signal_connect (terminal->xserver, X_SERVER_SIGNAL_CLIENT_CONNECTED, G_CALLBACK (client_connected_cb), terminal);
+    g_signal_connect (terminal->xserver, X_SERVER_SIGNAL_CLIENT_DISCONNECTED, G_CALLBACK (client_disconnected_cb), NULL);
+    if (!x_server_start (terminal->xserver))
+    {
+        fail_terminal (terminal, "Unable to start X server");
+        return;
+    }
+
+    terminal->client = xdmcp_client_new ();
+    xdmcp_client_set_hostname (terminal->client, host);
+    xdmcp_client_set_port (terminal->client, port);
+    g_signal_connect (terminal->client, XDMCP_CLIENT_SIGNAL_WILLING, G_CALLBACK (xdmcp_willing_cb), terminal);
+    g_signal_connect (terminal->client, XDMCP_CLIENT_SIGNAL_UNWILLING, G_CALLBACK (xdmcp_unwilling_cb), terminal);
+    g_signal_connect (terminal->client, XDMCP_CLIENT_SIGNAL_ACCEPT, G_CALLBACK (xdmcp_accept_cb), terminal);
+    g_signal_connect (terminal->client, XDMCP_CLIENT_SIGNAL_DECLINE, G_CALLBACK (xdmcp_decline_cb), terminal);
+    g_signal_connect (terminal->client, XDMCP_CLIENT_SIGNAL_FAILED, G_CALLBACK (xdmcp_failed_cb), terminal);
+    g_signal_connect (terminal->client, XDMCP_CLIENT_SIGNAL_ALIVE, G_CALLBACK (xdmcp_alive_cb), terminal);
+    if (!xdmcp_client_start (terminal->client))
+    {
+        fail_terminal (terminal, "Unable to start XDMCP client");
+        return;
+    }
+
+    set_state (terminal, TERMINAL_QUERY);
+}
+
+static gboolean
+arrival_cb (gpointer data)
+{
+    /* Start terminals at the arrival rate, however late this callback runs */
+    guint n_due = MIN ((guint) (get_time () * arrival_rate) + 1, n_terminals);
+    while (n_started < n_due)
+        start_terminal (&terminals[n_started++]);
+
+    return n_started < n_terminals ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+}
+
+static gboolean
+progress_cb (gpointer data)
+{
+    guint n_running = 0;
+    for (guint i = 0; i < n_started; i++)
+        if (terminals[i].state == TERMINAL_RUNNING)
+            n_running++;
+    status_notify ("XDMCP-LOAD PROGRESS STARTED=%u RUNNING=%u FINISHED=%u", n_started, n_running, n_finished);
+
+    return G_SOURCE_CONTINUE;
+}
+
+static gboolean
+sigint_cb (gpointer user_data)
+{
+    write_report ();
+    g_main_loop_quit (loop);
+    return G_SOURCE_REMOVE;
+}
+
+int
+main (int argc, char **argv)
+{
+#if !defined(GLIB_VERSION_2_36)
+    g_type_init ();
+#endif
+
+    for (int i = 1; i < argc; i++)
+    {
+        const gchar *arg = argv[i];
+
+        if (strcmp (arg, "--host") == 0 && i < argc - 1)
+            host = argv[++i];
+        else if (strcmp (arg, "--port") == 0 && i < argc - 1)
+            port = atoi (argv[++i]);
+        else if (strcmp (arg, "--terminals") == 0 && i < argc - 1)
+            n_terminals = atoi (argv[++i]);
+        else if (strcmp (arg, "--arrival-rate") == 0 && i < argc - 1)
+            arrival_rate = g_ascii_strtod (argv[++i], NULL);
+        else if (strcmp (arg, "--loss") == 0 && i < argc - 1)
+            loss_percent = g_ascii_strtod (argv[++i], NULL);
+        else if (strcmp (arg, "--keep-alive") == 0 && i < argc - 1)
+            keep_alive_interval = atoi (argv[++i]);
+        else if (strcmp (arg, "--duration") == 0 && i < argc - 1)
+            duration = atoi (argv[++i]);
+        else if (strcmp (arg, "--settle") == 0 && i < argc - 1)
+            settle_time = atoi (argv[++i]);
+        else if (strcmp (arg, "--first-display") == 0 && i < argc - 1)
+            first_display_number = atoi (argv[++i]);
+        else if (strcmp (arg, "--daemon-pid") == 0 && i < argc - 1)
+            daemon_pid = atoi (argv[++i]);
+        else
+        {
+            g_printerr ("Unrecognized option: %s\n"
+                        "Use: %s [option...]\n"
+                        "  --host name              XDMCP server to connect to (default 127.0.0.1)\n"
+                        "  --port port              UDP port of the XDMCP server (default 177)\n"
+                        "  --terminals count        Number of terminals to simulate (default 100)\n"
+                        "  --arrival-rate rate      Terminals started per second (default 10)\n"
+                        "  --loss percent           Percentage of packets to drop (default 0)\n"
+                        "  --keep-alive seconds     Time between KeepAlive messages (default 10)\n"
+                        "  --duration seconds       Time each session runs for (default 60)\n"
+                        "  --settle seconds         Time to wait before checking for leaked sessions (default 5)\n"
+                        "  --first-display number   Display number of the first terminal (default 100)\n"
+                        "  --daemon-pid pid         Daemon to measure CPU and memory use of\n",
+                        arg, argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (n_terminals == 0 || arrival_rate <= 0 || keep_alive_interval == 0)
+    {
+        g_printerr ("Terminal count, arrival rate and KeepAlive interval must be greater than zero\n");
+        return EXIT_FAILURE;
+    }
+
+    /* Terminals give this as the address of their display */
+    address = g_inet_address_new_from_string (host);
+    if (!address)
+    {
+        g_printerr ("Host must be an IP address: %s\n", host);
+        return EXIT_FAILURE;
+    }
+
+    loop = g_main_loop_new (NULL, FALSE);
+
+    g_unix_signal_add (SIGINT, sigint_cb, NULL);
+
+    status_connect (NULL, NULL);
+
+    accept_latencies = g_array_new (FALSE, FALSE, sizeof (gdouble));
+    failures = g_hash_table_new (g_str_hash, g_str_equal);
+    terminals = g_new0 (Terminal, n_terminals);
+    for (guint i = 0; i < n_terminals; i++)
+        terminals[i].display_number = first_display_number + i;
+
+    start_cpu_time = stats_get_process_cpu_time (daemon_pid);
+    start_rss = stats_get_process_memory (daemon_pid, "VmRSS");
+
+    status_notify ("XDMCP-LOAD START TERMINALS=%u", n_terminals);
+
+    start_time = g_get_monotonic_time ();
+    if (arrival_cb (NULL))
+        g_timeout_add (10, arrival_cb, NULL);
+    g_timeout_add_seconds (PROGRESS_INTERVAL, progress_cb, NULL);
+
+    g_main_loop_run (loop);
+
+    return EXIT_SUCCESS;
+}